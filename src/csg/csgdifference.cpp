@@ -7,15 +7,10 @@
 //  
 //-------------------------------------------------------------------
 
-#include <algorithm>
-#include <xutility>
-
 #include "csgdifference.h"
 
-#define TOO_FAR_AWAY		 1000000.f 
-
 CSGDifference::CSGDifference(CSGNode *lh, CSGNode *rh)
-	: CSGOperation(lh, rh)
+	: CSGOperation(lh, rh, SPAN_DIFFERENCE)
 {
 }
 
@@ -23,83 +18,6 @@ CSGDifference::~CSGDifference()
 {
 }
 
-CIsect CSGDifference::intersect(const Ray& ray) 
-{
-	// Difference operation is LeftHand \ RightHand, obviously non-commutative
-
-	// Post-order depth-first tree traversal
-	CIsect lIsect  = l()->intersect(ray);
-	CIsect rIsect = r()->intersect(ray);
-
-	// Due to intersection, if one doesn't exist, no intersection at all
-	if (!lIsect.Exists)
-	{
-		return CIsect(false);
-	}
-
-	// Right not intersected, so just l intersection can be returned
-	if (!rIsect.Exists)
-	{
-		return lIsect;
-	}
-
-	// Get min and max intersections
-	float lMin  = TOO_FAR_AWAY, lMax  = -1.f;
-	float rMin = TOO_FAR_AWAY, rMax = -1.f;
-
-	// Sort intersections
-	std::sort(lIsect.Dst.begin(), lIsect.Dst.end());
-	std::sort(rIsect.Dst.begin(), rIsect.Dst.end());
-
-	lMin  = lIsect.Dst.front();  lMax  = lIsect.Dst.back();
-	rMin = rIsect.Dst.front(); rMax = rIsect.Dst.back();
-
-	CIsect intersect(true);
-
-	// Right object is closer, that l, so they even don't overlap
-	if (rMax < lMin)
-	{
-		return lIsect;
-	}
-
-	// Left object is closer, than r, so r object
-	if (lMax < rMin)
-	{
-		return lIsect;
-	}
-
-	
-	if (lMin < rMin)
-	{
-		intersect.Distance  = lMin;
-		intersect.Object	  = lIsect.Object;
-		intersect.Normal    = lIsect.Normal; 
-		intersect.U					= lIsect.U;
-		intersect.V					= lIsect.V;
-		intersect.TexCoords = lIsect.TexCoords;
-	}
-	else if (rMax < lMax)
-	{
-		intersect.Distance  = rMax;
-		intersect.Object	  = rIsect.Object;
-		intersect.Normal    = -rIsect.Normal; // Use normal of negative object
-		intersect.U					= lIsect.U;
-		intersect.V					= lIsect.V;
-		intersect.TexCoords = lIsect.TexCoords;
-	}
-	else 
-	{
-		return CIsect(false);
-	}
-
-	// Copy all the distances
-	intersect.Dst.resize(lIsect.Dst.size() + rIsect.Dst.size());
-	std::copy(lIsect.Dst.begin(), lIsect.Dst.end(), intersect.Dst.begin());
-	std::copy(rIsect.Dst.begin(), rIsect.Dst.end(), intersect.Dst.begin() + lIsect.Dst.size());
-
-	return intersect;
-}
-
 const Mtrl* CSGDifference::getMtrl() const
 {
 	return NULL;
@@ -107,7 +25,8 @@ const Mtrl* CSGDifference::getMtrl() const
 
 Vec3D CSGDifference::getNormal(const Ray& ray, float distance, const CIsect& isect/* = CIsect() */) const
 {
-	return isect.Normal;
+	// Normal is evaluated by the intersected leaf object
+	return isect.Object->getNormal(ray, distance, isect);
 }
 
 void CSGDifference::setIsLight(bool)
@@ -144,5 +63,11 @@ Color CSGDifference::getSpcColor(const Vec3D& pnt, const CIsect& isect /*= CIsec
 Vec3D CSGDifference::getTexCoords(const Vec3D& pnt, const CIsect& isect /*= CIsect()*/) const
 {
 	// Fallback to data, cached in intersection
-	return isect.Object->getTexCoords(pnt);
+	return isect.Object->getTexCoords(pnt, isect);
+}
+
+BBox CSGDifference::computeBounds() const
+{
+	// Difference can't be larger, than left operand
+	return l()->getBBox();
 }
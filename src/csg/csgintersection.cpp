@@ -7,15 +7,10 @@
 //  
 //-------------------------------------------------------------------
 
-#include <algorithm>
-#include <xutility>
-
 #include "csgintersection.h"
 
-#define TOO_FAR_AWAY		 1000000.f 
-
 CSGCIsect::CSGCIsect(CSGNode *lh, CSGNode *rh)
-	: CSGOperation(lh, rh)
+	: CSGOperation(lh, rh, SPAN_INTERSECTION)
 {
 }
 
@@ -23,67 +18,6 @@ CSGCIsect::~CSGCIsect()
 {
 }
 
-CIsect CSGCIsect::intersect(const Ray& ray) 
-{
-	// Post-order depth-first tree traversal
-	CIsect lIsect  = l()->intersect(ray);
-	CIsect rIsect = r()->intersect(ray);
-
-	// Due to intersection, if one doesn't exist, no intersection at all
-	if (!lIsect.Exists || !rIsect.Exists)
-	{
-		return CIsect(false);
-	}
-
-	// Get min and max intersections
-	float lMin  = TOO_FAR_AWAY, lMax  = -1.f;
-	float rMin = TOO_FAR_AWAY, rMax = -1.f;
-
-	// Sort intersections
-	std::sort(lIsect.Dst.begin(), lIsect.Dst.end());
-	std::sort(rIsect.Dst.begin(), rIsect.Dst.end());
-
-	lMin  = lIsect.Dst.front();  lMax  = lIsect.Dst.back();
-	rMin = rIsect.Dst.front(); rMax = rIsect.Dst.back();
-
-	CIsect intersect(true);
-
-	if (lMin < rMin && lMax > rMin)
-	{
-		intersect.Distance  = rMin;
-		intersect.Object	  = rIsect.Object;
-		intersect.Normal    = rIsect.Normal;
-		intersect.U					= rIsect.U;
-		intersect.V					= rIsect.V;
-		intersect.TexCoords = rIsect.TexCoords;
-		intersect.Dst.push_back(rMin);
-		intersect.Dst.push_back(std::min(lMax, rMax));
-	}
-	else if (rMin < lMin && rMax > lMin)
-	{
-		intersect.Distance  = lMin;
-		intersect.Object	  = lIsect.Object;
-		intersect.Normal    = lIsect.Normal;
-		intersect.U					= lIsect.U;
-		intersect.V					= lIsect.V;
-		intersect.TexCoords = lIsect.TexCoords;
-		intersect.Dst.push_back(lMin);
-		intersect.Dst.push_back(std::min(lMax, rMax));
-	}
-	else
-	{
-		return CIsect(false);
-	}
-	
-	
-	// Copy all the distances
-	/*intersect.Dst.resize(lIsect.Dst.size() + rIsect.Dst.size());
-	std::copy(lIsect.Dst.begin(), lIsect.Dst.end(), intersect.Dst.begin());
-	std::copy(rIsect.Dst.begin(), rIsect.Dst.end(), intersect.Dst.begin() + lIsect.Dst.size());*/
-
-	return intersect;
-}
-
 const Mtrl* CSGCIsect::getMtrl() const
 {
 	return NULL;
@@ -91,7 +25,8 @@ const Mtrl* CSGCIsect::getMtrl() const
 
 Vec3D CSGCIsect::getNormal(const Ray& ray, float distance, const CIsect& isect/* = CIsect() */) const
 {
-	return isect.Normal;
+	// Normal is evaluated by the intersected leaf object
+	return isect.Object->getNormal(ray, distance, isect);
 }
 
 void CSGCIsect::setIsLight(bool)
@@ -128,5 +63,11 @@ Color CSGCIsect::getSpcColor(const Vec3D& pnt, const CIsect& isect /*= CIsect()*
 Vec3D CSGCIsect::getTexCoords(const Vec3D& pnt, const CIsect& isect /*= CIsect()*/) const
 {
 	// Fallback to data, cached in intersection
-	return isect.Object->getTexCoords(pnt);
+	return isect.Object->getTexCoords(pnt, isect);
+}
+
+BBox CSGCIsect::computeBounds() const
+{
+	// Intersection is inside both operands
+	return l()->getBBox().overlap(r()->getBBox());
 }
@@ -0,0 +1,55 @@
+//-------------------------------------------------------------------
+// File: csgnaryunion.cpp
+// 
+// Constructive solid geometry evaluation tree union of several operands
+// Spans of operands are merged one by one, so the union is evaluated as the chain of binary unions
+//
+//  
+//-------------------------------------------------------------------
+
+#include "csgnaryunion.h"
+
+CSGNaryUnion::CSGNaryUnion(const std::vector< CSGNode* >& operands)
+	: CSGUnion(NULL, NULL),
+		mOperands(operands)
+{
+}
+
+CSGNaryUnion::~CSGNaryUnion()
+{
+}
+
+SpanList CSGNaryUnion::intersectSpans(const Ray& ray, SpanArena* arena)
+{
+	if (!mayHit(ray))
+	{
+		return SpanList();
+	}
+
+	SpanList spans = mOperands[0]->intersectSpans(ray, arena);
+	for (unsigned idx = 1; idx < mOperands.size(); ++idx)
+	{
+		spans = SpanCombine(arena, spans, mOperands[idx]->intersectSpans(ray, arena), SPAN_UNION);
+	}
+	return spans;
+}
+
+void CSGNaryUnion::updateBounds()
+{
+	for (unsigned idx = 0; idx < mOperands.size(); ++idx)
+	{
+		mOperands[idx]->updateBounds();
+	}
+	CSGUnion::updateBounds();
+}
+
+BBox CSGNaryUnion::computeBounds() const
+{
+	// Union may be anywhere inside all the operands
+	BBox box = BBox::Empty();
+	for (unsigned idx = 0; idx < mOperands.size(); ++idx)
+	{
+		box.extend(mOperands[idx]->getBBox());
+	}
+	return box;
+}
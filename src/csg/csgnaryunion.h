@@ -0,0 +1,30 @@
+#ifndef CSG_CSGNARYUNION_H
+#define CSG_CSGNARYUNION_H
+
+#include <vector>
+
+#include "csgunion.h"
+
+// Union of several operands, which are tested against its bounds only. Optimizer collapses nested unions into it,
+// when bounds of the nested unions hardly cull any rays. It has no left and right operands
+class CSGNaryUnion : public CSGUnion
+{
+public:
+	explicit CSGNaryUnion(const std::vector< CSGNode* >& operands);
+	virtual ~CSGNaryUnion();
+	virtual SpanList intersectSpans(const Ray& ray, SpanArena* arena);
+	virtual void updateBounds();
+
+	const std::vector< CSGNode* >& getOperands() const
+	{
+		return mOperands;
+	}
+
+protected:
+	virtual BBox computeBounds() const;
+
+private:
+	std::vector< CSGNode* > mOperands;
+};
+
+#endif
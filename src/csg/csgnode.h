@@ -2,6 +2,7 @@
 #define CSG_CSGNODE_H
 
 #include "geometry/intersection.h"
+#include "geometry/span.h"
 #include "interfaces/ishape.h"
 	
 class Ray;
@@ -13,5 +14,11 @@ struct CSGNode : IShape
 	virtual CSGNode* r() const = 0;
 	virtual bool hasL() const = 0;
 	virtual bool hasR() const = 0;
+
+	//! Update cached bounds of the subtree, bounds of children are updated first
+	virtual void updateBounds() = 0;
+
+	//! Get sorted spans of the ray, which are inside of the subtree, spans are stored in the arena
+	virtual SpanList intersectSpans(const Ray& ray, SpanArena* arena) = 0;
 };
 #endif
\ No newline at end of file
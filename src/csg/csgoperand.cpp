@@ -12,7 +12,8 @@
 #include "csgoperand.h"
 
 CSGOperand::CSGOperand(CSGNode* lh, CSGNode* rh)
-	: mLHand(lh),
+	: mBounds(BBox::Infinite()),
+		mLHand(lh),
 		mRHand(rh)
 {
 }
@@ -22,6 +23,20 @@ CSGOperand::~CSGOperand()
 	rmvChild();
 }
 
+void CSGOperand::updateBounds()
+{
+	// Bounds are computed once, when the tree is loaded, instead of merging the whole subtree on each query
+	if (mLHand)
+	{
+		mLHand->updateBounds();
+	}
+	if (mRHand)
+	{
+		mRHand->updateBounds();
+	}
+	mBounds = computeBounds();
+}
+
 void CSGOperand::rmvChild()
 {
 
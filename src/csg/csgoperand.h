@@ -1,6 +1,7 @@
 #ifndef CSG_CSGOPERAND_H
 #define CSG_CSGOPERAND_H
 
+#include "geometry/bbox.h"
 #include "csgnode.h"
 
 class CSGOperand : public CSGNode
@@ -25,8 +26,32 @@ public:
 	{
 		return mRHand != NULL;
 	}
+	virtual void updateBounds();
+
+	//! Replace operands, e.g. when the tree is optimized, bounds must be updated afterwards
+	void setOperands(CSGNode* lh, CSGNode* rh)
+	{
+		mLHand = lh;
+		mRHand = rh;
+	}
+
+	virtual BBox getBBox() const
+	{
+		return mBounds;
+	}
+
+protected:
+	//! Compute conservative bounds of the node from the already updated bounds of its children
+	virtual BBox computeBounds() const = 0;
+
+	//! Rays, which miss the bounds, can't hit anything in the subtree, so it isn't traversed at all
+	bool mayHit(const Ray& ray) const
+	{
+		return mBounds.intersect(ray);
+	}
 
 private:
+	BBox		 mBounds;
 	CSGNode *mLHand;
 	CSGNode *mRHand;
 };
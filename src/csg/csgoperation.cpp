@@ -0,0 +1,44 @@
+//-------------------------------------------------------------------
+// File: csgoperation.cpp
+// 
+// Constructive solid geometry evaluation tree operation
+// Operands are evaluated to sorted spans, which are inside of them, and the spans are merged by the operation
+//
+//  
+//-------------------------------------------------------------------
+
+#include "csgoperation.h"
+
+CSGOperation::CSGOperation(CSGNode* lh, CSGNode* rh, SpanOperation operation)
+	: CSGOperand(lh, rh),
+		mOperation(operation)
+{
+}
+
+CIsect CSGOperation::intersect(const Ray& ray, HitBuffer* hits)
+{
+	SpanArena&		 arena = SpanArena::local();
+	SpanArenaScope scope(&arena);
+
+	return SpanIntersection(arena, intersectSpans(ray, &arena), ray, hits);
+}
+
+SpanList CSGOperation::intersectSpans(const Ray& ray, SpanArena* arena)
+{
+	if (!mayHit(ray))
+	{
+		return SpanList();
+	}
+
+	// Post-order depth-first tree traversal
+	const SpanList lSpans = l()->intersectSpans(ray, arena);
+
+	// Intersection and difference are empty without the left operand, so right operand isn't even traversed
+	if (lSpans.Count == 0 && mOperation != SPAN_UNION)
+	{
+		return SpanList();
+	}
+
+	const SpanList rSpans = r()->intersectSpans(ray, arena);
+	return SpanCombine(arena, lSpans, rSpans, mOperation);
+}
@@ -3,13 +3,21 @@
 
 #include "csgoperand.h"
 
+// Operation combines spans of its operands, so it's evaluated the same way for all the operation types
 class CSGOperation : public CSGOperand
 {
 public:
-	explicit CSGOperation(CSGNode* lh, CSGNode* rh)
-		: CSGOperand(lh, rh)
+	explicit CSGOperation(CSGNode* lh, CSGNode* rh, SpanOperation operation);
+	virtual CIsect intersect(const Ray& ray, HitBuffer* hits = NULL);
+	virtual SpanList intersectSpans(const Ray& ray, SpanArena* arena);
+
+	SpanOperation getOperation() const
 	{
+		return mOperation;
 	}
+
+private:
+	SpanOperation mOperation;
 };
 
-#endif
\ No newline at end of file
+#endif
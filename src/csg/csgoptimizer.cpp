@@ -0,0 +1,314 @@
+//-------------------------------------------------------------------
+// File: csgoptimizer.cpp
+// 
+// Constructive solid geometry tree optimizer
+// Tree is rewritten bottom-up by the cached node bounds: provably empty subtrees are removed,
+// intersection operands are ordered by the estimated cost and nested unions are merged
+//
+//  
+//-------------------------------------------------------------------
+
+#include <algorithm>
+
+#include "geometry/cone.h"
+#include "geometry/cylinder.h"
+#include "geometry/model.h"
+#include "geometry/sphere.h"
+#include "geometry/torus.h"
+#include "csgnaryunion.h"
+#include "csgvalue.h"
+
+#include "csgoptimizer.h"
+
+namespace
+{
+	// Costs are relative to the ray test against the box
+	const float cBoundsCost	 = 1.f;
+	const float cCombineCost = 0.5f;
+
+	// Estimate of the subtree for the ray, which is traced against it
+	struct NodeEstimate
+	{
+		// Cost of the subtree evaluation
+		float Cost;
+		// Probability, that the ray hits the solid
+		float Coverage;
+	};
+
+	NodeEstimate GEstimateLeaf(const IShape* shape)
+	{
+		// Coverage of convex shapes is the ratio of their surface area to the area of their box
+		NodeEstimate estimate = {1.f, 1.f};
+		if (dynamic_cast< const Torus* >(shape))
+		{
+			// Quartic equation
+			estimate.Cost			= 8.f;
+			estimate.Coverage = 0.5f;
+		}
+		else if (dynamic_cast< const Model* >(shape))
+		{
+			// Mesh hierarchy traversal
+			estimate.Cost			= 6.f;
+			estimate.Coverage = 0.5f;
+		}
+		else if (dynamic_cast< const Cylinder* >(shape) || dynamic_cast< const Cone* >(shape))
+		{
+			// Side and caps
+			estimate.Cost			= 2.f;
+			estimate.Coverage = 0.7f;
+		}
+		else if (dynamic_cast< const Sphere* >(shape))
+		{
+			estimate.Coverage = 0.5f;
+		}
+		return estimate;
+	}
+
+	// Probability, that the ray, which hits the outer bounds, hits the inner bounds too
+	float GHitProbability(const BBox& inner, const BBox& outer)
+	{
+		const float outerArea = outer.getSurfaceArea();
+		if (!outer.isFinite() || outerArea <= 0.f)
+		{
+			return 1.f;
+		}
+		return std::min(inner.getSurfaceArea() / outerArea, 1.f);
+	}
+
+	void GGetOperands(const CSGNode* node, std::vector< CSGNode* >* operands)
+	{
+		if (const CSGNaryUnion* naryUnion = dynamic_cast< const CSGNaryUnion* >(node))
+		{
+			*operands = naryUnion->getOperands();
+		}
+		else if (node->hasL() && node->hasR())
+		{
+			operands->push_back(node->l());
+			operands->push_back(node->r());
+		}
+	}
+
+	NodeEstimate GEstimateNode(const CSGNode* node);
+
+	// Estimate of the operand, which is evaluated for the ray hitting bounds of its parent,
+	// operations test their own bounds first, leaves are tested directly
+	NodeEstimate GEstimateOperand(const CSGNode* operand, const BBox& parentBounds)
+	{
+		const float probability	= GHitProbability(operand->getBBox(), parentBounds);
+		NodeEstimate estimate		= GEstimateNode(operand);
+		if (!dynamic_cast< const CSGValue* >(operand))
+		{
+			estimate.Cost = cBoundsCost + probability * estimate.Cost;
+		}
+		estimate.Coverage *= probability;
+		return estimate;
+	}
+
+	// Estimate of the subtree for the ray, which hits its bounds
+	NodeEstimate GEstimateNode(const CSGNode* node)
+	{
+		if (const CSGValue* value = dynamic_cast< const CSGValue* >(node))
+		{
+			return GEstimateLeaf(value->getShape());
+		}
+
+		const BBox bounds = node->getBBox();
+		std::vector< CSGNode* > operands;
+		GGetOperands(node, &operands);
+
+		const CSGOperation* operation = static_cast< const CSGOperation* >(node);
+		if (operation->getOperation() == SPAN_UNION)
+		{
+			// All the operands are evaluated, union misses the ray, only if all of them miss it
+			NodeEstimate estimate	= {(operands.size() - 1) * cCombineCost, 0.f};
+			float miss						= 1.f;
+			for (unsigned idx = 0; idx < operands.size(); ++idx)
+			{
+				const NodeEstimate operand = GEstimateOperand(operands[idx], bounds);
+				estimate.Cost += operand.Cost;
+				miss *= 1.f - operand.Coverage;
+			}
+			estimate.Coverage = 1.f - miss;
+			return estimate;
+		}
+
+		// Right operand is evaluated, only if the ray hits the left one
+		const NodeEstimate lh	= GEstimateOperand(operands[0], bounds);
+		const NodeEstimate rh	= GEstimateOperand(operands[1], bounds);
+		NodeEstimate estimate	= {lh.Cost + lh.Coverage * (rh.Cost + cCombineCost), lh.Coverage};
+		if (operation->getOperation() == SPAN_INTERSECTION)
+		{
+			estimate.Coverage *= rh.Coverage;
+		}
+		return estimate;
+	}
+
+	void GDeleteSubtree(CSGNode* node)
+	{
+		if (!node)
+		{
+			return;
+		}
+		std::vector< CSGNode* > operands;
+		GGetOperands(node, &operands);
+		for (unsigned idx = 0; idx < operands.size(); ++idx)
+		{
+			GDeleteSubtree(operands[idx]);
+		}
+		delete node;
+	}
+
+	bool GAreDisjoint(const CSGNode* lh, const CSGNode* rh)
+	{
+		return lh->getBBox().overlap(rh->getBBox()).isEmpty();
+	}
+
+	bool GIsUnion(const CSGNode* node)
+	{
+		const CSGOperation* operation = dynamic_cast< const CSGOperation* >(node);
+		return operation && operation->getOperation() == SPAN_UNION;
+	}
+
+	// Put the operand of the union, which has given bounds, into the list of operands. Nested union is replaced
+	// by its operands, unless its bounds skip more tests of its operands, than they cost themselves
+	void GGatherUnion(CSGNode* operand, const BBox& bounds, std::vector< CSGNode* >* operands, std::vector< CSGNode* >* merged)
+	{
+		std::vector< CSGNode* > nested;
+		if (GIsUnion(operand))
+		{
+			GGetOperands(operand, &nested);
+		}
+
+		// Operands and their combination are skipped, if the ray misses the nested bounds
+		float skippedCost = nested.empty() ? 0.f : (nested.size() - 1) * cCombineCost;
+		for (unsigned idx = 0; idx < nested.size(); ++idx)
+		{
+			const CSGValue* value = dynamic_cast< const CSGValue* >(nested[idx]);
+			skippedCost += value ? GEstimateLeaf(value->getShape()).Cost : cBoundsCost;
+		}
+
+		if (nested.empty() || cBoundsCost < (1.f - GHitProbability(operand->getBBox(), bounds)) * skippedCost)
+		{
+			operands->push_back(operand);
+			return;
+		}
+		operands->insert(operands->end(), nested.begin(), nested.end());
+		merged->push_back(operand);
+	}
+
+	CSGNode* GCollapseUnion(CSGOperation* operation)
+	{
+		const BBox bounds = operation->getBBox();
+		std::vector< CSGNode* > operands;
+		std::vector< CSGNode* > merged;
+		GGatherUnion(operation->l(), bounds, &operands, &merged);
+		GGatherUnion(operation->r(), bounds, &operands, &merged);
+		if (merged.empty())
+		{
+			return operation;
+		}
+
+		// Merged unions don't own their operands, so they are deleted alone
+		CSGNaryUnion* naryUnion = new CSGNaryUnion(operands);
+		naryUnion->updateBounds();
+		for (unsigned idx = 0; idx < merged.size(); ++idx)
+		{
+			delete merged[idx];
+		}
+		delete operation;
+		return naryUnion;
+	}
+
+	// Both operands are evaluated, if the ray hits the left one, so the operand, which is cheaper
+	// or more likely to miss the ray, goes first
+	void GOrderIntersection(CSGOperation* operation)
+	{
+		const BBox bounds			= operation->getBBox();
+		const NodeEstimate lh	= GEstimateOperand(operation->l(), bounds);
+		const NodeEstimate rh	= GEstimateOperand(operation->r(), bounds);
+		if (rh.Cost + rh.Coverage * lh.Cost < lh.Cost + lh.Coverage * rh.Cost)
+		{
+			operation->setOperands(operation->r(), operation->l());
+		}
+	}
+
+	// Optimize the subtree bottom-up, returns its new root or NULL, if the subtree is empty
+	CSGNode* GOptimize(CSGNode* node)
+	{
+		// N-ary unions are made by the optimizer, so their operands are optimized already
+		if (dynamic_cast< CSGValue* >(node) || dynamic_cast< CSGNaryUnion* >(node))
+		{
+			return node;
+		}
+
+		CSGOperation* operation	= static_cast< CSGOperation* >(node);
+		CSGNode* lh							= GOptimize(operation->l());
+		CSGNode* rh							= GOptimize(operation->r());
+
+		switch (operation->getOperation())
+		{
+		case SPAN_UNION:
+			if (!lh || !rh)
+			{
+				delete operation;
+				return lh ? lh : rh;
+			}
+			break;
+		case SPAN_INTERSECTION:
+			if (!lh || !rh || GAreDisjoint(lh, rh))
+			{
+				GDeleteSubtree(lh);
+				GDeleteSubtree(rh);
+				delete operation;
+				return NULL;
+			}
+			break;
+		case SPAN_DIFFERENCE:
+			// Nothing is subtracted from the left operand, if the right one is outside of it
+			if (!lh || !rh || GAreDisjoint(lh, rh))
+			{
+				GDeleteSubtree(rh);
+				delete operation;
+				return lh;
+			}
+			break;
+		}
+
+		operation->setOperands(lh, rh);
+		operation->updateBounds();
+
+		if (operation->getOperation() == SPAN_INTERSECTION)
+		{
+			GOrderIntersection(operation);
+		}
+		else if (operation->getOperation() == SPAN_UNION)
+		{
+			return GCollapseUnion(operation);
+		}
+		return operation;
+	}
+}
+
+float CSGEstimateCost(const CSGNode* root)
+{
+	// Tree tests the ray against its bounds first
+	return cBoundsCost + GEstimateNode(root).Cost;
+}
+
+unsigned CSGCountNodes(const CSGNode* root)
+{
+	std::vector< CSGNode* > operands;
+	GGetOperands(root, &operands);
+
+	unsigned count = 1;
+	for (unsigned idx = 0; idx < operands.size(); ++idx)
+	{
+		count += CSGCountNodes(operands[idx]);
+	}
+	return count;
+}
+
+CSGNode* CSGOptimize(CSGNode* root)
+{
+	return GOptimize(root);
+}
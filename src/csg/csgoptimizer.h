@@ -0,0 +1,28 @@
+#ifndef CSG_CSGOPTIMIZER_H
+#define CSG_CSGOPTIMIZER_H
+
+struct CSGNode;
+
+// Estimated cost and size of the tree before and after optimization
+struct CSGOptimizeStats
+{
+	float		 CostBefore;
+	float		 CostAfter;
+	unsigned NodesBefore;
+	unsigned NodesAfter;
+};
+
+//! Estimate average cost of the ray, which is traced against the tree, in units of the ray test against the box.
+//! Cost depends on the order of operands, because intersection and difference skip the right operand,
+//! if the ray misses the left one
+float CSGEstimateCost(const CSGNode* root);
+
+//! Count all the nodes of the tree, leaves included
+unsigned CSGCountNodes(const CSGNode* root);
+
+//! Optimize the tree with updated bounds, so the result is the same solid, which is evaluated faster.
+//! Nodes are reordered, merged and deleted, so the returned root replaces the given one,
+//! it's NULL, if bounds prove that the whole tree is empty
+CSGNode* CSGOptimize(CSGNode* root);
+
+#endif
@@ -0,0 +1,148 @@
+//-------------------------------------------------------------------
+// File: csgprogram.cpp
+// 
+// Constructive solid geometry tree, compiled to the postfix program
+// Operands are followed by their operation, so spans of operands are on the stack top, when it's evaluated
+//
+//  
+//-------------------------------------------------------------------
+
+#include <algorithm>
+
+#include "csgnaryunion.h"
+#include "csgvalue.h"
+
+#include "csgprogram.h"
+
+bool CSGProgram::compile(const CSGNode* root)
+{
+	mInstructions.clear();
+
+	// Tree tests the ray against root bounds before the program is evaluated
+	if (compileNode(root, false, NULL) > CSG_STACK_SIZE)
+	{
+		mInstructions.clear();
+		return false;
+	}
+	return true;
+}
+
+unsigned CSGProgram::compileNode(const CSGNode* node, bool testBounds, std::vector< unsigned >* emptyJumps)
+{
+	CSGInstruction instruction;
+	instruction.Opcode		= CSG_OP_LEAF;
+	instruction.Operation = SPAN_UNION;
+	instruction.Jump			= 0;
+	instruction.Shape			= NULL;
+	instruction.Bounds		= node->getBBox();
+
+	if (const CSGValue* value = dynamic_cast< const CSGValue* >(node))
+	{
+		if (emptyJumps)
+		{
+			emptyJumps->push_back(mInstructions.size());
+		}
+		instruction.Shape = value->getShape();
+		mInstructions.push_back(instruction);
+		return 1;
+	}
+
+	// Whole subtree is skipped, if the ray misses its bounds, as nodes do
+	const unsigned bounds = mInstructions.size();
+	if (testBounds)
+	{
+		instruction.Opcode = CSG_OP_BOUNDS;
+		mInstructions.push_back(instruction);
+	}
+
+	unsigned depth = 0;
+	std::vector< unsigned > chainJumps;
+	instruction.Opcode = CSG_OP_COMBINE;
+	if (const CSGNaryUnion* naryUnion = dynamic_cast< const CSGNaryUnion* >(node))
+	{
+		// Operands are combined into the spans of the first one, as by the chain of binary unions
+		const std::vector< CSGNode* >& operands = naryUnion->getOperands();
+		depth = compileNode(operands[0], true, NULL);
+		for (unsigned idx = 1; idx < operands.size(); ++idx)
+		{
+			depth = std::max(depth, compileNode(operands[idx], true, NULL) + 1);
+			mInstructions.push_back(instruction);
+		}
+	}
+	else
+	{
+		const CSGOperation* operation = static_cast< const CSGOperation* >(node);
+
+		// Intersection and difference are empty without the left operand, so its empty spans skip the right operand
+		// and the operation. Empty left operand of the left operand skips both operations, because left operands
+		// of the whole chain share the stack slot, so jumps of the chain are resolved by its topmost operation
+		std::vector< unsigned >* lJumps = NULL;
+		if (operation->getOperation() != SPAN_UNION)
+		{
+			lJumps = emptyJumps ? emptyJumps : &chainJumps;
+		}
+		const unsigned lDepth = compileNode(operation->l(), true, lJumps);
+
+		// Left operand spans stay on the stack, while the right operand is evaluated
+		const unsigned rDepth = compileNode(operation->r(), true, NULL) + 1;
+
+		instruction.Operation = operation->getOperation();
+		mInstructions.push_back(instruction);
+		depth = std::max(lDepth, rDepth);
+	}
+
+	if (emptyJumps)
+	{
+		emptyJumps->push_back(mInstructions.size() - 1);
+	}
+
+	const unsigned end = mInstructions.size();
+	if (testBounds)
+	{
+		mInstructions[bounds].Jump = end;
+		if (emptyJumps)
+		{
+			emptyJumps->push_back(bounds);
+		}
+	}
+	for (unsigned idx = 0; idx < chainJumps.size(); ++idx)
+	{
+		mInstructions[chainJumps[idx]].Jump = end;
+	}
+	return depth;
+}
+
+SpanList CSGProgram::evaluate(const Ray& ray, SpanArena* arena) const
+{
+	SpanList stack[CSG_STACK_SIZE];
+	unsigned top = 0;
+
+	for (unsigned idx = 0, count = mInstructions.size(); idx < count; ++idx)
+	{
+		const CSGInstruction& instruction = mInstructions[idx];
+		switch (instruction.Opcode)
+		{
+		case CSG_OP_LEAF:
+			stack[top++] = SpanIntersectShape(arena, instruction.Shape, ray);
+			break;
+		case CSG_OP_BOUNDS:
+			if (instruction.Bounds.intersect(ray))
+			{
+				continue;
+			}
+			stack[top++] = SpanList();
+			break;
+		case CSG_OP_COMBINE:
+			--top;
+			stack[top - 1] = SpanCombine(arena, stack[top - 1], stack[top], instruction.Operation);
+			break;
+		}
+
+		// Missed bounds always skip the subtree, other empty spans may skip operations, which need them
+		if (instruction.Jump != 0 && stack[top - 1].Count == 0)
+		{
+			idx = instruction.Jump - 1;
+		}
+	}
+	return stack[0];
+}
@@ -0,0 +1,67 @@
+#ifndef CSG_CSGPROGRAM_H
+#define CSG_CSGPROGRAM_H
+
+#include <vector>
+
+#include "geometry/bbox.h"
+#include "geometry/span.h"
+
+struct CSGNode;
+struct IShape;
+
+// Max depth of the spans stack, deeper trees are evaluated by their nodes
+#define CSG_STACK_SIZE 64
+
+enum CSGOpcode
+{
+	// Push spans of the leaf shape
+	CSG_OP_LEAF,
+	// Push no spans and jump over the subtree, if the ray misses its bounds
+	CSG_OP_BOUNDS,
+	// Replace two top spans by their union, intersection or difference
+	CSG_OP_COMBINE
+};
+
+struct CSGInstruction
+{
+	CSGOpcode			Opcode;
+	SpanOperation Operation;
+	// Index of the next instruction, if pushed spans are empty, zero means no jump
+	unsigned			Jump;
+	IShape*				Shape;
+	BBox					Bounds;
+};
+
+// CSG tree, flattened to the postfix program. It's evaluated by one loop with the stack of spans,
+// so there are no recursive virtual calls through the nodes
+class CSGProgram
+{
+public:
+	//! Compile the tree, returns false, if the tree needs deeper stack, than the program has
+	bool compile(const CSGNode* root);
+
+	bool isEmpty() const
+	{
+		return mInstructions.empty();
+	}
+
+	const std::vector< CSGInstruction >& getInstructions() const
+	{
+		return mInstructions;
+	}
+
+	//! Get sorted spans of the ray, which are inside of the tree, spans are stored in the arena.
+	//! Root bounds aren't tested by the program, so the caller culls rays, which miss them
+	SpanList evaluate(const Ray& ray, SpanArena* arena) const;
+
+private:
+	//! Append instructions of the subtree, returns stack depth, it needs.
+	//! Instructions, which push the subtree spans, are added to empty jumps, if the subtree is the left operand
+	//! of intersection or difference, so the operations are skipped, when there are no spans
+	unsigned compileNode(const CSGNode* node, bool testBounds, std::vector< unsigned >* emptyJumps);
+
+private:
+	std::vector< CSGInstruction > mInstructions;
+};
+
+#endif // CSG_CSGPROGRAM_H
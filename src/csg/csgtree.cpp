@@ -15,7 +15,11 @@
 CSGTree::CSGTree(CSGNode* root)
 	: mRoot(root)
 {
-
+	// Tree is complete, so bounds of all the nodes can be cached
+	if (mRoot)
+	{
+		mRoot->updateBounds();
+	}
 }
 
 CSGTree::~CSGTree()
@@ -27,10 +31,53 @@ CSGTree::~CSGTree()
 	}
 }
 
-CIsect CSGTree::intersect(const Ray& ray) 
+CIsect CSGTree::intersect(const Ray& ray, HitBuffer* hits)
 {
-	// Simply traverse tree, starting from the root
-	return mRoot->intersect(ray);
+	// Result must be inside both the root bounds and the ray interval
+	if (!mRoot->getBBox().intersect(ray))
+	{
+		return CIsect(false);
+	}
+
+	// Operations need all the spans of operands, so tree is traversed with the whole ray,
+	// starting from the root, and the first bound of the result inside of the ray interval is the hit
+	const Ray wholeRay(ray.getOrg(), ray.getDir(), Ray::UNIT_DIRECTION);
+
+	SpanArena&		 arena = SpanArena::local();
+	SpanArenaScope scope(&arena);
+
+	const SpanList spans = mProgram.isEmpty() ? mRoot->intersectSpans(wholeRay, &arena) : mProgram.evaluate(wholeRay, &arena);
+	return SpanIntersection(arena, spans, ray, hits);
+}
+
+bool CSGTree::optimize(CSGOptimizeStats* stats)
+{
+	if (!mRoot)
+	{
+		return false;
+	}
+
+	stats->CostBefore	 = CSGEstimateCost(mRoot);
+	stats->NodesBefore = CSGCountNodes(mRoot);
+
+	mRoot = CSGOptimize(mRoot);
+	// Program refers to the old nodes
+	mProgram = CSGProgram();
+	if (!mRoot)
+	{
+		stats->CostAfter	= 0.f;
+		stats->NodesAfter = 0;
+		return false;
+	}
+
+	stats->CostAfter	= CSGEstimateCost(mRoot);
+	stats->NodesAfter = CSGCountNodes(mRoot);
+	return true;
+}
+
+bool CSGTree::compile()
+{
+	return mRoot && mProgram.compile(mRoot);
 }
 
 const Mtrl* CSGTree::getMtrl() const
@@ -40,8 +87,8 @@ const Mtrl* CSGTree::getMtrl() const
 
 Vec3D CSGTree::getNormal(const Ray& ray, float distance, const CIsect& isect/* = CIsect() */) const
 {
-	// Falback to the intersection cached data
-	return isect.Normal;
+	// Normal is evaluated by the intersected leaf object
+	return isect.Object->getNormal(ray, distance, isect);
 }
 
 void CSGTree::setIsLight(bool)
@@ -78,5 +125,10 @@ Color CSGTree::getSpcColor(const Vec3D& pnt, const CIsect& isect /*= CIsect()*/)
 Vec3D CSGTree::getTexCoords(const Vec3D& pnt, const CIsect& isect /*= CIsect()*/) const
 {
 	// Fallback to data, cached in intersection
-	return isect.Object->getTexCoords(pnt);
+	return isect.Object->getTexCoords(pnt, isect);
+}
+
+BBox CSGTree::getBBox() const
+{
+	return mRoot->getBBox();
 }
@@ -3,13 +3,15 @@
 
 #include "interfaces/ishape.h"
 #include "csgnode.h"
+#include "csgoptimizer.h"
+#include "csgprogram.h"
 
 class CSGTree : public IShape
 {
 public:
 	explicit CSGTree(CSGNode* root);
 	virtual ~CSGTree();
-  virtual CIsect intersect(const Ray& ray);
+  virtual CIsect intersect(const Ray& ray, HitBuffer* hits = NULL);
   virtual const Mtrl* getMtrl() const;
   virtual Vec3D getNormal(const Ray& ray, float distance, const CIsect& isect = CIsect()) const;
   virtual void setIsLight(bool light);
@@ -18,8 +20,28 @@ public:
   virtual Color getDifColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
   virtual Color getSpcColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
   virtual Vec3D getTexCoords(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
+  virtual BBox getBBox() const;
+
+	//! Rewrite the tree to the cheaper one with the same solid, it's done before the tree is compiled.
+	//! Returns false, if the tree is proven to be empty, so it has no root and mustn't be traced
+	bool optimize(CSGOptimizeStats* stats);
+
+	//! Flatten the tree to the program, which is evaluated instead of nodes, returns false, if the tree is too deep
+	bool compile();
+
+	CSGNode* getRoot() const
+	{
+		return mRoot;
+	}
+
+	const CSGProgram& getProgram() const
+	{
+		return mProgram;
+	}
+
 private:
-	CSGNode* mRoot;
+	CSGNode*	 mRoot;
+	CSGProgram mProgram;
 };
 
 #endif
\ No newline at end of file
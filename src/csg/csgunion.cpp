@@ -7,15 +7,10 @@
 //  
 //-------------------------------------------------------------------
 
-#include <algorithm>
-#include <xutility>
-
 #include "csgunion.h"
 
-#define TOO_FAR_AWAY		 1000000.f 
-
 CSGUnion::CSGUnion(CSGNode *lh, CSGNode *rh)
-	: CSGOperation(lh, rh)
+	: CSGOperation(lh, rh, SPAN_UNION)
 {
 }
 
@@ -23,68 +18,6 @@ CSGUnion::~CSGUnion()
 {
 }
 
-CIsect CSGUnion::intersect(const Ray& ray) 
-{
-	// Post-order depth-first tree traversal
-	CIsect lIsect  = l()->intersect(ray);
-	CIsect rIsect = r()->intersect(ray);
-
-	// Update distance of not existing intersections to optimize algorithm
-	if (!lIsect.Exists)
-	{
-		lIsect.Distance = TOO_FAR_AWAY;
-	}
-	if (!rIsect.Exists)
-	{
-		rIsect.Distance = TOO_FAR_AWAY;
-	}
-
-	CIsect unite;
-
-	unite.Exists   = lIsect.Exists || rIsect.Exists;
-	if (!unite.Exists)
-	{
-		return CIsect(false);
-	}
-
-	// We won't update intersected object, to be able to determine which object was really intersected
-	if (lIsect.Distance < rIsect.Distance)
-	{
-		unite.Distance  = lIsect.Distance;
-		unite.Normal	  = lIsect.Normal;
-		unite.Object	  = lIsect.Object;
-		unite.TexCoords = lIsect.TexCoords;
-		unite.U					= lIsect.U;
-		unite.V					= lIsect.V;
-		// Do not copy distances - later
-	}
-	else
-	{
-		unite.Distance  = rIsect.Distance;
-		unite.Normal	  = rIsect.Normal;
-		unite.Object	  = rIsect.Object;
-		unite.TexCoords = rIsect.TexCoords;
-		unite.U					= rIsect.U;
-		unite.V					= rIsect.V;
-	}
-	
-	// Copy all distances
-	//unite.Dst.resize(lIsect.Dst.size() + rIsect.Dst.size()); n
-	if (lIsect.Exists)
-	{
-		unite.Dst.resize(lIsect.Dst.size());
-		std::copy(lIsect.Dst.begin(), lIsect.Dst.end(), unite.Dst.begin());
-	}
-	if (rIsect.Exists)
-	{
-		const int size = unite.Dst.size();
-		unite.Dst.resize(unite.Dst.size() + rIsect.Dst.size());
-		std::copy(rIsect.Dst.begin(), rIsect.Dst.end(), unite.Dst.begin() + size);
-	}
-
-	return unite;
-}
-
 const Mtrl* CSGUnion::getMtrl() const
 {
 	return NULL;
@@ -92,7 +25,8 @@ const Mtrl* CSGUnion::getMtrl() const
 
 Vec3D CSGUnion::getNormal(const Ray& ray, float distance, const CIsect& isect/* = CIsect() */) const
 {
-	return isect.Normal;
+	// Normal is evaluated by the intersected leaf object
+	return isect.Object->getNormal(ray, distance, isect);
 }
 
 void CSGUnion::setIsLight(bool)
@@ -129,5 +63,13 @@ Color CSGUnion::getSpcColor(const Vec3D& pnt, const CIsect& isect /*= CIsect()*/
 Vec3D CSGUnion::getTexCoords(const Vec3D& pnt, const CIsect& isect /*= CIsect()*/) const
 {
 	// Fallback to data, cached in intersection
-	return isect.Object->getTexCoords(pnt);
+	return isect.Object->getTexCoords(pnt, isect);
+}
+
+BBox CSGUnion::computeBounds() const
+{
+	// Union may be anywhere inside both operands
+	BBox box = l()->getBBox();
+	box.extend(r()->getBBox());
+	return box;
 }
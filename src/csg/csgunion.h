@@ -8,7 +8,6 @@ class CSGUnion : public CSGOperation
 public:
 	explicit CSGUnion(CSGNode* lh, CSGNode* rh);
 	virtual ~CSGUnion();
-	virtual CIsect intersect(const Ray& ray);
 	virtual const Mtrl* getMtrl() const;
 	virtual Vec3D getNormal(const Ray& ray, float distance, const CIsect& isect = CIsect()) const;
 	virtual void setIsLight(bool light);
@@ -17,6 +16,8 @@ public:
  	virtual Color getDifColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
 	virtual Color getSpcColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
 	virtual Vec3D getTexCoords(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
+protected:
+	virtual BBox computeBounds() const;
 };
 
 #endif
\ No newline at end of file
@@ -22,9 +22,14 @@ CSGValue::~CSGValue()
 	mShape = NULL;
 }
 
-CIsect CSGValue::intersect(const Ray& ray)
+CIsect CSGValue::intersect(const Ray& ray, HitBuffer* hits)
 {
-	return mShape->intersect(ray);
+	return mShape->intersect(ray, hits);
+}
+
+SpanList CSGValue::intersectSpans(const Ray& ray, SpanArena* arena)
+{
+	return SpanIntersectShape(arena, mShape, ray);
 }
 
 const Mtrl* CSGValue::getMtrl() const
@@ -67,4 +72,9 @@ Color CSGValue::getSpcColor(const Vec3D& pnt, const CIsect& isect /*= CIsect()*/
 Vec3D CSGValue::getTexCoords(const Vec3D& pnt, const CIsect& isect /*= CIsect()*/) const
 {
 	return mShape->getTexCoords(pnt, isect);
-}
\ No newline at end of file
+}
+
+BBox CSGValue::computeBounds() const
+{
+	return mShape->getBBox();
+}
@@ -8,7 +8,8 @@ class CSGValue : public CSGOperand
 public:
 	explicit CSGValue(IShape* shape);
 	virtual ~CSGValue();
-	virtual CIsect intersect(const Ray& ray);
+	virtual CIsect intersect(const Ray& ray, HitBuffer* hits = NULL);
+	virtual SpanList intersectSpans(const Ray& ray, SpanArena* arena);
 	virtual const Mtrl* getMtrl() const;
 	virtual Vec3D getNormal(const Ray& ray, float distance, const CIsect& isect = CIsect()) const;
 	virtual void setIsLight(bool light);
@@ -17,6 +18,15 @@ public:
 	virtual Color getDifColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
 	virtual Color getSpcColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
 	virtual Vec3D getTexCoords(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
+
+	IShape* getShape() const
+	{
+		return mShape;
+	}
+
+protected:
+	virtual BBox computeBounds() const;
+
 private:
 	IShape* mShape;
 };
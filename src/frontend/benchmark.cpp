@@ -0,0 +1,622 @@
+//-------------------------------------------------------------------
+// File: benchmark.cpp
+// 
+// Tracer performance measurements
+//			 Benchmark configuration defines BENCHMARK_ALLOCATIONS, so global allocation operators are replaced to count heap allocations,
+//			 other builds, e.g. the one, which is used for rendering, keep the standard allocation operators
+//
+//  
+//-------------------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <QFileInfo>
+
+#include "csg/csgtree.h"
+#include "geometry/bboxblock.h"
+#include "geometry/box.h"
+#include "geometry/intersection.h"
+#include "geometry/mesh.h"
+#include "geometry/parallel.h"
+#include "geometry/ray.h"
+#include "geometry/raypacket.h"
+#include "geometry/sphere.h"
+#include "geometry/triangleblock.h"
+#include "geometry/vector3d.h"
+#include "geometry/widebvh.h"
+#include "tracer/camera.h"
+#include "tracer/scene.h"
+#include "tracer/tracer.h"
+
+#include "objparser.h"
+#include "sceneserializable.h"
+
+#include "benchmark.h"
+
+namespace
+{
+#if defined(BENCHMARK_ALLOCATIONS)
+	std::atomic< unsigned long long > GAllocationsCount(0);
+#endif
+
+	unsigned long long GGetAllocationsCount()
+	{
+#if defined(BENCHMARK_ALLOCATIONS)
+		return GAllocationsCount.load(std::memory_order_relaxed);
+#else
+		return 0;
+#endif
+	}
+
+	//! Print allocations and their count per item, e.g. per ray, if allocations are counted
+	void GPrintAllocations(unsigned long long allocations, double itemsCount, const char* item)
+	{
+#if defined(BENCHMARK_ALLOCATIONS)
+		std::cout << allocations << " allocations (" << allocations / itemsCount << " per " << item << ")";
+#else
+		std::cout << "allocations aren't counted, use Benchmark configuration";
+#endif
+	}
+
+	double GGetSeconds(const std::chrono::steady_clock::time_point& start)
+	{
+		return std::chrono::duration< double >(std::chrono::steady_clock::now() - start).count();
+	}
+
+	const unsigned cShadeSamplesCount = 4096;
+	const unsigned cShadeRepeatsCount = 256;
+
+	// Repeat vector operations of the shading path: normalization of the hit normal, reflection and refraction
+	// of the view direction, specular term and color accumulation. Returns accumulated color, so work isn't dropped
+	template <class Vector>
+	Vector GShadeVectors(const std::vector< Vector >& directions, const std::vector< Vector >& normals, const Vector& lightDir, double* seconds)
+	{
+		const Vector lightColor(0.9f, 0.8f, 0.7f);
+		const Vector diffuseColor(0.3f, 0.5f, 0.7f);
+
+		Vector result;
+
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		for (unsigned repeat = 0; repeat < cShadeRepeatsCount; ++repeat)
+		{
+			for (unsigned idx = 0; idx < directions.size(); ++idx)
+			{
+				const Vector normal			= Vector(normals[idx]).toUnit();
+				const Vector& direction = directions[idx];
+
+				Vector refracted;
+				if (refract(direction, normal, 0.75f, &refracted))
+				{
+					result += 0.1f * refracted.toUnit();
+				}
+
+				const Vector reflected = reflect(direction, normal).toUnit();
+				const float	 diffuse	 = std::max(dot(normal, lightDir), 0.f);
+				const float	 specular	 = std::max(dot(reflected, lightDir), 0.f);
+				const Vector tangent	 = cross(normal, lightDir);
+
+				result += scale3D(diffuseColor, lightColor) * diffuse + lightColor * (specular * specular) + tangent * 0.01f;
+			}
+		}
+
+		*seconds = GGetSeconds(start);
+		return result;
+	}
+
+	// Generate the same pseudo-random unit directions and normals for every backend
+	template <class Vector>
+	void GFillShadeSamples(std::vector< Vector >* directions, std::vector< Vector >* normals)
+	{
+		directions->resize(cShadeSamplesCount);
+		normals->resize(cShadeSamplesCount);
+
+		unsigned seed = 12345;
+		for (unsigned idx = 0; idx < cShadeSamplesCount; ++idx)
+		{
+			float components[6];
+			for (unsigned comp = 0; comp < 6; ++comp)
+			{
+				seed = seed * 1664525 + 1013904223;
+				components[comp] = static_cast< float >(seed >> 8) / (1 << 24) * 2.f - 1.f;
+			}
+
+			(*directions)[idx] = Vector(components[0], components[1], components[2] - 2.f).toUnit();
+			// Normals face the directions and aren't normalized, as ones returned by shapes
+			(*normals)[idx]		 = Vector(components[3], components[4], components[5] + 2.f) * 3.f;
+		}
+	}
+
+	template <class Vector>
+	double GMeasureVectorBackend(const char* name)
+	{
+		std::vector< Vector > directions, normals;
+		GFillShadeSamples(&directions, &normals);
+
+		double			 seconds;
+		const Vector checksum		= GShadeVectors(directions, normals, Vector(0.f, 1.f, 1.f).toUnit(), &seconds);
+		const double throughput = static_cast< double >(cShadeSamplesCount) * cShadeRepeatsCount / seconds * 1e-6;
+
+		std::cout << "Shading vectors, " << name << ": " << seconds << " s, " << throughput << " Msamples/s (checksum "
+							<< checksum.x() + checksum.y() + checksum.z() << ")" << std::endl;
+
+		return throughput;
+	}
+
+	const unsigned cHierarchyRaysCount	 = 1 << 16;
+	const unsigned cAnimationFramesCount = 32;
+
+	// Objects swing with different phases by up to their own size, so hierarchy nodes overlap more with every frame
+	Vec3D GAnimationOffset(unsigned object, unsigned frame, float size)
+	{
+		const float phase = 0.3f * frame + object;
+		return Vec3D(sinf(phase), cosf(1.3f * phase), sinf(0.7f * phase)) * size;
+	}
+
+	// Counts reached leaves, max distance isn't shrunk, so the whole hierarchy path of the ray is traversed
+	struct LeavesCounter
+	{
+		LeavesCounter()
+			: Count(0)
+		{
+		}
+
+		bool operator()(unsigned leaf, float* maxDistance)
+		{
+			++Count;
+			return false;
+		}
+
+		unsigned long long Count;
+	};
+
+	// Rays start on the sphere around the box and pass through random points inside of it
+	void GFillHierarchyRays(const BBox& box, std::vector< Ray >* rays)
+	{
+		const Vec3D	center = box.getCentroid();
+		const float radius = length(box.Max - box.Min);
+
+		rays->resize(cHierarchyRaysCount);
+
+		unsigned seed = 54321;
+		for (unsigned idx = 0; idx < cHierarchyRaysCount; ++idx)
+		{
+			float components[6];
+			for (unsigned comp = 0; comp < 6; ++comp)
+			{
+				seed = seed * 1664525 + 1013904223;
+				components[comp] = static_cast< float >(seed >> 8) / (1 << 24);
+			}
+
+			const Vec3D origin = center + Vec3D(components[0] - 0.5f, components[1] - 0.5f, components[2] - 0.5f).toUnit() * radius;
+			const Vec3D target = box.Min + scale3D(box.Max - box.Min, Vec3D(components[3], components[4], components[5]));
+			(*rays)[idx]			 = Ray(origin, (target - origin).toUnit());
+		}
+	}
+
+	template <class Hierarchy>
+	double GMeasureHierarchy(const Hierarchy& hierarchy, const std::vector< Ray >& rays, unsigned long long* leavesCount)
+	{
+		LeavesCounter counter;
+
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		for (unsigned idx = 0; idx < rays.size(); ++idx)
+		{
+			hierarchy.traverseLeaves(rays[idx], counter);
+		}
+
+		const double seconds = GGetSeconds(start);
+		*leavesCount				 = counter.Count;
+		return static_cast< double >(rays.size()) / seconds * 1e-6;
+	}
+
+	// Trace closest hits of the rays, returns Mrays/s
+	double GMeasureMeshRays(const Mesh& mesh, const std::vector< Ray >& rays, unsigned* hitsCount)
+	{
+		unsigned hits = 0;
+
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		for (unsigned idx = 0; idx < rays.size(); ++idx)
+		{
+			if (mesh.intersect(rays[idx]).Exists)
+			{
+				++hits;
+			}
+		}
+
+		const double seconds = GGetSeconds(start);
+		*hitsCount					 = hits;
+		return static_cast< double >(rays.size()) / seconds * 1e-6;
+	}
+
+	// Trace closest hits of the rays with the shape, returns Mrays/s
+	double GMeasureShapeRays(IShape* shape, const std::vector< Ray >& rays, unsigned* hitsCount)
+	{
+		unsigned hits = 0;
+
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		for (unsigned idx = 0; idx < rays.size(); ++idx)
+		{
+			if (shape->intersect(rays[idx]).Exists)
+			{
+				++hits;
+			}
+		}
+
+		const double seconds = GGetSeconds(start);
+		*hitsCount					 = hits;
+		return static_cast< double >(rays.size()) / seconds * 1e-6;
+	}
+}
+
+#if defined(BENCHMARK_ALLOCATIONS)
+void* operator new(std::size_t size)
+{
+	GAllocationsCount.fetch_add(1, std::memory_order_relaxed);
+
+	void* memory = std::malloc(size > 0 ? size : 1);
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+#endif
+
+Benchmark::Benchmark()
+{
+}
+
+Benchmark::~Benchmark()
+{
+}
+
+bool Benchmark::run(const QString& sceneFile, int resolutionX, int resolutionY, unsigned threadsCount)
+{
+	SceneSerializable reader;
+
+	mScene = reader.readScene(sceneFile);
+	if (!mScene)
+	{
+		return false;
+	}
+
+	mScene->setImagePlaneRes(resolutionX, resolutionY);
+
+	std::cout << "Benchmark: " << sceneFile.toUtf8().constData() << ", " << resolutionX << "x" << resolutionY << std::endl;
+	std::cout << "Triangle kernel: " << TriangleBlock::GetKernelName() << std::endl;
+
+	const double raysThroughput = measureRays(*mScene);
+	measurePackets(*mScene, raysThroughput);
+	measureRender(*mScene, threadsCount);
+	measureHierarchies(*mScene);
+	measureSpatialSplits(*mScene);
+	measureObjParsing(*mScene, threadsCount);
+	measureCSG(*mScene);
+	measureAnimation(mScene.data());
+	measureVectors();
+
+	return true;
+}
+
+double Benchmark::measureRays(const Scene& scene)
+{
+	const int						cImgPlaneW = scene.getImagePlaneW();
+	const int						cImgPlaneH = scene.getImagePlaneH();
+	const Camera* const camera		 = scene.getCamera();
+
+	unsigned hitsCount = 0;
+
+	const unsigned long long								 allocationsBefore = GGetAllocationsCount();
+	const std::chrono::steady_clock::time_point start						 = std::chrono::steady_clock::now();
+
+	for (int y = 0; y < cImgPlaneH; ++y)
+	{
+		for (int x = 0; x < cImgPlaneW; ++x)
+		{
+			const CIsect isect = scene.intersect(camera->lookThrough(x, y));
+			if (isect.Exists)
+			{
+				++hitsCount;
+			}
+		}
+	}
+
+	const double						 seconds		 = GGetSeconds(start);
+	const unsigned long long allocations = GGetAllocationsCount() - allocationsBefore;
+	const double						 raysCount	 = static_cast< double >(cImgPlaneW) * cImgPlaneH;
+	const double						 throughput	 = raysCount / seconds * 1e-6;
+
+	std::cout << "Primary rays: " << raysCount << " rays, " << hitsCount << " hits, " << seconds << " s, "
+						<< throughput << " Mrays/s, ";
+	GPrintAllocations(allocations, raysCount, "ray");
+	std::cout << std::endl;
+
+	return throughput;
+}
+
+void Benchmark::measurePackets(const Scene& scene, double singleRaysThroughput)
+{
+	const int						cImgPlaneW = scene.getImagePlaneW();
+	const int						cImgPlaneH = scene.getImagePlaneH();
+	const Camera* const camera		 = scene.getCamera();
+
+	unsigned	hitsCount = 0;
+	RayPacket packet;
+	CIsect		isects[RAY_PACKET_SIZE];
+
+	const unsigned long long								 allocationsBefore = GGetAllocationsCount();
+	const std::chrono::steady_clock::time_point start						 = std::chrono::steady_clock::now();
+
+	for (int y = 0; y < cImgPlaneH; y += RAY_PACKET_WIDTH)
+	{
+		for (int x = 0; x < cImgPlaneW; x += RAY_PACKET_WIDTH)
+		{
+			const unsigned mask = camera->lookThrough(x, y, &packet);
+			scene.intersect(packet, mask, isects);
+			for (unsigned idx = 0; idx < RAY_PACKET_SIZE; ++idx)
+			{
+				if ((mask & (1 << idx)) != 0 && isects[idx].Exists)
+				{
+					++hitsCount;
+				}
+			}
+		}
+	}
+
+	const double						 seconds		 = GGetSeconds(start);
+	const unsigned long long allocations = GGetAllocationsCount() - allocationsBefore;
+	const double						 raysCount	 = static_cast< double >(cImgPlaneW) * cImgPlaneH;
+	const double						 throughput	 = raysCount / seconds * 1e-6;
+
+	std::cout << "Primary packets " << RAY_PACKET_WIDTH << "x" << RAY_PACKET_WIDTH << ": " << hitsCount << " hits, " << seconds << " s, "
+						<< throughput << " Mrays/s (x" << throughput / singleRaysThroughput << " of single rays), ";
+	GPrintAllocations(allocations, raysCount, "ray");
+	std::cout << std::endl;
+}
+
+void Benchmark::measureRender(const Scene& scene, unsigned threadsCount)
+{
+	const int cImgPlaneW = scene.getImagePlaneW();
+	const int cImgPlaneH = scene.getImagePlaneH();
+
+	// Image is allocated before counting
+	std::vector< unsigned > image(cImgPlaneW * cImgPlaneH);
+
+	Tracer tracer;
+	tracer.setThreadsCount(threadsCount);
+
+	const unsigned long long								 allocationsBefore = GGetAllocationsCount();
+	const std::chrono::steady_clock::time_point start						 = std::chrono::steady_clock::now();
+
+	tracer.render(scene, reinterpret_cast< unsigned char* >(&image[0]));
+
+	const double						 seconds		 = GGetSeconds(start);
+	const unsigned long long allocations = GGetAllocationsCount() - allocationsBefore;
+	const double						 pixelsCount = static_cast< double >(cImgPlaneW) * cImgPlaneH;
+
+	std::cout << "Render: " << seconds << " s, " << pixelsCount / seconds * 1e-6 << " Mpixels/s, ";
+	GPrintAllocations(allocations, pixelsCount, "pixel");
+	std::cout << std::endl;
+}
+
+void Benchmark::measureHierarchies(const Scene& scene)
+{
+	const std::map< std::string, Mesh* >& meshes = scene.getMeshes();
+	if (meshes.empty())
+	{
+		return;
+	}
+
+	std::cout << "Wide hierarchy kernel: " << QuantizedBBox8::GetKernelName() << std::endl;
+
+	std::vector< Ray > rays;
+	for (std::map< std::string, Mesh* >::const_iterator it = meshes.begin(); it != meshes.end(); ++it)
+	{
+		const Mesh& mesh = *it->second;
+		GFillHierarchyRays(mesh.getBBox(), &rays);
+
+		unsigned long long binaryLeaves, wideLeaves;
+		const double			 binaryThroughput = GMeasureHierarchy(mesh.getHierarchy(), rays, &binaryLeaves);
+		const double			 wideThroughput		= GMeasureHierarchy(mesh.getWideHierarchy(), rays, &wideLeaves);
+
+		const size_t binaryMemory = mesh.getHierarchy().getNodes().size() * sizeof(BVHNode);
+		const size_t wideMemory	 = mesh.getWideHierarchy().getMemorySize();
+
+		// Quantized bounds are conservative, so wide hierarchy may reach slightly more leaves
+		std::cout << "Mesh hierarchy " << it->first << ": binary " << binaryMemory / 1024 << " KB, " << binaryThroughput << " Mrays/s, "
+							<< static_cast< double >(binaryLeaves) / rays.size() << " leaves per ray; 8-wide " << wideMemory / 1024 << " KB, "
+							<< wideThroughput << " Mrays/s (x" << wideThroughput / binaryThroughput << "), "
+							<< static_cast< double >(wideLeaves) / rays.size() << " leaves per ray" << std::endl;
+	}
+}
+
+void Benchmark::measureSpatialSplits(const Scene& scene)
+{
+	const std::map< std::string, Mesh* >& meshes = scene.getMeshes();
+
+	std::vector< Ray > rays;
+	for (std::map< std::string, Mesh* >::const_iterator it = meshes.begin(); it != meshes.end(); ++it)
+	{
+		const Mesh sahMesh(*it->second, BVH_BUILD_SAH);
+		const Mesh spatialMesh(*it->second, BVH_BUILD_SPATIAL);
+		GFillHierarchyRays(sahMesh.getBBox(), &rays);
+
+		unsigned		 sahHits, spatialHits;
+		const double sahThroughput		 = GMeasureMeshRays(sahMesh, rays, &sahHits);
+		const double spatialThroughput = GMeasureMeshRays(spatialMesh, rays, &spatialHits);
+
+		const BVHBuildStats& sahStats			= sahMesh.getHierarchy().getBuildStats();
+		const BVHBuildStats& spatialStats = spatialMesh.getHierarchy().getBuildStats();
+		const float					 duplicated		= 100.f * (spatialStats.ReferencesCount - sahStats.ReferencesCount) / std::max(sahStats.ReferencesCount, 1u);
+
+		// Both hierarchies find the same hits, spatial one only culls nodes better
+		std::cout << "Spatial splits " << it->first << ": SAH " << sahThroughput << " Mrays/s, cost " << sahStats.SAHCost << ", built in "
+							<< sahStats.Seconds << " s; spatial " << spatialThroughput << " Mrays/s (x" << spatialThroughput / sahThroughput << "), cost "
+							<< spatialStats.SAHCost << ", built in " << spatialStats.Seconds << " s, " << duplicated << "% duplicated references, "
+							<< (sahHits == spatialHits ? "same hits" : "hits differ") << std::endl;
+	}
+}
+
+void Benchmark::measureObjParsing(const Scene& scene, unsigned threadsCount)
+{
+	const std::map< std::string, Mesh* >& meshes = scene.getMeshes();
+
+	// Meshes are named by their model files
+	for (std::map< std::string, Mesh* >::const_iterator it = meshes.begin(); it != meshes.end(); ++it)
+	{
+		const QString fileName = QString::fromUtf8(it->first.c_str());
+		const double	megabytes = QFileInfo(fileName).size() / (1024. * 1024.);
+
+		double	 seconds[2];
+		unsigned triangles[2];
+		bool		 parsed = true;
+		for (unsigned pass = 0; pass < 2 && parsed; ++pass)
+		{
+			ObjParser parser(pass == 0 ? 1 : threadsCount);
+
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			parsed					= parser.read(fileName);
+			seconds[pass]		= GGetSeconds(start);
+			triangles[pass] = parser.getTrianglesCount();
+		}
+
+		// Model could be changed or removed since the scene was loaded, other meshes are still measured
+		if (!parsed)
+		{
+			std::cout << "OBJ parsing " << it->first << ": failed reading model" << std::endl;
+			continue;
+		}
+
+		std::cout << "OBJ parsing " << it->first << ": " << megabytes << " MB, " << triangles[0] << " triangles; 1 thread " << megabytes / seconds[0]
+							<< " MB/s; " << ParallelThreadsCount(threadsCount) << " threads " << megabytes / seconds[1] << " MB/s (x" << seconds[0] / seconds[1]
+							<< "), " << (triangles[0] == triangles[1] ? "same triangles" : "triangles differ") << std::endl;
+	}
+}
+
+void Benchmark::measureCSG(const Scene& scene)
+{
+	const std::vector< IShape* >& objects = scene.getObjects();
+
+	std::vector< Ray > rays;
+	for (unsigned idx = 0; idx < objects.size(); ++idx)
+	{
+		CSGTree* tree = dynamic_cast< CSGTree* >(objects[idx]);
+		if (!tree || tree->getProgram().isEmpty())
+		{
+			continue;
+		}
+		GFillHierarchyRays(tree->getBBox(), &rays);
+
+		// Root node is evaluated recursively through the nodes, tree itself runs the compiled program
+		unsigned		 nodesHits, programHits;
+		const double nodesThroughput	 = GMeasureShapeRays(tree->getRoot(), rays, &nodesHits);
+		const double programThroughput = GMeasureShapeRays(tree, rays, &programHits);
+
+		std::cout << "CSG tree " << idx << ": " << tree->getProgram().getInstructions().size() << " instructions; nodes " << nodesThroughput
+							<< " Mrays/s; program " << programThroughput << " Mrays/s (x" << programThroughput / nodesThroughput << "), "
+							<< (nodesHits == programHits ? "same hits" : "hits differ") << std::endl;
+	}
+}
+
+void Benchmark::measureAnimation(Scene* scene)
+{
+	std::vector< Sphere* >				spheres;
+	std::vector< SphereGeometry > spheresStart;
+	std::vector< Box* >						boxes;
+	std::vector< BoxGeometry >		boxesStart;
+
+	const std::vector< IShape* >& objects = scene->getObjects();
+	for (unsigned idx = 0; idx < objects.size(); ++idx)
+	{
+		if (Sphere* sphere = dynamic_cast< Sphere* >(objects[idx]))
+		{
+			spheres.push_back(sphere);
+			spheresStart.push_back(sphere->getGeometry());
+		}
+		else if (Box* box = dynamic_cast< Box* >(objects[idx]))
+		{
+			boxes.push_back(box);
+			boxesStart.push_back(box->getGeometry());
+		}
+	}
+
+	if (spheres.empty() && boxes.empty())
+	{
+		return;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	scene->buildHierarchy();
+	const double buildSeconds = GGetSeconds(start);
+
+	double	 updateSeconds = 0.;
+	unsigned rebuilds			 = 0;
+	for (unsigned frame = 1; frame <= cAnimationFramesCount; ++frame)
+	{
+		for (unsigned idx = 0; idx < spheres.size(); ++idx)
+		{
+			const SphereGeometry& geometry = spheresStart[idx];
+			spheres[idx]->setCenter(geometry.Center + GAnimationOffset(idx, frame, sqrtf(geometry.Radius2)));
+		}
+		for (unsigned idx = 0; idx < boxes.size(); ++idx)
+		{
+			const BoxGeometry& geometry = boxesStart[idx];
+			const Vec3D				 offset		= GAnimationOffset(spheres.size() + idx, frame, length(geometry.Max - geometry.Min) * 0.5f);
+			boxes[idx]->setBounds(geometry.Min + offset, geometry.Max + offset);
+		}
+
+		start = std::chrono::steady_clock::now();
+		if (scene->updateHierarchy())
+		{
+			++rebuilds;
+		}
+		updateSeconds += GGetSeconds(start);
+	}
+
+	std::cout << "Animation: " << spheres.size() + boxes.size() << " moving objects, " << cAnimationFramesCount << " frames, update "
+						<< updateSeconds / cAnimationFramesCount * 1e3 << " ms per frame (" << rebuilds << " rebuilds), full build "
+						<< buildSeconds * 1e3 << " ms" << std::endl;
+
+	for (unsigned idx = 0; idx < spheres.size(); ++idx)
+	{
+		spheres[idx]->setCenter(spheresStart[idx].Center);
+	}
+	for (unsigned idx = 0; idx < boxes.size(); ++idx)
+	{
+		boxes[idx]->setBounds(boxesStart[idx].Min, boxesStart[idx].Max);
+	}
+	scene->buildHierarchy();
+}
+
+void Benchmark::measureVectors()
+{
+	std::cout << "Vector backend: " << VECTOR3D_BACKEND_NAME << std::endl;
+
+#ifdef VECTOR3D_HAS_SSE
+	const double scalarThroughput = GMeasureVectorBackend< Vec3DScalar >("scalar");
+	const double sseThroughput		= GMeasureVectorBackend< Vec3DSSE >("SSE");
+
+	std::cout << "Shading vectors, SSE speedup: x" << sseThroughput / scalarThroughput << std::endl;
+#else
+	GMeasureVectorBackend< Vec3DScalar >("scalar");
+#endif
+}
@@ -0,0 +1,52 @@
+#ifndef FRONTEND_BENCHMARK_H
+#define FRONTEND_BENCHMARK_H
+
+#include <QSharedPointer>
+#include <QString>
+
+class Scene;
+
+// Measures tracer performance on the given scene and prints results to the standard output
+class Benchmark
+{
+public:
+	explicit Benchmark();
+	~Benchmark();
+
+	//! Load scene and run all the measurements with given image resolution
+	bool run(const QString& sceneFile, int resolutionX, int resolutionY, unsigned threadsCount);
+
+private:
+	//! Trace primary ray for every pixel on the calling thread and count heap allocations in allocation counting builds, returns Mrays/s
+	double measureRays(const Scene& scene);
+
+	//! Trace primary rays by packets on the calling thread and compare with the single rays throughput
+	void measurePackets(const Scene& scene, double singleRaysThroughput);
+
+	//! Render the whole image and count heap allocations in allocation counting builds
+	void measureRender(const Scene& scene, unsigned threadsCount);
+
+	//! Traverse binary and eight-wide hierarchies of every mesh with the same rays and compare their memory and throughput
+	void measureHierarchies(const Scene& scene);
+
+	//! Build hierarchies of every mesh with and without spatial splits and compare their closest hit throughput
+	void measureSpatialSplits(const Scene& scene);
+
+	//! Parse model file of every mesh on one thread and on all the threads and compare their throughput in MB/s
+	void measureObjParsing(const Scene& scene, unsigned threadsCount);
+
+	//! Trace rays through every CSG tree by its nodes and by its compiled program and compare their throughput
+	void measureCSG(const Scene& scene);
+
+	//! Move spheres and boxes over several animation frames and compare hierarchy updates with full rebuilds,
+	//! objects are put back afterwards
+	void measureAnimation(Scene* scene);
+
+	//! Run shading vector operations with scalar and SIMD vector backends and compare their throughput
+	void measureVectors();
+
+private:
+	QSharedPointer< Scene > mScene;
+};
+
+#endif
@@ -0,0 +1,378 @@
+//-------------------------------------------------------------------
+// File: meshcache.cpp
+//
+// Binary cache of meshes with their hierarchies
+//			 File starts with the header, which keeps the key of the cache and counts and offsets
+//			 of all the sections, each section is an array aligned to 16 bytes
+//
+//
+//-------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#if defined(_WIN32)
+	#define NOMINMAX
+	#include <windows.h>
+#endif
+
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryFile>
+
+#include "geometry/mesh.h"
+#include "geometry/triangleblock.h"
+
+#include "meshcache.h"
+
+namespace
+{
+	enum MeshCacheSection
+	{
+		MESH_CACHE_POSITIONS,
+		MESH_CACHE_NORMALS,
+		MESH_CACHE_TEXCOORDS,
+		MESH_CACHE_INDICES,
+		MESH_CACHE_NODES,
+		MESH_CACHE_LEAF_INDICES,
+		MESH_CACHE_SECTIONS_COUNT
+	};
+
+	struct CacheHeader
+	{
+		char							 Magic[8];
+		unsigned					 Version;
+		unsigned					 ByteOrder; // Caches are written in native byte order, so other machines rebuild them
+		unsigned long long ContentHash;
+		unsigned long long DataHash; // Hash of all the sections, so damaged caches are rebuilt
+		unsigned					 HierarchyMode;
+		unsigned					 BlockSize;
+		unsigned					 Counts[MESH_CACHE_SECTIONS_COUNT];
+		unsigned long long Offsets[MESH_CACHE_SECTIONS_COUNT];
+	};
+
+	// Vectors are stored without SIMD padding, so the layout doesn't depend on the vector backend
+	struct CacheVector
+	{
+		float X, Y, Z;
+	};
+
+	struct CacheNode
+	{
+		float					 Min[3];
+		float					 Max[3];
+		unsigned			 Offset;
+		unsigned short Count;
+		unsigned short Axis;
+	};
+
+	const char		 cMagic[8]				 = { 'R', 'T', 'M', 'E', 'S', 'H', 0, 0 };
+	const unsigned cByteOrderMark		 = 0x01020304;
+	const unsigned cSectionAlignment = 16;
+
+	const unsigned cElementSizes[MESH_CACHE_SECTIONS_COUNT] =
+	{
+		sizeof(CacheVector), sizeof(CacheVector), sizeof(CacheVector), sizeof(unsigned), sizeof(CacheNode), sizeof(unsigned)
+	};
+
+	unsigned long long GAlign(unsigned long long offset)
+	{
+		return (offset + cSectionAlignment - 1) / cSectionAlignment * cSectionAlignment;
+	}
+
+	// 64-bit FNV-1a hash
+	unsigned long long GHash(const unsigned char* data, qint64 size)
+	{
+		unsigned long long hash = 14695981039346656037ull;
+		for (qint64 idx = 0; idx < size; ++idx)
+		{
+			hash = (hash ^ data[idx]) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	void GWriteVectors(const std::vector< Vec3D >& vectors, char* data)
+	{
+		CacheVector* cached = reinterpret_cast< CacheVector* >(data);
+		for (unsigned idx = 0; idx < vectors.size(); ++idx)
+		{
+			cached[idx].X = vectors[idx].x();
+			cached[idx].Y = vectors[idx].y();
+			cached[idx].Z = vectors[idx].z();
+		}
+	}
+
+	void GReadVectors(const unsigned char* data, unsigned count, std::vector< Vec3D >* vectors)
+	{
+		const CacheVector* cached = reinterpret_cast< const CacheVector* >(data);
+		vectors->resize(count);
+		for (unsigned idx = 0; idx < count; ++idx)
+		{
+			(*vectors)[idx] = Vec3D(cached[idx].X, cached[idx].Y, cached[idx].Z);
+		}
+	}
+
+	//! Replace the file at once, so readers see either the old file or the new one, but never no file at all
+	bool GReplaceFile(const QString& from, const QString& to)
+	{
+#if defined(_WIN32)
+		const QString nativeFrom = QDir::toNativeSeparators(from);
+		const QString nativeTo	 = QDir::toNativeSeparators(to);
+		return MoveFileExW(reinterpret_cast< const wchar_t* >(nativeFrom.utf16()), reinterpret_cast< const wchar_t* >(nativeTo.utf16()),
+											 MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		return rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#endif
+	}
+
+	//! Check that sections fit into the file and the mesh can be built from them without out of range indices
+	bool GValidate(const CacheHeader& header, qint64 size, const unsigned char* data)
+	{
+		for (unsigned section = 0; section < MESH_CACHE_SECTIONS_COUNT; ++section)
+		{
+			const unsigned long long end = header.Offsets[section] + static_cast< unsigned long long >(header.Counts[section]) * cElementSizes[section];
+			if (header.Offsets[section] < sizeof(CacheHeader) || header.Offsets[section] % cSectionAlignment != 0 || end > static_cast< unsigned long long >(size))
+			{
+				return false;
+			}
+		}
+
+		const unsigned verticesCount	= header.Counts[MESH_CACHE_POSITIONS];
+		const unsigned trianglesCount = header.Counts[MESH_CACHE_INDICES] / 3;
+		if (header.Counts[MESH_CACHE_INDICES] % 3 != 0 || header.Counts[MESH_CACHE_NODES] == 0 ||
+				(header.Counts[MESH_CACHE_NORMALS] != 0 && header.Counts[MESH_CACHE_NORMALS] != verticesCount) ||
+				(header.Counts[MESH_CACHE_TEXCOORDS] != 0 && header.Counts[MESH_CACHE_TEXCOORDS] != verticesCount))
+		{
+			return false;
+		}
+
+		const unsigned* indices = reinterpret_cast< const unsigned* >(data + header.Offsets[MESH_CACHE_INDICES]);
+		for (unsigned idx = 0; idx < header.Counts[MESH_CACHE_INDICES]; ++idx)
+		{
+			if (indices[idx] >= verticesCount)
+			{
+				return false;
+			}
+		}
+
+		const unsigned* leafIndices = reinterpret_cast< const unsigned* >(data + header.Offsets[MESH_CACHE_LEAF_INDICES]);
+		for (unsigned idx = 0; idx < header.Counts[MESH_CACHE_LEAF_INDICES]; ++idx)
+		{
+			if (leafIndices[idx] >= trianglesCount)
+			{
+				return false;
+			}
+		}
+
+		// Children follow their parents, so traversal never loops
+		const CacheNode* nodes			= reinterpret_cast< const CacheNode* >(data + header.Offsets[MESH_CACHE_NODES]);
+		const unsigned	 nodesCount = header.Counts[MESH_CACHE_NODES];
+		for (unsigned node = 0; node < nodesCount; ++node)
+		{
+			const CacheNode& cached = nodes[node];
+			const bool			 valid	= cached.Count > 0 ?
+				cached.Count <= header.BlockSize && cached.Offset + cached.Count <= header.Counts[MESH_CACHE_LEAF_INDICES] :
+				node + 1 < cached.Offset && cached.Offset < nodesCount;
+			if (!valid)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+MeshCache::MeshCache(const QString& modelFileName, BVHBuildMode hierarchyMode)
+	: mModelFileName(modelFileName),
+		mFileName(modelFileName + ".cache"),
+		mHierarchyMode(hierarchyMode),
+		mContentHash(0),
+		mHashed(false)
+{
+}
+
+Mesh* MeshCache::load()
+{
+	if (!hashModelFile())
+	{
+		return NULL;
+	}
+
+	QFile file(mFileName);
+	if (!file.open(QIODevice::ReadOnly) || file.size() < static_cast< qint64 >(sizeof(CacheHeader)))
+	{
+		return NULL;
+	}
+
+	const qint64	 size = file.size();
+	unsigned char* data = file.map(0, size);
+	if (!data)
+	{
+		return NULL;
+	}
+
+	CacheHeader header;
+	memcpy(&header, data, sizeof(CacheHeader));
+
+	// Cache of another version, builder or model contents is stale
+	if (memcmp(header.Magic, cMagic, sizeof(cMagic)) != 0 || header.Version != MESH_CACHE_VERSION || header.ByteOrder != cByteOrderMark ||
+			header.ContentHash != mContentHash || header.HierarchyMode != static_cast< unsigned >(mHierarchyMode) ||
+			header.BlockSize != TRIANGLE_BLOCK_SIZE || header.DataHash != GHash(data + sizeof(CacheHeader), size - sizeof(CacheHeader)) ||
+			!GValidate(header, size, data))
+	{
+		file.unmap(data);
+		return NULL;
+	}
+
+	std::vector< Vec3D >		positions, normals, texCoords;
+	std::vector< unsigned > indices, leafIndices;
+	std::vector< BVHNode >	nodes(header.Counts[MESH_CACHE_NODES]);
+
+	GReadVectors(data + header.Offsets[MESH_CACHE_POSITIONS], header.Counts[MESH_CACHE_POSITIONS], &positions);
+	GReadVectors(data + header.Offsets[MESH_CACHE_NORMALS], header.Counts[MESH_CACHE_NORMALS], &normals);
+	GReadVectors(data + header.Offsets[MESH_CACHE_TEXCOORDS], header.Counts[MESH_CACHE_TEXCOORDS], &texCoords);
+
+	const unsigned* cachedIndices = reinterpret_cast< const unsigned* >(data + header.Offsets[MESH_CACHE_INDICES]);
+	indices.assign(cachedIndices, cachedIndices + header.Counts[MESH_CACHE_INDICES]);
+
+	const unsigned* cachedLeafIndices = reinterpret_cast< const unsigned* >(data + header.Offsets[MESH_CACHE_LEAF_INDICES]);
+	leafIndices.assign(cachedLeafIndices, cachedLeafIndices + header.Counts[MESH_CACHE_LEAF_INDICES]);
+
+	const CacheNode* cachedNodes = reinterpret_cast< const CacheNode* >(data + header.Offsets[MESH_CACHE_NODES]);
+	for (unsigned node = 0; node < nodes.size(); ++node)
+	{
+		const CacheNode& cached = cachedNodes[node];
+		nodes[node].Bounds.Min = Vec3D(cached.Min[0], cached.Min[1], cached.Min[2]);
+		nodes[node].Bounds.Max = Vec3D(cached.Max[0], cached.Max[1], cached.Max[2]);
+		nodes[node].Offset		 = cached.Offset;
+		nodes[node].Count			 = cached.Count;
+		nodes[node].Axis			 = cached.Axis;
+	}
+
+	file.unmap(data);
+
+	return new Mesh(&positions, &normals, &texCoords, &indices, &nodes, &leafIndices, mHierarchyMode);
+}
+
+bool MeshCache::save(const Mesh& mesh)
+{
+	if (!hashModelFile())
+	{
+		return false;
+	}
+
+	const std::vector< BVHNode >& nodes = mesh.getHierarchy().getNodes();
+
+	CacheHeader header;
+	memset(&header, 0, sizeof(CacheHeader));
+	memcpy(header.Magic, cMagic, sizeof(cMagic));
+	header.Version												 = MESH_CACHE_VERSION;
+	header.ByteOrder											 = cByteOrderMark;
+	header.ContentHash										 = mContentHash;
+	header.HierarchyMode									 = mHierarchyMode;
+	header.BlockSize											 = TRIANGLE_BLOCK_SIZE;
+	header.Counts[MESH_CACHE_POSITIONS]		 = mesh.getPositions().size();
+	header.Counts[MESH_CACHE_NORMALS]			 = mesh.getNormals().size();
+	header.Counts[MESH_CACHE_TEXCOORDS]		 = mesh.getTexCoords().size();
+	header.Counts[MESH_CACHE_INDICES]			 = mesh.getIndices().size();
+	header.Counts[MESH_CACHE_NODES]				 = nodes.size();
+	header.Counts[MESH_CACHE_LEAF_INDICES] = mesh.getHierarchy().getIndices().size();
+
+	unsigned long long size = sizeof(CacheHeader);
+	for (unsigned section = 0; section < MESH_CACHE_SECTIONS_COUNT; ++section)
+	{
+		header.Offsets[section] = GAlign(size);
+		size										= header.Offsets[section] + static_cast< unsigned long long >(header.Counts[section]) * cElementSizes[section];
+	}
+
+	QByteArray buffer(static_cast< int >(size), 0);
+	char*			 data = buffer.data();
+
+	GWriteVectors(mesh.getPositions(), data + header.Offsets[MESH_CACHE_POSITIONS]);
+	GWriteVectors(mesh.getNormals(), data + header.Offsets[MESH_CACHE_NORMALS]);
+	GWriteVectors(mesh.getTexCoords(), data + header.Offsets[MESH_CACHE_TEXCOORDS]);
+
+	if (!mesh.getIndices().empty())
+	{
+		memcpy(data + header.Offsets[MESH_CACHE_INDICES], &mesh.getIndices()[0], mesh.getIndices().size() * sizeof(unsigned));
+	}
+	if (!mesh.getHierarchy().getIndices().empty())
+	{
+		memcpy(data + header.Offsets[MESH_CACHE_LEAF_INDICES], &mesh.getHierarchy().getIndices()[0], mesh.getHierarchy().getIndices().size() * sizeof(unsigned));
+	}
+
+	CacheNode* cachedNodes = reinterpret_cast< CacheNode* >(data + header.Offsets[MESH_CACHE_NODES]);
+	for (unsigned node = 0; node < nodes.size(); ++node)
+	{
+		const BBox& bounds = nodes[node].Bounds;
+		CacheNode&	cached = cachedNodes[node];
+		cached.Min[0] = bounds.Min.x();
+		cached.Min[1] = bounds.Min.y();
+		cached.Min[2] = bounds.Min.z();
+		cached.Max[0] = bounds.Max.x();
+		cached.Max[1] = bounds.Max.y();
+		cached.Max[2] = bounds.Max.z();
+		cached.Offset = nodes[node].Offset;
+		cached.Count	= nodes[node].Count;
+		cached.Axis		= nodes[node].Axis;
+	}
+
+	header.DataHash = GHash(reinterpret_cast< const unsigned char* >(data + sizeof(CacheHeader)), size - sizeof(CacheHeader));
+	memcpy(data, &header, sizeof(CacheHeader));
+
+	// Several renders may build the same cache at once, so each one writes its own temporary file next to the cache
+	// and replaces the cache with it, the last replaced file wins. Temporary file is removed, unless it's moved
+	QTemporaryFile file(mFileName + ".XXXXXX");
+	if (!file.open() || file.write(buffer) != buffer.size() || !file.flush())
+	{
+		std::cerr << "Failed writing mesh cache: " << mFileName.toUtf8().constData() << std::endl;
+		return false;
+	}
+	file.close();
+
+	// Temporary files are readable by the owner only, but caches are shared like the models next to them
+	file.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup | QFile::ReadOther);
+	if (!GReplaceFile(file.fileName(), mFileName))
+	{
+		std::cerr << "Failed replacing mesh cache: " << mFileName.toUtf8().constData() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool MeshCache::hashModelFile()
+{
+	if (mHashed)
+	{
+		return true;
+	}
+
+	QFile file(mModelFileName);
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		return false;
+	}
+
+	const qint64 size = file.size();
+	if (size == 0)
+	{
+		mContentHash = GHash(NULL, 0);
+		mHashed			 = true;
+		return true;
+	}
+
+	unsigned char* data = file.map(0, size);
+	if (!data)
+	{
+		return false;
+	}
+
+	mContentHash = GHash(data, size);
+	mHashed			 = true;
+
+	file.unmap(data);
+	return true;
+}
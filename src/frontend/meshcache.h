@@ -0,0 +1,45 @@
+#ifndef FRONTEND_MESHCACHE_H
+#define FRONTEND_MESHCACHE_H
+
+#include <QString>
+
+#include "geometry/bvh.h"
+
+class Mesh;
+
+// Layout version of cache files, caches of other versions are rebuilt
+#define MESH_CACHE_VERSION 2
+
+// Binary cache of the mesh, read from a model file, with its built hierarchy. It's kept next to the model file
+// and keyed by the hash of the file contents and the hierarchy builder, so edited models are read again.
+// Model transformations are applied by models, so all of them share one cache.
+// Cache sections are aligned arrays, which are memory mapped and copied without any parsing
+class MeshCache
+{
+public:
+	explicit MeshCache(const QString& modelFileName, BVHBuildMode hierarchyMode);
+
+	//! Load mesh from the cache, returns NULL if there is no valid cache for the current model file contents
+	Mesh* load();
+
+	//! Write mesh to the cache, another file is written and renamed, so readers never see a partial cache
+	bool save(const Mesh& mesh);
+
+	const QString& getFileName() const
+	{
+		return mFileName;
+	}
+
+private:
+	//! Hash contents of the model file once, returns false if it can't be read
+	bool hashModelFile();
+
+private:
+	QString						 mModelFileName;
+	QString						 mFileName;
+	BVHBuildMode			 mHierarchyMode;
+	unsigned long long mContentHash;
+	bool							 mHashed;
+};
+
+#endif // FRONTEND_MESHCACHE_H
@@ -0,0 +1,644 @@
+//-------------------------------------------------------------------
+// File: objparser.cpp
+//
+// Wavefront OBJ model parser
+//			 Numbers are scanned in place from the mapped file, without copying lines into strings.
+//			 Chunks keep their own vertices and faces, faces refer to vertices by indices,
+//			 which are resolved to the whole file indices, when chunks are stitched
+//
+//
+//-------------------------------------------------------------------
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+#include <locale.h>
+#if defined(__APPLE__)
+	#include <xlocale.h>
+#endif
+
+#include <QFile>
+
+#include "geometry/mesh.h"
+#include "geometry/parallel.h"
+
+#include "objparser.h"
+
+namespace
+{
+	enum ObjAttribute
+	{
+		OBJ_POSITION,
+		OBJ_TEXCOORD,
+		OBJ_NORMAL,
+		OBJ_ATTRIBUTES_COUNT
+	};
+
+	// Chunks are big enough, so small files aren't split between threads
+	const size_t cMinChunkSize = 1 << 20;
+
+	// Index of the face vertex attribute, which isn't given, e.g. texture coordinates of "v//vn"
+	const int cMissingIndex = INT_MIN;
+
+	// Numbers are always written with the dot, so they are converted in the C locale, whatever locale the application sets.
+	// Locale is created once at startup, because parser threads can't race to initialize it
+#if defined(_MSC_VER)
+	const _locale_t cNumericLocale = _create_locale(LC_NUMERIC, "C");
+#else
+	const locale_t	cNumericLocale = newlocale(LC_NUMERIC_MASK, "C", static_cast< locale_t >(0));
+#endif
+
+	// Powers of ten, which are exact in double, so numbers with them are rounded only once
+	const double cPowersOf10[] = {1e0,	1e1,	1e2,	1e3,	1e4,	1e5,	1e6,	1e7,	1e8,	1e9,	1e10, 1e11,
+																1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+	// Face vertex as it's written in the chunk. Positive OBJ indices refer to the whole file, negative ones refer
+	// to vertices before the face, so they are kept relative to the chunk start, until preceding chunks are counted
+	struct ObjFaceVertex
+	{
+		int			 Indices[OBJ_ATTRIBUTES_COUNT];
+		// Bit per attribute, which index is relative to the chunk start
+		unsigned Relative;
+	};
+
+	struct ObjChunk
+	{
+		std::vector< Vec3D >				 Attributes[OBJ_ATTRIBUTES_COUNT];
+		std::vector< ObjFaceVertex > FaceVertices;
+		std::vector< unsigned >			 FaceSizes;
+		// First malformed line of the chunk
+		const char*									 Error;
+		// Faces refer to vertices, which aren't in the file
+		bool												 InvalidIndices;
+		// All the face vertices have the attribute
+		bool												 Complete[OBJ_ATTRIBUTES_COUNT];
+		// All the face vertices have attribute indices equal to the position ones
+		bool												 Aligned[OBJ_ATTRIBUTES_COUNT];
+		// Offsets of chunk vertices and triangles in the whole file
+		unsigned										 Offsets[OBJ_ATTRIBUTES_COUNT];
+		unsigned										 TrianglesOffset;
+	};
+
+	// Face vertex of the whole file, zero index of attribute, which isn't used by the mesh, doesn't distinguish vertices
+	struct VertexKey
+	{
+		bool operator==(const VertexKey& rh) const
+		{
+			return Position == rh.Position && TexCoord == rh.TexCoord && Normal == rh.Normal;
+		}
+
+		unsigned Position;
+		unsigned TexCoord;
+		unsigned Normal;
+	};
+
+	struct VertexKeyHash
+	{
+		size_t operator()(const VertexKey& key) const
+		{
+			return (key.Position * 73856093u) ^ (key.TexCoord * 19349663u) ^ (key.Normal * 83492791u);
+		}
+	};
+
+	inline bool GIsSpace(char symbol)
+	{
+		return symbol == ' ' || symbol == '\t' || symbol == '\r';
+	}
+
+	inline bool GIsDigit(char symbol)
+	{
+		return static_cast< unsigned >(symbol - '0') < 10;
+	}
+
+	inline const char* GSkipSpaces(const char* pos, const char* end)
+	{
+		while (pos < end && GIsSpace(*pos))
+		{
+			++pos;
+		}
+		return pos;
+	}
+
+	// Scan number, which has no fast form, e.g. "inf" or a huge exponent. Text isn't null-terminated, so it's copied
+	const char* GScanFloatSlow(const char* pos, const char* end, float* value)
+	{
+		char				 buffer[64];
+		const size_t length = std::min(static_cast< size_t >(end - pos), sizeof(buffer) - 1);
+		memcpy(buffer, pos, length);
+		buffer[length] = '\0';
+
+		char*				 scanEnd;
+#if defined(_MSC_VER)
+		const double result = _strtod_l(buffer, &scanEnd, cNumericLocale);
+#else
+		const double result = strtod_l(buffer, &scanEnd, cNumericLocale);
+#endif
+		if (scanEnd == buffer)
+		{
+			return NULL;
+		}
+		*value = static_cast< float >(result);
+		return pos + (scanEnd - buffer);
+	}
+
+	//! Scan float at the position, returns position after it or NULL, if there is no number
+	const char* GScanFloat(const char* pos, const char* end, float* value)
+	{
+		const char* start		 = pos;
+		const bool	negative = pos < end && *pos == '-';
+		if (pos < end && (*pos == '-' || *pos == '+'))
+		{
+			++pos;
+		}
+
+		// Digits, which don't fit 64-bit mantissa, only scale it
+		unsigned long long mantissa = 0;
+		int								 exponent = 0;
+		int								 digits		= 0;
+		bool							 scanned	= false;
+		for (; pos < end && GIsDigit(*pos); ++pos)
+		{
+			scanned = true;
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*pos - '0');
+				digits += mantissa != 0;
+			}
+			else
+			{
+				++exponent;
+			}
+		}
+		if (pos < end && *pos == '.')
+		{
+			for (++pos; pos < end && GIsDigit(*pos); ++pos)
+			{
+				scanned = true;
+				if (digits < 19)
+				{
+					mantissa = mantissa * 10 + (*pos - '0');
+					digits += mantissa != 0;
+					--exponent;
+				}
+			}
+		}
+		if (!scanned)
+		{
+			return GScanFloatSlow(start, end, value);
+		}
+
+		if (pos < end && (*pos == 'e' || *pos == 'E'))
+		{
+			const char* exponentPos = pos + 1;
+			const bool	expNegative = exponentPos < end && *exponentPos == '-';
+			if (exponentPos < end && (*exponentPos == '-' || *exponentPos == '+'))
+			{
+				++exponentPos;
+			}
+			if (exponentPos == end || !GIsDigit(*exponentPos))
+			{
+				return GScanFloatSlow(start, end, value);
+			}
+			int written = 0;
+			for (; exponentPos < end && GIsDigit(*exponentPos); ++exponentPos)
+			{
+				written = std::min(written * 10 + (*exponentPos - '0'), 100000);
+			}
+			exponent += expNegative ? -written : written;
+			pos = exponentPos;
+		}
+
+		if (exponent < -22 || exponent > 22)
+		{
+			return GScanFloatSlow(start, end, value);
+		}
+
+		double result = static_cast< double >(mantissa);
+		result				= exponent < 0 ? result / cPowersOf10[-exponent] : result * cPowersOf10[exponent];
+		*value				= static_cast< float >(negative ? -result : result);
+		return pos;
+	}
+
+	//! Scan integer at the position, returns position after it or NULL, if there is no number
+	const char* GScanInt(const char* pos, const char* end, int* value)
+	{
+		const bool negative = pos < end && *pos == '-';
+		if (pos < end && (*pos == '-' || *pos == '+'))
+		{
+			++pos;
+		}
+		if (pos == end || !GIsDigit(*pos))
+		{
+			return NULL;
+		}
+
+		long long result = 0;
+		for (; pos < end && GIsDigit(*pos); ++pos)
+		{
+			result = std::min(result * 10 + (*pos - '0'), static_cast< long long >(INT_MAX));
+		}
+		*value = static_cast< int >(negative ? -result : result);
+		return pos;
+	}
+
+	//! Scan vector of two or three floats, third coordinate is optional, e.g. for texture coordinates
+	const char* GScanVector(const char* pos, const char* end, bool optionalZ, Vec3D* vector)
+	{
+		float coords[3] = {0.f, 0.f, 0.f};
+		for (unsigned axis = 0; axis < 3; ++axis)
+		{
+			pos									= GSkipSpaces(pos, end);
+			const char* scanned = GScanFloat(pos, end, &coords[axis]);
+			if (!scanned)
+			{
+				if (axis == 2 && optionalZ)
+				{
+					break;
+				}
+				return NULL;
+			}
+			pos = scanned;
+		}
+		*vector = Vec3D(coords[0], coords[1], coords[2]);
+		return pos;
+	}
+
+	//! Make index of the face vertex attribute zero-based, negative index is resolved against the chunk vertices
+	//! before the face and marked relative
+	bool GResolveIndex(int index, unsigned chunkCount, unsigned attribute, ObjFaceVertex* vertex)
+	{
+		if (index > 0)
+		{
+			vertex->Indices[attribute] = index - 1;
+			return true;
+		}
+		if (index < 0)
+		{
+			vertex->Indices[attribute] = static_cast< int >(chunkCount) + index;
+			vertex->Relative |= 1u << attribute;
+			return true;
+		}
+		return false;
+	}
+
+	//! Scan face vertex in "v", "v/vt", "v/vt/vn" or "v//vn" form
+	const char* GScanFaceVertex(const char* pos, const char* end, const ObjChunk& chunk, ObjFaceVertex* vertex)
+	{
+		for (unsigned attribute = 0; attribute < OBJ_ATTRIBUTES_COUNT; ++attribute)
+		{
+			vertex->Indices[attribute] = cMissingIndex;
+		}
+		vertex->Relative = 0;
+
+		for (unsigned attribute = 0; attribute < OBJ_ATTRIBUTES_COUNT; ++attribute)
+		{
+			if (attribute > 0)
+			{
+				if (pos == end || *pos != '/')
+				{
+					break;
+				}
+				++pos;
+				// Texture coordinates may be skipped
+				if (attribute == OBJ_TEXCOORD && pos < end && *pos == '/')
+				{
+					continue;
+				}
+			}
+
+			int index;
+			pos = GScanInt(pos, end, &index);
+			if (!pos || !GResolveIndex(index, chunk.Attributes[attribute].size(), attribute, vertex))
+			{
+				return NULL;
+			}
+		}
+		return pos;
+	}
+
+	//! Parse the line without its end, returns false if it's malformed
+	bool GParseLine(const char* pos, const char* end, ObjChunk* chunk)
+	{
+		if (end - pos < 2 || (!GIsSpace(pos[1]) && !(pos[0] == 'v' && (pos[1] == 't' || pos[1] == 'n') && end - pos > 2 && GIsSpace(pos[2]))))
+		{
+			// Comments, empty lines and commands with long names, e.g. "usemtl", aren't supported
+			return true;
+		}
+
+		if (pos[0] == 'v')
+		{
+			// Vertices are kept in mesh space, models apply their own transformations
+			const unsigned attribute = pos[1] == 't' ? OBJ_TEXCOORD : pos[1] == 'n' ? OBJ_NORMAL : OBJ_POSITION;
+			Vec3D					 vector;
+			if (!GScanVector(pos + (attribute == OBJ_POSITION ? 1 : 2), end, attribute == OBJ_TEXCOORD, &vector))
+			{
+				return false;
+			}
+			chunk->Attributes[attribute].push_back(vector);
+		}
+		else if (pos[0] == 'f')
+		{
+			unsigned count = 0;
+			for (pos = GSkipSpaces(pos + 1, end); pos < end && *pos != '#'; pos = GSkipSpaces(pos, end))
+			{
+				ObjFaceVertex vertex;
+				pos = GScanFaceVertex(pos, end, *chunk, &vertex);
+				if (!pos)
+				{
+					return false;
+				}
+				chunk->FaceVertices.push_back(vertex);
+				++count;
+			}
+
+			if (count < 3)
+			{
+				// Points and lines have no area
+				chunk->FaceVertices.resize(chunk->FaceVertices.size() - count);
+			}
+			else
+			{
+				chunk->FaceSizes.push_back(count);
+			}
+		}
+		return true;
+	}
+
+	void GParseChunk(const char* pos, const char* end, ObjChunk* chunk)
+	{
+		chunk->Error = NULL;
+		while (pos < end)
+		{
+			const char* lineEnd = static_cast< const char* >(memchr(pos, '\n', end - pos));
+			if (!lineEnd)
+			{
+				// Last line may have no line end
+				lineEnd = end;
+			}
+
+			const char* lineStart = GSkipSpaces(pos, lineEnd);
+			if (!GParseLine(lineStart, lineEnd, chunk) && !chunk->Error)
+			{
+				chunk->Error = pos;
+			}
+			pos = lineEnd + 1;
+		}
+	}
+
+	//! Resolve face vertices of the chunk to the whole file indices and check that they refer to existing vertices
+	void GResolveChunk(ObjChunk* chunk, const unsigned* totals)
+	{
+		chunk->InvalidIndices = false;
+		for (unsigned attribute = 0; attribute < OBJ_ATTRIBUTES_COUNT; ++attribute)
+		{
+			chunk->Complete[attribute] = true;
+			chunk->Aligned[attribute]	 = true;
+		}
+
+		for (unsigned idx = 0; idx < chunk->FaceVertices.size(); ++idx)
+		{
+			ObjFaceVertex& vertex = chunk->FaceVertices[idx];
+			for (unsigned attribute = 0; attribute < OBJ_ATTRIBUTES_COUNT; ++attribute)
+			{
+				int& index = vertex.Indices[attribute];
+				if (index == cMissingIndex)
+				{
+					chunk->Complete[attribute] = false;
+					continue;
+				}
+				if (vertex.Relative & (1u << attribute))
+				{
+					index += chunk->Offsets[attribute];
+				}
+				if (index < 0 || static_cast< unsigned >(index) >= totals[attribute])
+				{
+					chunk->InvalidIndices = true;
+					index									= 0;
+				}
+			}
+			chunk->Aligned[OBJ_TEXCOORD] = chunk->Aligned[OBJ_TEXCOORD] && vertex.Indices[OBJ_TEXCOORD] == vertex.Indices[OBJ_POSITION];
+			chunk->Aligned[OBJ_NORMAL]	 = chunk->Aligned[OBJ_NORMAL] && vertex.Indices[OBJ_NORMAL] == vertex.Indices[OBJ_POSITION];
+		}
+	}
+
+	//! Split polygons of the chunk into triangle fans, vertices of face vertices are taken from the given array
+	void GTriangulateChunk(const ObjChunk& chunk, const unsigned* vertices, unsigned* indices)
+	{
+		for (unsigned face = 0, first = 0; face < chunk.FaceSizes.size(); first += chunk.FaceSizes[face++])
+		{
+			for (unsigned idx = 2; idx < chunk.FaceSizes[face]; ++idx)
+			{
+				*indices++ = vertices[first];
+				*indices++ = vertices[first + idx - 1];
+				*indices++ = vertices[first + idx];
+			}
+		}
+	}
+
+	//! Get line number of the position for error messages
+	unsigned GLineNumber(const char* text, const char* pos)
+	{
+		unsigned line = 1;
+		for (; text < pos; ++text)
+		{
+			line += *text == '\n';
+		}
+		return line;
+	}
+}
+
+ObjParser::ObjParser(unsigned threadsCount)
+	: mThreadsCount(ParallelThreadsCount(threadsCount))
+{
+}
+
+bool ObjParser::read(const QString& fileName)
+{
+	QFile modelFile(fileName);
+	if (!modelFile.open(QIODevice::ReadOnly))
+	{
+		std::cerr << "Failed loading model file: " << fileName.toUtf8().constData() << std::endl;
+		return false;
+	}
+
+	// Empty files can't be mapped
+	const qint64 size = modelFile.size();
+	const char*	 text = size > 0 ? reinterpret_cast< const char* >(modelFile.map(0, size)) : "";
+	if (!text)
+	{
+		std::cerr << "Failed mapping model file: " << fileName.toUtf8().constData() << std::endl;
+		return false;
+	}
+
+	const bool parsed = parse(text, static_cast< size_t >(size));
+	if (size > 0)
+	{
+		modelFile.unmap(reinterpret_cast< uchar* >(const_cast< char* >(text)));
+	}
+	if (!parsed)
+	{
+		std::cerr << "Failed parsing model file: " << fileName.toUtf8().constData() << std::endl;
+	}
+	return parsed;
+}
+
+bool ObjParser::parse(const char* text, size_t size)
+{
+	mPositions.clear();
+	mNormals.clear();
+	mTexCoords.clear();
+	mIndices.clear();
+
+	// Chunks start after line ends, so every line is parsed by one thread
+	const unsigned				chunksCount = static_cast< unsigned >(std::max< size_t >(1, std::min< size_t >(mThreadsCount, size / cMinChunkSize)));
+	std::vector< size_t > bounds(chunksCount + 1, size);
+	bounds[0] = 0;
+	for (unsigned chunk = 1; chunk < chunksCount; ++chunk)
+	{
+		const size_t start	= std::max(bounds[chunk - 1], static_cast< size_t >(size * chunk / chunksCount));
+		const char*	 lineEnd = static_cast< const char* >(memchr(text + start, '\n', size - start));
+		bounds[chunk]				 = lineEnd ? lineEnd - text + 1 : size;
+	}
+
+	std::vector< ObjChunk > chunks(chunksCount);
+	ParallelRun(chunksCount, [&](unsigned chunk)
+	{
+		GParseChunk(text + bounds[chunk], text + bounds[chunk + 1], &chunks[chunk]);
+	});
+
+	for (unsigned chunk = 0; chunk < chunksCount; ++chunk)
+	{
+		if (chunks[chunk].Error)
+		{
+			std::cerr << "Malformed model line " << GLineNumber(text, chunks[chunk].Error) << std::endl;
+			return false;
+		}
+	}
+
+	// Stitch chunks: their vertices and triangles follow the ones of preceding chunks
+	unsigned totals[OBJ_ATTRIBUTES_COUNT] = {0, 0, 0};
+	unsigned trianglesCount								= 0;
+	for (unsigned chunk = 0; chunk < chunksCount; ++chunk)
+	{
+		for (unsigned attribute = 0; attribute < OBJ_ATTRIBUTES_COUNT; ++attribute)
+		{
+			chunks[chunk].Offsets[attribute] = totals[attribute];
+			totals[attribute] += chunks[chunk].Attributes[attribute].size();
+		}
+		chunks[chunk].TrianglesOffset = trianglesCount;
+		for (unsigned face = 0; face < chunks[chunk].FaceSizes.size(); ++face)
+		{
+			trianglesCount += chunks[chunk].FaceSizes[face] - 2;
+		}
+	}
+
+	ParallelRun(chunksCount, [&](unsigned chunk)
+	{
+		GResolveChunk(&chunks[chunk], totals);
+	});
+
+	// Attributes, which aren't given for some face vertices, aren't used at all, so such triangles use face normals
+	bool used[OBJ_ATTRIBUTES_COUNT]		 = {true, totals[OBJ_TEXCOORD] > 0, totals[OBJ_NORMAL] > 0};
+	bool aligned[OBJ_ATTRIBUTES_COUNT] = {true, totals[OBJ_TEXCOORD] == totals[OBJ_POSITION], totals[OBJ_NORMAL] == totals[OBJ_POSITION]};
+	for (unsigned chunk = 0; chunk < chunksCount; ++chunk)
+	{
+		if (chunks[chunk].InvalidIndices)
+		{
+			std::cerr << "Model faces refer to missing vertices" << std::endl;
+			return false;
+		}
+		for (unsigned attribute = OBJ_TEXCOORD; attribute < OBJ_ATTRIBUTES_COUNT; ++attribute)
+		{
+			used[attribute]		 = used[attribute] && chunks[chunk].Complete[attribute];
+			aligned[attribute] = aligned[attribute] && chunks[chunk].Aligned[attribute];
+		}
+	}
+
+	// Vertices of chunks are concatenated in the file order. If all the attributes of each face vertex have the same index,
+	// which is common for exported meshes, vertices are used as they are, so triangles are made on the same pass
+	const bool identity = (!used[OBJ_TEXCOORD] || aligned[OBJ_TEXCOORD]) && (!used[OBJ_NORMAL] || aligned[OBJ_NORMAL]);
+
+	std::vector< Vec3D >* attributes[OBJ_ATTRIBUTES_COUNT] = {&mPositions, &mTexCoords, &mNormals};
+	for (unsigned attribute = 0; attribute < OBJ_ATTRIBUTES_COUNT; ++attribute)
+	{
+		attributes[attribute]->resize(used[attribute] ? totals[attribute] : 0);
+	}
+	mIndices.resize(trianglesCount * 3);
+
+	ParallelRun(chunksCount, [&](unsigned chunk)
+	{
+		const ObjChunk& data = chunks[chunk];
+		for (unsigned attribute = 0; attribute < OBJ_ATTRIBUTES_COUNT; ++attribute)
+		{
+			if (used[attribute])
+			{
+				std::copy(data.Attributes[attribute].begin(), data.Attributes[attribute].end(), attributes[attribute]->begin() + data.Offsets[attribute]);
+			}
+		}
+
+		if (identity)
+		{
+			std::vector< unsigned > vertices(data.FaceVertices.size());
+			for (unsigned idx = 0; idx < vertices.size(); ++idx)
+			{
+				vertices[idx] = data.FaceVertices[idx].Indices[OBJ_POSITION];
+			}
+			GTriangulateChunk(data, vertices.data(), mIndices.data() + data.TrianglesOffset * 3);
+		}
+	});
+
+	if (identity)
+	{
+		return true;
+	}
+
+	// Face vertices, which are met several times, are stored only once. Attributes, which aren't used,
+	// don't distinguish vertices
+	std::vector< Vec3D > fileAttributes[OBJ_ATTRIBUTES_COUNT];
+	for (unsigned attribute = 0; attribute < OBJ_ATTRIBUTES_COUNT; ++attribute)
+	{
+		fileAttributes[attribute].swap(*attributes[attribute]);
+	}
+
+	std::unordered_map< VertexKey, unsigned, VertexKeyHash > vertices;
+	std::vector< unsigned >																	 chunkVertices;
+	for (unsigned chunk = 0; chunk < chunksCount; ++chunk)
+	{
+		const ObjChunk& data = chunks[chunk];
+		chunkVertices.resize(data.FaceVertices.size());
+		for (unsigned idx = 0; idx < data.FaceVertices.size(); ++idx)
+		{
+			const ObjFaceVertex& vertex = data.FaceVertices[idx];
+
+			VertexKey key;
+			key.Position = vertex.Indices[OBJ_POSITION];
+			key.TexCoord = used[OBJ_TEXCOORD] ? vertex.Indices[OBJ_TEXCOORD] : 0;
+			key.Normal	 = used[OBJ_NORMAL] ? vertex.Indices[OBJ_NORMAL] : 0;
+
+			const std::pair< std::unordered_map< VertexKey, unsigned, VertexKeyHash >::iterator, bool > inserted =
+				vertices.insert(std::make_pair(key, unsigned(mPositions.size())));
+			if (inserted.second)
+			{
+				for (unsigned attribute = 0; attribute < OBJ_ATTRIBUTES_COUNT; ++attribute)
+				{
+					if (used[attribute])
+					{
+						attributes[attribute]->push_back(fileAttributes[attribute][vertex.Indices[attribute]]);
+					}
+				}
+			}
+			chunkVertices[idx] = inserted.first->second;
+		}
+		GTriangulateChunk(data, chunkVertices.data(), mIndices.data() + data.TrianglesOffset * 3);
+	}
+	return true;
+}
+
+Mesh* ObjParser::createMesh(BVHBuildMode hierarchyMode)
+{
+	return new Mesh(&mPositions, &mNormals, &mTexCoords, &mIndices, hierarchyMode);
+}
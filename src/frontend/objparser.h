@@ -0,0 +1,47 @@
+#ifndef FRONTEND_OBJPARSER_H
+#define FRONTEND_OBJPARSER_H
+
+#include <cstddef>
+#include <vector>
+
+#include <QString>
+
+#include "geometry/bvh.h"
+#include "geometry/vector3d.h"
+
+class Mesh;
+
+// Parser of Wavefront OBJ models, it reads vertices, texture coordinates, normals and polygonal faces.
+// File is memory mapped and split into chunks at line boundaries, chunks are parsed on several threads
+// and then stitched in the file order, so negative indices are resolved against all the preceding vertices.
+// Face vertices, which are met several times, are stored only once
+class ObjParser
+{
+public:
+	//! Zero threads count means the number of hardware threads
+	explicit ObjParser(unsigned threadsCount = 0);
+
+	//! Parse the model file, returns false if it can't be read, it has malformed lines or faces refer to missing vertices
+	bool read(const QString& fileName);
+
+	//! Parse the model text, it doesn't need to be null-terminated
+	bool parse(const char* text, size_t size);
+
+	//! Create mesh from the parsed data, parser is left empty
+	Mesh* createMesh(BVHBuildMode hierarchyMode);
+
+	unsigned getTrianglesCount() const
+	{
+		return mIndices.size() / 3;
+	}
+
+private:
+	// Deduplicated vertices, each vertex has all the attributes, which are given for all the face vertices
+	std::vector< Vec3D >		mPositions;
+	std::vector< Vec3D >		mNormals;
+	std::vector< Vec3D >		mTexCoords;
+	std::vector< unsigned > mIndices;
+	unsigned								mThreadsCount;
+};
+
+#endif // FRONTEND_OBJPARSER_H
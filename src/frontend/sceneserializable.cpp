@@ -7,6 +7,7 @@
 //-------------------------------------------------------------------
 
 #define _USE_MATH_DEFINES
+#include <chrono>
 #include <iostream>
 #include <math.h>
 
@@ -23,13 +24,13 @@
 #include "geometry/box.h"
 #include "geometry/cone.h"
 #include "geometry/cylinder.h"
+#include "geometry/mesh.h"
 #include "geometry/model.h"
-#include "geometry/modeltriangle.h"
 #include "geometry/plane.h"
-#include "geometry/smoothtriangle.h"
 #include "geometry/sphere.h"
 #include "geometry/triangle.h"
 #include "geometry/torus.h"
+#include "geometry/transform.h"
 
 #include "illumination/lightsource.h"
 #include "illumination/material.h"
@@ -38,6 +39,9 @@
 #include "tracer/scene.h"
 #include "tracer/tracerproperties.h"
 
+#include "meshcache.h"
+#include "objparser.h"
+
 #include "sceneserializable.h"
 
 namespace
@@ -69,6 +73,55 @@ namespace
 		return std::string();
 	}
 
+	//! Read optional hierarchy builder from "hierarchy" attribute, which is "sah", "linear", "linear_treelets" or "spatial".
+	//! Mode is kept if there is no attribute, returns false for unknown builders
+	bool GReadHierarchyMode(const QDomNode& node, BVHBuildMode* mode)
+	{
+		QString name;
+		if (!IXmlSerializable::readAttribute(node, "hierarchy", name))
+		{
+			return true;
+		}
+
+		if (name == "sah")
+		{
+			*mode = BVH_BUILD_SAH;
+		}
+		else if (name == "linear")
+		{
+			*mode = BVH_BUILD_LINEAR;
+		}
+		else if (name == "linear_treelets")
+		{
+			*mode = BVH_BUILD_LINEAR_TREELETS;
+		}
+		else if (name == "spatial")
+		{
+			*mode = BVH_BUILD_SPATIAL;
+		}
+		else
+		{
+			std::cerr << "Unknown hierarchy builder: " << name.toUtf8().constData() << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	const char* GHierarchyModeName(BVHBuildMode mode)
+	{
+		switch (mode)
+		{
+		case BVH_BUILD_LINEAR:
+			return "linear";
+		case BVH_BUILD_LINEAR_TREELETS:
+			return "linear with treelets";
+		case BVH_BUILD_SPATIAL:
+			return "spatial split";
+		default:
+			return "SAH";
+		}
+	}
+
 	// Local readers for different scene entities
 	struct VectorReader : public IXmlSerializable
 	{
@@ -953,218 +1006,11 @@ namespace
 		Box* ObjBox;
 	};
 
-	class ObjLoader
-	{
-		struct Vertex 
-		{
-			Vec3D Position;
-			Vec3D Normal;
-			Vec3D TexCoords; // Actually 2 dimensional
-		};
-
-	public:
-		ObjLoader(const Vec3D& translation, const Vec3D& scale)
-			: mTranslation(translation),
-				mScale(scale)
-		{
-		}
-
-		bool read(const QString& fileName)
-		{
-			// Read obj file and construct triangles
-			QFile modelFile(fileName);
-
-			modelFile.open(QIODevice::ReadOnly);
-			if (!modelFile.isOpen())
-			{
-				std::cerr << "Failed loading model file: " << fileName.toUtf8().constData() << std::endl;
-				return false;
-			}
-
-			std::vector<Vec3D> positions;
-			std::vector<Vec3D> normals;
-			std::vector<Vec3D> texCoords;
-
-			std::vector<Vertex>	  faceVertices;
-			std::vector<unsigned> faceVerticesIndices;
-			std::vector<unsigned> faceIndices;
-
-			// Result indices for triangles construction
-			std::vector< unsigned > indices;
-			// Result vertices for triangles construction
-			std::vector< Vertex >		vertices;
-
-			for(;;)
-			{
-				QString command = modelFile.readLine();
-				if (modelFile.atEnd())
-				{
-					break;
-				}
-
-				if (command.contains("#"))
-				{
-					// Comment
-				}
-				else if (command.startsWith("v "))
-				{
-					// Vertex
-					// Also apply translation
-					Vec3D modelPosition = scale3D(fromObjLine(command, "v"), mScale) + mTranslation;
-					positions.push_back(modelPosition);
-				}
-				else if (command.startsWith("vt "))
-				{
-					// Texcoords
-					texCoords.push_back(fromObjLine(command, "vt"));
-				}
-				else if (command.startsWith("vn "))
-				{
-					// Normals
-					normals.push_back(fromObjLine(command, "vn"));
-				}
-				else if (command.startsWith("f "))
-				{
-					faceVertices.clear();
-					faceVerticesIndices.clear();
-
-					QStringList indicesDescs = toIndicesDescriptor(command, "f");
-
-					foreach (const QString& index, indicesDescs)
-					{
-						unsigned position, texcoord, normal;
-						Vertex v;
-
-						toIndices(index, &position, &normal, &texcoord);
-
-						// OBJ uses 1-based arrays
-						if (!positions.empty())
-							v.Position  = positions[position - 1];
-						if (!normals.empty())
-							v.Normal    = normals[normal - 1];
-						if (!texCoords.empty())
-							v.TexCoords = texCoords[texcoord - 1];
-
-						faceVertices.push_back(v);
-						faceVerticesIndices.push_back(position);
-					}
-					const unsigned count = faceVertices.size();
-					faceIndices.resize(count);
-					for (unsigned idx = 0; idx < count; ++idx)
-					{
-						// Triangle strip
-						if (idx > 2)
-						{
-							indices.push_back( faceIndices[0] );
-							indices.push_back( faceIndices[idx - 1] );
-						}
-						faceIndices[idx] = vertices.size();
-						vertices.push_back(faceVertices[idx]);
-						indices.push_back(faceIndices[idx]);
-					}
-				}
-
-				// Also commands can be "mtlib" and "usemtl", but we do not support them
-			}
-
-			// Now create triangles, we need only positions, maybe for now
-			for (int idx = 0, count = indices.size(); idx < count; idx += 3)
-			{
-				Vertex a = vertices[indices[idx]];
-				Vertex b = vertices[indices[idx + 1]];
-				Vertex c = vertices[indices[idx + 2]];
-
-				// Mtrl isn't assigned to triangle, it's owned by the model
-				mTriangles.push_back(new ModelTriangle(a.Position,  b.Position, c.Position, 
-																							 a.Normal,		b.Normal,		c.Normal,
-																							 a.TexCoords,	b.TexCoords,c.TexCoords,
-																							 NULL));
-			}
-
-			// Analyze positions to create bounding box
-			Vec3D bboxMin;
-			Vec3D bboxMax;
-			for (std::vector< Vec3D >::iterator pos = positions.begin(); pos != positions.end(); ++pos)
-			{
-				const Vec3D& position = *pos;
-
-				// Scan for min
-				if (position.x() < bboxMin.x())
-					bboxMin.setX(position.x());
-				if (position.y() < bboxMin.y())
-					bboxMin.setY(position.y());
-				if (position.z() < bboxMin.z())
-					bboxMin.setZ(position.z());
-
-				// Scan for max
-				if (position.x() > bboxMax.x())
-					bboxMax.setX(position.x());
-				if (position.y() > bboxMax.y())
-					bboxMax.setY(position.y());
-				if (position.z() > bboxMax.z())
-					bboxMax.setZ(position.z());
-			}
-
-			mModelBBox.Min = bboxMin;
-			mModelBBox.Max = bboxMax;
-			return true;
-		}
-
-		const std::vector< ModelTriangle* > getTriangles() const
-		{
-			return mTriangles;
-		}
-
-		const BBox& getBoundingBox() const
-		{
-			return mModelBBox;
-		}
-
-	private:
-		Vec3D fromObjLine(QString line /* Will be modified */, const QString& prefix)
-		{
-			QString			vectorString = line.remove(prefix + " ").remove("\n").remove("\r");
-			QStringList coords			 = vectorString.split(" ", QString::SkipEmptyParts);
-			// Remove spaces
-			coords.removeAll(" ");
-			coords.removeAll("");
-			coords.removeAll("\n");
-			if (coords.size() == 3)
-				return Vec3D(coords[0].toFloat(), coords[1].toFloat(), coords[2].toFloat());
-
-			// For texcoords
-			return Vec3D(coords[0].toFloat(), coords[1].toFloat(), 0.f);
-		}
-
-		QStringList toIndicesDescriptor(QString line, const QString& prefix)
-		{
-			QString			 indicesString = line.remove(prefix + " ");
-			QStringList	 descs = indicesString.split(" ");
-			return descs;
-		}
-
-		void toIndices(const QString& line, unsigned *position, unsigned *normal, unsigned *texcoord)
-		{
-			QStringList indices = line.split("/");
-			*position = indices[0].toUInt();
-			*texcoord = indices[1].toUInt(); // Texcoord is second 
-			*normal   = indices[2].toUInt();
-		}
-
-	private:
-		// Translation of model vertices
-		Vec3D											mTranslation;
-		// Scaling of model vertices
-		Vec3D											mScale;
-
-		std::vector< ModelTriangle* > mTriangles;
-		BBox													mModelBBox;
-	};
-
 	struct ModelLoader : public IXmlSerializable
 	{
-		ModelLoader() :
-			ObjModel(NULL)
+		ModelLoader(Scene* scene)
+			: ObjModel(NULL),
+				ModelScene(scene)
 		{
 		}
 
@@ -1195,7 +1041,23 @@ namespace
 				return false;
 			}
 			readNode = readNode.nextSibling();
-			// Read model file name
+			// Read optional rotation around axis, angle is in degrees
+			// <rotate>
+			Transform rotation;
+			if (readNode.toElement().tagName() == "rotate")
+			{
+				const Vec3D axis = reader.readPosition(&readNode, &ok);
+				float				angle;
+				ok = readAttribute(readNode, "angle", angle) && ok;
+				if (!ok)
+				{
+					GDumpErrorMessage(readNode, *node, "Failed reading model rotation!");
+					return false;
+				}
+				rotation = Transform::Rotation(axis, angle * float(M_PI) / 180.f);
+				readNode = readNode.nextSibling();
+			}
+			// Read model file name and optional hierarchy builder of its mesh
 			// <model>
 			ok = readAttribute(readNode, "file_name", fileName);
 
@@ -1205,6 +1067,13 @@ namespace
 				return false;
 			}
 
+			BVHBuildMode hierarchyMode = ModelScene->getHierarchyBuildMode();
+			if (!GReadHierarchyMode(readNode, &hierarchyMode))
+			{
+				GDumpErrorMessage(readNode, *node, "Failed reading model hierarchy builder!");
+				return false;
+			}
+
 			// Try to find explicitly set material
 			Mtrl* modelMtrl = NULL;
 			readNode = readNode.nextSibling();
@@ -1213,10 +1082,6 @@ namespace
 			{
 				MtrlReader reader;
 				if (!reader.read(&readNode))
-				{
-					return false;
-				}
-				else
 				{
 					GDumpErrorMessage(readNode, *node, "Failed reading model material!");
 					return false;
@@ -1224,30 +1089,63 @@ namespace
 				modelMtrl = reader.ObjMtrl;
 			}
 
-			// Read model
-			ObjLoader modelLoader(translate, scale);
-			if (!modelLoader.read(fileName))
+			// Mesh is read only once and then shared by all the models, which use the same file,
+			// so its hierarchy is built by the builder of the first model
+			const std::string meshName = fileName.toUtf8().constData();
+			Mesh*							mesh		 = ModelScene->getMesh(meshName);
+			if (!mesh)
 			{
-				return false;
-			}
-			else
-			{
-				GDumpErrorMessage(readNode, *node, "Failed reading model!");
-				return false;
+				// Model file is parsed and its hierarchy is built only if there is no cache for its current contents
+				const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+				MeshCache cache(fileName, hierarchyMode);
+				mesh = cache.load();
+				if (mesh)
+				{
+					std::cout << "Mesh " << meshName << ": " << mesh->getTrianglesCount() << " triangles, " << GHierarchyModeName(hierarchyMode)
+										<< " hierarchy loaded from cache in " << std::chrono::duration< double >(std::chrono::steady_clock::now() - start).count()
+										<< " s" << std::endl;
+				}
+				else
+				{
+					// Parsing is timed apart from the cache lookup, which has already hashed the file
+					ObjParser modelParser;
+
+					const std::chrono::steady_clock::time_point parseStart = std::chrono::steady_clock::now();
+					if (!modelParser.read(fileName))
+					{
+						GDumpErrorMessage(readNode, *node, "Failed reading model!");
+						delete modelMtrl;
+						return false;
+					}
+					const double parseSeconds = std::chrono::duration< double >(std::chrono::steady_clock::now() - parseStart).count();
+
+					mesh = modelParser.createMesh(hierarchyMode);
+					cache.save(*mesh);
+
+					const BVHBuildStats& stats = mesh->getHierarchy().getBuildStats();
+					std::cout << "Mesh " << meshName << ": " << mesh->getTrianglesCount() << " triangles parsed in " << parseSeconds << " s, "
+										<< GHierarchyModeName(stats.Mode) << " hierarchy built in " << stats.Seconds << " s by " << stats.ThreadsCount << " threads, SAH cost " << stats.SAHCost
+										<< ", " << stats.ReferencesCount << " triangle references" << std::endl;
+				}
+				ModelScene->addMesh(meshName, mesh);
 			}
 
-			ObjModel = new Model(modelLoader.getTriangles(), modelLoader.getBoundingBox(), modelMtrl);
+			const Transform transform = Transform::Translation(translate) * rotation * Transform::Scaling(scale);
+			ObjModel = new Model(mesh, transform, modelMtrl);
 
 			return ok;
 		}
 
 		Model* ObjModel;
+		Scene* ModelScene;
 	};
 
 	struct CSGValueReader : public IXmlSerializable
 	{
-		CSGValueReader()
-			: Value(NULL)
+		CSGValueReader(Scene* scene)
+			: Value(NULL),
+				ValueScene(scene)
 		{
 
 		}
@@ -1343,7 +1241,7 @@ namespace
 			}
 			else if (type == "model")
 			{
-				ModelLoader reader;
+				ModelLoader reader(ValueScene);
 				if (!reader.read(&element))
 				{
 					GDumpErrorMessage(readNode, *node, "Failed reading CSG model value!");
@@ -1359,12 +1257,15 @@ namespace
 
 
 		CSGNode* Value;
+		// Scene stores meshes of model values
+		Scene*	 ValueScene;
 	};
 
 	struct CSGOperandReader : public IXmlSerializable
 	{
-		CSGOperandReader()
-			: Operand(NULL)
+		CSGOperandReader(Scene* scene)
+			: Operand(NULL),
+				OperandScene(scene)
 		{
 
 		}
@@ -1372,18 +1273,21 @@ namespace
 		virtual bool read(const QDomNode* node);
 
 		CSGNode* Operand;
+		Scene*	 OperandScene;
 	};
 
 	struct CSGOperationReader : public IXmlSerializable
 	{
-		CSGOperationReader()
-			: Operation(NULL)
+		CSGOperationReader(Scene* scene)
+			: Operation(NULL),
+				OperationScene(scene)
 		{
 		}
 
 		virtual bool read(const QDomNode* node);
 
 		CSGOperation* Operation;
+		Scene*				OperationScene;
 	};
 
 	// Operation and operand readers are dependent
@@ -1396,14 +1300,14 @@ namespace
 		// Read operation or value
 		if (element.tagName() == "value")
 		{
-			CSGValueReader reader;
+			CSGValueReader reader(OperandScene);
 			if (!reader.read(&readNode))
 				return false;
 			Operand = reader.Value;
 		}
 		else if (element.tagName() == "operation")
 		{
-			CSGOperationReader reader;
+			CSGOperationReader reader(OperandScene);
 			if (!reader.read(&readNode))
 				return false;
 			Operand = reader.Operation;
@@ -1430,7 +1334,7 @@ namespace
 		CSGNode *lHand  = NULL;
 		CSGNode *rHand = NULL;
 
-		CSGOperandReader reader;
+		CSGOperandReader reader(OperationScene);
 
 		if (!reader.read(&readNode))
 		{
@@ -1483,8 +1387,9 @@ namespace
 
 	struct CSGTreeReader : public IXmlSerializable
 	{
-		CSGTreeReader()
-			: Tree(NULL)
+		CSGTreeReader(Scene* scene)
+			: Tree(NULL),
+				TreeScene(scene)
 		{
 
 		}
@@ -1503,7 +1408,7 @@ namespace
 
 			if (element.tagName() == "operation")
 			{
-				CSGOperationReader reader;
+				CSGOperationReader reader(TreeScene);
 
 				if (!reader.read(&readNode))
 				{
@@ -1514,7 +1419,7 @@ namespace
 			}
 			else if (element.tagName() == "value") // Tree contains only one object
 			{
-				CSGValueReader reader;
+				CSGValueReader reader(TreeScene);
 				if (!reader.read(&readNode))
 				{
 					GDumpErrorMessage(readNode, *node, "Failed reading CSG tree!");
@@ -1533,6 +1438,7 @@ namespace
 		}
 
 		CSGTree* Tree;
+		Scene*	 TreeScene;
 	};
 }
 
@@ -1575,12 +1481,29 @@ QSharedPointer< Scene > SceneSerializable::readScene(const QString& fileName)
 		return mScene;
 	}
 
+	// All the objects are read, so hierarchy can be built
+	mScene->buildHierarchy();
+
+	const BVHBuildStats& stats = mScene->getHierarchy().getBuildStats();
+	std::cout << "Scene hierarchy: " << mScene->getObjects().size() << " objects, " << GHierarchyModeName(stats.Mode)
+						<< " hierarchy built in " << stats.Seconds << " s, SAH cost " << stats.SAHCost << std::endl;
+
 	return mScene;
 }
 
 bool SceneSerializable::read(const QDomNode* node)
 {
 	mScene = QSharedPointer< Scene >(new Scene);
+
+	// Optional builder of object hierarchy and meshes hierarchies
+	// <scene hierarchy="linear">
+	BVHBuildMode hierarchyMode = BVH_BUILD_SAH;
+	if (!GReadHierarchyMode(*node, &hierarchyMode))
+	{
+		return false;
+	}
+	mScene->setHierarchyBuildMode(hierarchyMode);
+
 	// We must be in <scene> node, so start reading from first child
 	QDomNode currentNode = node->firstChild();
 
@@ -1675,7 +1598,7 @@ bool SceneSerializable::read(const QDomNode* node)
 			}
 			else if (type == "model")
 			{
-				ModelLoader reader;
+				ModelLoader reader(mScene.data());
 				if (!reader.read(&element))
 					return false;
 				mScene->addObject(reader.ObjModel);
@@ -1683,10 +1606,25 @@ bool SceneSerializable::read(const QDomNode* node)
 		}
 		else if (tag == "csg")
 		{
-			CSGTreeReader reader;
+			CSGTreeReader reader(mScene.data());
 			if (!reader.read(&element))
 				return false;
-			mScene->addObject(reader.Tree);
+			CSGOptimizeStats stats;
+			if (reader.Tree->optimize(&stats))
+			{
+				std::cout << "CSG tree: " << stats.NodesBefore << " -> " << stats.NodesAfter << " nodes, estimated cost "
+									<< stats.CostBefore << " -> " << stats.CostAfter << std::endl;
+
+				// Trees, which are too deep for the program stack, are evaluated by their nodes
+				reader.Tree->compile();
+				mScene->addObject(reader.Tree);
+			}
+			else
+			{
+				// Bounds of operands prove, that the tree contains nothing
+				std::cout << "CSG tree: " << stats.NodesBefore << " nodes, empty solid is skipped" << std::endl;
+				delete reader.Tree;
+			}
 		}
 		else if (tag == "background")
 		{
@@ -15,7 +15,8 @@
 #include "tracerwrapper.h"
 
 TracerWrapper::TracerWrapper()
-	: mTracerDepth(0)
+	: mTracerDepth(0),
+		mThreadsCount(0)
 {
 }
 
@@ -40,6 +41,7 @@ void TracerWrapper::renderScene(int resolutionX, int resolutionY, int width, int
 	props->MaxRayRecursionDepth = mTracerDepth;
 
 	Tracer rayTracer;
+	rayTracer.setThreadsCount(mThreadsCount);
 
 	mTracerOutput = QImage(resolutionX, resolutionY, QImage::Format_ARGB32);
 
@@ -56,4 +58,9 @@ void TracerWrapper::saveSceneImage(const QString& fileName)
 void TracerWrapper::setRecursionDepth(int depth)
 {
 	mTracerDepth = depth;
-}
\ No newline at end of file
+}
+
+void TracerWrapper::setThreadsCount(unsigned count)
+{
+	mThreadsCount = count;
+}
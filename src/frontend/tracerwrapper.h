@@ -18,11 +18,14 @@ public:
   void renderImage(QPainter* painter);
   void saveSceneImage(const QString& fileName);
   void setRecursionDepth(int depth);
+  //! Set number of rendering threads, zero means the number of hardware threads
+  void setThreadsCount(unsigned count);
 
 private:
 	QImage mTracerOutput,	mRenderImage;
 	QSharedPointer< Scene > mScene;
 	int	mTracerDepth;
+	unsigned mThreadsCount;
 };
 
 #endif 
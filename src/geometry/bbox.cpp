@@ -17,55 +17,102 @@
 
 #define Infinity FLT_MAX
 
-bool BBox::intersect(const Ray& ray) const
+namespace
 {
-	const Vec3D& origin    = ray.getOrg();
-	const Vec3D& direction = ray.getDir();
-
-	float d0 = -Infinity, d1 = Infinity;
-
-  if(fabs(direction.x()) > FLOAT_ZERO)
-  {
-    d0 = (Min.x() - origin.x()) / direction.x();
-    d1 = (Max.x() - origin.x()) / direction.x();
-    if(d1 < d0)
-		{
-        std::swap(d0, d1);
-    }
-	}
- 
-    if(fabs(direction.y()) > FLOAT_ZERO)
-    {
-        float t0, t1;
-        t0 = (Min.y() - origin.y()) / direction.y();
-        t1 = (Max.y() - origin.y()) / direction.y();
-        if(t1 < t0)
-				{
-            std::swap(t0, t1);
-				}
-        d0 = std::max(d0,t0);
-        d1 = std::min(d1,t1);
-    }
- 
-    if(fabs(direction.z()) > FLOAT_ZERO)
-    {
-        float t0, t1;
-        t0 = (Min.z() - origin.z()) / direction.z();
-        t1 = (Max.z() - origin.z()) / direction.z();
-        if(t1 < t0)
-				{
-            std::swap(t0, t1);
-				}
-        d0 = std::max(d0,t0);
-        d1 = std::min(d1,t1);
-    }
- 
-  if(d1 < d0 || d0 == -Infinity)
+	// Shrink [tNear, tFar] interval with the slab along one axis, sign of the direction tells which plane is entered first.
+	// Zero direction gives infinite distances, or NaN if the origin lies in the slab plane,
+	// comparisons are ordered so NaN keeps the current interval
+	inline void GClipSlab(float slabMin, float slabMax, float origin, float invDir, unsigned sign, float* tNear, float* tFar)
 	{
-      return false;
+		const float t0 = ((sign ? slabMax : slabMin) - origin) * invDir;
+		const float t1 = ((sign ? slabMin : slabMax) - origin) * invDir;
+
+		*tNear = t0 > *tNear ? t0 : *tNear;
+		*tFar	 = t1 < *tFar ? t1 : *tFar;
 	}
-  else
+}
+
+BBox BBox::Empty()
+{
+	BBox box;
+	box.Min = Vec3D(Infinity, Infinity, Infinity);
+	box.Max = Vec3D(-Infinity, -Infinity, -Infinity);
+	return box;
+}
+
+BBox BBox::Infinite()
+{
+	BBox box;
+	box.Min = Vec3D(-Infinity, -Infinity, -Infinity);
+	box.Max = Vec3D(Infinity, Infinity, Infinity);
+	return box;
+}
+
+bool BBox::intersect(const Ray& ray) const
+{
+	float tNear, tFar;
+	return intersect(ray, &tNear, &tFar);
+}
+
+bool BBox::intersect(const Ray& ray, float* tNear, float* tFar) const
+{
+	const Vec3D& origin = ray.getOrg();
+	const Vec3D& invDir = ray.getInvDir();
+
+	float d0 = ray.getTMin(), d1 = ray.getTMax();
+
+	GClipSlab(Min.x(), Max.x(), origin.x(), invDir.x(), ray.getSign(0), &d0, &d1);
+	GClipSlab(Min.y(), Max.y(), origin.y(), invDir.y(), ray.getSign(1), &d0, &d1);
+	GClipSlab(Min.z(), Max.z(), origin.z(), invDir.z(), ray.getSign(2), &d0, &d1);
+
+	*tNear = d0;
+	*tFar  = d1;
+	return d0 <= d1;
+}
+
+void BBox::extend(const Vec3D& pnt)
+{
+	Min.setXYZ(std::min(Min.x(), pnt.x()), std::min(Min.y(), pnt.y()), std::min(Min.z(), pnt.z()));
+	Max.setXYZ(std::max(Max.x(), pnt.x()), std::max(Max.y(), pnt.y()), std::max(Max.z(), pnt.z()));
+}
+
+void BBox::extend(const BBox& box)
+{
+	// Extending by corner points would make empty box infinite, so bounds are extended separately
+	Min.setXYZ(std::min(Min.x(), box.Min.x()), std::min(Min.y(), box.Min.y()), std::min(Min.z(), box.Min.z()));
+	Max.setXYZ(std::max(Max.x(), box.Max.x()), std::max(Max.y(), box.Max.y()), std::max(Max.z(), box.Max.z()));
+}
+
+BBox BBox::overlap(const BBox& box) const
+{
+	BBox res;
+	res.Min.setXYZ(std::max(Min.x(), box.Min.x()), std::max(Min.y(), box.Min.y()), std::max(Min.z(), box.Min.z()));
+	res.Max.setXYZ(std::min(Max.x(), box.Max.x()), std::min(Max.y(), box.Max.y()), std::min(Max.z(), box.Max.z()));
+	return res;
+}
+
+Vec3D BBox::getCentroid() const
+{
+	return (Min + Max) * 0.5f;
+}
+
+float BBox::getSurfaceArea() const
+{
+	if (isEmpty())
 	{
-      return true;
+		return 0.f;
 	}
-}
\ No newline at end of file
+	const Vec3D extent = Max - Min;
+	return 2.f * (extent.x() * extent.y() + extent.y() * extent.z() + extent.z() * extent.x());
+}
+
+bool BBox::isEmpty() const
+{
+	return Min.x() > Max.x() || Min.y() > Max.y() || Min.z() > Max.z();
+}
+
+bool BBox::isFinite() const
+{
+	return Min.x() > -Infinity && Min.y() > -Infinity && Min.z() > -Infinity &&
+				 Max.x() <  Infinity && Max.y() <  Infinity && Max.z() <  Infinity;
+}
@@ -7,8 +7,38 @@ class Ray;
 
 struct BBox
 {
+	//! Get box, which contains nothing, so it can be extended with points or other boxes
+	static BBox Empty();
+
+	//! Get box, which contains the whole space, used for unbounded objects like planes
+	static BBox Infinite();
+
 	bool intersect(const Ray& ray) const;
+
+	//! Find distances along the ray, where it enters and exits the box, they are clipped with the ray interval.
+	//! Test is branchless, it uses cached inverse direction of the ray
+	bool intersect(const Ray& ray, float* tNear, float* tFar) const;
+
+	//! Extend box to contain given pnt
+	void extend(const Vec3D& pnt);
+
+	//! Extend box to contain given box
+	void extend(const BBox& box);
+
+	//! Get intersection of two boxes, result may be empty
+	BBox overlap(const BBox& box) const;
+
+	Vec3D getCentroid() const;
+
+	float getSurfaceArea() const;
+
+	//! Check whether box contains anything
+	bool isEmpty() const;
+
+	//! Check whether box is bounded along all the axes
+	bool isFinite() const;
+
 	Vec3D Max, Min;
 };
 
-#endif
\ No newline at end of file
+#endif
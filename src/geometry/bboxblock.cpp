@@ -0,0 +1,464 @@
+//-------------------------------------------------------------------
+// File: bboxblock.cpp
+// 
+// SIMD tests of several bounding boxes against one ray
+//			 Kernels are chosen at startup by CPU features and repeat BBox::intersect operations,
+//			 including the order of NaN-safe min/max, so results don't depend on the chosen one.
+//			 Quantized boxes are dequantized by the same float operations in all the kernels
+//
+//  
+//-------------------------------------------------------------------
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "cpufeatures.h"
+
+#include "bboxblock.h"
+
+namespace
+{
+	// Planes of the boxes, which are entered and exited first along each axis, they're chosen by signs of the ray direction
+	template <class Plane>
+	struct SlabPlanes
+	{
+		const Plane* Near[3];
+		const Plane* Far[3];
+	};
+
+	template <class Plane, unsigned Size>
+	SlabPlanes< Plane > GGetPlanes(const Plane (&minBounds)[3][Size], const Plane (&maxBounds)[3][Size], const Ray& ray)
+	{
+		SlabPlanes< Plane > planes;
+		for (unsigned axis = 0; axis < 3; ++axis)
+		{
+			const bool negative = ray.getSign(axis) != 0;
+			planes.Near[axis] = negative ? maxBounds[axis] : minBounds[axis];
+			planes.Far[axis]	= negative ? minBounds[axis] : maxBounds[axis];
+		}
+		return planes;
+	}
+
+	template <unsigned Size>
+	void GSetEmpty(float (&minBounds)[3][Size], float (&maxBounds)[3][Size])
+	{
+		for (unsigned axis = 0; axis < 3; ++axis)
+		{
+			for (unsigned lane = 0; lane < Size; ++lane)
+			{
+				minBounds[axis][lane] = FLT_MAX;
+				maxBounds[axis][lane] = -FLT_MAX;
+			}
+		}
+	}
+
+	template <unsigned Size>
+	void GSetBox(float (&minBounds)[3][Size], float (&maxBounds)[3][Size], unsigned lane, const BBox& box)
+	{
+		minBounds[0][lane] = box.Min.x();
+		minBounds[1][lane] = box.Min.y();
+		minBounds[2][lane] = box.Min.z();
+		maxBounds[0][lane] = box.Max.x();
+		maxBounds[1][lane] = box.Max.y();
+		maxBounds[2][lane] = box.Max.z();
+	}
+
+	const unsigned cQuantizedMax = 255;
+
+	inline float GDequantize(float origin, float scale, unsigned plane)
+	{
+		return origin + static_cast< float >(plane) * scale;
+	}
+
+	typedef unsigned (*BBoxKernel)(const SlabPlanes< float >& planes, const Ray& ray, float maxDistance, unsigned count, float* tNear);
+
+	unsigned GIntersectScalar(const SlabPlanes< float >& planes, const Ray& ray, float maxDistance, unsigned count, float* tNear)
+	{
+		const Vec3D& origin = ray.getOrg();
+		const Vec3D& invDir = ray.getInvDir();
+
+		const float org[3] = { origin.x(), origin.y(), origin.z() };
+		const float inv[3] = { invDir.x(), invDir.y(), invDir.z() };
+
+		unsigned mask = 0;
+		for (unsigned lane = 0; lane < count; ++lane)
+		{
+			float d0 = ray.getTMin(), d1 = maxDistance;
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				const float t0 = (planes.Near[axis][lane] - org[axis]) * inv[axis];
+				const float t1 = (planes.Far[axis][lane] - org[axis]) * inv[axis];
+
+				d0 = t0 > d0 ? t0 : d0;
+				d1 = t1 < d1 ? t1 : d1;
+			}
+
+			tNear[lane] = d0;
+			if (d0 <= d1)
+			{
+				mask |= 1 << lane;
+			}
+		}
+		return mask;
+	}
+
+	typedef unsigned (*QuantizedKernel)(const QuantizedBBox8& boxes, const SlabPlanes< unsigned char >& planes, const Ray& ray, float maxDistance, float* tNear);
+
+	unsigned GIntersectQuantizedScalar(const QuantizedBBox8& boxes, const SlabPlanes< unsigned char >& planes, const Ray& ray, float maxDistance, float* tNear)
+	{
+		const Vec3D& origin = ray.getOrg();
+		const Vec3D& invDir = ray.getInvDir();
+
+		const float org[3] = { origin.x(), origin.y(), origin.z() };
+		const float inv[3] = { invDir.x(), invDir.y(), invDir.z() };
+
+		unsigned mask = 0;
+		for (unsigned lane = 0; lane < 8; ++lane)
+		{
+			float d0 = ray.getTMin(), d1 = maxDistance;
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				const float t0 = (GDequantize(boxes.Origin[axis], boxes.Scale[axis], planes.Near[axis][lane]) - org[axis]) * inv[axis];
+				const float t1 = (GDequantize(boxes.Origin[axis], boxes.Scale[axis], planes.Far[axis][lane]) - org[axis]) * inv[axis];
+
+				d0 = t0 > d0 ? t0 : d0;
+				d1 = t1 < d1 ? t1 : d1;
+			}
+
+			tNear[lane] = d0;
+			if (d0 <= d1)
+			{
+				mask |= 1 << lane;
+			}
+		}
+		return mask;
+	}
+
+#ifdef CPU_X86
+	TARGET_SSE2 unsigned GIntersectSSE(const SlabPlanes< float >& planes, const Ray& ray, float maxDistance, unsigned count, float* tNear)
+	{
+		const Vec3D& origin = ray.getOrg();
+		const Vec3D& invDir = ray.getInvDir();
+
+		const __m128 org[3] = { _mm_set1_ps(origin.x()), _mm_set1_ps(origin.y()), _mm_set1_ps(origin.z()) };
+		const __m128 inv[3] = { _mm_set1_ps(invDir.x()), _mm_set1_ps(invDir.y()), _mm_set1_ps(invDir.z()) };
+
+		unsigned mask = 0;
+		for (unsigned base = 0; base < count; base += 4)
+		{
+			__m128 d0 = _mm_set1_ps(ray.getTMin());
+			__m128 d1 = _mm_set1_ps(maxDistance);
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(planes.Near[axis] + base), org[axis]), inv[axis]);
+				const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(planes.Far[axis] + base), org[axis]), inv[axis]);
+
+				// Second operand is returned, if any of them is NaN
+				d0 = _mm_max_ps(t0, d0);
+				d1 = _mm_min_ps(t1, d1);
+			}
+
+			_mm_storeu_ps(tNear + base, d0);
+			mask |= _mm_movemask_ps(_mm_cmple_ps(d0, d1)) << base;
+		}
+		return mask;
+	}
+
+	TARGET_AVX unsigned GIntersectAVX(const SlabPlanes< float >& planes, const Ray& ray, float maxDistance, unsigned count, float* tNear)
+	{
+		const Vec3D& origin = ray.getOrg();
+		const Vec3D& invDir = ray.getInvDir();
+
+		const __m256 org[3] = { _mm256_set1_ps(origin.x()), _mm256_set1_ps(origin.y()), _mm256_set1_ps(origin.z()) };
+		const __m256 inv[3] = { _mm256_set1_ps(invDir.x()), _mm256_set1_ps(invDir.y()), _mm256_set1_ps(invDir.z()) };
+
+		unsigned mask = 0;
+		for (unsigned base = 0; base < count; base += 8)
+		{
+			__m256 d0 = _mm256_set1_ps(ray.getTMin());
+			__m256 d1 = _mm256_set1_ps(maxDistance);
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				const __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(planes.Near[axis] + base), org[axis]), inv[axis]);
+				const __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(planes.Far[axis] + base), org[axis]), inv[axis]);
+
+				// Second operand is returned, if any of them is NaN
+				d0 = _mm256_max_ps(t0, d0);
+				d1 = _mm256_min_ps(t1, d1);
+			}
+
+			_mm256_storeu_ps(tNear + base, d0);
+			mask |= _mm256_movemask_ps(_mm256_cmp_ps(d0, d1, _CMP_LE_OQ)) << base;
+		}
+		return mask;
+	}
+
+	// Convert four 8-bit planes to floats and dequantize them
+	TARGET_SSE2 __m128 GDequantizeSSE(const unsigned char* planes, __m128 origin, __m128 scale)
+	{
+		int bytes;
+		memcpy(&bytes, planes, sizeof(bytes));
+
+		const __m128i zero	= _mm_setzero_si128();
+		const __m128i words = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero);
+		return _mm_add_ps(origin, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero)), scale));
+	}
+
+	TARGET_SSE2 unsigned GIntersectQuantizedSSE(const QuantizedBBox8& boxes, const SlabPlanes< unsigned char >& planes, const Ray& ray, float maxDistance, float* tNear)
+	{
+		const Vec3D& origin = ray.getOrg();
+		const Vec3D& invDir = ray.getInvDir();
+
+		const __m128 org[3] = { _mm_set1_ps(origin.x()), _mm_set1_ps(origin.y()), _mm_set1_ps(origin.z()) };
+		const __m128 inv[3] = { _mm_set1_ps(invDir.x()), _mm_set1_ps(invDir.y()), _mm_set1_ps(invDir.z()) };
+
+		const __m128 gridOrigin[3] = { _mm_set1_ps(boxes.Origin[0]), _mm_set1_ps(boxes.Origin[1]), _mm_set1_ps(boxes.Origin[2]) };
+		const __m128 gridScale[3]	= { _mm_set1_ps(boxes.Scale[0]), _mm_set1_ps(boxes.Scale[1]), _mm_set1_ps(boxes.Scale[2]) };
+
+		unsigned mask = 0;
+		for (unsigned base = 0; base < 8; base += 4)
+		{
+			__m128 d0 = _mm_set1_ps(ray.getTMin());
+			__m128 d1 = _mm_set1_ps(maxDistance);
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				const __m128 nearPlane = GDequantizeSSE(planes.Near[axis] + base, gridOrigin[axis], gridScale[axis]);
+				const __m128 farPlane	= GDequantizeSSE(planes.Far[axis] + base, gridOrigin[axis], gridScale[axis]);
+
+				const __m128 t0 = _mm_mul_ps(_mm_sub_ps(nearPlane, org[axis]), inv[axis]);
+				const __m128 t1 = _mm_mul_ps(_mm_sub_ps(farPlane, org[axis]), inv[axis]);
+
+				// Second operand is returned, if any of them is NaN
+				d0 = _mm_max_ps(t0, d0);
+				d1 = _mm_min_ps(t1, d1);
+			}
+
+			_mm_storeu_ps(tNear + base, d0);
+			mask |= _mm_movemask_ps(_mm_cmple_ps(d0, d1)) << base;
+		}
+		return mask;
+	}
+
+	// Convert eight 8-bit planes to floats and dequantize them, integer part uses SSE2 as AVX has no 256-bit integer operations
+	TARGET_AVX __m256 GDequantizeAVX(const unsigned char* planes, __m256 origin, __m256 scale)
+	{
+		const __m128i zero	= _mm_setzero_si128();
+		const __m128i words = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast< const __m128i* >(planes)), zero);
+		const __m256i ints	= _mm256_insertf128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(words, zero)), _mm_unpackhi_epi16(words, zero), 1);
+		return _mm256_add_ps(origin, _mm256_mul_ps(_mm256_cvtepi32_ps(ints), scale));
+	}
+
+	TARGET_AVX unsigned GIntersectQuantizedAVX(const QuantizedBBox8& boxes, const SlabPlanes< unsigned char >& planes, const Ray& ray, float maxDistance, float* tNear)
+	{
+		const Vec3D& origin = ray.getOrg();
+		const Vec3D& invDir = ray.getInvDir();
+
+		const __m256 org[3] = { _mm256_set1_ps(origin.x()), _mm256_set1_ps(origin.y()), _mm256_set1_ps(origin.z()) };
+		const __m256 inv[3] = { _mm256_set1_ps(invDir.x()), _mm256_set1_ps(invDir.y()), _mm256_set1_ps(invDir.z()) };
+
+		__m256 d0 = _mm256_set1_ps(ray.getTMin());
+		__m256 d1 = _mm256_set1_ps(maxDistance);
+		for (unsigned axis = 0; axis < 3; ++axis)
+		{
+			const __m256 gridOrigin = _mm256_set1_ps(boxes.Origin[axis]);
+			const __m256 gridScale	= _mm256_set1_ps(boxes.Scale[axis]);
+
+			const __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(GDequantizeAVX(planes.Near[axis], gridOrigin, gridScale), org[axis]), inv[axis]);
+			const __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(GDequantizeAVX(planes.Far[axis], gridOrigin, gridScale), org[axis]), inv[axis]);
+
+			// Second operand is returned, if any of them is NaN
+			d0 = _mm256_max_ps(t0, d0);
+			d1 = _mm256_min_ps(t1, d1);
+		}
+
+		_mm256_storeu_ps(tNear, d0);
+		return _mm256_movemask_ps(_mm256_cmp_ps(d0, d1, _CMP_LE_OQ));
+	}
+#endif
+
+	struct KernelInfo
+	{
+		BBoxKernel	Kernel;
+		const char* Name;
+	};
+
+	KernelInfo GSelectKernel(bool allowAVX)
+	{
+		KernelInfo info = { GIntersectScalar, "scalar" };
+	#ifdef CPU_X86
+		if (allowAVX && CpuHasAVX())
+		{
+			info.Kernel = GIntersectAVX;
+			info.Name		= "AVX";
+		}
+		else if (CpuHasSSE2())
+		{
+			info.Kernel = GIntersectSSE;
+			info.Name		= "SSE2";
+		}
+	#endif
+		return info;
+	}
+
+	struct QuantizedKernelInfo
+	{
+		QuantizedKernel Kernel;
+		const char*			Name;
+	};
+
+	QuantizedKernelInfo GSelectQuantizedKernel()
+	{
+		QuantizedKernelInfo info = { GIntersectQuantizedScalar, "scalar" };
+	#ifdef CPU_X86
+		if (CpuHasAVX())
+		{
+			info.Kernel = GIntersectQuantizedAVX;
+			info.Name		= "AVX";
+		}
+		else if (CpuHasSSE2())
+		{
+			info.Kernel = GIntersectQuantizedSSE;
+			info.Name		= "SSE2";
+		}
+	#endif
+		return info;
+	}
+
+	// Chosen once, before rendering threads are started, four boxes fit into one SSE register
+	static const KernelInfo					 cKernel4					= GSelectKernel(false);
+	static const KernelInfo					 cKernel8					= GSelectKernel(true);
+	static const QuantizedKernelInfo cQuantizedKernel = GSelectQuantizedKernel();
+}
+
+const char* BBox4::GetKernelName()
+{
+	return cKernel4.Name;
+}
+
+BBox4::BBox4()
+{
+	GSetEmpty(Min, Max);
+}
+
+void BBox4::set(unsigned lane, const BBox& box)
+{
+	GSetBox(Min, Max, lane, box);
+}
+
+unsigned BBox4::intersect(const Ray& ray, float maxDistance, float* tNear) const
+{
+	return cKernel4.Kernel(GGetPlanes(Min, Max, ray), ray, maxDistance, 4, tNear);
+}
+
+const char* BBox8::GetKernelName()
+{
+	return cKernel8.Name;
+}
+
+BBox8::BBox8()
+{
+	GSetEmpty(Min, Max);
+}
+
+void BBox8::set(unsigned lane, const BBox& box)
+{
+	GSetBox(Min, Max, lane, box);
+}
+
+unsigned BBox8::intersect(const Ray& ray, float maxDistance, float* tNear) const
+{
+	return cKernel8.Kernel(GGetPlanes(Min, Max, ray), ray, maxDistance, 8, tNear);
+}
+
+const char* QuantizedBBox8::GetKernelName()
+{
+	return cQuantizedKernel.Name;
+}
+
+QuantizedBBox8::QuantizedBBox8()
+{
+	// Unused lanes have min plane above max one, so they are never hit
+	for (unsigned axis = 0; axis < 3; ++axis)
+	{
+		Origin[axis] = 0.f;
+		Scale[axis]	= 0.f;
+		for (unsigned lane = 0; lane < 8; ++lane)
+		{
+			Min[axis][lane] = cQuantizedMax;
+			Max[axis][lane] = 0;
+		}
+	}
+}
+
+void QuantizedBBox8::setGrid(const BBox& parent)
+{
+	const float parentMin[3] = { parent.Min.x(), parent.Min.y(), parent.Min.z() };
+	const float parentMax[3] = { parent.Max.x(), parent.Max.y(), parent.Max.z() };
+
+	for (unsigned axis = 0; axis < 3; ++axis)
+	{
+		float scale = (parentMax[axis] - parentMin[axis]) / cQuantizedMax;
+		// Rounding mustn't shrink the grid, its last plane has to cover the parent box
+		while (GDequantize(parentMin[axis], scale, cQuantizedMax) < parentMax[axis])
+		{
+			scale = scale > 0.f ? scale * (1.f + FLT_EPSILON) : FLT_MIN;
+		}
+
+		Origin[axis] = parentMin[axis];
+		Scale[axis]	= scale;
+	}
+}
+
+void QuantizedBBox8::set(unsigned lane, const BBox& box)
+{
+	const float boxMin[3] = { box.Min.x(), box.Min.y(), box.Min.z() };
+	const float boxMax[3] = { box.Max.x(), box.Max.y(), box.Max.z() };
+
+	for (unsigned axis = 0; axis < 3; ++axis)
+	{
+		const float origin = Origin[axis];
+		const float scale	= Scale[axis];
+
+		unsigned low	= 0;
+		unsigned high = 0;
+		if (scale > 0.f)
+		{
+			const float relativeMin = std::min(std::max((boxMin[axis] - origin) / scale, 0.f), static_cast< float >(cQuantizedMax));
+			const float relativeMax = std::min(std::max((boxMax[axis] - origin) / scale, 0.f), static_cast< float >(cQuantizedMax));
+			low	= static_cast< unsigned >(floor(relativeMin));
+			high = static_cast< unsigned >(ceil(relativeMax));
+		}
+
+		// Division is rounded, so planes are moved outwards until dequantized box contains the original one
+		while (low > 0 && GDequantize(origin, scale, low) > boxMin[axis])
+		{
+			--low;
+		}
+		while (high < cQuantizedMax && GDequantize(origin, scale, high) < boxMax[axis])
+		{
+			++high;
+		}
+
+		Min[axis][lane] = static_cast< unsigned char >(low);
+		Max[axis][lane] = static_cast< unsigned char >(high);
+	}
+}
+
+BBox QuantizedBBox8::get(unsigned lane) const
+{
+	BBox box;
+	box.Min = Vec3D(GDequantize(Origin[0], Scale[0], Min[0][lane]),
+									GDequantize(Origin[1], Scale[1], Min[1][lane]),
+									GDequantize(Origin[2], Scale[2], Min[2][lane]));
+	box.Max = Vec3D(GDequantize(Origin[0], Scale[0], Max[0][lane]),
+									GDequantize(Origin[1], Scale[1], Max[1][lane]),
+									GDequantize(Origin[2], Scale[2], Max[2][lane]));
+	return box;
+}
+
+unsigned QuantizedBBox8::intersect(const Ray& ray, float maxDistance, float* tNear) const
+{
+	return cQuantizedKernel.Kernel(*this, GGetPlanes(Min, Max, ray), ray, maxDistance, tNear);
+}
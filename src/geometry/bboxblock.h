@@ -0,0 +1,73 @@
+#ifndef GEOMETRY_BBOXBLOCK_H
+#define GEOMETRY_BBOXBLOCK_H
+
+#include "geometry/bbox.h"
+#include "geometry/ray.h"
+
+// Bounding boxes of several hierarchy nodes, stored as structure of arrays, so one ray is tested against all of them
+// with SIMD instructions. Test is the same as BBox::intersect, unused lanes are empty boxes, which are never hit
+struct BBox4
+{
+	//! Get name of the kernel, chosen for this CPU
+	static const char* GetKernelName();
+
+	explicit BBox4();
+
+	//! Put box into given lane
+	void set(unsigned lane, const BBox& box);
+
+	//! Intersect all the boxes with the ray, which interval is limited by maxDistance.
+	//! Returns mask of hit lanes, entry distances are stored for them, so nodes can be ordered
+	unsigned intersect(const Ray& ray, float maxDistance, float* tNear) const;
+
+	float Min[3][4];
+	float Max[3][4];
+};
+
+// Same as BBox4 for eight boxes, AVX instructions are used if CPU supports them
+struct BBox8
+{
+	//! Get name of the kernel, chosen for this CPU
+	static const char* GetKernelName();
+
+	explicit BBox8();
+
+	//! Put box into given lane
+	void set(unsigned lane, const BBox& box);
+
+	//! Intersect all the boxes with the ray, which interval is limited by maxDistance.
+	//! Returns mask of hit lanes, entry distances are stored for them, so nodes can be ordered
+	unsigned intersect(const Ray& ray, float maxDistance, float* tNear) const;
+
+	float Min[3][8];
+	float Max[3][8];
+};
+
+// Eight boxes, quantized to 8 bits in the grid of their parent box, so they take less than a third of BBox8 memory.
+// Quantized boxes are never smaller than the original ones, so every ray, which hits a box, hits its quantized one too
+struct QuantizedBBox8
+{
+	//! Get name of the kernel, chosen for this CPU
+	static const char* GetKernelName();
+
+	explicit QuantizedBBox8();
+
+	//! Set grid, which covers the parent box, it must be set before lanes
+	void setGrid(const BBox& parent);
+
+	//! Put box into given lane, box must be inside of the parent one
+	void set(unsigned lane, const BBox& box);
+
+	//! Get box of the lane, as it's tested
+	BBox get(unsigned lane) const;
+
+	//! Same as BBox8::intersect for dequantized boxes
+	unsigned intersect(const Ray& ray, float maxDistance, float* tNear) const;
+
+	float					Origin[3];
+	float					Scale[3];
+	unsigned char Min[3][8];
+	unsigned char Max[3][8];
+};
+
+#endif
@@ -22,12 +22,12 @@
 #define Infinity FLT_MAX
 
 Box::Box(const Vec3D& min, const Vec3D& max, Mtrl* material)
-  : mMin(min),
-    mMax(max),
-		mIsLight(false),
+  : mIsLight(false),
 		mMtrl(material)
 {
-	mDiagonalLength = length(mMax - mMin);
+	mGeometry.Min		= min;
+	mGeometry.Max		= max;
+	mDiagonalLength = length(max - min);
 }
 
 Box::~Box()
@@ -35,7 +35,14 @@ Box::~Box()
   delete mMtrl;
 }
 
-CIsect Box::intersect(const Ray& ray)
+void Box::setBounds(const Vec3D& min, const Vec3D& max)
+{
+	mGeometry.Min		= min;
+	mGeometry.Max		= max;
+	mDiagonalLength = length(max - min);
+}
+
+bool BoxGeometry::intersect(const Ray& ray, CIsect* isect, HitBuffer* hits) const
 {
   const Vec3D& origin    = ray.getOrg();
 	const Vec3D& direction = ray.getDir();
@@ -48,24 +55,27 @@ CIsect Box::intersect(const Ray& ray)
 		a= 5;
 	}
 
-	float invDir = 0.f;
+	const Vec3D& invDir = ray.getInvDir();
 	if (fabs(direction.x()) > FLOAT_ZERO)
 	{
-		invDir = 1.f / direction.x();
-		tmin = (mMin.x() - origin.x()) * invDir;
-		tmax = (mMax.x() - origin.x()) * invDir;
+		tmin = (Min.x() - origin.x()) * invDir.x();
+		tmax = (Max.x() - origin.x()) * invDir.x();
 
 		if (tmin > tmax)
 		{
 			std::swap(tmin, tmax);
 		}
 	}
+	else if (origin.x() < Min.x() || origin.x() > Max.x())
+	{
+		// Ray is parallel to the slab and passes outside of it
+		return false;
+	}
 
 	if (fabs(direction.y()) > FLOAT_ZERO)
 	{
-		invDir = 1.f / direction.y();
-		float tymin = (mMin.y() - origin.y()) * invDir;
-		float tymax = (mMax.y() - origin.y()) * invDir;
+		float tymin = (Min.y() - origin.y()) * invDir.y();
+		float tymax = (Max.y() - origin.y()) * invDir.y();
 
 		if (tymin > tymax)
 		{
@@ -83,20 +93,23 @@ CIsect Box::intersect(const Ray& ray)
 
 		if (tmin > tmax)
 		{
-			return CIsect(false);
+			return false;
 		}
 
 		if (tmax < 0.f)
 		{
-			return CIsect(false);
+			return false;
 		}
 	}
+	else if (origin.y() < Min.y() || origin.y() > Max.y())
+	{
+		return false;
+	}
 
 	if (fabs(direction.z()) > FLOAT_ZERO)
 	{
-		invDir = 1.f / direction.z();
-		float tzmin = (mMin.z() - origin.z()) * invDir;
-		float tzmax = (mMax.z() - origin.z()) * invDir;
+		float tzmin = (Min.z() - origin.z()) * invDir.z();
+		float tzmax = (Max.z() - origin.z()) * invDir.z();
 
 		if (tzmin > tzmax)
 		{
@@ -114,30 +127,47 @@ CIsect Box::intersect(const Ray& ray)
 
 		if (tmin > tmax)
 		{
-			return CIsect(false);
+			return false;
 		}
 	}
+	else if (origin.z() < Min.z() || origin.z() > Max.z())
+	{
+		return false;
+	}
 
 	if (tmax < 0.f)
 	{
-		return CIsect(false);
+		return false;
 	}
 
-	if (tmin < 0.f)
+	// Only entry is reported, box isn't hit from inside
+	if (!ray.contains(tmin))
 	{
-		return CIsect(false);
+		return false;
 	}
 
 	if (tmin == Infinity)
 	{
-		return CIsect(false);
+		return false;
+	}
+
+	if (hits)
+	{
+		hits->add(tmin, true);
+		hits->add(tmax, false);
 	}
+	isect->Exists		= true;
+	isect->Distance = tmin;
+	return true;
+}
 
-	CIsect res = CIsect(true, tmin, this, getNormal(ray, tmin));
-	res.Dst.resize(2);
-	res.Dst[0] = tmin;
-	res.Dst[1] = tmax;
-	res.InsideIntervals.push_back(Span(tmin, tmax));
+CIsect Box::intersect(const Ray& ray, HitBuffer* hits)
+{
+	CIsect res(false);
+	if (mGeometry.intersect(ray, &res, hits))
+	{
+		res.Object = this;
+	}
 	return res;
 }
 
@@ -145,8 +175,8 @@ Vec3D Box::getNormal(const Ray& ray, float distance, const CIsect& isect /*= CIs
 {
 	const Vec3D atSurface = ray.apply(distance);
   
-	const Vec3D toMin = atSurface - mMin;
-	const Vec3D toMax = atSurface - mMax;
+	const Vec3D toMin = atSurface - mGeometry.Min;
+	const Vec3D toMax = atSurface - mGeometry.Max;
 
 	if (fabs(toMin.x()) < EPSILON)
 	{
@@ -200,4 +230,12 @@ Vec3D Box::getTexCoords(const Vec3D& pnt, const CIsect& isect /*= CIsect()*/) co
 {
 	// TODO:
 	return Vec3D();
-}
\ No newline at end of file
+}
+
+BBox Box::getBBox() const
+{
+	BBox box;
+	box.Min = mGeometry.Min;
+	box.Max = mGeometry.Max;
+	return box;
+}
@@ -6,12 +6,21 @@
 #include "geometry/ray.h"
 #include "geometry/vector3d.h"
 
+// Data of the box, which is enough to intersect it, compiled scene keeps it in contiguous arrays
+struct BoxGeometry
+{
+	//! Find entry hit inside of the ray interval, entry and exit distances are added to the buffer, if it's given
+	bool intersect(const Ray& ray, CIsect* isect, HitBuffer* hits = NULL) const;
+
+	Vec3D Min, Max;
+};
+
 class Box : public IShape
 {
 public:
   explicit Box(const Vec3D& min, const Vec3D& max, Mtrl* material);
   virtual ~Box();
-  virtual CIsect intersect(const Ray& ray);
+  virtual CIsect intersect(const Ray& ray, HitBuffer* hits = NULL);
   virtual const Mtrl* getMtrl() const
   {
     return mMtrl;
@@ -29,8 +38,15 @@ public:
 	virtual Color getDifColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
 	virtual Color getSpcColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
 	virtual Vec3D getTexCoords(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
+	virtual BBox getBBox() const;
+	const BoxGeometry& getGeometry() const
+	{
+		return mGeometry;
+	}
+	//! Move or resize box, scene must update its hierarchy before the next frame
+	void setBounds(const Vec3D& min, const Vec3D& max);
 private:
-  Vec3D	mMin, mMax;
+  BoxGeometry mGeometry;
   float	mDiagonalLength;
   Mtrl* mMtrl;
   bool mIsLight;
@@ -0,0 +1,666 @@
+//-------------------------------------------------------------------
+// File: bvh.cpp
+//
+// Bounding volume hierarchy, built with binned surface area heuristic
+//			 Split positions are searched between bins of primitive centroids,
+//			 see "On fast Construction of SAH-based Bounding Volume Hierarchies" by Wald.
+//			 Upper levels are binned by all the threads at once, then subtrees are built in parallel.
+//			 Refit keeps the topology and recomputes bounds from leaves to root
+//
+//
+//-------------------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+
+#include "bvhbuild.h"
+#include "linearbvh.h"
+#include "parallel.h"
+#include "spatialbvh.h"
+
+#include "bvh.h"
+
+namespace
+{
+	static const float		cTraversalCost	 = BVH_TRAVERSAL_COST;
+	static const float		cIntersectionCost = BVH_INTERSECTION_COST;
+	// Deeper nodes are split by median to keep traversal stack bounded
+	static const unsigned cMaxSAHDepth			 = BVH_STACK_SIZE / 2;
+	static const unsigned cMaxLeafCount			 = 0xffff;
+	// Small ranges get a bin per primitive, so sweeping empty bins doesn't dominate the build
+	static const unsigned cBinsCount				 = 32;
+	// Less primitives are built on the calling thread only
+	static const unsigned cMinParallelCount	 = 4096;
+	// Larger ranges of primitives are binned by all the threads at once
+	static const unsigned cMinParallelBinning = 65536;
+	// Subtrees are made small enough for every thread to get several of them
+	static const unsigned cSubtreesPerThread = 8;
+
+	// Bounds of primitives in the range and bounds of their centroids
+	struct RangeBounds
+	{
+		RangeBounds()
+			: Bounds(BBox::Empty()),
+				Centroids(BBox::Empty())
+		{
+		}
+
+		void extend(const RangeBounds& other)
+		{
+			Bounds.extend(other.Bounds);
+			Centroids.extend(other.Centroids);
+		}
+
+		BBox Bounds;
+		BBox Centroids;
+	};
+
+	// Primitives, which centroids fall into one bin along each axis, only first binsCount bins are used
+	struct Bins
+	{
+		explicit Bins(unsigned binsCount = cBinsCount)
+			: BinsCount(binsCount)
+		{
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				for (unsigned bin = 0; bin < BinsCount; ++bin)
+				{
+					Bounds[axis][bin] = BBox::Empty();
+					Counts[axis][bin] = 0;
+				}
+			}
+		}
+
+		void extend(const Bins& other)
+		{
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				for (unsigned bin = 0; bin < BinsCount; ++bin)
+				{
+					Bounds[axis][bin].extend(other.Bounds[axis][bin]);
+					Counts[axis][bin] += other.Counts[axis][bin];
+				}
+			}
+		}
+
+		unsigned BinsCount;
+		BBox		 Bounds[3][cBinsCount];
+		unsigned Counts[3][cBinsCount];
+	};
+
+	// Maps centroids to bins, partitioning uses the same mapping, so primitives go to the side they were counted for
+	struct BinMapping
+	{
+		BinMapping(const BBox& centroids, unsigned binsCount)
+			: BinsCount(binsCount)
+		{
+			const Vec3D extent = centroids.Max - centroids.Min;
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				const float axisExtent = BVHAxisValue(extent, axis);
+
+				Min[axis]		= BVHAxisValue(centroids.Min, axis);
+				Scale[axis] = axisExtent > 0.f ? BinsCount / axisExtent : 0.f;
+			}
+		}
+
+		bool isSplittable(unsigned axis) const
+		{
+			return Scale[axis] > 0.f;
+		}
+
+		unsigned getBin(const Vec3D& centroid, unsigned axis) const
+		{
+			const float position = (BVHAxisValue(centroid, axis) - Min[axis]) * Scale[axis];
+			return std::min(BinsCount - 1, static_cast< unsigned >(std::max(position, 0.f)));
+		}
+
+		unsigned BinsCount;
+		float		 Min[3];
+		float		 Scale[3];
+	};
+
+	// Range of primitives, which subtree is built later by one of the threads
+	struct SubtreeTask
+	{
+		unsigned Begin;
+		unsigned End;
+		unsigned Depth;
+		unsigned Node; // Placeholder node in the upper levels
+	};
+
+	// Builds nodes of ranges of the shared indices array, ranges of different subtrees don't overlap,
+	// so their subtrees can be built concurrently into separate node arrays
+	class BinnedBuilder
+	{
+	public:
+		BinnedBuilder(const std::vector< BBox >& bounds,
+									const std::vector< Vec3D >& centroids,
+									std::vector< unsigned >* indices,
+									unsigned maxLeafSize,
+									unsigned blockSize,
+									unsigned threadsCount)
+			: mBounds(bounds),
+				mCentroids(centroids),
+				mIndices(*indices),
+				mMaxLeafSize(maxLeafSize),
+				mBlockSize(blockSize),
+				mThreadsCount(threadsCount),
+				mSubtreeSize(std::max(cMinParallelCount, static_cast< unsigned >(indices->size()) / (threadsCount * cSubtreesPerThread)))
+		{
+		}
+
+		//! Build nodes of the range in depth-first order, returns index of the range root.
+		//! If tasks are given, subtrees not larger than subtree size are left as placeholder nodes to build later
+		unsigned build(std::vector< BVHNode >* nodes, std::vector< SubtreeTask >* tasks, unsigned begin, unsigned end, unsigned depth)
+		{
+			const unsigned nodeIdx = nodes->size();
+			nodes->push_back(BVHNode());
+
+			if (tasks && end - begin <= mSubtreeSize)
+			{
+				const SubtreeTask task = { begin, end, depth, nodeIdx };
+				tasks->push_back(task);
+				return nodeIdx;
+			}
+
+			const bool				parallel = tasks && end - begin >= cMinParallelBinning;
+			const RangeBounds range		 = computeBounds(begin, end, parallel);
+
+			(*nodes)[nodeIdx].Bounds = range.Bounds;
+
+			unsigned axis, middle;
+			if (!split(begin, end, depth, range, parallel, &axis, &middle))
+			{
+				(*nodes)[nodeIdx].Offset = begin;
+				(*nodes)[nodeIdx].Count	 = end - begin;
+				(*nodes)[nodeIdx].Axis	 = 0;
+				return nodeIdx;
+			}
+
+			// First child follows its parent, so store only second one
+			build(nodes, tasks, begin, middle, depth + 1);
+			const unsigned secondChild = build(nodes, tasks, middle, end, depth + 1);
+
+			(*nodes)[nodeIdx].Offset = secondChild;
+			(*nodes)[nodeIdx].Count	 = 0;
+			(*nodes)[nodeIdx].Axis	 = axis;
+
+			return nodeIdx;
+		}
+
+	private:
+		BinnedBuilder& operator=(const BinnedBuilder&);
+
+		template <class Function>
+		void runParts(unsigned begin, unsigned end, bool parallel, const Function& function) const
+		{
+			if (!parallel)
+			{
+				function(0, begin, end);
+				return;
+			}
+
+			ParallelRun(mThreadsCount, [&](unsigned thread)
+			{
+				function(thread, begin + ParallelPartBegin(end - begin, thread, mThreadsCount), begin + ParallelPartBegin(end - begin, thread + 1, mThreadsCount));
+			});
+		}
+
+		RangeBounds computeBounds(unsigned begin, unsigned end, bool parallel) const
+		{
+			std::vector< RangeBounds > parts(parallel ? mThreadsCount : 1);
+			runParts(begin, end, parallel, [&](unsigned thread, unsigned first, unsigned last)
+			{
+				RangeBounds& part = parts[thread];
+				for (unsigned idx = first; idx < last; ++idx)
+				{
+					part.Bounds.extend(mBounds[mIndices[idx]]);
+					part.Centroids.extend(mCentroids[mIndices[idx]]);
+				}
+			});
+
+			for (unsigned thread = 1; thread < parts.size(); ++thread)
+			{
+				parts[0].extend(parts[thread]);
+			}
+			return parts[0];
+		}
+
+		//! Find split of the range, returns false if it should become a leaf
+		bool split(unsigned begin, unsigned end, unsigned depth, const RangeBounds& range, bool parallel, unsigned* axis, unsigned* middle)
+		{
+			const unsigned count = end - begin;
+			if (count == 1)
+			{
+				return false;
+			}
+
+			const BinMapping mapping(range.Centroids, std::min(cBinsCount, count));
+
+			int			 bestAxis = -1;
+			unsigned bestBin	= 0;
+			float		 bestCost = FLT_MAX;
+
+			if (depth < cMaxSAHDepth)
+			{
+				std::vector< Bins > parts(parallel ? mThreadsCount : 1, Bins(mapping.BinsCount));
+				runParts(begin, end, parallel, [&](unsigned thread, unsigned first, unsigned last)
+				{
+					Bins& part = parts[thread];
+					for (unsigned idx = first; idx < last; ++idx)
+					{
+						const unsigned primitive = mIndices[idx];
+						for (unsigned binAxis = 0; binAxis < 3; ++binAxis)
+						{
+							const unsigned bin = mapping.getBin(mCentroids[primitive], binAxis);
+							part.Bounds[binAxis][bin].extend(mBounds[primitive]);
+							++part.Counts[binAxis][bin];
+						}
+					}
+				});
+
+				for (unsigned thread = 1; thread < parts.size(); ++thread)
+				{
+					parts[0].extend(parts[thread]);
+				}
+				const Bins& bins = parts[0];
+
+				const float nodeArea = range.Bounds.getSurfaceArea();
+				for (unsigned binAxis = 0; binAxis < 3; ++binAxis)
+				{
+					if (!mapping.isSplittable(binAxis))
+					{
+						continue;
+					}
+
+					// Areas and counts of primitives in bins [i, binsCount) for each split
+					float		 rightAreas[cBinsCount];
+					unsigned rightCounts[cBinsCount];
+
+					BBox		 rightBounds = BBox::Empty();
+					unsigned rightCount	 = 0;
+					for (unsigned bin = mapping.BinsCount - 1; bin > 0; --bin)
+					{
+						rightBounds.extend(bins.Bounds[binAxis][bin]);
+						rightCount			 += bins.Counts[binAxis][bin];
+						rightAreas[bin]	 = rightBounds.getSurfaceArea();
+						rightCounts[bin] = rightCount;
+					}
+
+					BBox		 leftBounds = BBox::Empty();
+					unsigned leftCount	= 0;
+					for (unsigned bin = 1; bin < mapping.BinsCount; ++bin)
+					{
+						leftBounds.extend(bins.Bounds[binAxis][bin - 1]);
+						leftCount += bins.Counts[binAxis][bin - 1];
+						if (leftCount == 0 || rightCounts[bin] == 0)
+						{
+							continue;
+						}
+
+						const float cost = cTraversalCost + cIntersectionCost *
+							(leftBounds.getSurfaceArea() * BVHBlocksCount(leftCount, mBlockSize) + rightAreas[bin] * BVHBlocksCount(rightCounts[bin], mBlockSize)) / nodeArea;
+
+						if (cost < bestCost)
+						{
+							bestCost = cost;
+							bestAxis = binAxis;
+							bestBin	 = bin;
+						}
+					}
+				}
+			}
+
+			// Splitting is not worth it
+			if (count <= mMaxLeafSize && (bestAxis < 0 || bestCost >= cIntersectionCost * BVHBlocksCount(count, mBlockSize)))
+			{
+				return false;
+			}
+
+			std::vector< unsigned >::iterator first = mIndices.begin() + begin;
+			std::vector< unsigned >::iterator last	= mIndices.begin() + end;
+			if (bestAxis >= 0)
+			{
+				*axis		= bestAxis;
+				*middle = std::partition(first, last, [&](unsigned primitive)
+				{
+					return mapping.getBin(mCentroids[primitive], bestAxis) < bestBin;
+				}) - mIndices.begin();
+				return true;
+			}
+
+			// Either centroids coincide or hierarchy is too deep, so split by median along the widest axis
+			const Vec3D centroidExtent = range.Centroids.Max - range.Centroids.Min;
+
+			*axis = 0;
+			if (centroidExtent.y() > BVHAxisValue(centroidExtent, *axis))
+				*axis = 1;
+			if (centroidExtent.z() > BVHAxisValue(centroidExtent, *axis))
+				*axis = 2;
+
+			*middle = begin + count / 2;
+			const unsigned medianAxis = *axis;
+			std::nth_element(first, mIndices.begin() + *middle, last, [&](unsigned lh, unsigned rh)
+			{
+				return BVHAxisValue(mCentroids[lh], medianAxis) < BVHAxisValue(mCentroids[rh], medianAxis);
+			});
+			return true;
+		}
+
+	private:
+		const std::vector< BBox >&	mBounds;
+		const std::vector< Vec3D >& mCentroids;
+		std::vector< unsigned >&		mIndices;
+		unsigned										mMaxLeafSize;
+		unsigned										mBlockSize;
+		unsigned										mThreadsCount;
+		unsigned										mSubtreeSize;
+	};
+
+	//! Append upper level node and its children to the hierarchy in depth-first order, placeholders are replaced with built subtrees.
+	//! Returns index of the appended node
+	unsigned GAppendNodes(const std::vector< BVHNode >& upperNodes,
+												unsigned node,
+												const std::vector< int >& nodeTasks,
+												const std::vector< std::vector< BVHNode > >& subtrees,
+												std::vector< BVHNode >* nodes)
+	{
+		const unsigned nodeIdx = nodes->size();
+		if (nodeTasks[node] >= 0)
+		{
+			// Leaves of subtrees already refer to the shared indices, only inner nodes are shifted
+			const std::vector< BVHNode >& subtree = subtrees[nodeTasks[node]];
+			for (unsigned idx = 0; idx < subtree.size(); ++idx)
+			{
+				nodes->push_back(subtree[idx]);
+				if (subtree[idx].Count == 0)
+				{
+					nodes->back().Offset += nodeIdx;
+				}
+			}
+			return nodeIdx;
+		}
+
+		nodes->push_back(upperNodes[node]);
+		if (upperNodes[node].Count == 0)
+		{
+			GAppendNodes(upperNodes, node + 1, nodeTasks, subtrees, nodes);
+			(*nodes)[nodeIdx].Offset = GAppendNodes(upperNodes, upperNodes[node].Offset, nodeTasks, subtrees, nodes);
+		}
+		return nodeIdx;
+	}
+
+	// Nodes [Begin, End) of one subtree in depth-first order
+	struct NodeRange
+	{
+		unsigned Begin;
+		unsigned End;
+	};
+
+	//! Split subtree of the node, which takes nodes up to end, into subtrees of at most maxSize nodes.
+	//! Nodes above them are appended to upper nodes in depth-first order
+	void GSplitRanges(const std::vector< BVHNode >& nodes,
+										unsigned node,
+										unsigned end,
+										unsigned maxSize,
+										std::vector< unsigned >* upperNodes,
+										std::vector< NodeRange >* ranges)
+	{
+		if (end - node <= maxSize || nodes[node].Count > 0)
+		{
+			const NodeRange range = { node, end };
+			ranges->push_back(range);
+			return;
+		}
+
+		upperNodes->push_back(node);
+		GSplitRanges(nodes, node + 1, nodes[node].Offset, maxSize, upperNodes, ranges);
+		GSplitRanges(nodes, nodes[node].Offset, end, maxSize, upperNodes, ranges);
+	}
+
+	//! Recompute bounds of the node from its primitives or its children, which must be already refitted
+	void GRefitNode(const std::vector< BBox >& bounds, const std::vector< unsigned >& indices, std::vector< BVHNode >* nodes, unsigned node)
+	{
+		BVHNode& current = (*nodes)[node];
+		if (current.Count > 0)
+		{
+			current.Bounds = BBox::Empty();
+			for (unsigned idx = current.Offset, last = current.Offset + current.Count; idx < last; ++idx)
+			{
+				current.Bounds.extend(bounds[indices[idx]]);
+			}
+		}
+		else
+		{
+			current.Bounds = (*nodes)[node + 1].Bounds;
+			current.Bounds.extend((*nodes)[current.Offset].Bounds);
+		}
+	}
+}
+
+BVH::BVH()
+	: mBlockSize(1)
+{
+	clear();
+}
+
+void BVH::build(const std::vector< BBox >& bounds,
+								unsigned maxLeafSize,
+								unsigned blockSize,
+								BVHBuildMode mode,
+								unsigned threadsCount,
+								const BVHPrimitiveSplitter* splitter)
+{
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	clear();
+
+	const unsigned count = bounds.size();
+	if (count == 0)
+	{
+		return;
+	}
+
+	mBlockSize	 = std::max(1u, blockSize);
+	maxLeafSize	 = std::max(1u, std::min(maxLeafSize, cMaxLeafCount));
+	threadsCount = count < cMinParallelCount ? 1 : ParallelThreadsCount(threadsCount);
+
+	// Primitives can't be clipped without their owner
+	if (mode == BVH_BUILD_SPATIAL && !splitter)
+	{
+		mode = BVH_BUILD_SAH;
+	}
+
+	if (mode == BVH_BUILD_SAH)
+	{
+		buildBinned(bounds, maxLeafSize, threadsCount);
+	}
+	else if (mode == BVH_BUILD_SPATIAL)
+	{
+		// References are split one node after another
+		threadsCount = 1;
+
+		SpatialBVHBuilder builder(maxLeafSize, mBlockSize, BVH_SPATIAL_SPLIT_BUDGET);
+		builder.build(bounds, *splitter, &mNodes, &mIndices);
+	}
+	else
+	{
+		LinearBVHBuilder builder(maxLeafSize, mBlockSize, threadsCount);
+		builder.build(bounds, mode == BVH_BUILD_LINEAR_TREELETS, &mNodes, &mIndices);
+	}
+
+	setBuildStats(mode, threadsCount, std::chrono::duration< double >(std::chrono::steady_clock::now() - start).count());
+}
+
+void BVH::assign(std::vector< BVHNode >* nodes, std::vector< unsigned >* indices, unsigned blockSize, BVHBuildMode mode)
+{
+	clear();
+
+	mNodes.swap(*nodes);
+	mIndices.swap(*indices);
+	mBlockSize = std::max(1u, blockSize);
+
+	setBuildStats(mode, 0, 0.);
+}
+
+void BVH::setBuildStats(BVHBuildMode mode, unsigned threadsCount, double seconds)
+{
+	mBuildStats.Mode						= mode;
+	mBuildStats.Seconds					= seconds;
+	mBuildStats.SAHCost					= getSAHCost();
+	mBuildStats.NodesCount			= mNodes.size();
+	mBuildStats.LeavesCount			= 0;
+	mBuildStats.ReferencesCount	= mIndices.size();
+	mBuildStats.ThreadsCount		= threadsCount;
+	for (unsigned node = 0; node < mNodes.size(); ++node)
+	{
+		if (mNodes[node].Count > 0)
+		{
+			++mBuildStats.LeavesCount;
+		}
+	}
+}
+
+void BVH::buildBinned(const std::vector< BBox >& bounds, unsigned maxLeafSize, unsigned threadsCount)
+{
+	const unsigned count = bounds.size();
+
+	std::vector< Vec3D > centroids(count);
+	mIndices.resize(count);
+	for (unsigned idx = 0; idx < count; ++idx)
+	{
+		centroids[idx] = bounds[idx].getCentroid();
+		mIndices[idx]	 = idx;
+	}
+
+	BinnedBuilder builder(bounds, centroids, &mIndices, maxLeafSize, mBlockSize, threadsCount);
+
+	if (threadsCount == 1)
+	{
+		mNodes.reserve(2 * count - 1);
+		builder.build(&mNodes, NULL, 0, count, 0);
+	}
+	else
+	{
+		std::vector< BVHNode >		 upperNodes;
+		std::vector< SubtreeTask > tasks;
+		builder.build(&upperNodes, &tasks, 0, count, 0);
+
+		// Largest subtrees are taken first, so threads finish at about the same time
+		std::vector< unsigned > order(tasks.size());
+		std::vector< int >			nodeTasks(upperNodes.size(), -1);
+		for (unsigned task = 0; task < tasks.size(); ++task)
+		{
+			order[task]									= task;
+			nodeTasks[tasks[task].Node] = task;
+		}
+		std::sort(order.begin(), order.end(), [&](unsigned lh, unsigned rh)
+		{
+			return tasks[lh].End - tasks[lh].Begin > tasks[rh].End - tasks[rh].Begin;
+		});
+
+		std::vector< std::vector< BVHNode > > subtrees(tasks.size());
+		std::atomic< unsigned >								nextTask(0);
+		ParallelRun(std::min< unsigned >(threadsCount, tasks.size()), [&](unsigned /*thread*/)
+		{
+			for (unsigned idx = nextTask++; idx < order.size(); idx = nextTask++)
+			{
+				const SubtreeTask& task = tasks[order[idx]];
+				subtrees[order[idx]].reserve(2 * (task.End - task.Begin) - 1);
+				builder.build(&subtrees[order[idx]], NULL, task.Begin, task.End, task.Depth);
+			}
+		});
+
+		mNodes.reserve(2 * count - 1);
+		GAppendNodes(upperNodes, 0, nodeTasks, subtrees, &mNodes);
+	}
+}
+
+void BVH::refit(const std::vector< BBox >& bounds, unsigned threadsCount)
+{
+	const unsigned count = mNodes.size();
+	if (count == 0)
+	{
+		return;
+	}
+
+	threadsCount = bounds.size() < cMinParallelCount ? 1 : ParallelThreadsCount(threadsCount);
+
+	// Children follow their parents, so nodes are refitted in reverse order
+	if (threadsCount == 1)
+	{
+		for (unsigned node = count; node-- > 0;)
+		{
+			GRefitNode(bounds, mIndices, &mNodes, node);
+		}
+		return;
+	}
+
+	// Subtrees take contiguous ranges of nodes, so they're refitted independently, then nodes above them
+	std::vector< unsigned >	upperNodes;
+	std::vector< NodeRange > ranges;
+	GSplitRanges(mNodes, 0, count, std::max(cMinParallelCount, count / (threadsCount * cSubtreesPerThread)), &upperNodes, &ranges);
+
+	std::atomic< unsigned > nextRange(0);
+	ParallelRun(std::min< unsigned >(threadsCount, ranges.size()), [&](unsigned /*thread*/)
+	{
+		for (unsigned idx = nextRange++; idx < ranges.size(); idx = nextRange++)
+		{
+			for (unsigned node = ranges[idx].End; node-- > ranges[idx].Begin;)
+			{
+				GRefitNode(bounds, mIndices, &mNodes, node);
+			}
+		}
+	});
+
+	for (unsigned idx = upperNodes.size(); idx-- > 0;)
+	{
+		GRefitNode(bounds, mIndices, &mNodes, upperNodes[idx]);
+	}
+}
+
+void BVH::clear()
+{
+	mNodes.clear();
+	mIndices.clear();
+
+	const BVHBuildStats noStats = { BVH_BUILD_SAH, 0., 0.f, 0, 0, 0, 0 };
+	mBuildStats = noStats;
+}
+
+BBox BVH::getBounds() const
+{
+	if (mNodes.empty())
+	{
+		return BBox::Empty();
+	}
+	return mNodes.front().Bounds;
+}
+
+float BVH::getSAHCost() const
+{
+	if (mNodes.empty())
+	{
+		return 0.f;
+	}
+
+	const float rootArea = mNodes.front().Bounds.getSurfaceArea();
+	if (rootArea <= 0.f)
+	{
+		return cIntersectionCost * BVHBlocksCount(mIndices.size(), mBlockSize);
+	}
+
+	// Ray, which hits the root, hits each node with probability proportional to its area
+	float cost = 0.f;
+	for (unsigned node = 0; node < mNodes.size(); ++node)
+	{
+		const BVHNode& current = mNodes[node];
+		const float		 area		 = current.Bounds.getSurfaceArea();
+
+		cost += area / rootArea * (current.Count > 0 ? cIntersectionCost * BVHBlocksCount(current.Count, mBlockSize) : cTraversalCost);
+	}
+	return cost;
+}
@@ -0,0 +1,294 @@
+#ifndef GEOMETRY_BVH_H
+#define GEOMETRY_BVH_H
+
+#include <vector>
+
+#include "geometry/bbox.h"
+#include "geometry/ray.h"
+#include "geometry/raypacket.h"
+
+#define BVH_STACK_SIZE 64
+
+// Node of the flattened hierarchy, nodes are stored in depth-first order,
+// so the first child of an inner node always follows its parent
+struct BVHNode
+{
+	BBox					 Bounds;
+	unsigned			 Offset; // Leaf: first primitive in indices array, inner node: index of the second child
+	unsigned short Count;	 // Primitives count, zero for inner nodes
+	unsigned short Axis;	 // Axis, inner node was split along
+};
+
+// Hierarchy builders trade traversal speed for build speed
+enum BVHBuildMode
+{
+	BVH_BUILD_SAH,						// Binned surface area heuristic, the fastest traversal
+	BVH_BUILD_LINEAR,					// Primitives sorted by Morton codes, built in a fraction of SAH build time
+	BVH_BUILD_LINEAR_TREELETS, // Linear hierarchy with small treelets restructured by SAH
+	BVH_BUILD_SPATIAL					 // SAH with spatial splits, primitives are clipped and referenced by several leaves
+};
+
+// Owner of primitives clips them for spatial splits, as hierarchy knows only their bounds
+struct BVHPrimitiveSplitter
+{
+	virtual ~BVHPrimitiveSplitter()
+	{
+	}
+
+	//! Get bounds of the primitive parts on both sides of the axis-aligned plane, either of them may be empty
+	virtual void split(unsigned primitive, unsigned axis, float position, BBox* left, BBox* right) const = 0;
+};
+
+// Statistics of the last hierarchy build
+struct BVHBuildStats
+{
+	BVHBuildMode Mode;
+	double			 Seconds;
+	float				 SAHCost; // Expected cost of a ray, which hits the root, in traversal steps and primitive intersections
+	unsigned		 NodesCount;
+	unsigned		 LeavesCount;
+	unsigned		 ReferencesCount; // Primitives in leaves, spatial splits reference primitives several times
+	unsigned		 ThreadsCount;
+};
+
+// Bounding volume hierarchy over abstract primitives, which are known only by their bounds.
+// Hierarchy is built using binned surface area heuristic and stores only indices of primitives,
+// so the owner is responsible for intersecting primitives found in leaves.
+class BVH
+{
+public:
+	explicit BVH();
+
+	//! Build hierarchy over primitives with given bounds, bounds must be finite.
+	//! If primitives are intersected in blocks of blockSize at once, leaf cost is counted per block.
+	//! Large hierarchies are built by threadsCount threads, zero means the number of hardware threads.
+	//! Spatial splits need splitter of primitives, hierarchy is built by SAH without it
+	void build(const std::vector< BBox >& bounds,
+						 unsigned maxLeafSize = 4,
+						 unsigned blockSize = 1,
+						 BVHBuildMode mode = BVH_BUILD_SAH,
+						 unsigned threadsCount = 0,
+						 const BVHPrimitiveSplitter* splitter = NULL);
+
+	//! Take over nodes and indices of the hierarchy, which was built before, e.g. the one loaded from a cache.
+	//! They must be valid for the primitives, given arrays are left empty
+	void assign(std::vector< BVHNode >* nodes, std::vector< unsigned >* indices, unsigned blockSize, BVHBuildMode mode);
+
+	//! Update bounds of the built hierarchy for primitives, which have moved, topology is kept.
+	//! Primitives must be the same as for the build, independent subtrees are refitted by threadsCount threads.
+	//! Leaves of spatial splits get whole bounds of their primitives, so they stay valid, but overlap more
+	void refit(const std::vector< BBox >& bounds, unsigned threadsCount = 0);
+
+	void clear();
+
+	bool isEmpty() const
+	{
+		return mNodes.empty();
+	}
+
+	const std::vector< BVHNode >& getNodes() const
+	{
+		return mNodes;
+	}
+
+	const std::vector< unsigned >& getIndices() const
+	{
+		return mIndices;
+	}
+
+	//! Get bounds of all the primitives
+	BBox getBounds() const;
+
+	//! Get expected cost of a ray, which hits the root, by surface area heuristic.
+	//! Its growth since the build shows how much the refitted hierarchy has degraded
+	float getSAHCost() const;
+
+	const BVHBuildStats& getBuildStats() const
+	{
+		return mBuildStats;
+	}
+
+	//! Traverse hierarchy front-to-back, skipping nodes outside of the ray interval.
+	//! Visitor is called as bool visitor(unsigned primitive, float* maxDistance) for primitives in reached leaves,
+	//! max distance starts from the ray tMax, visitor may shrink it to cull further nodes and returns true to stop traversal
+	template <class Visitor>
+	void traverse(const Ray& ray, Visitor& visitor) const;
+
+	//! Same as traverse, but visitor is called as bool visitor(unsigned leaf, float* maxDistance) for reached leaf nodes,
+	//! so owner may intersect all the primitives of the leaf at once
+	template <class Visitor>
+	void traverseLeaves(const Ray& ray, Visitor& visitor) const;
+
+	//! Traverse hierarchy with the packet of rays from the mask, node is visited if any of them hits it not further than its max distance.
+	//! Visitor is called as bool visitor(unsigned leaf, unsigned mask, float* maxDistances) with mask of rays, which reached the leaf,
+	//! it may shrink max distances of these rays and returns true to stop traversal
+	template <class Visitor>
+	void traversePacket(const RayPacket& packet, unsigned mask, float* maxDistances, Visitor& visitor) const;
+
+private:
+	//! Build by binned SAH, upper levels are split by all the threads, then subtrees are built in parallel
+	void buildBinned(const std::vector< BBox >& bounds, unsigned maxLeafSize, unsigned threadsCount);
+
+	//! Count nodes and leaves of the built hierarchy, assigned hierarchy has no build time and threads
+	void setBuildStats(BVHBuildMode mode, unsigned threadsCount, double seconds);
+
+private:
+	std::vector< BVHNode >  mNodes;
+	std::vector< unsigned > mIndices;
+	unsigned								mBlockSize;
+	BVHBuildStats						mBuildStats;
+};
+
+// Calls primitives visitor for each primitive of the visited leaf
+template <class Visitor>
+struct BVHPrimitivesVisitor
+{
+	BVHPrimitivesVisitor(const std::vector< BVHNode >& nodes, const std::vector< unsigned >& indices, Visitor& visitor)
+		: Nodes(nodes),
+			Indices(indices),
+			PrimitivesVisitor(visitor)
+	{
+	}
+
+	bool operator()(unsigned leaf, float* maxDistance)
+	{
+		const BVHNode& node = Nodes[leaf];
+		for (unsigned idx = node.Offset, last = node.Offset + node.Count; idx < last; ++idx)
+		{
+			if (PrimitivesVisitor(Indices[idx], maxDistance))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	const std::vector< BVHNode >&  Nodes;
+	const std::vector< unsigned >& Indices;
+	Visitor&											 PrimitivesVisitor;
+};
+
+template <class Visitor>
+inline void BVH::traverse(const Ray& ray, Visitor& visitor) const
+{
+	BVHPrimitivesVisitor< Visitor > leavesVisitor(mNodes, mIndices, visitor);
+	traverseLeaves(ray, leavesVisitor);
+}
+
+template <class Visitor>
+inline void BVH::traverseLeaves(const Ray& ray, Visitor& visitor) const
+{
+	if (mNodes.empty())
+	{
+		return;
+	}
+
+	float maxDistance = ray.getTMax();
+
+	unsigned stack[BVH_STACK_SIZE];
+	int			 stackSize = 0;
+	unsigned current	 = 0;
+
+	for (;;)
+	{
+		const BVHNode& node = mNodes[current];
+
+		float tNear, tFar;
+		if (node.Bounds.intersect(ray, &tNear, &tFar) && tNear <= maxDistance)
+		{
+			if (node.Count > 0)
+			{
+				if (visitor(current, &maxDistance))
+				{
+					return;
+				}
+			}
+			else
+			{
+				// Visit near child first and postpone the far one
+				if (ray.getSign(node.Axis))
+				{
+					stack[stackSize++] = current + 1;
+					current						 = node.Offset;
+				}
+				else
+				{
+					stack[stackSize++] = node.Offset;
+					current						 = current + 1;
+				}
+				continue;
+			}
+		}
+
+		if (stackSize == 0)
+		{
+			break;
+		}
+		current = stack[--stackSize];
+	}
+}
+
+template <class Visitor>
+inline void BVH::traversePacket(const RayPacket& packet, unsigned mask, float* maxDistances, Visitor& visitor) const
+{
+	if (mNodes.empty() || mask == 0)
+	{
+		return;
+	}
+
+	// Rays of the postponed node are the ones, which reached its parent, they are culled again when it's popped
+	unsigned stack[BVH_STACK_SIZE];
+	unsigned stackMasks[BVH_STACK_SIZE];
+	int			 stackSize	 = 0;
+	unsigned current		 = 0;
+	unsigned currentMask = mask;
+
+	for (;;)
+	{
+		const BVHNode& node		 = mNodes[current];
+		const unsigned nodeMask = packet.intersect(node.Bounds, currentMask, maxDistances);
+
+		if (nodeMask != 0)
+		{
+			if (node.Count > 0)
+			{
+				if (visitor(current, nodeMask, maxDistances))
+				{
+					return;
+				}
+			}
+			else
+			{
+				// Packet is coherent, so the first active ray chooses the near child for all of them
+				unsigned first = 0;
+				while ((nodeMask & (1 << first)) == 0)
+				{
+					++first;
+				}
+				stackMasks[stackSize] = nodeMask;
+				currentMask						= nodeMask;
+				if (packet.Rays[first].getSign(node.Axis))
+				{
+					stack[stackSize++] = current + 1;
+					current						 = node.Offset;
+				}
+				else
+				{
+					stack[stackSize++] = node.Offset;
+					current						 = current + 1;
+				}
+				continue;
+			}
+		}
+
+		if (stackSize == 0)
+		{
+			break;
+		}
+		--stackSize;
+		current			= stack[stackSize];
+		currentMask = stackMasks[stackSize];
+	}
+}
+
+#endif // GEOMETRY_BVH_H
@@ -0,0 +1,27 @@
+#ifndef GEOMETRY_BVHBUILD_H
+#define GEOMETRY_BVHBUILD_H
+
+#include "geometry/vector3d.h"
+
+// Costs and helpers, which are shared by hierarchy builders
+
+// Relative costs of node traversal and primitive intersection for surface area heuristic
+#define BVH_TRAVERSAL_COST		1.f
+#define BVH_INTERSECTION_COST 1.f
+
+// Spatial splits may add at most this share of primitives count as duplicated references
+#define BVH_SPATIAL_SPLIT_BUDGET 0.3f
+
+//! Get count of blocks, which primitives take. Primitives, intersected in blocks, cost the same as the whole block
+inline unsigned BVHBlocksCount(unsigned count, unsigned blockSize)
+{
+	return (count + blockSize - 1) / blockSize;
+}
+
+//! Get vector component along given axis
+inline float BVHAxisValue(const Vec3D& v, unsigned axis)
+{
+	return axis == 0 ? v.x() : (axis == 1 ? v.y() : v.z());
+}
+
+#endif
@@ -6,20 +6,22 @@
 //  
 //-------------------------------------------------------------------
 
+#include <algorithm>
+
 #include "illumination/material.h"
 
 #include "cone.h"
 
 Cone::Cone(const Vec3D& top, const Vec3D& bottom, float radius, Mtrl* material)
-	: mTop(top),
-		mBottom(bottom),
-		mRadius(radius),
+	: mRadius(radius),
 		mMtrl(material),
 		mIsLight(false)
 {
-	mAxis					= (mTop - mBottom).toUnit();
-	mRadius2			= mRadius * mRadius;
-	mRadPerHeight = mRadius / length(mTop - mBottom);
+	mGeometry.Top					 = top;
+	mGeometry.Bottom			 = bottom;
+	mGeometry.Axis				 = (top - bottom).toUnit();
+	mGeometry.Radius2			 = mRadius * mRadius;
+	mGeometry.RadPerHeight = mRadius / length(top - bottom);
 }
 
 Cone::~Cone()
@@ -27,23 +29,24 @@ Cone::~Cone()
 	delete mMtrl;
 }
 
-CIsect Cone::intersect(const Ray& ray)
+bool ConeGeometry::intersect(const Ray& ray, CIsect* isect, HitBuffer* hits) const
 {
 	const Vec3D& rayOrg    = ray.getOrg();
 	const Vec3D& rayDir = ray.getDir();
 
-	const Vec3D& CO = rayOrg - mBottom;
+	const Vec3D& CO = rayOrg - Bottom;
 
-	const float dirDotAxis = dot(rayDir, mAxis);
-	const float CODotAxis	 = dot(CO, mAxis);
+	const float dirDotAxis = dot(rayDir, Axis);
+	const float CODotAxis	 = dot(CO, Axis);
 
-	const Vec3D& u = rayDir + mAxis * (-dirDotAxis);
-	const Vec3D& v = CO + mAxis * (-CODotAxis);
-	const float     w = CODotAxis * mRadPerHeight;
+	const Vec3D& u = rayDir + Axis * (-dirDotAxis);
+	const Vec3D& v = CO + Axis * (-CODotAxis);
+	const float     w = CODotAxis * RadPerHeight;
 
-	const float	radPerDir = dirDotAxis * mRadPerHeight;
+	const float	radPerDir = dirDotAxis * RadPerHeight;
 
-	CIsect res = CIsect(true);
+	// Hits are reported only if intersection is found
+	HitBuffer shapeHits;
 
 	// Let a, b, c be the coefficients of the square equation
 	const float a = dot(u, u) - radPerDir * radPerDir;
@@ -60,22 +63,23 @@ CIsect Cone::intersect(const Ray& ray)
 		// Complete miss
 		if (D < 0.f) 
 		{
-			return CIsect(false);
+			return false;
 		}
 
 		D = sqrtf(D);
 
 		const float denom = 1 / (2 * a);
 
+		// Equation is negative inside, so its first root is the entry, whatever the sign of a is
 		root = (-b - D) * denom;
 		if (root > 0.f)
 		{
 			const Vec3D& surfacePoint = ray.apply(root);
-			Vec3D toBottom = surfacePoint - mBottom;
-			Vec3D toTop		= surfacePoint - mTop;
-			if (dot(mAxis, toBottom) > 0.f && dot((-mAxis), toTop) > 0.f)
+			Vec3D toBottom = surfacePoint - Bottom;
+			Vec3D toTop		= surfacePoint - Top;
+			if (dot(Axis, toBottom) > 0.f && dot((-Axis), toTop) > 0.f)
 			{
-				res.Dst.push_back(root);
+				shapeHits.add(root, true);
 				closest = root;
 			}
 		}
@@ -83,11 +87,11 @@ CIsect Cone::intersect(const Ray& ray)
 		if (root > 0.f)
 		{
 			const Vec3D& surfacePoint = ray.apply(root);
-			Vec3D toBottom = surfacePoint - mBottom;
-			Vec3D toTop		= surfacePoint - mTop;
-			if (dot(mAxis, toBottom) > 0.f && dot(-mAxis, toTop) > 0.f)
+			Vec3D toBottom = surfacePoint - Bottom;
+			Vec3D toTop		= surfacePoint - Top;
+			if (dot(Axis, toBottom) > 0.f && dot(-Axis, toTop) > 0.f)
 			{
-				res.Dst.push_back(root);
+				shapeHits.add(root, false);
 				if (closest < 0.f)
 				{
 					closest = root;
@@ -109,36 +113,36 @@ CIsect Cone::intersect(const Ray& ray)
 
 	if (fabs(dirDotAxis) < FLOAT_ZERO)
 	{
-		if (closest > 0.f)
+		// Entry may be out of the ray interval, then the exit is the closest hit
+		const float distance = ray.contains(closest) ? closest : rayExit;
+		if (ray.contains(distance))
 		{
-			res.Exists	 = true;
-			res.Distance = closest;
-			res.Object   = this;
-			res.Normal	 = getNormal(ray, closest);
-			if (rayExit < 0.f) 
+			isect->Exists		= true;
+			isect->Distance = distance;
+			// Ray starts inside the shape
+			if (rayExit < 0.f)
 			{
-				res.InsideIntervals.push_back(Span(0.f, closest));
-				res.Dst.insert(res.Dst.begin(), 0.f);
+				shapeHits.add(0.f, true);
 			}
-			else
+			if (hits)
 			{
-				res.InsideIntervals.push_back(Span(closest, rayExit));
+				hits->append(shapeHits);
 			}
-			
-			return res;
+			return true;
 		}
 
-		return CIsect(false);
+		return false;
 	}
 
 	// Somewhere I messed up with the top and bottom pnts
-	root = (dot(-mAxis, rayOrg - mTop)) / dirDotAxis;
+	root = (dot(-Axis, rayOrg - Top)) / dirDotAxis;
 	if (root > 0.f)
 	{
-		Vec3D test = ray.apply(root) - mTop;
-		if (dot(test, test) < mRadius2)
+		Vec3D test = ray.apply(root) - Top;
+		if (dot(test, test) < Radius2)
 		{
-			res.Dst.push_back(root);
+			// Cap faces along the axis
+			shapeHits.add(root, dirDotAxis < 0.f);
 			if (closest < 0.f)
 			{
 				closest = root;
@@ -156,24 +160,34 @@ CIsect Cone::intersect(const Ray& ray)
 		}
 	}
 	
-	if (closest > 0.f)
+	// Entry may be out of the ray interval, then the exit is the closest hit
+	const float distance = ray.contains(closest) ? closest : rayExit;
+	if (ray.contains(distance))
 	{
-			res.Exists	 = true;
-			res.Distance = closest;
-			res.Object   = this;
-			res.Normal	 = getNormal(ray, closest);
-			if (rayExit < 0.f) 
+			isect->Exists		= true;
+			isect->Distance = distance;
+			// Ray starts inside the shape
+			if (rayExit < 0.f)
 			{
-				res.InsideIntervals.push_back(Span(0.f, closest));
-				res.Dst.insert(res.Dst.begin(), 0.f);
+				shapeHits.add(0.f, true);
 			}
-			else
+			if (hits)
 			{
-				res.InsideIntervals.push_back(Span(closest, rayExit));
+				hits->append(shapeHits);
 			}
-			return res;
+			return true;
+	}
+	return false;
+}
+
+CIsect Cone::intersect(const Ray& ray, HitBuffer* hits)
+{
+	CIsect res(false);
+	if (mGeometry.intersect(ray, &res, hits))
+	{
+		res.Object = this;
 	}
-	return CIsect(false);
+	return res;
 }
 
 
@@ -182,14 +196,14 @@ Vec3D Cone::getNormal(const Ray& ray, float distance, const CIsect& isect /*= CI
 	const Vec3D atSurface = ray.apply(distance);
 	// Check, whether pnt is lying on caps
 	// Bottom
-	const Vec3D& toBottom		 = atSurface - mTop;
-	if (fabs(dot(mAxis, toBottom)) < FLOAT_ZERO && dot(toBottom, toBottom) < mRadius2)
+	const Vec3D& toBottom		 = atSurface - mGeometry.Top;
+	if (fabs(dot(mGeometry.Axis, toBottom)) < FLOAT_ZERO && dot(toBottom, toBottom) < mGeometry.Radius2)
 	{
-		return mAxis;
+		return mGeometry.Axis;
 	}
 	
-	const Vec3D& approxNorm = atSurface - (mAxis * (dot(atSurface - mTop, mAxis)) + mTop); // Check me
-	return (approxNorm + mAxis * (-mRadPerHeight * length(approxNorm))).toUnit();
+	const Vec3D& approxNorm = atSurface - (mGeometry.Axis * (dot(atSurface - mGeometry.Top, mGeometry.Axis)) + mGeometry.Top); // Check me
+	return (approxNorm + mGeometry.Axis * (-mGeometry.RadPerHeight * length(approxNorm))).toUnit();
 }
 
 Color Cone::getAmbColor(const Vec3D& pnt, const CIsect& isect/* = CIsect()*/) const
@@ -216,4 +230,18 @@ Vec3D Cone::getTexCoords(const Vec3D& pnt, const CIsect& isect/* = CIsect()*/) c
 {
 	// TODO:
 	return Vec3D();
-}
\ No newline at end of file
+}
+
+BBox Cone::getBBox() const
+{
+	// Cone apex is at the bottom pnt and its cap of given radius is at the top one
+	const Vec3D capExtent(mRadius * sqrtf(std::max(0.f, 1.f - mGeometry.Axis.x() * mGeometry.Axis.x())),
+												mRadius * sqrtf(std::max(0.f, 1.f - mGeometry.Axis.y() * mGeometry.Axis.y())),
+												mRadius * sqrtf(std::max(0.f, 1.f - mGeometry.Axis.z() * mGeometry.Axis.z())));
+
+	BBox box = BBox::Empty();
+	box.extend(mGeometry.Bottom);
+	box.extend(mGeometry.Top - capExtent);
+	box.extend(mGeometry.Top + capExtent);
+	return box;
+}
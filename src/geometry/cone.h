@@ -6,12 +6,22 @@
 #include "geometry/ray.h"
 #include "geometry/vector3d.h"
 
+// Data of the cone, which is enough to intersect it, compiled scene keeps it in contiguous arrays
+struct ConeGeometry
+{
+	//! Find closest hit inside of the ray interval, distances of all the hits are added to the buffer, if it's given
+	bool intersect(const Ray& ray, CIsect* isect, HitBuffer* hits = NULL) const;
+
+	Vec3D Bottom, Top, Axis;
+	float Radius2, RadPerHeight;
+};
+
 class Cone : public IShape
 {
 public:
 	Cone(const Vec3D& top, const Vec3D& bottom, float radius, Mtrl* material);
   virtual ~Cone();
-  virtual CIsect intersect(const Ray& ray);
+  virtual CIsect intersect(const Ray& ray, HitBuffer* hits = NULL);
 
 	virtual const Mtrl* getMtrl() const
 	{
@@ -33,9 +43,14 @@ public:
 	virtual Color getDifColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
 	virtual Color getSpcColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
 	virtual Vec3D getTexCoords(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
+	virtual BBox getBBox() const;
+	const ConeGeometry& getGeometry() const
+	{
+		return mGeometry;
+	}
 private:
-	Vec3D	mBottom, mTop, mAxis;
-	float mRadius, mRadius2, mRadPerHeight;
+	ConeGeometry mGeometry;
+	float				 mRadius;
 	Mtrl* mMtrl;
 	bool mIsLight;
 };
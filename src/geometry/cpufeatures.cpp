@@ -0,0 +1,73 @@
+//-------------------------------------------------------------------
+// File: cpufeatures.cpp
+// 
+// CPU instruction sets detection
+//
+//  
+//-------------------------------------------------------------------
+
+#include "cpufeatures.h"
+
+#if defined(CPU_X86) && defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+#if defined(CPU_X86) && defined(_MSC_VER)
+namespace
+{
+	bool GHasOSSupportForAVX()
+	{
+		int info[4];
+		__cpuid(info, 1);
+		const bool hasOSXSave = (info[2] & (1 << 27)) != 0;
+		const bool hasAVX			= (info[2] & (1 << 28)) != 0;
+		// OS must save AVX registers on context switch
+		return hasOSXSave && hasAVX && (_xgetbv(0) & 6) == 6;
+	}
+}
+#endif
+
+bool CpuHasSSE2()
+{
+#if !defined(CPU_X86)
+	return false;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse2") != 0;
+#endif
+}
+
+bool CpuHasAVX()
+{
+#if !defined(CPU_X86)
+	return false;
+#elif defined(_MSC_VER)
+	return GHasOSSupportForAVX();
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx") != 0;
+#endif
+}
+
+bool CpuHasAVX2()
+{
+#if !defined(CPU_X86)
+	return false;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7 || !GHasOSSupportForAVX())
+	{
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
@@ -0,0 +1,30 @@
+#ifndef GEOMETRY_CPUFEATURES_H
+#define GEOMETRY_CPUFEATURES_H
+
+// SIMD kernels are compiled for their instruction sets function by function and chosen at startup,
+// so one binary runs on CPUs with and without AVX
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	#define CPU_X86
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		// Compiler allows any intrinsics in any function
+		#define TARGET_SSE2
+		#define TARGET_AVX
+		#define TARGET_AVX2
+	#else
+		#define TARGET_SSE2 __attribute__((target("sse2")))
+		#define TARGET_AVX	__attribute__((target("avx")))
+		#define TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+//! Check whether CPU supports SSE2 instructions
+bool CpuHasSSE2();
+
+//! Check whether CPU and OS support AVX instructions
+bool CpuHasAVX();
+
+//! Check whether CPU and OS support AVX2 instructions
+bool CpuHasAVX2();
+
+#endif
@@ -9,21 +9,23 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 
+#include <algorithm>
+
 #include "illumination/material.h"
 
 #include "cylinder.h"
 
 Cylinder::Cylinder(const Vec3D& top, const Vec3D& bottom, float radius, Mtrl* material)
-  : mTop(top),
-    mBottom(bottom),
-    mRadius(radius),
+  : mRadius(radius),
     mMtrl(material),
 		mIsLight(false)
 {
-  mAxis		 = (mTop - mBottom).toUnit();
-	mRadius2 = mRadius * mRadius;
-	mVe			 = Vec3D(mAxis.y(), mAxis.z(), -mAxis.x());
-	mVn			 = cross(mVe, mAxis);
+	mGeometry.Top			= top;
+	mGeometry.Bottom	= bottom;
+	mGeometry.Axis		= (top - bottom).toUnit();
+	mGeometry.Radius2 = mRadius * mRadius;
+	mVe								= Vec3D(mGeometry.Axis.y(), mGeometry.Axis.z(), -mGeometry.Axis.x());
+	mVn								= cross(mVe, mGeometry.Axis);
 }
 
 Cylinder::~Cylinder()
@@ -31,17 +33,18 @@ Cylinder::~Cylinder()
   delete mMtrl;
 }
 
-CIsect Cylinder::intersect(const Ray& ray)
+bool CylinderGeometry::intersect(const Ray& ray, CIsect* isect, HitBuffer* hits) const
 {
   const Vec3D& origin    = ray.getOrg();
   const Vec3D& direction = ray.getDir();
 
-	const Vec3D& CO = origin - mBottom;
+	const Vec3D& CO = origin - Bottom;
 	
-	const Vec3D& u = direction - mAxis * (dot(direction, mAxis));
-	const Vec3D& v = CO - mAxis * (dot(CO, mAxis));
+	const Vec3D& u = direction - Axis * (dot(direction, Axis));
+	const Vec3D& v = CO - Axis * (dot(CO, Axis));
 
-	CIsect res = CIsect(true);
+	// Hits are reported only if intersection is found
+	HitBuffer shapeHits;
 	// Let a, b and c be coefficients of some square equation
 	const float a = dot(u, u);
 	float root		= 0.f;
@@ -50,14 +53,14 @@ CIsect Cylinder::intersect(const Ray& ray)
 	if (fabs(a) > FLOAT_ZERO)
 	{
 		const float b = 2 * dot(u, v);
-		const float c = dot(v, v) - mRadius2;
+		const float c = dot(v, v) - Radius2;
 
 		float D = b * b - 4 * a * c;
 
 		// Complete miss
 		if (D < 0.f) 
 		{
-			return CIsect(false);
+			return false;
 		}
 
 		D = sqrtf(D);
@@ -68,11 +71,11 @@ CIsect Cylinder::intersect(const Ray& ray)
 		root = (-b - D) * denom;
 		if (root >= 0.f)
 		{
-			Vec3D toBottom = ray.apply(root) - mBottom;
-			Vec3D toTop		= ray.apply(root) - mTop;
-			if (dot(mAxis, toBottom) > 0.f && dot(mAxis, toTop) < 0.f)
+			Vec3D toBottom = ray.apply(root) - Bottom;
+			Vec3D toTop		= ray.apply(root) - Top;
+			if (dot(Axis, toBottom) > 0.f && dot(Axis, toTop) < 0.f)
 			{
-				res.Dst.push_back(root);
+				shapeHits.add(root, true);
 				closest = root;
 			}
 		}
@@ -80,11 +83,11 @@ CIsect Cylinder::intersect(const Ray& ray)
 		if (root > 0.f)
 		{
 			// Awful copy paste :(
-			Vec3D toBottom = ray.apply(root) - mBottom;
-			Vec3D toTop		= ray.apply(root) - mTop;
-			if (dot(mAxis, toBottom) > 0.f && dot(mAxis, toTop) < 0.f)
+			Vec3D toBottom = ray.apply(root) - Bottom;
+			Vec3D toTop		= ray.apply(root) - Top;
+			if (dot(Axis, toBottom) > 0.f && dot(Axis, toTop) < 0.f)
 			{
-				res.Dst.push_back(root);
+				shapeHits.add(root, false);
 				if (closest < 0.f)
 				{
 					root = closest;
@@ -106,40 +109,42 @@ CIsect Cylinder::intersect(const Ray& ray)
 
 	// Find intersection with caps
 	// Bottom one
-	float axisToDir = dot(mAxis, direction);
+	float axisToDir = dot(Axis, direction);
 
 	if (fabs(axisToDir) < FLOAT_ZERO)
 	{
-		if (closest > 0.f)
+		// Entry may be out of the ray interval, then the exit is the closest hit
+		const float distance = ray.contains(closest) ? closest : rayExit;
+		if (ray.contains(distance))
 		{
-			res.Distance = closest;
-			res.Object   = this;
-			res.Normal	 = getNormal(ray, closest);
-			if (rayExit < 0.f) 
+			isect->Exists		= true;
+			isect->Distance = distance;
+			// Ray starts inside the shape
+			if (rayExit < 0.f)
 			{
-				res.InsideIntervals.push_back(Span(0.f, closest));
-				res.Dst.insert(res.Dst.begin(), 0.f);
+				shapeHits.add(0.f, true);
 			}
-			else
+			if (hits)
 			{
-				res.InsideIntervals.push_back(Span(closest, rayExit));
+				hits->append(shapeHits);
 			}
-			return res;
+			return true;
 		}
 
-		return CIsect(false);
+		return false;
 	}
 
-	float axisToOrg		= dot(mAxis, origin);
-	//root = (dot(mAxis, mBottom) - axisToOrg) / axisToDir;
-	float CODotAxis = dot(CO, mAxis);
+	float axisToOrg		= dot(Axis, origin);
+	//root = (dot(Axis, Bottom) - axisToOrg) / axisToDir;
+	float CODotAxis = dot(CO, Axis);
 	root = -CODotAxis / axisToDir;
 	if (root > 0.f)
 	{
-		Vec3D toBottom = ray.apply(root) - mBottom;
-		if (dot(toBottom, toBottom) < mRadius2)
+		Vec3D toBottom = ray.apply(root) - Bottom;
+		if (dot(toBottom, toBottom) < Radius2)
 		{
-			res.Dst.push_back(root);
+			// Caps face away from each other along the axis
+			shapeHits.add(root, axisToDir > 0.f);
 			// Awful copy paste :(
 			if (closest < 0.f)
 			{
@@ -157,16 +162,16 @@ CIsect Cylinder::intersect(const Ray& ray)
 		}
 	}
 	// Top one
-	//root = (dot(mAxis, mTop) - axisToOrg) / axisToDir;
-	float CTDotAxis = dot(origin - mTop, -mAxis);
+	//root = (dot(Axis, Top) - axisToOrg) / axisToDir;
+	float CTDotAxis = dot(origin - Top, -Axis);
 	root = CTDotAxis / axisToDir;
 	if (root > 0.f)
 	{
 		// Awful copy paste :(
-		Vec3D toTop = ray.apply(root) - mTop;
-		if (dot(toTop, toTop) < mRadius2)
+		Vec3D toTop = ray.apply(root) - Top;
+		if (dot(toTop, toTop) < Radius2)
 		{
-			res.Dst.push_back(root);
+			shapeHits.add(root, axisToDir < 0.f);
 			if (closest < 0.f)
 			{
 				closest = root;
@@ -183,23 +188,34 @@ CIsect Cylinder::intersect(const Ray& ray)
 		}
 	}
 	
-	if (closest >= 0.f)
+	// Entry may be out of the ray interval, then the exit is the closest hit
+	const float distance = ray.contains(closest) ? closest : rayExit;
+	if (ray.contains(distance))
 	{
-		res.Distance = closest;
-		res.Object   = this;
-		res.Normal	 = getNormal(ray, closest);
-		if (rayExit < 0.f) 
+		isect->Exists		= true;
+		isect->Distance = distance;
+		// Ray starts inside the shape
+		if (rayExit < 0.f)
 		{
-			res.InsideIntervals.push_back(Span(0.f, closest));
-			res.Dst.insert(res.Dst.begin(), 0.f);
+			shapeHits.add(0.f, true);
 		}
-		else
+		if (hits)
 		{
-			res.InsideIntervals.push_back(Span(closest, rayExit));
+			hits->append(shapeHits);
 		}
-		return res;
+		return true;
+	}
+  return false;
+}
+
+CIsect Cylinder::intersect(const Ray& ray, HitBuffer* hits)
+{
+	CIsect res(false);
+	if (mGeometry.intersect(ray, &res, hits))
+	{
+		res.Object = this;
 	}
-  return CIsect(false);
+	return res;
 }
 
 Vec3D Cylinder::getNormal(const Ray& ray, float distance, const CIsect& isect /*= CIsect()*/) const
@@ -207,18 +223,18 @@ Vec3D Cylinder::getNormal(const Ray& ray, float distance, const CIsect& isect /*
 	const Vec3D atSurface = ray.apply(distance);
   // Check, whether pnt is lying on caps
 	// Bottom
-	const Vec3D& toBottom = atSurface - mBottom;
-	if (fabs(dot(mAxis, toBottom)) < FLOAT_ZERO && dot(toBottom, toBottom) < mRadius2)
+	const Vec3D& toBottom = atSurface - mGeometry.Bottom;
+	if (fabs(dot(mGeometry.Axis, toBottom)) < FLOAT_ZERO && dot(toBottom, toBottom) < mGeometry.Radius2)
 	{
-		return -mAxis;
+		return -mGeometry.Axis;
 	}
-	const Vec3D& toTop = atSurface - mTop;
-	if (fabs(dot(mAxis, toTop)) < FLOAT_ZERO && dot(toTop, toTop) < mRadius2)
+	const Vec3D& toTop = atSurface - mGeometry.Top;
+	if (fabs(dot(mGeometry.Axis, toTop)) < FLOAT_ZERO && dot(toTop, toTop) < mGeometry.Radius2)
 	{
-		return mAxis;
+		return mGeometry.Axis;
 	}
     
-	return (atSurface - mAxis * dot(toBottom, mAxis) - mBottom).toUnit();
+	return (atSurface - mGeometry.Axis * dot(toBottom, mGeometry.Axis) - mGeometry.Bottom).toUnit();
 }
 
 Color Cylinder::getAmbColor(const Vec3D& pnt, const CIsect& isect/* = CIsect()*/) const
@@ -244,20 +260,35 @@ Color Cylinder::getSpcColor(const Vec3D& pnt, const CIsect& isect/* = CIsect()*/
 Vec3D Cylinder::getTexCoords(const Vec3D& pnt, const CIsect& isect /*= CIsect()*/) const
 {
 	// Get position of pnt on the surface of the cylinder
-	const Vec3D CO = pnt - mBottom;
+	const Vec3D CO = pnt - mGeometry.Bottom;
 
-	float CODotAxis = dot(CO, mAxis);
+	float CODotAxis = dot(CO, mGeometry.Axis);
 
-	Vec3D atCircle = pnt - CODotAxis * mAxis - mBottom;
+	Vec3D atCircle = pnt - CODotAxis * mGeometry.Axis - mGeometry.Bottom;
 	float		 x			  = dot(atCircle, mVe);
 	float		 z				= dot(atCircle, mVn);
 
 	float u = atan2(x, z) / (2 * M_PI);
 
 	// v coordinate is the projection of the pnt on axis, mapped to [0..1]
-	const float height = length(mTop - mBottom);
+	const float height = length(mGeometry.Top - mGeometry.Bottom);
 
 	float v = CODotAxis / height;
 
 	return Vec3D(u, v, 0.f);
-}
\ No newline at end of file
+}
+
+BBox Cylinder::getBBox() const
+{
+	// Caps are discs, perpendicular to the axis, so disc extent along each world axis is radius * sin(angle to the axis)
+	const Vec3D capExtent(mRadius * sqrtf(std::max(0.f, 1.f - mGeometry.Axis.x() * mGeometry.Axis.x())),
+												mRadius * sqrtf(std::max(0.f, 1.f - mGeometry.Axis.y() * mGeometry.Axis.y())),
+												mRadius * sqrtf(std::max(0.f, 1.f - mGeometry.Axis.z() * mGeometry.Axis.z())));
+
+	BBox box = BBox::Empty();
+	box.extend(mGeometry.Bottom - capExtent);
+	box.extend(mGeometry.Bottom + capExtent);
+	box.extend(mGeometry.Top - capExtent);
+	box.extend(mGeometry.Top + capExtent);
+	return box;
+}
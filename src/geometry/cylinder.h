@@ -5,12 +5,22 @@
 #include "geometry/ray.h"
 #include "geometry/vector3d.h"
 
+// Data of the cylinder, which is enough to intersect it, compiled scene keeps it in contiguous arrays
+struct CylinderGeometry
+{
+	//! Find closest hit inside of the ray interval, distances of all the hits are added to the buffer, if it's given
+	bool intersect(const Ray& ray, CIsect* isect, HitBuffer* hits = NULL) const;
+
+	Vec3D Bottom, Top, Axis;
+	float Radius2;
+};
+
 class Cylinder : public IShape
 {
 public:
   Cylinder(const Vec3D& top, const Vec3D& bottom, float radius, Mtrl* material);
   virtual ~Cylinder();
-  virtual CIsect intersect(const Ray& ray);
+  virtual CIsect intersect(const Ray& ray, HitBuffer* hits = NULL);
   virtual const Mtrl* getMtrl() const
   {
     return mMtrl;
@@ -28,9 +38,15 @@ public:
 	virtual Color getDifColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
 	virtual Color getSpcColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
 	virtual Vec3D getTexCoords(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
+	virtual BBox getBBox() const;
+	const CylinderGeometry& getGeometry() const
+	{
+		return mGeometry;
+	}
 private:
-  Vec3D	mBottom, mTop, mAxis, mVe, mVn;
-  float mRadius, mRadius2;
+  CylinderGeometry mGeometry;
+  Vec3D	mVe, mVn;
+  float mRadius;
   Mtrl* mMtrl;
   bool	mIsLight;
 };
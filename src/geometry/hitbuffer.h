@@ -0,0 +1,158 @@
+#ifndef GEOMETRY_HITBUFFER_H
+#define GEOMETRY_HITBUFFER_H
+
+#include <algorithm>
+#include <vector>
+
+#define HIT_BUFFER_SIZE 16
+
+// Hit of the ray with the surface, it's an entry into the solid if the surface faces the ray
+struct SurfaceHit
+{
+	float Distance;
+	bool	Entry;
+};
+
+// Sorted hits of the ray with the shape, which are needed by CSG operations only. Each hit knows, whether the ray
+// enters or exits the solid there, so tangent hits and hits of edges, which are shared by faces, don't break pairing.
+// First hits are stored inline, so buffers can live on the stack without heap allocations.
+// Hits are never dropped: if the inline storage is full, all the hits are moved to the heap,
+// e.g. for meshes, which are crossed by the ray many times
+class HitBuffer
+{
+public:
+	HitBuffer()
+		: mHits(mInline),
+			mCount(0)
+	{
+	}
+
+	HitBuffer(const HitBuffer& hits)
+		: mHits(mInline),
+			mCount(0)
+	{
+		append(hits);
+	}
+
+	HitBuffer& operator=(const HitBuffer& hits)
+	{
+		if (this != &hits)
+		{
+			clear();
+			append(hits);
+		}
+		return *this;
+	}
+
+	//! Spilled storage is kept, so the buffer, which is reused, allocates only once
+	void clear()
+	{
+		mSpilled.clear();
+		mHits	 = mInline;
+		mCount = 0;
+	}
+
+	bool isEmpty() const
+	{
+		return mCount == 0;
+	}
+
+	unsigned size() const
+	{
+		return mCount;
+	}
+
+	float operator[](unsigned idx) const
+	{
+		return mHits[idx].Distance;
+	}
+
+	//! Check if the ray enters the solid at the hit, otherwise it exits
+	bool isEntry(unsigned idx) const
+	{
+		return mHits[idx].Entry;
+	}
+
+	//! Get nearest hit, buffer mustn't be empty
+	float front() const
+	{
+		return mHits[0].Distance;
+	}
+
+	//! Get furthest hit, buffer mustn't be empty
+	float back() const
+	{
+		return mHits[mCount - 1].Distance;
+	}
+
+	//! Check if the same distance has been already added
+	bool contains(float distance) const
+	{
+		for (unsigned idx = 0; idx < mCount; ++idx)
+		{
+			if (mHits[idx].Distance == distance)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//! Insert hit, keeping hits sorted by distance. Entries go before exits at the same distance,
+	//! so the ray, which touches the solid, enters and exits it at once
+	void add(float distance, bool entry)
+	{
+		const SurfaceHit hit = { distance, entry };
+		if (mCount == HIT_BUFFER_SIZE && mHits == mInline)
+		{
+			mSpilled.assign(mInline, mInline + mCount);
+			mHits = mSpilled.data();
+		}
+		if (mHits != mInline)
+		{
+			mSpilled.insert(std::upper_bound(mSpilled.begin(), mSpilled.end(), hit, isBefore), hit);
+			mHits = mSpilled.data();
+			++mCount;
+			return;
+		}
+
+		unsigned idx = mCount++;
+		for (; idx > 0 && isBefore(hit, mHits[idx - 1]); --idx)
+		{
+			mHits[idx] = mHits[idx - 1];
+		}
+		mHits[idx] = hit;
+	}
+
+	void append(const HitBuffer& hits)
+	{
+		for (unsigned idx = 0; idx < hits.mCount; ++idx)
+		{
+			add(hits.mHits[idx].Distance, hits.mHits[idx].Entry);
+		}
+	}
+
+	//! Multiply all the distances, e.g. to convert them to another space
+	void scale(float factor)
+	{
+		for (unsigned idx = 0; idx < mCount; ++idx)
+		{
+			mHits[idx].Distance *= factor;
+		}
+	}
+
+private:
+	static bool isBefore(const SurfaceHit& lh, const SurfaceHit& rh)
+	{
+		return lh.Distance < rh.Distance || (lh.Distance == rh.Distance && lh.Entry && !rh.Entry);
+	}
+
+private:
+	SurfaceHit								mInline[HIT_BUFFER_SIZE];
+	// Hits of the buffer, which outgrew the inline storage
+	std::vector< SurfaceHit > mSpilled;
+	SurfaceHit*								mHits;
+	unsigned									mCount;
+};
+
+#endif
@@ -1,29 +1,57 @@
 #ifndef GEOMETRY_INTERSECTION_H
 #define GEOMETRY_INTERSECTION_H
 
-#include <vector>
-	
-#include "span.h"
 #include "vector3d.h"
 
 struct IShape;
 
+// Primitives are grouped by these types in contiguous arrays of the compiled scene
+enum PrimitiveType
+{
+	PRIMITIVE_SPHERE,
+	PRIMITIVE_PLANE,
+	PRIMITIVE_BOX,
+	PRIMITIVE_CYLINDER,
+	PRIMITIVE_CONE,
+	PRIMITIVE_TORUS,
+	PRIMITIVE_TRIANGLE,
+	// Models, CSG trees and other shapes, which are intersected through IShape
+	PRIMITIVE_SHAPE,
+	PRIMITIVE_TYPES_COUNT
+};
+
+// Reference to the primitive of the compiled scene: its type and index in the array of this type
+struct PrimitiveHandle
+{
+	unsigned Type	: 4;
+	unsigned Index : 28;
+};
+
 struct CIsect
 {
-	explicit CIsect(bool hit = false, float dist = -1.f, IShape *object = 0x0, const Vec3D& normal = Vec3D())
+	explicit CIsect(bool hit = false, float dist = -1.f, IShape *object = 0x0)
 		: Exists(hit),
 			Distance(dist),
 			Object(object),
-			Normal(normal)
+			PrimId(0),
+			FlipNormal(false)
 	{
+		Handle.Type	 = PRIMITIVE_SHAPE;
+		Handle.Index = 0;
 	}
 
 	bool		 Exists;
 	IShape  *Object;
-	Vec3D Normal, TexCoords;
+	// Shading normal is evaluated only for the closest hit, after the intersection is found
+	Vec3D Normal;
+	// Barycentric coordinates and index of the hit primitive inside of the object,
+	// object uses them to interpolate normal and texture coordinates later
 	float	U, V, Distance;
-  std::vector< float > Dst;
-	Spans InsideIntervals;
+	unsigned PrimId;
+	// Normal must be negated, e.g. hit belongs to negative object of CSG difference
+	bool		 FlipNormal;
+	// Hit primitive of the compiled scene, object pointer is resolved from it only for the closest hit
+	PrimitiveHandle Handle;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,610 @@
+//-------------------------------------------------------------------
+// File: linearbvh.cpp
+//
+// Linear bounding volume hierarchy builder
+//			 Radix tree is emitted as in "Maximizing Parallelism in the Construction of BVHs, Octrees, and k-d Trees" by Karras,
+//			 treelets are restructured as in "Fast Parallel Construction of High-Quality Bounding Volume Hierarchies" by Karras and Aila
+//
+//
+//-------------------------------------------------------------------
+
+#include <atomic>
+#include <cfloat>
+
+#include "bvhbuild.h"
+#include "parallel.h"
+
+#include "linearbvh.h"
+
+namespace
+{
+	static const float		cTraversalCost		 = BVH_TRAVERSAL_COST;
+	static const float		cIntersectionCost	 = BVH_INTERSECTION_COST;
+	// Deeper subtrees are rebalanced to keep traversal stack bounded
+	static const unsigned cMaxDepth					 = BVH_STACK_SIZE / 2;
+	// 10 bits per axis are enough to separate centroids of smaller sets, larger ones get 21 bits per axis
+	static const unsigned cMaxShortCodesCount = 1 << 20;
+	static const unsigned cRadixBits				 = 8;
+	static const unsigned cRadixBuckets			 = 1 << cRadixBits;
+	// Leaves of the restructured treelet, every topology of them is checked
+	static const unsigned cTreeletSize			 = 5;
+	static const unsigned cTreeletSubsets		 = 1 << cTreeletSize;
+	static const unsigned cNoNode						 = ~0u;
+
+	//! Interleave 21 lower bits of the value with two zero bits each
+	unsigned long long GExpandBits(unsigned long long value)
+	{
+		value &= 0x1fffff;
+		value = (value | value << 32) & 0x1f00000000ffffull;
+		value = (value | value << 16) & 0x1f0000ff0000ffull;
+		value = (value | value << 8)	& 0x100f00f00f00f00full;
+		value = (value | value << 4)	& 0x10c30c30c30c30c3ull;
+		value = (value | value << 2)	& 0x1249249249249249ull;
+		return value;
+	}
+
+	//! Count leading zero bits of non-zero value
+	int GLeadingZeros(unsigned long long value)
+	{
+		int zeros = 0;
+		for (int shift = 32; shift > 0; shift /= 2)
+		{
+			if ((value >> (64 - shift)) == 0)
+			{
+				zeros += shift;
+				value <<= shift;
+			}
+		}
+		return zeros;
+	}
+
+	//! Get index of the lowest set bit of non-zero value
+	unsigned GLowestBit(unsigned value)
+	{
+		unsigned bit = 0;
+		while ((value & (1u << bit)) == 0)
+		{
+			++bit;
+		}
+		return bit;
+	}
+
+	unsigned GBitsCount(unsigned value)
+	{
+		unsigned count = 0;
+		for (; value != 0; value &= value - 1)
+		{
+			++count;
+		}
+		return count;
+	}
+}
+
+LinearBVHBuilder::LinearBVHBuilder(unsigned maxLeafSize, unsigned blockSize, unsigned threadsCount)
+	: mMaxLeafSize(maxLeafSize),
+		mBlockSize(blockSize),
+		mThreadsCount(threadsCount),
+		mBounds(NULL),
+		mLeavesBegin(0),
+		mRoot(0),
+		mNodes(NULL),
+		mIndices(NULL)
+{
+}
+
+void LinearBVHBuilder::build(const std::vector< BBox >& bounds, bool optimizeTreelets, std::vector< BVHNode >* nodes, std::vector< unsigned >* indices)
+{
+	const unsigned count = bounds.size();
+
+	mBounds	= &bounds;
+	mNodes	 = nodes;
+	mIndices = indices;
+
+	nodes->reserve(2 * count - 1);
+	indices->reserve(count);
+
+	if (count == 1)
+	{
+		BVHNode leaf;
+		leaf.Bounds = bounds[0];
+		leaf.Offset = 0;
+		leaf.Count	= 1;
+		leaf.Axis		= 0;
+		nodes->push_back(leaf);
+		indices->push_back(0);
+		return;
+	}
+
+	sortPrimitives(bounds);
+	emitInnerNodes();
+	propagateBounds(optimizeTreelets);
+	flatten(mRoot, 0);
+}
+
+void LinearBVHBuilder::sortPrimitives(const std::vector< BBox >& bounds)
+{
+	const unsigned count				= bounds.size();
+	const unsigned threadsCount = std::min(mThreadsCount, count);
+
+	std::vector< BBox > parts(threadsCount, BBox::Empty());
+	ParallelFor(count, threadsCount, [&](unsigned thread, unsigned first, unsigned last)
+	{
+		for (unsigned idx = first; idx < last; ++idx)
+		{
+			parts[thread].extend(bounds[idx].getCentroid());
+		}
+	});
+
+	BBox centroids = BBox::Empty();
+	for (unsigned thread = 0; thread < threadsCount; ++thread)
+	{
+		centroids.extend(parts[thread]);
+	}
+
+	// Centroids are quantized to the grid over their bounds
+	const unsigned bitsPerAxis = count <= cMaxShortCodesCount ? 10 : 21;
+	const float		 cellsCount	 = static_cast< float >((1u << bitsPerAxis) - 1);
+	const Vec3D		 extent			 = centroids.Max - centroids.Min;
+
+	float scale[3];
+	for (unsigned axis = 0; axis < 3; ++axis)
+	{
+		scale[axis] = BVHAxisValue(extent, axis) > 0.f ? cellsCount / BVHAxisValue(extent, axis) : 0.f;
+	}
+
+	std::vector< unsigned long long > codes(count);
+	std::vector< unsigned >						primitives(count);
+	ParallelFor(count, threadsCount, [&](unsigned /*thread*/, unsigned first, unsigned last)
+	{
+		for (unsigned idx = first; idx < last; ++idx)
+		{
+			const Vec3D centroid = bounds[idx].getCentroid();
+
+			unsigned long long code = 0;
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				const float cell = (BVHAxisValue(centroid, axis) - BVHAxisValue(centroids.Min, axis)) * scale[axis];
+				code |= GExpandBits(static_cast< unsigned long long >(std::min(std::max(cell, 0.f), cellsCount))) << (2 - axis);
+			}
+
+			codes[idx]			= code;
+			primitives[idx] = idx;
+		}
+	});
+
+	// Stable LSD radix sort, every thread counts and then scatters its own part of keys
+	mCodes.resize(count);
+	mPrimitives.resize(count);
+
+	std::vector< unsigned > offsets(threadsCount * cRadixBuckets);
+	for (unsigned shift = 0; shift < 3 * bitsPerAxis; shift += cRadixBits)
+	{
+		std::fill(offsets.begin(), offsets.end(), 0);
+		ParallelFor(count, threadsCount, [&](unsigned thread, unsigned first, unsigned last)
+		{
+			unsigned* histogram = &offsets[thread * cRadixBuckets];
+			for (unsigned idx = first; idx < last; ++idx)
+			{
+				++histogram[(codes[idx] >> shift) & (cRadixBuckets - 1)];
+			}
+		});
+
+		// Bucket parts of threads follow each other, so order of equal keys is kept
+		unsigned sum = 0;
+		for (unsigned bucket = 0; bucket < cRadixBuckets; ++bucket)
+		{
+			for (unsigned thread = 0; thread < threadsCount; ++thread)
+			{
+				const unsigned bucketCount = offsets[thread * cRadixBuckets + bucket];
+				offsets[thread * cRadixBuckets + bucket] = sum;
+				sum += bucketCount;
+			}
+		}
+
+		ParallelFor(count, threadsCount, [&](unsigned thread, unsigned first, unsigned last)
+		{
+			unsigned* bucketOffsets = &offsets[thread * cRadixBuckets];
+			for (unsigned idx = first; idx < last; ++idx)
+			{
+				const unsigned target = bucketOffsets[(codes[idx] >> shift) & (cRadixBuckets - 1)]++;
+				mCodes[target]			 = codes[idx];
+				mPrimitives[target] = primitives[idx];
+			}
+		});
+
+		codes.swap(mCodes);
+		primitives.swap(mPrimitives);
+	}
+
+	mCodes.swap(codes);
+	mPrimitives.swap(primitives);
+}
+
+int LinearBVHBuilder::getCommonPrefix(int first, int second) const
+{
+	if (second < 0 || second >= static_cast< int >(mPrimitives.size()))
+	{
+		return -1;
+	}
+
+	// Equal codes are told apart by positions of primitives
+	const unsigned long long difference = mCodes[first] ^ mCodes[second];
+	if (difference == 0)
+	{
+		return 64 + GLeadingZeros(static_cast< unsigned long long >(first ^ second) << 32);
+	}
+	return GLeadingZeros(difference);
+}
+
+void LinearBVHBuilder::emitInnerNodes()
+{
+	const unsigned count = mPrimitives.size();
+
+	mLeavesBegin = count - 1;
+	mRoot				 = 0;
+	mTree.resize(2 * count - 1);
+	mTree[mRoot].Parent = cNoNode;
+
+	// Every inner node covers a range of sorted primitives, one end of the range is the node index,
+	// and the split is where the common prefix of the range codes ends
+	ParallelFor(count - 1, mThreadsCount, [&](unsigned /*thread*/, unsigned first, unsigned last)
+	{
+		for (int node = first; node < static_cast< int >(last); ++node)
+		{
+			const int direction = getCommonPrefix(node, node + 1) > getCommonPrefix(node, node - 1) ? 1 : -1;
+			const int minPrefix = getCommonPrefix(node, node - direction);
+
+			int maxLength = 2;
+			while (getCommonPrefix(node, node + maxLength * direction) > minPrefix)
+			{
+				maxLength *= 2;
+			}
+
+			int length = 0;
+			for (int step = maxLength / 2; step >= 1; step /= 2)
+			{
+				if (getCommonPrefix(node, node + (length + step) * direction) > minPrefix)
+				{
+					length += step;
+				}
+			}
+
+			const int other			 = node + length * direction;
+			const int nodePrefix = getCommonPrefix(node, other);
+
+			int split = 0;
+			int step	= length;
+			do
+			{
+				step = (step + 1) / 2;
+				if (getCommonPrefix(node, node + (split + step) * direction) > nodePrefix)
+				{
+					split += step;
+				}
+			}
+			while (step > 1);
+
+			const int			 middle = node + split * direction + std::min(direction, 0);
+			const unsigned left		= std::min(node, other) == middle ? mLeavesBegin + middle : middle;
+			const unsigned right	= std::max(node, other) == middle + 1 ? mLeavesBegin + middle + 1 : middle + 1;
+
+			mTree[node].Children[0] = left;
+			mTree[node].Children[1] = right;
+			mTree[left].Parent			= node;
+			mTree[right].Parent			= node;
+		}
+	});
+}
+
+float LinearBVHBuilder::getCost(const BBox& bounds, unsigned count, float childrenCost) const
+{
+	const float area = bounds.getSurfaceArea();
+	const float cost = cTraversalCost * area + childrenCost;
+	if (count > mMaxLeafSize)
+	{
+		return cost;
+	}
+	return std::min(cost, cIntersectionCost * BVHBlocksCount(count, mBlockSize) * area);
+}
+
+bool LinearBVHBuilder::isCollapsed(unsigned node) const
+{
+	const RadixNode& current = mTree[node];
+	return isLeaf(node) ||
+		(current.Count <= mMaxLeafSize && cIntersectionCost * BVHBlocksCount(current.Count, mBlockSize) * current.Bounds.getSurfaceArea() <= current.Cost);
+}
+
+void LinearBVHBuilder::propagateBounds(bool optimizeTreelets)
+{
+	const unsigned count = mPrimitives.size();
+
+	// Inner node is finished by the thread, which finished the second of its children, so both are ready
+	std::vector< std::atomic< unsigned > > visits(count - 1);
+	ParallelFor(count - 1, mThreadsCount, [&](unsigned /*thread*/, unsigned first, unsigned last)
+	{
+		for (unsigned node = first; node < last; ++node)
+		{
+			visits[node].store(0, std::memory_order_relaxed);
+		}
+	});
+
+	ParallelFor(count, mThreadsCount, [&](unsigned /*thread*/, unsigned first, unsigned last)
+	{
+		for (unsigned primitive = first; primitive < last; ++primitive)
+		{
+			RadixNode& leaf = mTree[mLeavesBegin + primitive];
+			leaf.Bounds			= (*mBounds)[mPrimitives[primitive]];
+			leaf.Count			= 1;
+			leaf.Cost				= cIntersectionCost * leaf.Bounds.getSurfaceArea();
+		}
+	});
+
+	ParallelFor(count, mThreadsCount, [&](unsigned /*thread*/, unsigned first, unsigned last)
+	{
+		for (unsigned primitive = first; primitive < last; ++primitive)
+		{
+			for (unsigned node = mTree[mLeavesBegin + primitive].Parent; node != cNoNode; node = mTree[node].Parent)
+			{
+				if (visits[node].fetch_add(1, std::memory_order_acq_rel) == 0)
+				{
+					break;
+				}
+
+				RadixNode&			 current = mTree[node];
+				const RadixNode& left		 = mTree[current.Children[0]];
+				const RadixNode& right	 = mTree[current.Children[1]];
+
+				current.Bounds = left.Bounds;
+				current.Bounds.extend(right.Bounds);
+				current.Count = left.Count + right.Count;
+				current.Cost	= getCost(current.Bounds, current.Count, left.Cost + right.Cost);
+
+				if (optimizeTreelets && current.Count >= cTreeletSize)
+				{
+					optimizeTreelet(node);
+				}
+			}
+		}
+	});
+}
+
+void LinearBVHBuilder::optimizeTreelet(unsigned root)
+{
+	// Treelet grows from the root by expanding its largest leaf
+	unsigned leaves[cTreeletSize];
+	unsigned inner[cTreeletSize - 1];
+	unsigned leavesCount = 2;
+	unsigned innerCount	 = 1;
+
+	leaves[0] = mTree[root].Children[0];
+	leaves[1] = mTree[root].Children[1];
+	inner[0]	= root;
+
+	while (leavesCount < cTreeletSize)
+	{
+		int		best		 = -1;
+		float bestArea = -1.f;
+		for (unsigned leaf = 0; leaf < leavesCount; ++leaf)
+		{
+			const float area = mTree[leaves[leaf]].Bounds.getSurfaceArea();
+			if (!isLeaf(leaves[leaf]) && area > bestArea)
+			{
+				best		 = leaf;
+				bestArea = area;
+			}
+		}
+		if (best < 0)
+		{
+			break;
+		}
+
+		const unsigned expanded = leaves[best];
+		inner[innerCount++]			= expanded;
+		leaves[best]						= mTree[expanded].Children[0];
+		leaves[leavesCount++]		= mTree[expanded].Children[1];
+	}
+
+	if (leavesCount < 3)
+	{
+		// Two leaves have only one topology
+		return;
+	}
+
+	// Find optimal subtree for every subset of treelet leaves, smaller subsets go first
+	BBox					bounds[cTreeletSubsets];
+	unsigned			counts[cTreeletSubsets];
+	float					costs[cTreeletSubsets];
+	unsigned char splits[cTreeletSubsets];
+
+	const unsigned subsetsCount = 1 << leavesCount;
+	for (unsigned subset = 1; subset < subsetsCount; ++subset)
+	{
+		const unsigned lowest	 = subset & (0u - subset);
+		const RadixNode& leaf = mTree[leaves[GLowestBit(subset)]];
+		if (subset == lowest)
+		{
+			bounds[subset] = leaf.Bounds;
+			counts[subset] = leaf.Count;
+			costs[subset]	 = leaf.Cost;
+			continue;
+		}
+
+		bounds[subset] = bounds[subset ^ lowest];
+		bounds[subset].extend(leaf.Bounds);
+		counts[subset] = counts[subset ^ lowest] + leaf.Count;
+	}
+
+	for (unsigned size = 2; size <= leavesCount; ++size)
+	{
+		for (unsigned subset = 1; subset < subsetsCount; ++subset)
+		{
+			if (GBitsCount(subset) != size)
+			{
+				continue;
+			}
+
+			// Each partition is checked once, its first part keeps the lowest leaf
+			const unsigned lowest = subset & (0u - subset);
+
+			float		 bestCost = FLT_MAX;
+			unsigned bestPart = lowest;
+			for (unsigned part = (subset - 1) & subset; part > 0; part = (part - 1) & subset)
+			{
+				if ((part & lowest) != 0 && costs[part] + costs[subset ^ part] < bestCost)
+				{
+					bestCost = costs[part] + costs[subset ^ part];
+					bestPart = part;
+				}
+			}
+
+			costs[subset]	 = getCost(bounds[subset], counts[subset], bestCost);
+			splits[subset] = static_cast< unsigned char >(bestPart);
+		}
+	}
+
+	const unsigned all = subsetsCount - 1;
+	if (costs[all] >= mTree[root].Cost)
+	{
+		return;
+	}
+
+	// Rebuild the treelet, reusing its inner nodes, root keeps its place and parent
+	unsigned stackSubsets[cTreeletSize];
+	unsigned stackNodes[cTreeletSize];
+	unsigned stackSize = 0;
+	unsigned nextInner = 1;
+
+	stackSubsets[stackSize] = all;
+	stackNodes[stackSize++] = root;
+	while (stackSize > 0)
+	{
+		--stackSize;
+		const unsigned subset = stackSubsets[stackSize];
+		const unsigned node		= stackNodes[stackSize];
+		const unsigned parts[2] = { splits[subset], subset ^ splits[subset] };
+
+		RadixNode& current = mTree[node];
+		current.Bounds		 = bounds[subset];
+		current.Count			 = counts[subset];
+		current.Cost			 = costs[subset];
+
+		for (unsigned child = 0; child < 2; ++child)
+		{
+			unsigned childNode;
+			if (GBitsCount(parts[child]) == 1)
+			{
+				childNode = leaves[GLowestBit(parts[child])];
+			}
+			else
+			{
+				childNode									= inner[nextInner++];
+				stackSubsets[stackSize] = parts[child];
+				stackNodes[stackSize++] = childNode;
+			}
+
+			current.Children[child] = childNode;
+			mTree[childNode].Parent = node;
+		}
+	}
+}
+
+void LinearBVHBuilder::gatherPrimitives(unsigned node)
+{
+	if (isLeaf(node))
+	{
+		mIndices->push_back(mPrimitives[node - mLeavesBegin]);
+		return;
+	}
+	gatherPrimitives(mTree[node].Children[0]);
+	gatherPrimitives(mTree[node].Children[1]);
+}
+
+unsigned LinearBVHBuilder::flatten(unsigned node, unsigned depth)
+{
+	const RadixNode& current = mTree[node];
+	if (depth >= cMaxDepth && !isCollapsed(node))
+	{
+		const unsigned begin = mIndices->size();
+		gatherPrimitives(node);
+		return flattenBalanced(begin, mIndices->size(), depth);
+	}
+
+	const unsigned nodeIdx = mNodes->size();
+	mNodes->push_back(BVHNode());
+	(*mNodes)[nodeIdx].Bounds = current.Bounds;
+
+	if (isCollapsed(node))
+	{
+		(*mNodes)[nodeIdx].Offset = mIndices->size();
+		(*mNodes)[nodeIdx].Count	= current.Count;
+		(*mNodes)[nodeIdx].Axis		= 0;
+		gatherPrimitives(node);
+		return nodeIdx;
+	}
+
+	// Traversal visits the first child first along positive directions, so it must be the lower one
+	unsigned		first	 = current.Children[0];
+	unsigned		second = current.Children[1];
+	const Vec3D offset = mTree[second].Bounds.getCentroid() - mTree[first].Bounds.getCentroid();
+	const Vec3D spread = offset.absolute();
+
+	unsigned axis = 0;
+	if (spread.y() > BVHAxisValue(spread, axis))
+		axis = 1;
+	if (spread.z() > BVHAxisValue(spread, axis))
+		axis = 2;
+	if (BVHAxisValue(offset, axis) < 0.f)
+	{
+		std::swap(first, second);
+	}
+
+	flatten(first, depth + 1);
+	const unsigned secondChild = flatten(second, depth + 1);
+
+	(*mNodes)[nodeIdx].Offset = secondChild;
+	(*mNodes)[nodeIdx].Count	= 0;
+	(*mNodes)[nodeIdx].Axis		= axis;
+
+	return nodeIdx;
+}
+
+unsigned LinearBVHBuilder::flattenBalanced(unsigned begin, unsigned end, unsigned depth)
+{
+	const unsigned nodeIdx = mNodes->size();
+	mNodes->push_back(BVHNode());
+
+	BBox bounds = BBox::Empty();
+	for (unsigned idx = begin; idx < end; ++idx)
+	{
+		bounds.extend((*mBounds)[(*mIndices)[idx]]);
+	}
+	(*mNodes)[nodeIdx].Bounds = bounds;
+
+	if (end - begin <= mMaxLeafSize)
+	{
+		(*mNodes)[nodeIdx].Offset = begin;
+		(*mNodes)[nodeIdx].Count	= end - begin;
+		(*mNodes)[nodeIdx].Axis		= 0;
+		return nodeIdx;
+	}
+
+	// Primitives are in order of Morton codes, so halves are compact
+	const unsigned middle = begin + (end - begin) / 2;
+
+	flattenBalanced(begin, middle, depth + 1);
+	const unsigned secondChild = flattenBalanced(middle, end, depth + 1);
+
+	const Vec3D offset = (*mNodes)[secondChild].Bounds.getCentroid() - (*mNodes)[nodeIdx + 1].Bounds.getCentroid();
+
+	unsigned axis = 0;
+	if (offset.y() > BVHAxisValue(offset, axis))
+		axis = 1;
+	if (offset.z() > BVHAxisValue(offset, axis))
+		axis = 2;
+
+	(*mNodes)[nodeIdx].Offset = secondChild;
+	(*mNodes)[nodeIdx].Count	= 0;
+	(*mNodes)[nodeIdx].Axis		= axis;
+
+	return nodeIdx;
+}
@@ -0,0 +1,88 @@
+#ifndef GEOMETRY_LINEARBVH_H
+#define GEOMETRY_LINEARBVH_H
+
+#include <vector>
+
+#include "geometry/bbox.h"
+#include "geometry/bvh.h"
+
+// Builder of linear bounding volume hierarchy. Primitives are sorted by Morton codes of their centroids
+// and all the inner nodes are emitted at once from the sorted codes, so build takes linear time and
+// runs in parallel. Optionally small treelets are restructured to minimize SAH cost
+class LinearBVHBuilder
+{
+public:
+	//! Builder uses up to threadsCount threads, it must be greater than zero
+	LinearBVHBuilder(unsigned maxLeafSize, unsigned blockSize, unsigned threadsCount);
+
+	//! Build nodes of the hierarchy in depth-first order and indices of primitives, referenced by leaves
+	void build(const std::vector< BBox >& bounds, bool optimizeTreelets, std::vector< BVHNode >* nodes, std::vector< unsigned >* indices);
+
+private:
+	// Node of the binary radix tree: inner nodes go first, then leaves with one primitive each in order of Morton codes
+	struct RadixNode
+	{
+		BBox		 Bounds;
+		unsigned Children[2];
+		unsigned Parent;
+		unsigned Count; // Primitives count in the subtree
+		float		 Cost;	// SAH cost of the subtree, not normalized by the root area
+	};
+
+	//! Compute Morton codes of centroids and sort primitives by them
+	void sortPrimitives(const std::vector< BBox >& bounds);
+
+	//! Find children of every inner node from the sorted codes
+	void emitInnerNodes();
+
+	//! Compute bounds and costs of inner nodes from leaves to root, optionally restructuring treelets on the way
+	void propagateBounds(bool optimizeTreelets);
+
+	//! Find cost of the inner node with given bounds, count and children costs, collapsed subtree is counted as a leaf
+	float getCost(const BBox& bounds, unsigned count, float childrenCost) const;
+
+	//! Restructure treelet below the inner node, which minimizes SAH cost of the treelet
+	void optimizeTreelet(unsigned root);
+
+	//! Check if subtree should be stored as one leaf
+	bool isCollapsed(unsigned node) const;
+
+	//! Append subtree to the hierarchy in depth-first order, returns index of the appended node
+	unsigned flatten(unsigned node, unsigned depth);
+
+	//! Append primitives of the subtree to indices
+	void gatherPrimitives(unsigned node);
+
+	//! Append balanced subtree over gathered primitives [begin, end), deep radix trees are rebalanced to bound traversal stack
+	unsigned flattenBalanced(unsigned begin, unsigned end, unsigned depth);
+
+	//! Get Morton code length or primitive index prefix length of two sorted primitives, -1 if the second is out of range
+	int getCommonPrefix(int first, int second) const;
+
+	bool isLeaf(unsigned node) const
+	{
+		return node >= mLeavesBegin;
+	}
+
+private:
+	// Disable copy and assignment
+	LinearBVHBuilder(const LinearBVHBuilder&);
+	LinearBVHBuilder& operator=(const LinearBVHBuilder&);
+
+private:
+	unsigned mMaxLeafSize;
+	unsigned mBlockSize;
+	unsigned mThreadsCount;
+
+	const std::vector< BBox >*			 mBounds;
+	std::vector< unsigned long long > mCodes;
+	std::vector< unsigned >					 mPrimitives; // Primitives in order of Morton codes
+	std::vector< RadixNode >				 mTree;
+	unsigned												 mLeavesBegin;
+	unsigned												 mRoot;
+
+	std::vector< BVHNode >*	mNodes;
+	std::vector< unsigned >* mIndices;
+};
+
+#endif
@@ -0,0 +1,375 @@
+//-------------------------------------------------------------------
+// File: mesh.cpp
+// 
+// Shared indexed triangle mesh implementation
+//
+//  
+//-------------------------------------------------------------------
+
+#include <float.h>
+
+#include "bvhbuild.h"
+
+#include "mesh.h"
+
+namespace
+{
+	// Keeps closest intersection with triangles, found in hierarchy leaves
+	struct ClosestBlockVisitor
+	{
+		ClosestBlockVisitor(const std::vector< TriangleBlock >& blocks, const std::vector< unsigned >& leafBlocks, const Ray& ray, HitBuffer* hits, bool sharedTriangles)
+			: Blocks(blocks),
+				LeafBlocks(leafBlocks),
+				ViewRay(ray),
+				Hits(hits),
+				SharedTriangles(sharedTriangles),
+				Closest(false)
+		{
+		}
+
+		bool operator()(unsigned leaf, float* maxDistance)
+		{
+			const TriangleBlock& block = Blocks[LeafBlocks[leaf]];
+
+			TriangleBlockHits blockHits;
+			unsigned					mask = block.intersect(ViewRay, &blockHits);
+			for (unsigned lane = 0; mask != 0; ++lane, mask >>= 1)
+			{
+				if ((mask & 1) == 0)
+				{
+					continue;
+				}
+
+				// Triangle, shared by several leaves, is hit at the same distance in each of them
+				const float distance = blockHits.Distance[lane];
+				if (Hits && !(SharedTriangles && Hits->contains(distance)))
+				{
+					// Face normal is the cross product of its edges, so the ray enters the mesh against it
+					const Vec3D e1(block.E1[0][lane], block.E1[1][lane], block.E1[2][lane]);
+					const Vec3D e2(block.E2[0][lane], block.E2[1][lane], block.E2[2][lane]);
+					Hits->add(distance, dot(cross(e1, e2), ViewRay.getDir()) < 0.f);
+				}
+
+				// Max distance isn't shrunk if all the hits are needed, so closest one is also checked.
+				// Ray interval includes its end, as in Ray::contains, so occlusion and closest hit agree on hits at tMax
+				if (distance > ViewRay.getTMin() && distance <= *maxDistance && (!Closest.Exists || distance < Closest.Distance))
+				{
+					Closest.Exists		= true;
+					Closest.Distance	= distance;
+					Closest.U					= blockHits.U[lane];
+					Closest.V					= blockHits.V[lane];
+					Closest.PrimId		= block.PrimIds[lane];
+
+					// All the hits are needed, so further nodes mustn't be culled
+					if (!Hits)
+					{
+						*maxDistance = distance;
+					}
+				}
+			}
+			return false;
+		}
+
+		const std::vector< TriangleBlock >& Blocks;
+		const std::vector< unsigned >&			LeafBlocks;
+		const Ray&													ViewRay;
+		HitBuffer*													Hits;
+		bool																SharedTriangles;
+		CIsect															Closest;
+	};
+
+	// Keeps closest intersections of the packet rays, each ray, which reached the leaf, is tested against its block
+	struct ClosestPacketBlockVisitor
+	{
+		ClosestPacketBlockVisitor(const std::vector< TriangleBlock >& blocks, const std::vector< unsigned >& leafBlocks, const RayPacket& packet, CIsect* isects)
+			: Blocks(blocks),
+				LeafBlocks(leafBlocks),
+				Packet(packet),
+				Isects(isects),
+				Found(0)
+		{
+		}
+
+		bool operator()(unsigned leaf, unsigned mask, float* maxDistances)
+		{
+			const TriangleBlock& block = Blocks[LeafBlocks[leaf]];
+
+			for (unsigned ray = 0; mask != 0; ++ray, mask >>= 1)
+			{
+				if ((mask & 1) == 0)
+				{
+					continue;
+				}
+
+				TriangleBlockHits blockHits;
+				unsigned					lanes = block.intersect(Packet.Rays[ray], &blockHits);
+				for (unsigned lane = 0; lanes != 0; ++lane, lanes >>= 1)
+				{
+					// Interval includes its end as for single rays, hit at the same distance doesn't replace the closest one
+					const float distance = blockHits.Distance[lane];
+					CIsect&			closest	 = Isects[ray];
+					if ((lanes & 1) != 0 && distance > Packet.Rays[ray].getTMin() && distance <= maxDistances[ray] && (!closest.Exists || distance < closest.Distance))
+					{
+						closest.Exists		= true;
+						closest.Distance	= distance;
+						closest.U					= blockHits.U[lane];
+						closest.V					= blockHits.V[lane];
+						closest.PrimId		= block.PrimIds[lane];
+
+						maxDistances[ray] = closest.Distance;
+						Found						 |= 1 << ray;
+					}
+				}
+			}
+			return false;
+		}
+
+		const std::vector< TriangleBlock >& Blocks;
+		const std::vector< unsigned >&			LeafBlocks;
+		const RayPacket&										Packet;
+		CIsect*															Isects;
+		unsigned														Found;
+	};
+
+	void GSetAxis(Vec3D* v, unsigned axis, float value)
+	{
+		if (axis == 0)
+		{
+			v->setX(value);
+		}
+		else if (axis == 1)
+		{
+			v->setY(value);
+		}
+		else
+		{
+			v->setZ(value);
+		}
+	}
+
+	// Clips triangles of the mesh for spatial splits of its hierarchy
+	class TriangleSplitter : public BVHPrimitiveSplitter
+	{
+	public:
+		TriangleSplitter(const std::vector< Vec3D >& positions, const std::vector< unsigned >& indices)
+			: mPositions(positions),
+				mIndices(indices)
+		{
+		}
+
+		virtual void split(unsigned primitive, unsigned axis, float position, BBox* left, BBox* right) const
+		{
+			*left	 = BBox::Empty();
+			*right = BBox::Empty();
+
+			const unsigned* vertices = &mIndices[3 * primitive];
+			for (unsigned edge = 0; edge < 3; ++edge)
+			{
+				const Vec3D& v0 = mPositions[vertices[edge]];
+				const Vec3D& v1 = mPositions[vertices[(edge + 1) % 3]];
+				const float	 p0 = BVHAxisValue(v0, axis);
+				const float	 p1 = BVHAxisValue(v1, axis);
+
+				if (p0 <= position)
+				{
+					left->extend(v0);
+				}
+				if (p0 >= position)
+				{
+					right->extend(v0);
+				}
+
+				// Edge, which crosses the plane, adds the crossing point to both parts
+				if ((p0 < position && position < p1) || (p1 < position && position < p0))
+				{
+					Vec3D point = v0 + (v1 - v0) * ((position - p0) / (p1 - p0));
+					GSetAxis(&point, axis, position);
+
+					left->extend(point);
+					right->extend(point);
+				}
+			}
+		}
+
+	private:
+		TriangleSplitter& operator=(const TriangleSplitter&);
+
+	private:
+		const std::vector< Vec3D >&		 mPositions;
+		const std::vector< unsigned >& mIndices;
+	};
+
+	// Stops traversal on the first found triangle
+	struct AnyBlockVisitor
+	{
+		AnyBlockVisitor(const std::vector< TriangleBlock >& blocks, const std::vector< unsigned >& leafBlocks, const Ray& ray)
+			: Blocks(blocks),
+				LeafBlocks(leafBlocks),
+				ViewRay(ray),
+				Found(false)
+		{
+		}
+
+		bool operator()(unsigned leaf, float* /*maxDistance*/)
+		{
+			TriangleBlockHits blockHits;
+			unsigned					mask = Blocks[LeafBlocks[leaf]].intersect(ViewRay, &blockHits);
+			for (unsigned lane = 0; mask != 0 && !Found; ++lane, mask >>= 1)
+			{
+				Found = (mask & 1) != 0 && ViewRay.contains(blockHits.Distance[lane]);
+			}
+			return Found;
+		}
+
+		const std::vector< TriangleBlock >& Blocks;
+		const std::vector< unsigned >&			LeafBlocks;
+		const Ray&													ViewRay;
+		bool																Found;
+	};
+}
+
+Mesh::Mesh(std::vector< Vec3D >* positions,
+					 std::vector< Vec3D >* normals,
+					 std::vector< Vec3D >* texCoords,
+					 std::vector< unsigned >* indices,
+					 BVHBuildMode hierarchyMode)
+	: mBoundingBox(BBox::Empty())
+{
+	mPositions.swap(*positions);
+	mNormals.swap(*normals);
+	mTexCoords.swap(*texCoords);
+	mIndices.swap(*indices);
+
+	buildHierarchy(hierarchyMode);
+}
+
+Mesh::Mesh(std::vector< Vec3D >* positions,
+					 std::vector< Vec3D >* normals,
+					 std::vector< Vec3D >* texCoords,
+					 std::vector< unsigned >* indices,
+					 std::vector< BVHNode >* hierarchyNodes,
+					 std::vector< unsigned >* hierarchyIndices,
+					 BVHBuildMode hierarchyMode)
+	: mBoundingBox(BBox::Empty())
+{
+	mPositions.swap(*positions);
+	mNormals.swap(*normals);
+	mTexCoords.swap(*texCoords);
+	mIndices.swap(*indices);
+
+	mHierarchy.assign(hierarchyNodes, hierarchyIndices, TRIANGLE_BLOCK_SIZE, hierarchyMode);
+	mBoundingBox = mHierarchy.getBounds();
+
+	buildLeafBlocks();
+}
+
+Mesh::Mesh(const Mesh& source, BVHBuildMode hierarchyMode)
+	: mPositions(source.mPositions),
+		mNormals(source.mNormals),
+		mTexCoords(source.mTexCoords),
+		mIndices(source.mIndices),
+		mBoundingBox(BBox::Empty())
+{
+	buildHierarchy(hierarchyMode);
+}
+
+Mesh::~Mesh()
+{
+}
+
+void Mesh::buildHierarchy(BVHBuildMode hierarchyMode)
+{
+	std::vector< BBox > bounds(getTrianglesCount());
+	for (unsigned tri = 0, count = bounds.size(); tri < count; ++tri)
+	{
+		BBox& box = bounds[tri];
+		box = BBox::Empty();
+		box.extend(mPositions[mIndices[3 * tri]]);
+		box.extend(mPositions[mIndices[3 * tri + 1]]);
+		box.extend(mPositions[mIndices[3 * tri + 2]]);
+
+		mBoundingBox.extend(box);
+	}
+	// Leaf is never larger than a block, so it's intersected at once
+	const TriangleSplitter splitter(mPositions, mIndices);
+	mHierarchy.build(bounds, TRIANGLE_BLOCK_SIZE, TRIANGLE_BLOCK_SIZE, hierarchyMode, 0, &splitter);
+
+	buildLeafBlocks();
+}
+
+void Mesh::buildLeafBlocks()
+{
+	const std::vector< BVHNode >&	 nodes				= mHierarchy.getNodes();
+	const std::vector< unsigned >& leafIndices = mHierarchy.getIndices();
+	mLeafBlocks.resize(nodes.size());
+	for (unsigned node = 0, count = nodes.size(); node < count; ++node)
+	{
+		const BVHNode& leaf = nodes[node];
+		if (leaf.Count == 0)
+		{
+			continue;
+		}
+
+		mLeafBlocks[node] = mBlocks.size();
+		mBlocks.push_back(TriangleBlock());
+
+		TriangleBlock& block = mBlocks.back();
+		for (unsigned lane = 0; lane < leaf.Count; ++lane)
+		{
+			const unsigned	tri			 = leafIndices[leaf.Offset + lane];
+			const unsigned* vertices = &mIndices[3 * tri];
+			block.set(lane, mPositions[vertices[0]], mPositions[vertices[1]], mPositions[vertices[2]], tri);
+		}
+	}
+
+	mWideHierarchy.build(mHierarchy);
+}
+
+CIsect Mesh::intersect(const Ray& ray, HitBuffer* hits) const
+{
+	ClosestBlockVisitor visitor(mBlocks, mLeafBlocks, ray, hits, mHierarchy.getIndices().size() > getTrianglesCount());
+	mWideHierarchy.traverseLeaves(ray, visitor);
+
+	return visitor.Closest;
+}
+
+unsigned Mesh::intersect(const RayPacket& packet, unsigned mask, float* maxDistances, CIsect* isects) const
+{
+	ClosestPacketBlockVisitor visitor(mBlocks, mLeafBlocks, packet, isects);
+	mHierarchy.traversePacket(packet, mask, maxDistances, visitor);
+
+	return visitor.Found;
+}
+
+bool Mesh::occluded(const Ray& ray) const
+{
+	AnyBlockVisitor visitor(mBlocks, mLeafBlocks, ray);
+	mWideHierarchy.traverseLeaves(ray, visitor);
+
+	return visitor.Found;
+}
+
+Vec3D Mesh::getNormal(const CIsect& isect) const
+{
+	const unsigned* vertices = &mIndices[3 * isect.PrimId];
+
+	if (mNormals.empty())
+	{
+		const Vec3D& v0 = mPositions[vertices[0]];
+		return cross(mPositions[vertices[1]] - v0, mPositions[vertices[2]] - v0).toUnit();
+	}
+
+	Vec3D normal = isect.U * mNormals[vertices[1]] + isect.V * mNormals[vertices[2]] + (1 - isect.U - isect.V) * mNormals[vertices[0]];
+	return normal.toUnit();
+}
+
+Vec3D Mesh::getTexCoords(const CIsect& isect) const
+{
+	if (mTexCoords.empty())
+	{
+		return Vec3D();
+	}
+
+	const unsigned* vertices = &mIndices[3 * isect.PrimId];
+	return isect.U * mTexCoords[vertices[1]] + isect.V * mTexCoords[vertices[2]] + (1 - isect.U - isect.V) * mTexCoords[vertices[0]];
+}
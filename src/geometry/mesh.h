@@ -0,0 +1,134 @@
+#ifndef GEOMETRY_MESH_H
+#define GEOMETRY_MESH_H
+
+#include <vector>
+
+#include "geometry/bbox.h"
+#include "geometry/bvh.h"
+#include "geometry/hitbuffer.h"
+#include "geometry/intersection.h"
+#include "geometry/ray.h"
+#include "geometry/raypacket.h"
+#include "geometry/triangleblock.h"
+#include "geometry/widebvh.h"
+
+// Indexed triangle mesh in its own object space with bottom-level hierarchy,
+// it's shared by all the models which instantiate it.
+// Vertices are shared by triangles, each triangle is a triple of 32-bit vertex indices.
+// Each hierarchy leaf keeps its triangles in one SIMD block with precomputed edges.
+// Single rays traverse the eight-wide hierarchy, collapsed from the binary one, packets traverse the binary one
+class Mesh
+{
+public:
+	//! Mesh takes over contents of given arrays, they are left empty.
+	//! Each three indices form a triangle, normals and texture coordinates are either empty or given for each vertex
+	explicit Mesh(std::vector< Vec3D >* positions,
+								std::vector< Vec3D >* normals,
+								std::vector< Vec3D >* texCoords,
+								std::vector< unsigned >* indices,
+								BVHBuildMode hierarchyMode = BVH_BUILD_SAH);
+
+	//! Same as above, but hierarchy built before is taken over instead of building a new one, e.g. the one loaded from a cache.
+	//! Hierarchy nodes and leaf triangle indices must be built for these triangles with TRIANGLE_BLOCK_SIZE leaves
+	explicit Mesh(std::vector< Vec3D >* positions,
+								std::vector< Vec3D >* normals,
+								std::vector< Vec3D >* texCoords,
+								std::vector< unsigned >* indices,
+								std::vector< BVHNode >* hierarchyNodes,
+								std::vector< unsigned >* hierarchyIndices,
+								BVHBuildMode hierarchyMode);
+
+	//! Copy geometry of the mesh and build its hierarchy in another mode, e.g. to compare builders
+	explicit Mesh(const Mesh& source, BVHBuildMode hierarchyMode);
+
+	~Mesh();
+
+	//! Find closest intersection in mesh space inside of the ray interval, intersection object isn't set, but triangle index and barycentrics are.
+	//! If hits buffer is given, all the hits are added to it, so no nodes are culled
+	CIsect intersect(const Ray& ray, HitBuffer* hits = NULL) const;
+
+	//! Find closest intersections of the packet rays from the mask in mesh space, which are closer than their max distances.
+	//! Max distances are shrunk, returns mask of rays with found intersections
+	unsigned intersect(const RayPacket& packet, unsigned mask, float* maxDistances, CIsect* isects) const;
+
+	//! Any-hit query, stops on the first triangle inside of the ray interval
+	bool occluded(const Ray& ray) const;
+
+	//! Interpolate mesh space normal of the intersected triangle, face normal is used if mesh has no normals
+	Vec3D getNormal(const CIsect& isect) const;
+
+	//! Interpolate texture coordinates of the intersected triangle
+	Vec3D getTexCoords(const CIsect& isect) const;
+
+	const BBox& getBBox() const
+	{
+		return mBoundingBox;
+	}
+
+	unsigned getTrianglesCount() const
+	{
+		return mIndices.size() / 3;
+	}
+
+	unsigned getVerticesCount() const
+	{
+		return mPositions.size();
+	}
+
+	const std::vector< Vec3D >& getPositions() const
+	{
+		return mPositions;
+	}
+
+	const std::vector< Vec3D >& getNormals() const
+	{
+		return mNormals;
+	}
+
+	const std::vector< Vec3D >& getTexCoords() const
+	{
+		return mTexCoords;
+	}
+
+	const std::vector< unsigned >& getIndices() const
+	{
+		return mIndices;
+	}
+
+	const BVH& getHierarchy() const
+	{
+		return mHierarchy;
+	}
+
+	const WideBVH& getWideHierarchy() const
+	{
+		return mWideHierarchy;
+	}
+
+private:
+	//! Build hierarchies and triangle blocks of their leaves.
+	//! Spatial splits clip triangles, so a triangle may be referenced by several leaves
+	void buildHierarchy(BVHBuildMode hierarchyMode);
+
+	//! Fill triangle blocks of the binary hierarchy leaves and collapse it into the wide one
+	void buildLeafBlocks();
+
+private:
+	// Meshes are shared, so they mustn't be copied
+	Mesh(const Mesh&);
+	Mesh& operator=(const Mesh&);
+
+private:
+	std::vector< Vec3D >		mPositions;
+	std::vector< Vec3D >		mNormals;
+	std::vector< Vec3D >		mTexCoords;
+	std::vector< unsigned > mIndices;
+	BBox										mBoundingBox;
+	BVH											mHierarchy;
+	WideBVH									mWideHierarchy;
+	// Triangle blocks of hierarchy leaves, indexed by leaf node
+	std::vector< TriangleBlock > mBlocks;
+	std::vector< unsigned >			 mLeafBlocks;
+};
+
+#endif
@@ -1,71 +1,125 @@
 //-------------------------------------------------------------------
 // File: model.cpp
 // 
-// Model scene object implementation
+// Model scene object implementation, model is an instance of the shared mesh
 //
 //  
 //-------------------------------------------------------------------
 
 #include "illumination/material.h"
-#include "triangle.h"
+#include "mesh.h"
 
 #include "model.h"
 
-#define TOO_FAR_AWAY		 1000000.f
-
-Model::Model(const std::vector< ModelTriangle* > &triangles, const BBox &bbox, Mtrl* material)
-	: mTriangles(triangles),
-		mBoundingBox(bbox),
+Model::Model(const Mesh* mesh, const Transform& transform, Mtrl* material)
+	: mMesh(mesh),
+		mWorldToMesh(transform.inverse()),
+		mBoundingBox(transform.applyToBBox(mesh->getBBox())),
 		mMtrl(material),
 		mIsLight(false)
 {
-	
 }
 
 Model::~Model()
 {
-	for (std::vector< ModelTriangle* >::iterator tri = mTriangles.begin(); tri != mTriangles.end(); ++tri)
-	{
-		delete *tri;
-		*tri = NULL;
-	}
 	delete mMtrl;
 }
 
-CIsect Model::intersect(const Ray& ray)
+void Model::setTransform(const Transform& transform)
+{
+	mWorldToMesh = transform.inverse();
+	mBoundingBox = transform.applyToBBox(mMesh->getBBox());
+}
+
+Ray Model::toMeshSpace(const Ray& ray, float* distanceScale) const
+{
+	const Vec3D direction = mWorldToMesh.applyToVector(ray.getDir());
+	// World ray direction is unit, so the length is the scale of mesh space distances
+	*distanceScale = length(direction);
+
+	return Ray(mWorldToMesh.applyToPoint(ray.getOrg()), direction, ray.getTMin() * *distanceScale, ray.getTMax() * *distanceScale);
+}
+
+CIsect Model::intersect(const Ray& ray, HitBuffer* hits)
 {
-	if (!mBoundingBox.intersect(ray))
+	float			distanceScale;
+	const Ray meshRay = toMeshSpace(ray, &distanceScale);
+
+	HitBuffer meshHits;
+	CIsect		isect = mMesh->intersect(meshRay, hits ? &meshHits : NULL);
+	if (!isect.Exists)
+	{
+		return isect;
+	}
+
+	isect.Object	 = this;
+	isect.Distance /= distanceScale;
+	if (!ray.contains(isect.Distance))
 	{
+		// Rounding of the rescaled distance
 		return CIsect(false);
 	}
 
-	float				 closestDistance = TOO_FAR_AWAY;
-	CIsect closestCIsect(false);
-	for (std::vector< ModelTriangle* >::iterator tri = mTriangles.begin(); tri != mTriangles.end(); ++tri)
+	if (hits)
 	{
-		CIsect current = (*tri)->intersect(ray);
-		if (current.Exists)
+		meshHits.scale(1.f / distanceScale);
+		hits->append(meshHits);
+	}
+
+	return isect;
+}
+
+unsigned Model::intersectPacket(const RayPacket& packet, unsigned mask, float* maxDistances, CIsect* isects)
+{
+	RayPacket meshPacket;
+	float			distanceScales[RAY_PACKET_SIZE];
+	float			meshDistances[RAY_PACKET_SIZE];
+	for (unsigned idx = 0; idx < RAY_PACKET_SIZE; ++idx)
+	{
+		if ((mask & (1 << idx)) != 0)
 		{
-			closestCIsect.Dst.push_back(current.Distance);
-			if (current.Distance < closestDistance)
-			{
-				closestCIsect.Exists	 = true;
-				closestCIsect.Distance = current.Distance;
-				closestCIsect.Object	 = this;
-				closestCIsect.Normal	 = current.Normal;
-
-				closestDistance = current.Distance;
-			}
+			meshPacket.set(idx, toMeshSpace(packet.Rays[idx], &distanceScales[idx]));
+			meshDistances[idx] = maxDistances[idx] * distanceScales[idx];
 		}
 	}
 
-	return closestCIsect;
+	CIsect		 meshIsects[RAY_PACKET_SIZE];
+	unsigned	 found = mMesh->intersect(meshPacket, mask, meshDistances, meshIsects);
+	for (unsigned idx = 0; idx < RAY_PACKET_SIZE; ++idx)
+	{
+		if ((found & (1 << idx)) == 0)
+		{
+			continue;
+		}
+
+		const float distance = meshIsects[idx].Distance / distanceScales[idx];
+		if (distance > maxDistances[idx])
+		{
+			// Rounding of the rescaled distance
+			found &= ~(1 << idx);
+			continue;
+		}
+
+		isects[idx]					 = meshIsects[idx];
+		isects[idx].Object	 = this;
+		isects[idx].Distance = distance;
+		maxDistances[idx]		 = distance;
+	}
+	return found;
 }
 
+bool Model::occluded(const Ray& ray)
+{
+	float			distanceScale;
+	const Ray meshRay = toMeshSpace(ray, &distanceScale);
+
+	return mMesh->occluded(meshRay);
+}
 
 Vec3D Model::getNormal(const Ray& ray, float distance, const CIsect& isect /*= CIsect()*/) const
 {
-	return isect.Normal; // Return already calculated normal
+	// Normals are transformed with inverse transposed matrix
+	return mWorldToMesh.applyTransposed(mMesh->getNormal(isect)).toUnit();
 }
 
 Color Model::getAmbColor(const Vec3D& pnt, const CIsect& isect/* = CIsect()*/) const
@@ -90,5 +144,10 @@ Color Model::getSpcColor(const Vec3D& pnt, const CIsect& isect/* = CIsect()*/) c
 
 Vec3D Model::getTexCoords(const Vec3D& pnt, const CIsect& isect/* = CIsect()*/) const
 {
-	return isect.TexCoords;
-}
\ No newline at end of file
+	return mMesh->getTexCoords(isect);
+}
+
+BBox Model::getBBox() const
+{
+	return mBoundingBox;
+}
@@ -1,21 +1,26 @@
 #ifndef GEOMETRY_MODEL_H
 #define GEOMETRY_MODEL_H
 
-#include <vector>
 #include "interfaces/ishape.h"
 #include "geometry/bbox.h"
-#include "geometry/modeltriangle.h"
 #include "geometry/ray.h"
+#include "geometry/transform.h"
 #include "geometry/vector3d.h"
 
-class Triangle;
+class Mesh;
 
+// Instance of the shared mesh, placed into the scene with its own transformation and material
 class Model : public IShape
 {
 public:
-	Model(const std::vector< ModelTriangle* >& triangles, const BBox& bbox, Mtrl* material);
+	//! Mesh isn't owned by the model, material is
+	Model(const Mesh* mesh, const Transform& transform, Mtrl* material);
 	virtual ~Model();
-	virtual CIsect intersect(const Ray& ray);
+	virtual CIsect intersect(const Ray& ray, HitBuffer* hits = NULL);
+	//! Packet is transformed into mesh space and traverses mesh hierarchy at once
+	virtual unsigned intersectPacket(const RayPacket& packet, unsigned mask, float* maxDistances, CIsect* isects);
+	//! Any-hit query for shadow rays, stops on the first triangle inside of the ray interval
+	virtual bool occluded(const Ray& ray);
 	virtual const Mtrl* getMtrl() const
 	{
 		return mMtrl;
@@ -33,11 +38,19 @@ public:
 	virtual Color getDifColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
 	virtual Color getSpcColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
 	virtual Vec3D getTexCoords(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
+	virtual BBox getBBox() const;
+	//! Place model with new transformation, scene must update its hierarchy before the next frame
+	void setTransform(const Transform& transform);
 private:
-	std::vector< ModelTriangle* > mTriangles;
-	BBox													mBoundingBox;
+	//! Transform world space ray and its interval into mesh space, returns length of transformed direction to rescale distances
+	Ray toMeshSpace(const Ray& ray, float* distanceScale) const;
+
+private:
+	const Mesh* mMesh;
+	Transform		mWorldToMesh;
+	BBox				mBoundingBox;
 	Mtrl* mMtrl;
 	bool			mIsLight;
 };
 
-#endif
\ No newline at end of file
+#endif
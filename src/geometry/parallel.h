@@ -0,0 +1,52 @@
+#ifndef GEOMETRY_PARALLEL_H
+#define GEOMETRY_PARALLEL_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// Helpers for builders, which split their work between several threads
+
+//! Get threads count to use, zero means the number of hardware threads
+inline unsigned ParallelThreadsCount(unsigned threadsCount)
+{
+	return threadsCount > 0 ? threadsCount : std::max(1u, std::thread::hardware_concurrency());
+}
+
+//! Get first item of the thread part of items, parts are contiguous and differ in size at most by one
+inline unsigned ParallelPartBegin(unsigned count, unsigned thread, unsigned threadsCount)
+{
+	return static_cast< unsigned >(static_cast< unsigned long long >(count) * thread / threadsCount);
+}
+
+//! Call function(thread) on threadsCount threads, calling thread is the first one
+template <class Function>
+void ParallelRun(unsigned threadsCount, const Function& function)
+{
+	std::vector< std::thread > workers;
+	workers.reserve(threadsCount - 1);
+	for (unsigned thread = 1; thread < threadsCount; ++thread)
+	{
+		workers.push_back(std::thread(function, thread));
+	}
+
+	function(0);
+
+	for (unsigned idx = 0; idx < workers.size(); ++idx)
+	{
+		workers[idx].join();
+	}
+}
+
+//! Call function(thread, first, last) for parts of items [0, count) on threadsCount threads
+template <class Function>
+void ParallelFor(unsigned count, unsigned threadsCount, const Function& function)
+{
+	threadsCount = std::max(1u, std::min(threadsCount, count));
+	ParallelRun(threadsCount, [&](unsigned thread)
+	{
+		function(thread, ParallelPartBegin(count, thread, threadsCount), ParallelPartBegin(count, thread + 1, threadsCount));
+	});
+}
+
+#endif
@@ -13,13 +13,13 @@
 #include "plane.h"
 
 Plane::Plane(const Vec3D& normal, float D, Mtrl* material)
-	: mNormal(normal),
-		mD(D),
-		mMtrl(material),
+	: mMtrl(material),
 		mIsLight(false)
 {
-	mUAxis = Vec3D(mNormal.y(), mNormal.z(), -mNormal.x());
-	mVAxis = cross(mUAxis, mNormal);
+	mGeometry.Normal = normal;
+	mGeometry.D			 = D;
+	mUAxis = Vec3D(mGeometry.Normal.y(), mGeometry.Normal.z(), -mGeometry.Normal.x());
+	mVAxis = cross(mUAxis, mGeometry.Normal);
 }
 
 Plane::~Plane()
@@ -29,22 +29,36 @@ Plane::~Plane()
 }
 
 
-CIsect Plane::intersect(const Ray& ray)
+bool PlaneGeometry::intersect(const Ray& ray, CIsect* isect, HitBuffer* hits) const
 {
-	float angle = dot(mNormal, ray.getDir());
+	float angle = dot(Normal, ray.getDir());
 	if (fabs(angle) < FLOAT_ZERO) 
 	{
-		return CIsect(false);
+		return false;
 	}
-	float t = (-(dot(ray.getOrg(), mNormal) + mD) / angle);
-	if (t > 0.f)
+	float t = (-(dot(ray.getOrg(), Normal) + D) / angle);
+	if (ray.contains(t))
 	{
-		CIsect res(true, t, this, getNormal(ray, t));
-		res.Dst.push_back(t);
-		res.InsideIntervals.push_back(Span(t, t));
-		return res;
+		if (hits)
+		{
+			// Solid is behind the plane, so the ray enters it against the normal
+			hits->add(t, angle < 0.f);
+		}
+		isect->Exists		= true;
+		isect->Distance = t;
+		return true;
 	}
-	return CIsect(false);
+	return false;
+}
+
+CIsect Plane::intersect(const Ray& ray, HitBuffer* hits)
+{
+	CIsect res(false);
+	if (mGeometry.intersect(ray, &res, hits))
+	{
+		res.Object = this;
+	}
+	return res;
 }
 
 Color Plane::getAmbColor(const Vec3D& pnt, const CIsect& isect/* = CIsect()*/) const
@@ -86,4 +100,10 @@ Vec3D Plane::getTexCoords(const Vec3D& pnt, const CIsect& isect/* = CIsect()*/)
 	//	v = 1.f + v; 
 	//}
 	return Vec3D(xu, yv, 0.f);
-}
\ No newline at end of file
+}
+
+BBox Plane::getBBox() const
+{
+	// Plane is infinite
+	return BBox::Infinite();
+}
@@ -3,19 +3,29 @@
 
 #include "interfaces/ishape.h"
 
+// Data of the plane, which is enough to intersect it, compiled scene keeps it in contiguous arrays
+struct PlaneGeometry
+{
+	//! Find hit inside of the ray interval, its distance is added to the buffer, if it's given
+	bool intersect(const Ray& ray, CIsect* isect, HitBuffer* hits = NULL) const;
+
+	Vec3D Normal;
+	float D;
+};
+
 class Plane : public IShape
 {
 public:
 	explicit Plane(const Vec3D& normal, float D, Mtrl* material);
   virtual ~Plane();
-	virtual CIsect intersect(const Ray& ray);
+	virtual CIsect intersect(const Ray& ray, HitBuffer* hits = NULL);
 	virtual const Mtrl* getMtrl() const
 	{
 		return mMtrl;
 	}
 	virtual Vec3D getNormal(const Ray& ray, float distance, const CIsect& isect = CIsect()) const
 	{
-		return mNormal;
+		return mGeometry.Normal;
 	}
 	virtual void setIsLight(bool light)
 	{
@@ -29,9 +39,14 @@ public:
 	virtual Color getDifColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
 	virtual Color getSpcColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
 	virtual Vec3D getTexCoords(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
+	virtual BBox getBBox() const;
+	const PlaneGeometry& getGeometry() const
+	{
+		return mGeometry;
+	}
 private:
-	Vec3D	mNormal, mUAxis, mVAxis;
-	float	mD;
+	PlaneGeometry mGeometry;
+	Vec3D					mUAxis, mVAxis;
 	Mtrl *mMtrl;
 	bool mIsLight;
 };
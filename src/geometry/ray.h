@@ -1,16 +1,39 @@
 #ifndef GEOMETRY_RAY_H
 #define GEOMETRY_RAY_H
 
+#include <cfloat>
+
 #include "vector3d.h"
 
+// Ray with the interval of distances (tMin, tMax], where hits are searched.
+// Reciprocal direction and its signs are cached for box tests
 class Ray
 {
 public:
-	Ray(const Vec3D& org = Vec3D(), const Vec3D& dir = Vec3D())
-		: mOrg(org), 
-			mDir(dir)
+	//! Tag for the constructor, which takes already normalized direction
+	enum UnitDirection
+	{
+		UNIT_DIRECTION
+	};
+
+	Ray(const Vec3D& org = Vec3D(), const Vec3D& dir = Vec3D(), float tMin = 0.f, float tMax = FLT_MAX)
+		: mOrg(org),
+			mDir(dir),
+			mTMin(tMin),
+			mTMax(tMax)
 	{
 		mDir.normalize();
+		updateInvDir();
+	}
+
+	//! Direction is taken as is, it must be unit already
+	Ray(const Vec3D& org, const Vec3D& dir, UnitDirection, float tMin = 0.f, float tMax = FLT_MAX)
+		: mOrg(org),
+			mDir(dir),
+			mTMin(tMin),
+			mTMax(tMax)
+	{
+		updateInvDir();
 	}
 
 	const Vec3D& getOrg() const
@@ -23,14 +46,67 @@ public:
 		return mDir;
 	}
 
+	//! Get reciprocal direction, zero components give infinities
+	const Vec3D& getInvDir() const
+	{
+		return mInvDir;
+	}
+
+	//! Get 1 if direction component along given axis is negative, 0 otherwise
+	unsigned getSign(unsigned axis) const
+	{
+		return mSign[axis];
+	}
+
+	float getTMin() const
+	{
+		return mTMin;
+	}
+
+	float getTMax() const
+	{
+		return mTMax;
+	}
+
+	void setTMin(float tMin)
+	{
+		mTMin = tMin;
+	}
+
+	//! Shrink search interval, e.g. when closer hit is found
+	void setTMax(float tMax)
+	{
+		mTMax = tMax;
+	}
+
+	//! Check if distance lies inside of the search interval
+	bool contains(float t) const
+	{
+		return t > mTMin && t <= mTMax;
+	}
+
 	Vec3D apply(float t) const
 	{
 		return mOrg + mDir * t;
 	}
 
 private:
-	Vec3D mOrg;
-	Vec3D mDir;
+	void updateInvDir()
+	{
+		mInvDir = mDir.inverse();
+
+		mSign[0] = mInvDir.x() < 0.f;
+		mSign[1] = mInvDir.y() < 0.f;
+		mSign[2] = mInvDir.z() < 0.f;
+	}
+
+private:
+	Vec3D		 mOrg;
+	Vec3D		 mDir;
+	Vec3D		 mInvDir;
+	unsigned mSign[3];
+	float		 mTMin;
+	float		 mTMax;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,97 @@
+//-------------------------------------------------------------------
+// File: raypacket.cpp
+// 
+// Packet of coherent rays implementation
+//			 Box test repeats BBox::intersect operations for each ray, so packets cull the same nodes as single rays
+//
+//  
+//-------------------------------------------------------------------
+
+#include "raypacket.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define RAY_PACKET_SSE
+	#include <emmintrin.h>
+#endif
+
+#ifdef RAY_PACKET_SSE
+namespace
+{
+	inline __m128 GSelect(__m128 condition, __m128 ifTrue, __m128 ifFalse)
+	{
+		return _mm_or_ps(_mm_and_ps(condition, ifTrue), _mm_andnot_ps(condition, ifFalse));
+	}
+
+	// Shrink [near, far] interval of each ray with the slab along one axis, same as BBox::intersect does.
+	// Sign of the direction tells which plane is entered first, NaN distances keep the current interval
+	inline void GClipSlab(float slabMin, float slabMax, __m128 origin, __m128 invDir, __m128* nearDistance, __m128* farDistance)
+	{
+		const __m128 negative = _mm_cmplt_ps(invDir, _mm_setzero_ps());
+		const __m128 planeMin = _mm_set1_ps(slabMin);
+		const __m128 planeMax = _mm_set1_ps(slabMax);
+
+		const __m128 t0 = _mm_mul_ps(_mm_sub_ps(GSelect(negative, planeMax, planeMin), origin), invDir);
+		const __m128 t1 = _mm_mul_ps(_mm_sub_ps(GSelect(negative, planeMin, planeMax), origin), invDir);
+
+		// Second operand is returned, if any of them is NaN
+		*nearDistance = _mm_max_ps(t0, *nearDistance);
+		*farDistance	= _mm_min_ps(t1, *farDistance);
+	}
+}
+#endif
+
+RayPacket::RayPacket()
+{
+}
+
+void RayPacket::set(unsigned idx, const Ray& ray)
+{
+	Rays[idx] = ray;
+
+	const Vec3D& origin = ray.getOrg();
+	const Vec3D& invDir = ray.getInvDir();
+
+	OrgX[idx] = origin.x();
+	OrgY[idx] = origin.y();
+	OrgZ[idx] = origin.z();
+	InvDirX[idx] = invDir.x();
+	InvDirY[idx] = invDir.y();
+	InvDirZ[idx] = invDir.z();
+	TMin[idx]		 = ray.getTMin();
+}
+
+unsigned RayPacket::intersect(const BBox& box, unsigned mask, const float* maxDistances) const
+{
+	unsigned result = 0;
+
+#ifdef RAY_PACKET_SSE
+	for (unsigned base = 0; base < RAY_PACKET_SIZE && (mask >> base) != 0; base += 4)
+	{
+		const unsigned lanes = (mask >> base) & 0xf;
+		if (lanes == 0)
+		{
+			continue;
+		}
+
+		__m128 nearDistance = _mm_loadu_ps(TMin + base);
+		__m128 farDistance	= _mm_loadu_ps(maxDistances + base);
+
+		GClipSlab(box.Min.x(), box.Max.x(), _mm_loadu_ps(OrgX + base), _mm_loadu_ps(InvDirX + base), &nearDistance, &farDistance);
+		GClipSlab(box.Min.y(), box.Max.y(), _mm_loadu_ps(OrgY + base), _mm_loadu_ps(InvDirY + base), &nearDistance, &farDistance);
+		GClipSlab(box.Min.z(), box.Max.z(), _mm_loadu_ps(OrgZ + base), _mm_loadu_ps(InvDirZ + base), &nearDistance, &farDistance);
+
+		result |= (_mm_movemask_ps(_mm_cmple_ps(nearDistance, farDistance)) & lanes) << base;
+	}
+#else
+	for (unsigned idx = 0; idx < RAY_PACKET_SIZE; ++idx)
+	{
+		float tNear, tFar;
+		if ((mask & (1 << idx)) != 0 && box.intersect(Rays[idx], &tNear, &tFar) && tNear <= maxDistances[idx])
+		{
+			result |= 1 << idx;
+		}
+	}
+#endif
+
+	return result;
+}
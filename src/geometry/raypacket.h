@@ -0,0 +1,29 @@
+#ifndef GEOMETRY_RAYPACKET_H
+#define GEOMETRY_RAYPACKET_H
+
+#include "geometry/bbox.h"
+#include "geometry/ray.h"
+
+#define RAY_PACKET_WIDTH 4
+#define RAY_PACKET_SIZE	 (RAY_PACKET_WIDTH * RAY_PACKET_WIDTH)
+
+// Packet of coherent rays, e.g. primary rays of the square of neighbouring pixels.
+// Rays are kept as they are, so every ray gives the same results as if it was traced alone,
+// and also as structure of arrays, so the box is tested against the whole packet with SIMD instructions
+struct RayPacket
+{
+	explicit RayPacket();
+
+	//! Put ray into given slot
+	void set(unsigned idx, const Ray& ray);
+
+	//! Intersect box with rays from the mask, returns mask of rays which hit it not further than their max distances
+	unsigned intersect(const BBox& box, unsigned mask, const float* maxDistances) const;
+
+	Ray		Rays[RAY_PACKET_SIZE];
+	float OrgX[RAY_PACKET_SIZE], OrgY[RAY_PACKET_SIZE], OrgZ[RAY_PACKET_SIZE];
+	float InvDirX[RAY_PACKET_SIZE], InvDirY[RAY_PACKET_SIZE], InvDirZ[RAY_PACKET_SIZE];
+	float TMin[RAY_PACKET_SIZE];
+};
+
+#endif
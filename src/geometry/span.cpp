@@ -6,124 +6,294 @@
 //  
 //-------------------------------------------------------------------
 
-#include <xutility>
+#include <algorithm>
+#include <cfloat>
 
-#include "precision.h"
+#include "interfaces/ishape.h"
+
+#include "hitbuffer.h"
+#include "ray.h"
 
 #include "span.h"
 
-Spans SpanUnite(const Span& lh, const Span& rh)
+namespace
 {
-	Spans res;
-	if (SpanIsToTheLeft(lh, rh))
+	// Walks bounds of sorted spans, entries and exits alternate
+	struct BoundCursor
+	{
+		BoundCursor(const Span* spans, unsigned count)
+			: Spans(spans),
+				Idx(0),
+				End(2 * count)
+		{
+		}
+
+		bool atEnd() const
+		{
+			return Idx == End;
+		}
+
+		bool isEntry() const
+		{
+			return (Idx & 1) == 0;
+		}
+
+		const SpanBound& bound() const
+		{
+			const Span& span = Spans[Idx / 2];
+			return isEntry() ? span.Entry : span.Exit;
+		}
+
+		const Span* Spans;
+		unsigned		Idx;
+		unsigned		End;
+	};
+
+	bool GIsInside(SpanOperation operation, bool lInside, bool rInside)
 	{
-		res.push_back(lh);
-		res.push_back(rh);
-		return res;
+		switch (operation)
+		{
+		case SPAN_UNION:
+			return lInside || rInside;
+		case SPAN_INTERSECTION:
+			return lInside && rInside;
+		default:
+			return lInside && !rInside;
+		}
 	}
-	if (SpanIsToTheRight(lh, rh))
+
+	// Bounds at the same distance are ordered entries first, so union merges touching spans
+	bool GIsBefore(const BoundCursor& lh, const BoundCursor& rh)
 	{
-		res.push_back(rh);
-		res.push_back(lh);
+		const float lDistance = lh.bound().Distance;
+		const float rDistance = rh.bound().Distance;
+		return lDistance < rDistance || (lDistance == rDistance && (lh.isEntry() || !rh.isEntry()));
 	}
 
-	res.push_back(Span(std::min(lh.Start, rh.Start), std::max(lh.End, rh.End)));
-	return res;
+	void GSetLeafSpan(Span* span, float entry, float exit, unsigned leaf)
+	{
+		span->Entry.Distance	 = entry;
+		span->Entry.Leaf			 = leaf;
+		span->Entry.FlipNormal = false;
+		span->Exit.Distance		 = exit;
+		span->Exit.Leaf				 = leaf;
+		span->Exit.FlipNormal	 = false;
+	}
 }
 
-Spans SpanUnite(const Spans& lh, const Spans& rh)
+SpanArena& SpanArena::local()
 {
-	Spans res;
-	int resSize = 0;
-	for each (auto lSpan in lh)
+	thread_local SpanArena arena;
+	return arena;
+}
+
+unsigned SpanArena::addLeaf(const CIsect& isect)
+{
+	if (mLeavesTop == mLeaves.size())
 	{
-		for each (auto rSpan in rh)
-		{
-			Spans united = SpanUnite(lSpan, rSpan);
-			resSize = res.size();
-			res.resize(resSize + united.size());
-			std::copy(united.begin(), united.end(), res.begin() + resSize);
-		}
+		mLeaves.push_back(isect);
 	}
-	return res;
+	else
+	{
+		mLeaves[mLeavesTop] = isect;
+	}
+	return mLeavesTop++;
 }
 
-Spans SpanIntersect(const Span& lh, const Span& rh)
+unsigned SpanArena::allocSpans(unsigned count)
 {
-	if (SpanIsToTheLeft(lh, rh) || SpanIsToTheRight(lh, rh))
+	const unsigned first = mSpansTop;
+	mSpansTop += count;
+	if (mSpansTop > mSpans.size())
 	{
-		return Spans();
+		mSpans.resize(mSpansTop);
 	}
-
-	Spans res;
-	res.push_back(Span(std::max(lh.Start, rh.Start), std::min(lh.End, rh.End)));
-	return res;
+	return first;
 }
 
-Spans SpanIntersect(const Spans& lh, const Spans& rh)
+SpanList SpanFromHits(SpanArena* arena, const Ray& ray, const HitBuffer& hits, unsigned leaf)
 {
-	Spans res;
-	int   resSize = 0;
-	for each (auto lSpan in lh)
+	// Ray is inside of the solid, where more entries than exits are passed. Ray starts inside,
+	// if it meets more exits than entries before some hit, so depth starts from their excess
+	int depth = 0, minDepth = 0;
+	for (unsigned idx = 0; idx < hits.size(); ++idx)
 	{
-		for each (auto rSpan in rh)
+		depth		 += hits.isEntry(idx) ? 1 : -1;
+		minDepth = std::min(depth, minDepth);
+	}
+
+	// Each span, except the one started at the ray origin, takes at least one entry and one exit
+	SpanList spans;
+	spans.First = arena->allocSpans(hits.size() / 2 + 1);
+	spans.Count = 0;
+
+	Span* out		= arena->getSpans(spans.First);
+	float entry = ray.getTMin();
+	depth				= -minDepth;
+	for (unsigned idx = 0; idx < hits.size(); ++idx)
+	{
+		const float distance = hits[idx];
+		if (hits.isEntry(idx))
 		{
-			Spans intersected = SpanIntersect(lSpan, rSpan);
-			resSize = res.size();
-			res.resize(resSize + intersected.size());
-			std::copy(intersected.begin(), intersected.end(), res.begin() + resSize);
+			if (depth++ == 0)
+			{
+				entry = distance;
+			}
+		}
+		// Empty spans, left by tangent rays, are dropped
+		else if (--depth == 0 && distance > entry)
+		{
+			GSetLeafSpan(&out[spans.Count++], entry, distance, leaf);
 		}
 	}
-	return res;
+
+	// Ray doesn't leave the solid, which isn't closed, e.g. the plane, so the last span is endless
+	if (depth > 0)
+	{
+		GSetLeafSpan(&out[spans.Count++], entry, FLT_MAX, leaf);
+	}
+
+	arena->trimSpans(spans.First + spans.Count);
+	return spans;
 }
 
-Spans SpanDifference(const Span& lh, const Span& rh)
+SpanList SpanIntersectShape(SpanArena* arena, IShape* shape, const Ray& ray)
 {
-	if (SpanIsToTheRight(rh, lh) || SpanIsToTheLeft(rh, lh))
+	HitBuffer		 hits;
+	const CIsect isect = shape->intersect(ray, &hits);
+	if (!isect.Exists)
 	{
-		return Spans(1, lh);
+		return SpanList();
 	}
+	return SpanFromHits(arena, ray, hits, arena->addLeaf(isect));
+}
 
-	// Fit negative to positive
-	Span rhFit = Span(std::max(lh.Start, rh.Start), std::min(lh.End, rh.End));
+SpanList SpanCombine(SpanArena* arena, const SpanList& lh, const SpanList& rh, SpanOperation operation)
+{
+	// Culled or missed operand leaves either the other one or nothing, so spans aren't copied
+	if (rh.Count == 0)
+	{
+		return operation == SPAN_INTERSECTION ? SpanList() : lh;
+	}
+	if (lh.Count == 0)
+	{
+		return operation == SPAN_UNION ? rh : SpanList();
+	}
+
+	// Each result span starts at a bound of operands, so there can't be more spans, than operands have together
+	SpanList res;
+	res.First = arena->allocSpans(lh.Count + rh.Count);
+	res.Count = 0;
 
-	Spans res;
+	Span*				out = arena->getSpans(res.First);
+	BoundCursor lCursor(arena->getSpans(lh.First), lh.Count);
+	BoundCursor rCursor(arena->getSpans(rh.First), rh.Count);
 
-	if (fabs(lh.Start - rhFit.Start) > FLOAT_ZERO)
+	bool lInside = false, rInside = false, inside = false;
+	while (!lCursor.atEnd() || !rCursor.atEnd())
 	{
-		res.push_back(Span(lh.Start, rhFit.Start));
-		res.push_back(Span(rhFit.End, lh.End));
-		return res;
+		// Intersection and difference are outside after the left operand ends and intersection after the right one too
+		if ((operation != SPAN_UNION && lCursor.atEnd()) || (operation == SPAN_INTERSECTION && rCursor.atEnd()))
+		{
+			break;
+		}
+
+		const bool	 isLeft = rCursor.atEnd() || (!lCursor.atEnd() && GIsBefore(lCursor, rCursor));
+		BoundCursor& cursor = isLeft ? lCursor : rCursor;
+		SpanBound		 bound	= cursor.bound();
+		if (isLeft)
+		{
+			lInside = cursor.isEntry();
+		}
+		else
+		{
+			rInside = cursor.isEntry();
+		}
+		++cursor.Idx;
+
+		const bool isInside = GIsInside(operation, lInside, rInside);
+		if (isInside == inside)
+		{
+			continue;
+		}
+		inside = isInside;
+
+		// Negative operand is turned inside out, so its surfaces face the other way
+		if (!isLeft && operation == SPAN_DIFFERENCE)
+		{
+			bound.FlipNormal = !bound.FlipNormal;
+		}
+
+		if (inside)
+		{
+			out[res.Count].Entry = bound;
+		}
+		// Empty spans, left by coincident surfaces, are dropped
+		else if (bound.Distance > out[res.Count].Entry.Distance)
+		{
+			out[res.Count++].Exit = bound;
+		}
 	}
-	
-	res.push_back(Span(rhFit.End, lh.End));
 
+	arena->trimSpans(res.First + res.Count);
 	return res;
+}
 
-	/*if (lh.Start - rhFit.Start > FLOAT_ZERO)
+const SpanBound* SpanFirstBound(const SpanArena& arena, const SpanList& spans, float tMin)
+{
+	const Span* list = arena.getSpans(spans.First);
+	for (unsigned idx = 0; idx < spans.Count; ++idx)
 	{
-		res.push_back(Span(lh.Start, rhFit.Start));
+		if (list[idx].Entry.Distance > tMin)
+		{
+			return &list[idx].Entry;
+		}
+		if (list[idx].Exit.Distance > tMin)
+		{
+			return &list[idx].Exit;
+		}
 	}
-	if (rhFit.End - lh.End > FLOAT_ZERO)
+	return NULL;
+}
+
+const SpanBound* SpanFirstEntry(const SpanArena& arena, const SpanList& spans, float tMin)
+{
+	const Span* list = arena.getSpans(spans.First);
+	for (unsigned idx = 0; idx < spans.Count; ++idx)
 	{
-		res.push_back(Span(rhFit.End, lh.End));
-	}*/
-	//return res;
+		if (list[idx].Entry.Distance > tMin)
+		{
+			return &list[idx].Entry;
+		}
+	}
+	return NULL;
 }
 
-Spans SpanDifference(const Spans& lh, const Spans& rh)
+CIsect SpanIntersection(const SpanArena& arena, const SpanList& spans, const Ray& ray, HitBuffer* hits)
 {
-	Spans res;
-	int   resSize = 0;
-	for each (auto lSpan in lh)
+	if (hits)
 	{
-		for each (auto rSpan in rh)
+		// Span, started at the ray origin, has no entry hit, so the ray starts inside of the result too
+		const Span* list = arena.getSpans(spans.First);
+		for (unsigned idx = 0; idx < spans.Count; ++idx)
 		{
-			Spans diff = SpanDifference(lSpan, rSpan);
-			resSize = res.size();
-			res.resize(resSize + diff.size());
-			std::copy(diff.begin(), diff.end(), res.begin() + resSize);
+			if (list[idx].Entry.Distance > ray.getTMin())
+			{
+				hits->add(list[idx].Entry.Distance, true);
+			}
+			hits->add(list[idx].Exit.Distance, false);
 		}
 	}
-	return res;
-}
\ No newline at end of file
+
+	const SpanBound* bound = SpanFirstBound(arena, spans, ray.getTMin());
+	if (!bound || bound->Distance > ray.getTMax())
+	{
+		return CIsect(false);
+	}
+
+	// Hit data of the leaf is the one of its closest hit, shapes evaluate normals from the hit point
+	CIsect isect		 = arena.getLeaf(bound->Leaf);
+	isect.Distance	 = bound->Distance;
+	isect.FlipNormal = isect.FlipNormal != bound->FlipNormal;
+	return isect;
+}
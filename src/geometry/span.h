@@ -1,52 +1,141 @@
 #ifndef GEOMETRY_SPAN_H
 #define GEOMETRY_SPAN_H
-	
+
 #include <vector>
 
-struct Span
-{	
-	explicit Span(float start = -1.f, float end = -1.f)
-		: Start(start),
-			End(end)
-	{
+#include "intersection.h"
 
-	}
+class HitBuffer;
+class Ray;
+struct IShape;
 
-	float Start, End;
+// Boundary of the span, its normal is the normal of the leaf shape, which is hit at the boundary distance
+struct SpanBound
+{
+	float		 Distance;
+	// Index of the leaf intersection in the arena, it keeps the hit shape and its hit data
+	unsigned Leaf;
+	// Normal must be negated, e.g. bound belongs to negative operand of difference
+	bool		 FlipNormal;
 };
 
-typedef std::vector<Span> Spans;
-
-inline bool SpanIsToTheLeft(const Span& lh, const Span& rh)
+// Interval of the ray, which is inside of the solid
+struct Span
 {
-	return lh.End < rh.Start;
-}
+	SpanBound Entry;
+	SpanBound Exit;
+};
 
-inline bool SpanIsToTheRight(const Span& lh, const Span& rh)
+// Sorted disjoint spans, which are stored contiguously in the arena.
+// It's a plain structure, so stacks of lists aren't initialized, SpanList() is the empty list
+struct SpanList
 {
-	return lh.Start > rh.End;
-}
+	unsigned First;
+	unsigned Count;
+};
 
-inline bool operator<(const Span& lh, const Span& rh)
+enum SpanOperation
 {
-	return lh.Start <= rh.Start;
-}
+	SPAN_UNION,
+	SPAN_INTERSECTION,
+	SPAN_DIFFERENCE
+};
 
-inline bool operator>(const Span& lh, const Span& rh)
+// Storage of spans and leaf intersections, used while the ray is evaluated against CSG tree.
+// Storage is allocated from the top of the arena and released at once, when the ray is finished,
+// so the memory is reused by all the rays of the thread and it's allocated only while the arena grows
+class SpanArena
 {
-	return lh.Start > rh.Start;
-}
+public:
+	SpanArena()
+		: mSpansTop(0),
+			mLeavesTop(0)
+	{
+	}
+
+	//! Arena of the calling thread, so rendering threads never share storage
+	static SpanArena& local();
+
+	//! Store intersection of the leaf shape, spans refer to it by the returned index
+	unsigned addLeaf(const CIsect& isect);
+
+	const CIsect& getLeaf(unsigned leaf) const
+	{
+		return mLeaves[leaf];
+	}
 
-inline bool SpanContains(const Span& span, float t)
+	//! Allocate count spans on the top, pointers to spans stay valid until the next allocation only
+	unsigned allocSpans(unsigned count);
+
+	//! Release spans above the top, which weren't used by the last allocation
+	void trimSpans(unsigned top)
+	{
+		mSpansTop = top;
+	}
+
+	Span* getSpans(unsigned first)
+	{
+		return mSpans.data() + first;
+	}
+
+	const Span* getSpans(unsigned first) const
+	{
+		return mSpans.data() + first;
+	}
+
+private:
+	friend class SpanArenaScope;
+
+	std::vector< Span >		mSpans;
+	std::vector< CIsect > mLeaves;
+	unsigned							mSpansTop;
+	unsigned							mLeavesTop;
+};
+
+// Releases all the arena storage, allocated during the scope, evaluations may be nested
+class SpanArenaScope
 {
-	return span.Start <= t && t <= span.End;
-}
+public:
+	explicit SpanArenaScope(SpanArena* arena)
+		: mArena(arena),
+			mSpansTop(arena->mSpansTop),
+			mLeavesTop(arena->mLeavesTop)
+	{
+	}
+
+	~SpanArenaScope()
+	{
+		mArena->mSpansTop	 = mSpansTop;
+		mArena->mLeavesTop = mLeavesTop;
+	}
+
+private:
+	SpanArenaScope(const SpanArenaScope&);
+	SpanArenaScope& operator=(const SpanArenaScope&);
+
+private:
+	SpanArena* mArena;
+	unsigned	 mSpansTop;
+	unsigned	 mLeavesTop;
+};
+
+//! Make spans of the leaf from its sorted hits, the ray is inside, while it has passed more entries than exits.
+//! So the edge, which is shared by two triangles of the mesh, is crossed once, and the tangent ray doesn't enter the solid
+SpanList SpanFromHits(SpanArena* arena, const Ray& ray, const HitBuffer& hits, unsigned leaf);
+
+//! Make spans of the leaf shape from all its hits, the closest hit keeps the shape data for the bounds
+SpanList SpanIntersectShape(SpanArena* arena, IShape* shape, const Ray& ray);
+
+//! Combine spans of operands by one linear pass over their sorted bounds
+SpanList SpanCombine(SpanArena* arena, const SpanList& lh, const SpanList& rh, SpanOperation operation);
+
+//! Find the first bound after tMin, it's the exit of the span, if tMin is inside of it
+const SpanBound* SpanFirstBound(const SpanArena& arena, const SpanList& spans, float tMin);
+
+//! Find the first entry into the solid after tMin
+const SpanBound* SpanFirstEntry(const SpanArena& arena, const SpanList& spans, float tMin);
 
-Spans SpanUnite(const Span& lh, const Span& rh);
-Spans SpanUnite(const Spans& lh, const Spans& rh);
-Spans SpanIntersect(const Span& lh, const Span& rh);
-Spans SpanIntersect(const Spans& lh, const Spans& rh);
-Spans SpanDifference(const Span& lh, const Span& rh);
-Spans SpanDifference(const Spans& lh, const Spans& rh);
+//! Make intersection from the first bound inside of the ray interval, all the bounds are added to the hits
+CIsect SpanIntersection(const SpanArena& arena, const SpanList& spans, const Ray& ray, HitBuffer* hits);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,463 @@
+//-------------------------------------------------------------------
+// File: spatialbvh.cpp
+//
+// Bounding volume hierarchy builder with spatial splits
+//			 Splits are chosen as in "Spatial Splits in Bounding Volume Hierarchies" by Stich, Friedrich and Dietrich:
+//			 spatial split is searched only if children of the best object split overlap,
+//			 crossing references are kept whole in one child, if clipping them doesn't pay off
+//
+//
+//-------------------------------------------------------------------
+
+#include <algorithm>
+#include <cfloat>
+
+#include "bvhbuild.h"
+
+#include "spatialbvh.h"
+
+namespace
+{
+	static const float		cTraversalCost	 = BVH_TRAVERSAL_COST;
+	static const float		cIntersectionCost = BVH_INTERSECTION_COST;
+	// Deeper nodes are split by median to keep traversal stack bounded
+	static const unsigned cMaxDepth				 = BVH_STACK_SIZE / 2;
+	static const unsigned cObjectBinsCount	 = 32;
+	static const unsigned cSpatialBinsCount	 = 32;
+	// Spatial splits are searched if children overlap more than this share of the root area
+	static const float		cMinOverlapShare	 = 1e-5f;
+
+	unsigned GBin(float position, float origin, float scale, unsigned binsCount)
+	{
+		return std::min(binsCount - 1, static_cast< unsigned >(std::max((position - origin) * scale, 0.f)));
+	}
+}
+
+SpatialBVHBuilder::SpatialBVHBuilder(unsigned maxLeafSize, unsigned blockSize, float duplicationBudget)
+	: mMaxLeafSize(maxLeafSize),
+		mBlockSize(blockSize),
+		mDuplicationBudget(duplicationBudget),
+		mSplitter(NULL),
+		mReferencesCount(0),
+		mMaxReferencesCount(0),
+		mMinOverlapArea(0.f),
+		mNodes(NULL),
+		mIndices(NULL)
+{
+}
+
+void SpatialBVHBuilder::build(const std::vector< BBox >& bounds, const BVHPrimitiveSplitter& splitter, std::vector< BVHNode >* nodes, std::vector< unsigned >* indices)
+{
+	const unsigned count = bounds.size();
+
+	mSplitter = &splitter;
+	mNodes		= nodes;
+	mIndices	= indices;
+
+	std::vector< Reference > references(count);
+	BBox										 rootBounds = BBox::Empty();
+	for (unsigned idx = 0; idx < count; ++idx)
+	{
+		references[idx].Bounds		= bounds[idx];
+		references[idx].Primitive = idx;
+		rootBounds.extend(bounds[idx]);
+	}
+
+	mReferencesCount		= count;
+	mMaxReferencesCount = count + static_cast< unsigned >(count * mDuplicationBudget);
+	mMinOverlapArea			= cMinOverlapShare * rootBounds.getSurfaceArea();
+
+	mNodes->clear();
+	mIndices->clear();
+	mNodes->reserve(2 * mMaxReferencesCount);
+	mIndices->reserve(mMaxReferencesCount);
+
+	buildNode(&references, 0);
+}
+
+unsigned SpatialBVHBuilder::buildNode(std::vector< Reference >* references, unsigned depth)
+{
+	const unsigned count = references->size();
+
+	BBox bounds = BBox::Empty();
+	for (unsigned idx = 0; idx < count; ++idx)
+	{
+		bounds.extend((*references)[idx].Bounds);
+	}
+
+	const unsigned nodeIdx = mNodes->size();
+	mNodes->push_back(BVHNode());
+	(*mNodes)[nodeIdx].Bounds = bounds;
+
+	Split split;
+	bool	found = false;
+	if (count > 1 && depth < cMaxDepth)
+	{
+		found = findObjectSplit(*references, bounds, &split);
+
+		// Spatial split pays off only if object split children overlap, duplicated references must fit into the budget
+		const float overlapArea = found ? split.LeftBounds.overlap(split.RightBounds).getSurfaceArea() : FLT_MAX;
+		Split				spatial;
+		if (overlapArea > mMinOverlapArea && mReferencesCount < mMaxReferencesCount && findSpatialSplit(*references, bounds, &spatial) &&
+				(!found || spatial.Cost < split.Cost) && mReferencesCount + spatial.LeftCount + spatial.RightCount - count <= mMaxReferencesCount)
+		{
+			split = spatial;
+			found = true;
+		}
+	}
+
+	// Splitting is not worth it
+	if (count <= mMaxLeafSize && (!found || split.Cost >= cIntersectionCost * BVHBlocksCount(count, mBlockSize)))
+	{
+		(*mNodes)[nodeIdx].Offset = mIndices->size();
+		(*mNodes)[nodeIdx].Count	= count;
+		(*mNodes)[nodeIdx].Axis		= 0;
+		for (unsigned idx = 0; idx < count; ++idx)
+		{
+			mIndices->push_back((*references)[idx].Primitive);
+		}
+		return nodeIdx;
+	}
+
+	std::vector< Reference > left, right;
+	unsigned								 axis = 0;
+	if (found && split.Spatial)
+	{
+		splitSpace(references, split, &left, &right);
+		axis = split.Axis;
+	}
+	else if (found)
+	{
+		splitObjects(references, split, &left, &right);
+		axis = split.Axis;
+	}
+
+	// Either no split is found, hierarchy is too deep or all the references ended up in one child,
+	// then nothing was duplicated and node references are still intact
+	if (left.empty() || right.empty())
+	{
+		left.clear();
+		right.clear();
+		axis = splitMedian(references, &left, &right);
+	}
+
+	// References of the node aren't needed anymore, so they don't take memory during the whole subtree build
+	std::vector< Reference >().swap(*references);
+
+	// First child follows its parent, so store only second one
+	buildNode(&left, depth + 1);
+	const unsigned secondChild = buildNode(&right, depth + 1);
+
+	(*mNodes)[nodeIdx].Offset = secondChild;
+	(*mNodes)[nodeIdx].Count	= 0;
+	(*mNodes)[nodeIdx].Axis		= axis;
+
+	return nodeIdx;
+}
+
+bool SpatialBVHBuilder::findObjectSplit(const std::vector< Reference >& references, const BBox& bounds, Split* split) const
+{
+	const unsigned count = references.size();
+
+	BBox centroids = BBox::Empty();
+	for (unsigned idx = 0; idx < count; ++idx)
+	{
+		centroids.extend(references[idx].Bounds.getCentroid());
+	}
+
+	const float		 nodeArea	 = bounds.getSurfaceArea();
+	const float		 invArea	 = nodeArea > 0.f ? 1.f / nodeArea : 1.f;
+	const unsigned binsCount = std::min(cObjectBinsCount, count);
+
+	split->Cost = FLT_MAX;
+	for (unsigned axis = 0; axis < 3; ++axis)
+	{
+		const float origin = BVHAxisValue(centroids.Min, axis);
+		const float extent = BVHAxisValue(centroids.Max, axis) - origin;
+		if (extent <= 0.f)
+		{
+			continue;
+		}
+		const float scale = binsCount / extent;
+
+		BBox		 binBounds[cObjectBinsCount];
+		unsigned binCounts[cObjectBinsCount];
+		for (unsigned bin = 0; bin < binsCount; ++bin)
+		{
+			binBounds[bin] = BBox::Empty();
+			binCounts[bin] = 0;
+		}
+
+		for (unsigned idx = 0; idx < count; ++idx)
+		{
+			const unsigned bin = GBin(BVHAxisValue(references[idx].Bounds.getCentroid(), axis), origin, scale, binsCount);
+			binBounds[bin].extend(references[idx].Bounds);
+			++binCounts[bin];
+		}
+
+		// Bounds and counts of references in bins [i, binsCount) for each split
+		BBox		 rightBounds[cObjectBinsCount];
+		unsigned rightCounts[cObjectBinsCount];
+
+		BBox		 right			= BBox::Empty();
+		unsigned rightCount = 0;
+		for (unsigned bin = binsCount - 1; bin > 0; --bin)
+		{
+			right.extend(binBounds[bin]);
+			rightCount			 += binCounts[bin];
+			rightBounds[bin] = right;
+			rightCounts[bin] = rightCount;
+		}
+
+		BBox		 left			 = BBox::Empty();
+		unsigned leftCount = 0;
+		for (unsigned bin = 1; bin < binsCount; ++bin)
+		{
+			left.extend(binBounds[bin - 1]);
+			leftCount += binCounts[bin - 1];
+			if (leftCount == 0 || rightCounts[bin] == 0)
+			{
+				continue;
+			}
+
+			const float cost = getSplitCost(invArea, left, leftCount, rightBounds[bin], rightCounts[bin]);
+			if (cost < split->Cost)
+			{
+				split->Cost				 = cost;
+				split->Spatial		 = false;
+				split->Axis				 = axis;
+				split->Position		 = 0.f;
+				split->BinOrigin	 = origin;
+				split->BinScale		 = scale;
+				split->Bin				 = bin;
+				split->BinsCount	 = binsCount;
+				split->LeftBounds	 = left;
+				split->RightBounds = rightBounds[bin];
+				split->LeftCount	 = leftCount;
+				split->RightCount	 = rightCounts[bin];
+			}
+		}
+	}
+
+	return split->Cost < FLT_MAX;
+}
+
+bool SpatialBVHBuilder::findSpatialSplit(const std::vector< Reference >& references, const BBox& bounds, Split* split) const
+{
+	const unsigned count = references.size();
+
+	const float nodeArea = bounds.getSurfaceArea();
+	const float invArea	 = nodeArea > 0.f ? 1.f / nodeArea : 1.f;
+
+	split->Cost = FLT_MAX;
+	for (unsigned axis = 0; axis < 3; ++axis)
+	{
+		const float origin = BVHAxisValue(bounds.Min, axis);
+		const float extent = BVHAxisValue(bounds.Max, axis) - origin;
+		if (extent <= 0.f)
+		{
+			continue;
+		}
+		const float width = extent / cSpatialBinsCount;
+		const float scale = cSpatialBinsCount / extent;
+
+		// Reference is counted as entering its first bin and exiting its last one, its parts extend all the bins in between
+		BBox		 binBounds[cSpatialBinsCount];
+		unsigned entries[cSpatialBinsCount];
+		unsigned exits[cSpatialBinsCount];
+		for (unsigned bin = 0; bin < cSpatialBinsCount; ++bin)
+		{
+			binBounds[bin] = BBox::Empty();
+			entries[bin]	 = 0;
+			exits[bin]		 = 0;
+		}
+
+		for (unsigned idx = 0; idx < count; ++idx)
+		{
+			const Reference& reference = references[idx];
+			const unsigned	 firstBin	 = GBin(BVHAxisValue(reference.Bounds.Min, axis), origin, scale, cSpatialBinsCount);
+			const unsigned	 lastBin	 = GBin(BVHAxisValue(reference.Bounds.Max, axis), origin, scale, cSpatialBinsCount);
+
+			Reference remaining = reference;
+			for (unsigned bin = firstBin; bin < lastBin; ++bin)
+			{
+				Reference binPart, rest;
+				clip(remaining, axis, origin + width * (bin + 1), &binPart, &rest);
+				binBounds[bin].extend(binPart.Bounds);
+				remaining = rest;
+			}
+			binBounds[lastBin].extend(remaining.Bounds);
+
+			++entries[firstBin];
+			++exits[lastBin];
+		}
+
+		BBox		 rightBounds[cSpatialBinsCount];
+		unsigned rightCounts[cSpatialBinsCount];
+
+		BBox		 right			= BBox::Empty();
+		unsigned rightCount = 0;
+		for (unsigned bin = cSpatialBinsCount - 1; bin > 0; --bin)
+		{
+			right.extend(binBounds[bin]);
+			rightCount			 += exits[bin];
+			rightBounds[bin] = right;
+			rightCounts[bin] = rightCount;
+		}
+
+		BBox		 left			 = BBox::Empty();
+		unsigned leftCount = 0;
+		for (unsigned bin = 1; bin < cSpatialBinsCount; ++bin)
+		{
+			left.extend(binBounds[bin - 1]);
+			leftCount += entries[bin - 1];
+			if (leftCount == 0 || rightCounts[bin] == 0)
+			{
+				continue;
+			}
+
+			const float cost = getSplitCost(invArea, left, leftCount, rightBounds[bin], rightCounts[bin]);
+			if (cost < split->Cost)
+			{
+				split->Cost				 = cost;
+				split->Spatial		 = true;
+				split->Axis				 = axis;
+				split->Position		 = origin + width * bin;
+				split->BinOrigin	 = 0.f;
+				split->BinScale		 = 0.f;
+				split->Bin				 = 0;
+				split->BinsCount	 = 0;
+				split->LeftBounds	 = left;
+				split->RightBounds = rightBounds[bin];
+				split->LeftCount	 = leftCount;
+				split->RightCount	 = rightCounts[bin];
+			}
+		}
+	}
+
+	return split->Cost < FLT_MAX;
+}
+
+void SpatialBVHBuilder::splitObjects(std::vector< Reference >* references, const Split& split, std::vector< Reference >* left, std::vector< Reference >* right) const
+{
+	left->reserve(split.LeftCount);
+	right->reserve(split.RightCount);
+
+	for (unsigned idx = 0; idx < references->size(); ++idx)
+	{
+		const Reference& reference = (*references)[idx];
+		if (GBin(BVHAxisValue(reference.Bounds.getCentroid(), split.Axis), split.BinOrigin, split.BinScale, split.BinsCount) < split.Bin)
+		{
+			left->push_back(reference);
+		}
+		else
+		{
+			right->push_back(reference);
+		}
+	}
+}
+
+void SpatialBVHBuilder::splitSpace(std::vector< Reference >* references, const Split& split, std::vector< Reference >* left, std::vector< Reference >* right)
+{
+	left->reserve(split.LeftCount);
+	right->reserve(split.RightCount);
+
+	// Costs of keeping crossing reference whole are estimated with children bounds from bins
+	const float leftArea	= split.LeftBounds.getSurfaceArea();
+	const float rightArea = split.RightBounds.getSurfaceArea();
+	const float splitCost = leftArea * split.LeftCount + rightArea * split.RightCount;
+
+	for (unsigned idx = 0; idx < references->size(); ++idx)
+	{
+		const Reference& reference = (*references)[idx];
+		if (BVHAxisValue(reference.Bounds.Max, split.Axis) <= split.Position)
+		{
+			left->push_back(reference);
+			continue;
+		}
+		if (BVHAxisValue(reference.Bounds.Min, split.Axis) >= split.Position)
+		{
+			right->push_back(reference);
+			continue;
+		}
+
+		Reference leftPart, rightPart;
+		clip(reference, split.Axis, split.Position, &leftPart, &rightPart);
+		if (leftPart.Bounds.isEmpty())
+		{
+			right->push_back(reference);
+			continue;
+		}
+		if (rightPart.Bounds.isEmpty())
+		{
+			left->push_back(reference);
+			continue;
+		}
+
+		BBox leftWhole = split.LeftBounds;
+		leftWhole.extend(reference.Bounds);
+		BBox rightWhole = split.RightBounds;
+		rightWhole.extend(reference.Bounds);
+
+		const float leftCost	= leftWhole.getSurfaceArea() * split.LeftCount + rightArea * (split.RightCount - 1);
+		const float rightCost = leftArea * (split.LeftCount - 1) + rightWhole.getSurfaceArea() * split.RightCount;
+
+		if (leftCost < splitCost && leftCost <= rightCost)
+		{
+			left->push_back(reference);
+		}
+		else if (rightCost < splitCost)
+		{
+			right->push_back(reference);
+		}
+		else
+		{
+			left->push_back(leftPart);
+			right->push_back(rightPart);
+			++mReferencesCount;
+		}
+	}
+}
+
+unsigned SpatialBVHBuilder::splitMedian(std::vector< Reference >* references, std::vector< Reference >* left, std::vector< Reference >* right) const
+{
+	BBox centroids = BBox::Empty();
+	for (unsigned idx = 0; idx < references->size(); ++idx)
+	{
+		centroids.extend((*references)[idx].Bounds.getCentroid());
+	}
+
+	const Vec3D extent = centroids.Max - centroids.Min;
+
+	unsigned axis = 0;
+	if (extent.y() > BVHAxisValue(extent, axis))
+		axis = 1;
+	if (extent.z() > BVHAxisValue(extent, axis))
+		axis = 2;
+
+	const std::vector< Reference >::iterator middle = references->begin() + references->size() / 2;
+	std::nth_element(references->begin(), middle, references->end(), [&](const Reference& lh, const Reference& rh)
+	{
+		return BVHAxisValue(lh.Bounds.getCentroid(), axis) < BVHAxisValue(rh.Bounds.getCentroid(), axis);
+	});
+
+	left->assign(references->begin(), middle);
+	right->assign(middle, references->end());
+	return axis;
+}
+
+void SpatialBVHBuilder::clip(const Reference& reference, unsigned axis, float position, Reference* left, Reference* right) const
+{
+	mSplitter->split(reference.Primitive, axis, position, &left->Bounds, &right->Bounds);
+
+	left->Bounds		 = left->Bounds.overlap(reference.Bounds);
+	right->Bounds		 = right->Bounds.overlap(reference.Bounds);
+	left->Primitive	 = reference.Primitive;
+	right->Primitive = reference.Primitive;
+}
+
+float SpatialBVHBuilder::getSplitCost(float invArea, const BBox& left, unsigned leftCount, const BBox& right, unsigned rightCount) const
+{
+	return cTraversalCost + cIntersectionCost *
+		(left.getSurfaceArea() * BVHBlocksCount(leftCount, mBlockSize) + right.getSurfaceArea() * BVHBlocksCount(rightCount, mBlockSize)) * invArea;
+}
@@ -0,0 +1,89 @@
+#ifndef GEOMETRY_SPATIALBVH_H
+#define GEOMETRY_SPATIALBVH_H
+
+#include <vector>
+
+#include "geometry/bbox.h"
+#include "geometry/bvh.h"
+
+// Builder of bounding volume hierarchy with spatial splits. Besides splits of primitives by their centroids,
+// node may be split by a plane, then primitives, which cross it, are clipped and referenced by both children.
+// Long thin primitives don't make children overlap then, duplicated references are limited by the budget
+class SpatialBVHBuilder
+{
+public:
+	//! Duplicated references are limited by the share of primitives count
+	SpatialBVHBuilder(unsigned maxLeafSize, unsigned blockSize, float duplicationBudget);
+
+	//! Build nodes of the hierarchy in depth-first order and indices of primitives, referenced by leaves
+	void build(const std::vector< BBox >& bounds, const BVHPrimitiveSplitter& splitter, std::vector< BVHNode >* nodes, std::vector< unsigned >* indices);
+
+private:
+	// Part of the primitive, which belongs to the node
+	struct Reference
+	{
+		BBox		 Bounds;
+		unsigned Primitive;
+	};
+
+	// Best found split of the node references, children bounds and counts are estimated by bins
+	struct Split
+	{
+		float		 Cost;
+		bool		 Spatial;
+		unsigned Axis;
+		float		 Position;	// Spatial split: plane position
+		float		 BinOrigin; // Object split: centroids are mapped to bins by origin and scale, right child starts from the bin
+		float		 BinScale;
+		unsigned Bin;
+		unsigned BinsCount;
+		BBox		 LeftBounds;
+		BBox		 RightBounds;
+		unsigned LeftCount;
+		unsigned RightCount;
+	};
+
+	//! Append node of the references and its subtree, returns index of the appended node
+	unsigned buildNode(std::vector< Reference >* references, unsigned depth);
+
+	//! Find the best split of references by bins of their centroids
+	bool findObjectSplit(const std::vector< Reference >& references, const BBox& bounds, Split* split) const;
+
+	//! Find the best split of references by bins of space, which references may cross
+	bool findSpatialSplit(const std::vector< Reference >& references, const BBox& bounds, Split* split) const;
+
+	//! Split references by their centroids
+	void splitObjects(std::vector< Reference >* references, const Split& split, std::vector< Reference >* left, std::vector< Reference >* right) const;
+
+	//! Split references by the plane, crossing ones are clipped unless it's cheaper to keep them in one child
+	void splitSpace(std::vector< Reference >* references, const Split& split, std::vector< Reference >* left, std::vector< Reference >* right);
+
+	//! Split references in halves by centroids along the widest axis, used when no split is found or hierarchy is too deep
+	unsigned splitMedian(std::vector< Reference >* references, std::vector< Reference >* left, std::vector< Reference >* right) const;
+
+	//! Clip reference by the plane, parts are limited by the reference bounds
+	void clip(const Reference& reference, unsigned axis, float position, Reference* left, Reference* right) const;
+
+	//! Get SAH cost of the inner node, which area is given by its inverse
+	float getSplitCost(float invArea, const BBox& left, unsigned leftCount, const BBox& right, unsigned rightCount) const;
+
+private:
+	// Disable copy and assignment
+	SpatialBVHBuilder(const SpatialBVHBuilder&);
+	SpatialBVHBuilder& operator=(const SpatialBVHBuilder&);
+
+private:
+	unsigned mMaxLeafSize;
+	unsigned mBlockSize;
+	float		 mDuplicationBudget;
+
+	const BVHPrimitiveSplitter* mSplitter;
+	unsigned										mReferencesCount;
+	unsigned										mMaxReferencesCount;
+	float												mMinOverlapArea;
+
+	std::vector< BVHNode >*	mNodes;
+	std::vector< unsigned >* mIndices;
+};
+
+#endif
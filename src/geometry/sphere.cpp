@@ -14,12 +14,12 @@
 #include "sphere.h"
 
 Sphere::Sphere(const Vec3D& center, float radius, Mtrl* material)
-	: mCenter(center),
-		mRadius(radius),
+	: mRadius(radius),
 		mMtrl(material),
 		mIsLight(false)
 {
-	mRadius2 = radius * radius;
+	mGeometry.Center	= center;
+	mGeometry.Radius2 = radius * radius;
 	mVn = Vec3D(0.f, 1.f, 0.f);
 	mVe = Vec3D(1.f, 0.f, 0.f);
 	mVc = cross(mVn, mVe);
@@ -30,79 +30,67 @@ Sphere::~Sphere()
 	delete mMtrl;
 }
 
-CIsect Sphere::intersect(const Ray& ray)
+bool SphereGeometry::intersect(const Ray& ray, CIsect* isect, HitBuffer* hits) const
 {
 	// Solve square equation
-	Vec3D CO = ray.getOrg() - mCenter;
+	Vec3D CO = ray.getOrg() - Center;
 
 	// Let p and q be coefficients of the square equation x^2 + p * x + q = 0
 	float p = dot(ray.getDir(), CO);
-	float q = dot(CO, CO) - mRadius2;
+	float q = dot(CO, CO) - Radius2;
 
 	// Let D be discriminant of the equation
 	float D = p * p - q;
 
 	if (D < 0)
 	{
-		return CIsect(false);
+		return false;
 	}
 
 	D = sqrt(D);
 
-	float				 closest = -1.f;
-	CIsect res(true);
-	
-	// Get closest intersection
-	float root = -p - D;
-	float rayExit = -1.f;
-	if (root >= 0.f)
+	// Roots are sorted, entry is cut off if ray starts inside the sphere or it's out of the ray interval
+	const float rayEntry = -p - D;
+	const float rayExit	 = -p + D;
+
+	float closest;
+	if (ray.contains(rayEntry))
+	{
+		closest = rayEntry;
+	}
+	else if (ray.contains(rayExit))
 	{
-		closest = root;
-		res.Dst.push_back(root);
+		closest = rayExit;
 	}
-	
-	root = -p + D;
-	if (root >= 0.f)
+	else
 	{
-		res.Dst.push_back(root);
-		if (closest < 0.f)
-		{
-			closest = root;
-		}
-		else if (root < closest)
-		{
-			rayExit = closest;
-			closest = root;
-		}
-		else
-		{
-			rayExit = root;
-		}
+		return false;
 	}
 
-	if (closest > 0.f)
+	isect->Exists		= true;
+	isect->Distance = closest;
+	if (hits)
 	{
-		res.Distance = closest;
-		res.Object	 = this;
-		res.Normal	 = getNormal(ray, closest);
-		if (rayExit < 0.f)
-		{
-			res.InsideIntervals.push_back(Span(0.f, closest));
-			res.Dst.insert(res.Dst.begin(), 0.f);
-		}
-		else
-		{
-			res.InsideIntervals.push_back(Span(closest, rayExit));
-		}
-		return res;
+		// If entry is behind, ray starts inside the sphere
+		hits->add(rayEntry < 0.f ? 0.f : rayEntry, true);
+		hits->add(rayExit, false);
 	}
+	return true;
+}
 
-	return CIsect(false);
+CIsect Sphere::intersect(const Ray& ray, HitBuffer* hits)
+{
+	CIsect res(false);
+	if (mGeometry.intersect(ray, &res, hits))
+	{
+		res.Object = this;
+	}
+	return res;
 }
 
 Vec3D Sphere::getNormal(const Ray& ray, float distance, const CIsect& isect /*= CIsect()*/) const
 {
-	Vec3D normal = (ray.apply(distance) - mCenter) / mRadius;
+	Vec3D normal = (ray.apply(distance) - mGeometry.Center) / mRadius;
 	normal.normalize();
 	return normal;
 }
@@ -130,7 +118,7 @@ Color Sphere::getSpcColor(const Vec3D& pnt, const CIsect& isect/* = CIsect()*/)
 
 Vec3D Sphere::getTexCoords(const Vec3D& pnt, const CIsect& isect/* = CIsect()*/) const
 {
-	const Vec3D CO = (pnt - mCenter) / mRadius;
+	const Vec3D CO = (pnt - mGeometry.Center) / mRadius;
 
 	const float phi   = acosf(-dot(CO, mVn));
 	const float theta = (acosf(dot(mVe, CO)) / (sinf(phi))) * (2.f / M_PI);
@@ -149,4 +137,14 @@ Vec3D Sphere::getTexCoords(const Vec3D& pnt, const CIsect& isect/* = CIsect()*/)
 	float v = phi / mMtrl->TexScaleV * (1.f / M_PI);
 
 	return Vec3D(u, v, 0.f);
-}
\ No newline at end of file
+}
+
+BBox Sphere::getBBox() const
+{
+	const Vec3D radius(mRadius, mRadius, mRadius);
+
+	BBox box;
+	box.Min = mGeometry.Center - radius;
+	box.Max = mGeometry.Center + radius;
+	return box;
+}
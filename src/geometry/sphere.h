@@ -6,12 +6,22 @@
 #include "geometry/ray.h"
 #include "geometry/vector3d.h"
 
+// Data of the sphere, which is enough to intersect it, compiled scene keeps it in contiguous arrays
+struct SphereGeometry
+{
+	//! Find closest hit inside of the ray interval, distances of all the hits are added to the buffer, if it's given
+	bool intersect(const Ray& ray, CIsect* isect, HitBuffer* hits = NULL) const;
+
+	Vec3D Center;
+	float Radius2;
+};
+
 class Sphere : public IShape
 {
 public:
 	Sphere(const Vec3D& center, float radius, Mtrl* material);
   virtual ~Sphere();
-  virtual CIsect intersect(const Ray& ray);
+  virtual CIsect intersect(const Ray& ray, HitBuffer* hits = NULL);
 
 	virtual const Mtrl* getMtrl() const
 	{
@@ -34,10 +44,23 @@ public:
 	virtual Color getDifColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
 	virtual Color getSpcColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
  	virtual Vec3D getTexCoords(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
+	virtual BBox getBBox() const;
+
+	const SphereGeometry& getGeometry() const
+	{
+		return mGeometry;
+	}
+
+	//! Move sphere, scene must update its hierarchy before the next frame
+	void setCenter(const Vec3D& center)
+	{
+		mGeometry.Center = center;
+	}
 
 private:
-	Vec3D	mCenter, mVn, mVe, mVc;
-	float mRadius, mRadius2;
+	SphereGeometry mGeometry;
+	Vec3D					 mVn, mVe, mVc;
+	float					 mRadius;
 	
 	Mtrl* mMtrl;
 	bool	mIsLight;
@@ -19,15 +19,15 @@
 #include "torus.h"
 
 Torus::Torus(const Vec3D& center, const Vec3D& axis, float innerRadius, float outerRadius, Mtrl* material)
-	: mCenter(center),
-		mAxis(axis),
-		mInnerRadius(innerRadius),
+	: mInnerRadius(innerRadius),
 		mOuterRadius(outerRadius),
 		mMtrl(material),
 		mIsLight(false)
 {
-	mInnerRadius2 = mInnerRadius * mInnerRadius;
-	mOuterRadius2	= mOuterRadius * mOuterRadius;
+	mGeometry.Center			 = center;
+	mGeometry.Axis				 = axis;
+	mGeometry.InnerRadius2 = mInnerRadius * mInnerRadius;
+	mGeometry.OuterRadius2 = mOuterRadius * mOuterRadius;
 }
 
 Torus::~Torus()
@@ -35,29 +35,29 @@ Torus::~Torus()
 	delete mMtrl;
 }
 
-CIsect Torus::intersect(const Ray& ray)
+bool TorusGeometry::intersect(const Ray& ray, CIsect* isect, HitBuffer* hits) const
 {
 	const Vec3D& rayOrg    = ray.getOrg();
 	const Vec3D& rayDir = ray.getDir();
 
-	const Vec3D CO	 = rayOrg - mCenter;
+	const Vec3D CO	 = rayOrg - Center;
 
 	const float CODotDir   = dot(rayDir, CO);
 
 	const float		 CO2 = dot(CO, CO);
-	const float		 u	 = dot(mAxis, CO);
-	const float		 v   = dot(mAxis, rayDir);
+	const float		 u	 = dot(Axis, CO);
+	const float		 v   = dot(Axis, rayDir);
 	const float		 a   = (1 - v * v); // At general (dot(rayDir, rayDir) - v * v), but ray direction is normalized)
 	const float		 b   = 2 * (dot(CO, rayDir) - u * v);
 	const float    c   = (CO2 - u * u);
-	const float		 d   = (CO2 + mOuterRadius2 - mInnerRadius2);
+	const float		 d   = (CO2 + OuterRadius2 - InnerRadius2);
 
 	//// Let A, B, C, D, E be the coefficients of general quadratic
 	const float A = 1; // As soon as ray direction was normalized A = (P1 * P1)^2
 	const float B = 4 * CODotDir;
-	const float C = 2 * d + B * B * 0.25f - 4 * mOuterRadius2 * a;
-	const float D = B * d - 4 * mOuterRadius2 * b;
-	const float E = d * d - 4 * mOuterRadius2 * c;
+	const float C = 2 * d + B * B * 0.25f - 4 * OuterRadius2 * a;
+	const float D = B * d - 4 * OuterRadius2 * b;
+	const float E = d * d - 4 * OuterRadius2 * c;
 
 	// Now solve quadratic, extern solver requires double array as result for roots
 	const int cRootsCount = 4;
@@ -68,51 +68,67 @@ CIsect Torus::intersect(const Ray& ray)
 
 	if (rootsCount == 0)
 	{
-		return CIsect(false);
+		return false;
 	}
 
-	// Sort found roots and get the lowest positive solution
-	std::sort(solutions, solutions + cRootsCount);
+	// Sort found roots and get the lowest positive solution, only rootsCount of them are initialized
+	std::sort(solutions, solutions + rootsCount);
 
-	int					 closest = 0;
-	CIsect res(true);
-	// Find first positive solution in sorted array
-	for (int idx = 0; idx < cRootsCount; ++idx)
+	int					 closest = -1;
+	// Find first solution inside of the ray interval in sorted array
+	for (int idx = 0; idx < rootsCount; ++idx)
 	{
 		const float t = solutions[idx];
-		if (t > 0.f)
+		if (ray.contains(t))
 		{
 			closest = idx;
 			break;
 		}
 	}
 
-	// Store all intersections
-	if (closest < cRootsCount && closest > 0.f)
+	// Store all the intersections in front of the ray
+	if (closest >= 0)
 	{
-		for (int idx = closest; idx < cRootsCount; ++idx)
+		for (int idx = 0; idx < rootsCount && hits; ++idx)
 		{
-			res.Dst.push_back(solutions[idx]);
+			const float t = solutions[idx];
+			if (t > 0.f)
+			{
+				// Ray enters the torus, where its equation decreases along the ray, the gradient is scaled by 1/4
+				const Vec3D p				 = CO + rayDir * t;
+				const float pDotDir	 = CODotDir + t;
+				const float gradient = (dot(p, p) + OuterRadius2 - InnerRadius2) * pDotDir - 2 * OuterRadius2 * (pDotDir - dot(Axis, p) * v);
+				hits->add(t, gradient < 0.f);
+			}
 		}
 
-		res.Distance = solutions[closest];
-		res.Object	 = this;
-		res.Normal	 = getNormal(ray, solutions[closest]);
+		isect->Exists		= true;
+		isect->Distance = solutions[closest];
 
-		return res;
+		return true;
 	}
 
-	return CIsect(false);
+	return false;
+}
+
+CIsect Torus::intersect(const Ray& ray, HitBuffer* hits)
+{
+	CIsect res(false);
+	if (mGeometry.intersect(ray, &res, hits))
+	{
+		res.Object = this;
+	}
+	return res;
 }
 
 
 Vec3D Torus::getNormal(const Ray& ray, float distance, const CIsect& isect /*= CIsect()*/) const
 {
 	const Vec3D atSurface = ray.apply(distance);
-	const float		 y = dot((atSurface - mCenter), mAxis);
-	const Vec3D D = ((atSurface - mCenter) - y * mAxis).toUnit();
+	const float		 y = dot((atSurface - mGeometry.Center), mGeometry.Axis);
+	const Vec3D D = ((atSurface - mGeometry.Center) - y * mGeometry.Axis).toUnit();
 	const Vec3D X = D * mOuterRadius;
-	return (atSurface - mCenter + X).toUnit();
+	return (atSurface - mGeometry.Center + X).toUnit();
 }
 
 Color Torus::getAmbColor(const Vec3D& pnt, const CIsect& isect/* = CIsect()*/) const
@@ -140,3 +156,15 @@ Vec3D Torus::getTexCoords(const Vec3D& pnt, const CIsect& isect/* = CIsect()*/)
 	// TODO:
 	return Vec3D();
 }
+
+BBox Torus::getBBox() const
+{
+	// Conservative box, which doesn't take axis orientation into account
+	const float radius = mOuterRadius + mInnerRadius;
+	const Vec3D extent(radius, radius, radius);
+
+	BBox box;
+	box.Min = mGeometry.Center - extent;
+	box.Max = mGeometry.Center + extent;
+	return box;
+}
@@ -6,12 +6,22 @@
 #include "geometry/ray.h"
 #include "geometry/vector3d.h"
 
+// Data of the torus, which is enough to intersect it, compiled scene keeps it in contiguous arrays
+struct TorusGeometry
+{
+	//! Find closest hit inside of the ray interval, distances of all the hits are added to the buffer, if it's given
+	bool intersect(const Ray& ray, CIsect* isect, HitBuffer* hits = NULL) const;
+
+	Vec3D Center, Axis;
+	float InnerRadius2, OuterRadius2;
+};
+
 class Torus : public IShape
 {
 public:
 	explicit Torus(const Vec3D& center, const Vec3D& axis, float innerRadius, float outedRadius, Mtrl* material);
 	virtual ~Torus();
-	virtual CIsect intersect(const Ray& ray);
+	virtual CIsect intersect(const Ray& ray, HitBuffer* hits = NULL);
 	virtual const Mtrl* getMtrl() const
 	{
 		return mMtrl;
@@ -29,10 +39,16 @@ public:
 	virtual Color getDifColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
 	virtual Color getSpcColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
 	virtual Vec3D getTexCoords(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
+	virtual BBox getBBox() const;
+
+	const TorusGeometry& getGeometry() const
+	{
+		return mGeometry;
+	}
 
 private:
-	Vec3D	mCenter, mAxis;
-	float mInnerRadius, mOuterRadius, mInnerRadius2, mOuterRadius2;
+	TorusGeometry mGeometry;
+	float					mInnerRadius, mOuterRadius;
 	Mtrl* mMtrl;
 	bool mIsLight;
 };
@@ -0,0 +1,157 @@
+//-------------------------------------------------------------------
+// File: transform.cpp
+// 
+// Affine transformation implementation
+//
+//  
+//-------------------------------------------------------------------
+
+#include <math.h>
+
+#include "transform.h"
+
+Transform::Transform()
+{
+	for (int row = 0; row < 3; ++row)
+	{
+		for (int col = 0; col < 4; ++col)
+		{
+			mM[row][col] = (row == col) ? 1.f : 0.f;
+		}
+	}
+}
+
+Transform Transform::Translation(const Vec3D& offset)
+{
+	Transform result;
+	result.mM[0][3] = offset.x();
+	result.mM[1][3] = offset.y();
+	result.mM[2][3] = offset.z();
+	return result;
+}
+
+Transform Transform::Scaling(const Vec3D& factors)
+{
+	Transform result;
+	result.mM[0][0] = factors.x();
+	result.mM[1][1] = factors.y();
+	result.mM[2][2] = factors.z();
+	return result;
+}
+
+Transform Transform::Rotation(const Vec3D& axis, float angle)
+{
+	// Rodrigues' rotation formula
+	Vec3D a = axis;
+	a.normalize();
+
+	const float c = cosf(angle);
+	const float s = sinf(angle);
+	const float t = 1.f - c;
+
+	Transform result;
+	result.mM[0][0] = t * a.x() * a.x() + c;
+	result.mM[0][1] = t * a.x() * a.y() - s * a.z();
+	result.mM[0][2] = t * a.x() * a.z() + s * a.y();
+
+	result.mM[1][0] = t * a.x() * a.y() + s * a.z();
+	result.mM[1][1] = t * a.y() * a.y() + c;
+	result.mM[1][2] = t * a.y() * a.z() - s * a.x();
+
+	result.mM[2][0] = t * a.x() * a.z() - s * a.y();
+	result.mM[2][1] = t * a.y() * a.z() + s * a.x();
+	result.mM[2][2] = t * a.z() * a.z() + c;
+	return result;
+}
+
+Transform Transform::operator*(const Transform& rh) const
+{
+	Transform result;
+	for (int row = 0; row < 3; ++row)
+	{
+		for (int col = 0; col < 4; ++col)
+		{
+			float value = 0.f;
+			for (int k = 0; k < 3; ++k)
+			{
+				value += mM[row][k] * rh.mM[k][col];
+			}
+			// Translation column of the implicit last row (0, 0, 0, 1)
+			if (col == 3)
+			{
+				value += mM[row][3];
+			}
+			result.mM[row][col] = value;
+		}
+	}
+	return result;
+}
+
+Transform Transform::inverse() const
+{
+	// Inverse of linear part via cofactors
+	const float (&m)[3][4] = mM;
+	const float c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+	const float c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+	const float c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+
+	const float det		= m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+	const float invDet = 1.f / det;
+
+	Transform result;
+	result.mM[0][0] = c00 * invDet;
+	result.mM[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * invDet;
+	result.mM[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * invDet;
+
+	result.mM[1][0] = c01 * invDet;
+	result.mM[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * invDet;
+	result.mM[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * invDet;
+
+	result.mM[2][0] = c02 * invDet;
+	result.mM[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * invDet;
+	result.mM[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * invDet;
+
+	// Inverse translation is -inv(M) * t
+	const Vec3D translation = result.applyToVector(Vec3D(m[0][3], m[1][3], m[2][3]));
+	result.mM[0][3] = -translation.x();
+	result.mM[1][3] = -translation.y();
+	result.mM[2][3] = -translation.z();
+	return result;
+}
+
+Vec3D Transform::applyToPoint(const Vec3D& pnt) const
+{
+	return applyToVector(pnt) + Vec3D(mM[0][3], mM[1][3], mM[2][3]);
+}
+
+Vec3D Transform::applyToVector(const Vec3D& vec) const
+{
+	return Vec3D(mM[0][0] * vec.x() + mM[0][1] * vec.y() + mM[0][2] * vec.z(),
+							 mM[1][0] * vec.x() + mM[1][1] * vec.y() + mM[1][2] * vec.z(),
+							 mM[2][0] * vec.x() + mM[2][1] * vec.y() + mM[2][2] * vec.z());
+}
+
+Vec3D Transform::applyTransposed(const Vec3D& vec) const
+{
+	return Vec3D(mM[0][0] * vec.x() + mM[1][0] * vec.y() + mM[2][0] * vec.z(),
+							 mM[0][1] * vec.x() + mM[1][1] * vec.y() + mM[2][1] * vec.z(),
+							 mM[0][2] * vec.x() + mM[1][2] * vec.y() + mM[2][2] * vec.z());
+}
+
+BBox Transform::applyToBBox(const BBox& box) const
+{
+	if (box.isEmpty())
+	{
+		return box;
+	}
+
+	BBox result = BBox::Empty();
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		const Vec3D pnt((corner & 1) ? box.Max.x() : box.Min.x(),
+										(corner & 2) ? box.Max.y() : box.Min.y(),
+										(corner & 4) ? box.Max.z() : box.Min.z());
+		result.extend(applyToPoint(pnt));
+	}
+	return result;
+}
@@ -0,0 +1,42 @@
+#ifndef GEOMETRY_TRANSFORM_H
+#define GEOMETRY_TRANSFORM_H
+
+#include "geometry/bbox.h"
+#include "geometry/vector3d.h"
+
+// Affine transformation, stored as 3x3 linear part and translation column
+class Transform
+{
+public:
+	//! Create identity transformation
+	explicit Transform();
+
+	static Transform Translation(const Vec3D& offset);
+
+	static Transform Scaling(const Vec3D& factors);
+
+	//! Rotation around given axis, angle is in radians
+	static Transform Rotation(const Vec3D& axis, float angle);
+
+	//! Compose transformations, rh is applied first
+	Transform operator*(const Transform& rh) const;
+
+	//! Get inverse transformation, linear part must be non-degenerate
+	Transform inverse() const;
+
+	Vec3D applyToPoint(const Vec3D& pnt) const;
+
+	//! Apply only linear part, so translation doesn't affect directions
+	Vec3D applyToVector(const Vec3D& vec) const;
+
+	//! Apply transposed linear part, used to transform normals with the inverse transformation
+	Vec3D applyTransposed(const Vec3D& vec) const;
+
+	//! Get bounding box of the transformed box
+	BBox applyToBBox(const BBox& box) const;
+
+private:
+	float mM[3][4];
+};
+
+#endif
@@ -2,13 +2,13 @@
 // File: triangle.h
 // 
 // Triangle scene object implementation
-//			 Algorithm can be found here, so don't get confused with identifier names
-//			 http://geomalgorithms.com/a06-_intersect-2.html
+//			 Intersection routine is shared with mesh triangle blocks, see triangleblock.cpp
 //
 //  
 //-------------------------------------------------------------------
 
 #include "illumination/material.h"
+#include "triangleblock.h"
 
 #include "triangle.h"
 	
@@ -18,62 +18,35 @@ Triangle::~Triangle()
 	delete mMtrl;
 }
 
-CIsect Triangle::intersect(const Ray& ray)
+bool TriangleGeometry::intersect(const Ray& ray, CIsect* isect, HitBuffer* hits) const
 {
-	const Vec3D& origin	  = ray.getOrg();
-	const Vec3D& direction = ray.getDir();
-
-	const Vec3D e1 = mV1 - mV0;
-	const Vec3D e2 = mV2 - mV0;
-
-	const Vec3D pvec = cross(direction, e2);
-	const float		 det  = dot(e1, pvec);
-
-	if (fabs(det) < FLOAT_ZERO)
-	{
-		return CIsect(false);
-	}
-
-	const float invDet = 1.f / det;
-
-	const Vec3D tvec		= origin - mV0;
-	float					 lambda = dot(tvec, pvec);
-
-	lambda *= invDet;
-
-	if (lambda < 0.f || lambda > 1.f)
+	float distance, u, v;
+	if (!IntersectTriangle(V0, E1, E2, ray, &distance, &u, &v) || !ray.contains(distance))
 	{
-		return CIsect(false);
+		return false;
 	}
 
-	const Vec3D qvec = cross(tvec, e1);
-	float					 mue	= dot(direction, qvec);
-
-	mue *= invDet;
-
-	if (mue < 0.f || mue + lambda > 1.f)
+	if (hits)
 	{
-		return CIsect(false);
+		hits->add(distance, dot(cross(E1, E2), ray.getDir()) < 0.f);
 	}
 
-	float f = dot(e2, qvec);
-	f = f * invDet - FLOAT_ZERO;
+	// Normal and texture coordinates are evaluated later, only if the hit is the closest one
+	isect->Exists		= true;
+	isect->Distance = distance;
+	isect->U				= u;
+	isect->V				= v;
+	return true;
+}
 
-	if (f < FLOAT_ZERO)
+CIsect Triangle::intersect(const Ray& ray, HitBuffer* hits)
+{
+	CIsect res(false);
+	if (mGeometry.intersect(ray, &res, hits))
 	{
-		return CIsect(false);
+		res.Object = this;
 	}
-
-	CIsect isect(true, f, this);
-	
-	isect.Dst.push_back(f);
-
-	isect.U = lambda;
-	isect.V = mue;
-	isect.Normal    = getNormal(ray, f, isect); // CIsect data may be needed in subclasses
-  isect.TexCoords = getTexCoords(ray.apply(f), isect);
-
-	return isect;
+	return res;
 }
 
 Color Triangle::getAmbColor(const Vec3D& pnt, const CIsect& isect/* = CIsect()*/) const
@@ -98,5 +71,14 @@ Color Triangle::getSpcColor(const Vec3D& pnt, const CIsect& isect/* = CIsect()*/
 
 Vec3D Triangle::getTexCoords(const Vec3D& pnt, const CIsect& isect/* = CIsect()*/) const
 {
-	return isect.U * mV1 + isect.V * mV2 + (1 - isect.U - isect.V) * mV0;
+	return isect.U * mV1 + isect.V * mV2 + (1 - isect.U - isect.V) * mGeometry.V0;
+}
+
+BBox Triangle::getBBox() const
+{
+	BBox box = BBox::Empty();
+	box.extend(mGeometry.V0);
+	box.extend(mV1);
+	box.extend(mV2);
+	return box;
 }
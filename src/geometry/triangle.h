@@ -3,22 +3,33 @@
 
 #include "interfaces/ishape.h"
 	
+// Data of the triangle, which is enough to intersect it, compiled scene keeps it in contiguous arrays
+struct TriangleGeometry
+{
+	//! Find hit inside of the ray interval with its barycentric coordinates, distance is added to the buffer, if it's given
+	bool intersect(const Ray& ray, CIsect* isect, HitBuffer* hits = NULL) const;
+
+	Vec3D V0;
+	// Edges are precomputed for intersection
+	Vec3D E1, E2;
+};
+
 class Triangle : public IShape
 {
 public:
 	explicit Triangle(const Vec3D& v0, const Vec3D& v1, const Vec3D& v2, Mtrl* material)
-	: mV0(v0),
-		mV1(v1),
+	: mV1(v1),
 		mV2(v2),
 		mMtrl(material),
 		mIsLight(false)
 	{
-		Vec3D e1 = v1 - v0;
-		Vec3D e2 = v2 - v0;
-		mNormal = cross(e1, e2).toUnit();
+		mGeometry.V0 = v0;
+		mGeometry.E1 = v1 - v0;
+		mGeometry.E2 = v2 - v0;
+		mNormal			 = cross(mGeometry.E1, mGeometry.E2).toUnit();
 	}
 	virtual ~Triangle();
-	virtual CIsect intersect(const Ray& ray);
+	virtual CIsect intersect(const Ray& ray, HitBuffer* hits = NULL);
 	virtual const Mtrl* getMtrl() const
 	{
 		return mMtrl;
@@ -43,9 +54,16 @@ public:
 	virtual Color getDifColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
 	virtual Color getSpcColor(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
 	virtual Vec3D getTexCoords(const Vec3D& pnt, const CIsect& isect = CIsect()) const;
+	virtual BBox getBBox() const;
+
+	const TriangleGeometry& getGeometry() const
+	{
+		return mGeometry;
+	}
 
 private:
-	Vec3D mV0, mV1, mV2, mNormal;		
+	TriangleGeometry mGeometry;
+	Vec3D						 mV1, mV2, mNormal;
 	Mtrl *mMtrl;
 	bool mIsLight;
 };
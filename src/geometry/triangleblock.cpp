@@ -0,0 +1,263 @@
+//-------------------------------------------------------------------
+// File: triangleblock.cpp
+// 
+// SIMD triangle block intersection kernels
+//			 Kernel is chosen at startup by CPU features, so one binary runs on CPUs with and without AVX2.
+//			 All the kernels repeat scalar operations in the same order, so results don't depend on the chosen one
+//
+//  
+//-------------------------------------------------------------------
+
+#include <string.h>
+
+#include "cpufeatures.h"
+
+#include "triangleblock.h"
+
+namespace
+{
+	typedef unsigned (*TriangleBlockKernel)(const TriangleBlock& block, const Ray& ray, TriangleBlockHits* hits);
+
+	unsigned GIntersectScalar(const TriangleBlock& block, const Ray& ray, TriangleBlockHits* hits)
+	{
+		unsigned mask = 0;
+		for (unsigned lane = 0; lane < TRIANGLE_BLOCK_SIZE; ++lane)
+		{
+			const Vec3D v0(block.V0[0][lane], block.V0[1][lane], block.V0[2][lane]);
+			const Vec3D e1(block.E1[0][lane], block.E1[1][lane], block.E1[2][lane]);
+			const Vec3D e2(block.E2[0][lane], block.E2[1][lane], block.E2[2][lane]);
+
+			if (IntersectTriangle(v0, e1, e2, ray, &hits->Distance[lane], &hits->U[lane], &hits->V[lane]))
+			{
+				mask |= 1 << lane;
+			}
+		}
+		return mask;
+	}
+
+#ifdef CPU_X86
+	TARGET_SSE2 unsigned GIntersectSSE(const TriangleBlock& block, const Ray& ray, TriangleBlockHits* hits)
+	{
+		const Vec3D& origin		= ray.getOrg();
+		const Vec3D& direction = ray.getDir();
+
+		const __m128 ox = _mm_set1_ps(origin.x());
+		const __m128 oy = _mm_set1_ps(origin.y());
+		const __m128 oz = _mm_set1_ps(origin.z());
+		const __m128 dx = _mm_set1_ps(direction.x());
+		const __m128 dy = _mm_set1_ps(direction.y());
+		const __m128 dz = _mm_set1_ps(direction.z());
+
+		const __m128 zero		 = _mm_setzero_ps();
+		const __m128 one		 = _mm_set1_ps(1.f);
+		const __m128 epsilon = _mm_set1_ps(FLOAT_ZERO);
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+		unsigned mask = 0;
+		for (unsigned base = 0; base < TRIANGLE_BLOCK_SIZE; base += 4)
+		{
+			const __m128 e1x = _mm_loadu_ps(block.E1[0] + base);
+			const __m128 e1y = _mm_loadu_ps(block.E1[1] + base);
+			const __m128 e1z = _mm_loadu_ps(block.E1[2] + base);
+			const __m128 e2x = _mm_loadu_ps(block.E2[0] + base);
+			const __m128 e2y = _mm_loadu_ps(block.E2[1] + base);
+			const __m128 e2z = _mm_loadu_ps(block.E2[2] + base);
+
+			// pvec = cross(direction, e2)
+			const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+			const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+			const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+
+			const __m128 det		= _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+			const __m128 invDet = _mm_div_ps(one, det);
+
+			// tvec = origin - v0
+			const __m128 tx = _mm_sub_ps(ox, _mm_loadu_ps(block.V0[0] + base));
+			const __m128 ty = _mm_sub_ps(oy, _mm_loadu_ps(block.V0[1] + base));
+			const __m128 tz = _mm_sub_ps(oz, _mm_loadu_ps(block.V0[2] + base));
+
+			const __m128 lambda = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), invDet);
+
+			// qvec = cross(tvec, e1)
+			const __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+			const __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+			const __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+
+			const __m128 mue = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+			const __m128 f	 = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet),
+																epsilon);
+
+			__m128 rejected = _mm_cmplt_ps(_mm_and_ps(det, absMask), epsilon);
+			rejected = _mm_or_ps(rejected, _mm_or_ps(_mm_cmplt_ps(lambda, zero), _mm_cmpgt_ps(lambda, one)));
+			rejected = _mm_or_ps(rejected, _mm_or_ps(_mm_cmplt_ps(mue, zero), _mm_cmpgt_ps(_mm_add_ps(mue, lambda), one)));
+			rejected = _mm_or_ps(rejected, _mm_cmplt_ps(f, epsilon));
+
+			_mm_storeu_ps(hits->Distance + base, f);
+			_mm_storeu_ps(hits->U + base, lambda);
+			_mm_storeu_ps(hits->V + base, mue);
+
+			mask |= (~_mm_movemask_ps(rejected) & 0xf) << base;
+		}
+		return mask;
+	}
+
+	TARGET_AVX2 unsigned GIntersectAVX2(const TriangleBlock& block, const Ray& ray, TriangleBlockHits* hits)
+	{
+		const Vec3D& origin		= ray.getOrg();
+		const Vec3D& direction = ray.getDir();
+
+		const __m256 dx = _mm256_set1_ps(direction.x());
+		const __m256 dy = _mm256_set1_ps(direction.y());
+		const __m256 dz = _mm256_set1_ps(direction.z());
+
+		const __m256 zero		 = _mm256_setzero_ps();
+		const __m256 one		 = _mm256_set1_ps(1.f);
+		const __m256 epsilon = _mm256_set1_ps(FLOAT_ZERO);
+		const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+		const __m256 e1x = _mm256_loadu_ps(block.E1[0]);
+		const __m256 e1y = _mm256_loadu_ps(block.E1[1]);
+		const __m256 e1z = _mm256_loadu_ps(block.E1[2]);
+		const __m256 e2x = _mm256_loadu_ps(block.E2[0]);
+		const __m256 e2y = _mm256_loadu_ps(block.E2[1]);
+		const __m256 e2z = _mm256_loadu_ps(block.E2[2]);
+
+		// pvec = cross(direction, e2)
+		const __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+		const __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+		const __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+
+		const __m256 det		= _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+		const __m256 invDet = _mm256_div_ps(one, det);
+
+		// tvec = origin - v0
+		const __m256 tx = _mm256_sub_ps(_mm256_set1_ps(origin.x()), _mm256_loadu_ps(block.V0[0]));
+		const __m256 ty = _mm256_sub_ps(_mm256_set1_ps(origin.y()), _mm256_loadu_ps(block.V0[1]));
+		const __m256 tz = _mm256_sub_ps(_mm256_set1_ps(origin.z()), _mm256_loadu_ps(block.V0[2]));
+
+		const __m256 lambda = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, px), _mm256_mul_ps(ty, py)), _mm256_mul_ps(tz, pz)), invDet);
+
+		// qvec = cross(tvec, e1)
+		const __m256 qx = _mm256_sub_ps(_mm256_mul_ps(ty, e1z), _mm256_mul_ps(tz, e1y));
+		const __m256 qy = _mm256_sub_ps(_mm256_mul_ps(tz, e1x), _mm256_mul_ps(tx, e1z));
+		const __m256 qz = _mm256_sub_ps(_mm256_mul_ps(tx, e1y), _mm256_mul_ps(ty, e1x));
+
+		const __m256 mue = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), invDet);
+		const __m256 f	 = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), invDet),
+																 epsilon);
+
+		__m256 rejected = _mm256_cmp_ps(_mm256_and_ps(det, absMask), epsilon, _CMP_LT_OQ);
+		rejected = _mm256_or_ps(rejected, _mm256_or_ps(_mm256_cmp_ps(lambda, zero, _CMP_LT_OQ), _mm256_cmp_ps(lambda, one, _CMP_GT_OQ)));
+		rejected = _mm256_or_ps(rejected, _mm256_or_ps(_mm256_cmp_ps(mue, zero, _CMP_LT_OQ), _mm256_cmp_ps(_mm256_add_ps(mue, lambda), one, _CMP_GT_OQ)));
+		rejected = _mm256_or_ps(rejected, _mm256_cmp_ps(f, epsilon, _CMP_LT_OQ));
+
+		_mm256_storeu_ps(hits->Distance, f);
+		_mm256_storeu_ps(hits->U, lambda);
+		_mm256_storeu_ps(hits->V, mue);
+
+		return ~_mm256_movemask_ps(rejected) & 0xff;
+	}
+#endif
+
+	struct KernelInfo
+	{
+		TriangleBlockKernel Kernel;
+		const char*					Name;
+	};
+
+	KernelInfo GSelectKernel()
+	{
+		KernelInfo info = { GIntersectScalar, "scalar" };
+	#ifdef CPU_X86
+		if (CpuHasAVX2())
+		{
+			info.Kernel = GIntersectAVX2;
+			info.Name		= "AVX2";
+		}
+		else if (CpuHasSSE2())
+		{
+			info.Kernel = GIntersectSSE;
+			info.Name		= "SSE2";
+		}
+	#endif
+		return info;
+	}
+
+	// Chosen once, before rendering threads are started
+	static const KernelInfo cKernel = GSelectKernel();
+}
+
+// Algorithm can be found here, so don't get confused with identifier names
+// http://geomalgorithms.com/a06-_intersect-2.html
+bool IntersectTriangle(const Vec3D& v0, const Vec3D& e1, const Vec3D& e2, const Ray& ray, float* distance, float* u, float* v)
+{
+	const Vec3D& origin		= ray.getOrg();
+	const Vec3D& direction = ray.getDir();
+
+	const Vec3D pvec = cross(direction, e2);
+	const float det	 = dot(e1, pvec);
+
+	if (fabs(det) < FLOAT_ZERO)
+	{
+		return false;
+	}
+
+	const float invDet = 1.f / det;
+
+	const Vec3D tvec	 = origin - v0;
+	const float lambda = dot(tvec, pvec) * invDet;
+
+	if (lambda < 0.f || lambda > 1.f)
+	{
+		return false;
+	}
+
+	const Vec3D qvec = cross(tvec, e1);
+	const float mue	 = dot(direction, qvec) * invDet;
+
+	if (mue < 0.f || mue + lambda > 1.f)
+	{
+		return false;
+	}
+
+	const float f = dot(e2, qvec) * invDet - FLOAT_ZERO;
+
+	if (f < FLOAT_ZERO)
+	{
+		return false;
+	}
+
+	*distance = f;
+	*u				= lambda;
+	*v				= mue;
+
+	return true;
+}
+
+const char* TriangleBlock::GetKernelName()
+{
+	return cKernel.Name;
+}
+
+TriangleBlock::TriangleBlock()
+{
+	// Zero edges make all the lanes degenerate
+	memset(this, 0, sizeof(TriangleBlock));
+}
+
+void TriangleBlock::set(unsigned lane, const Vec3D& v0, const Vec3D& v1, const Vec3D& v2, unsigned primId)
+{
+	const Vec3D e1 = v1 - v0;
+	const Vec3D e2 = v2 - v0;
+
+	V0[0][lane] = v0.x(); V0[1][lane] = v0.y(); V0[2][lane] = v0.z();
+	E1[0][lane] = e1.x(); E1[1][lane] = e1.y(); E1[2][lane] = e1.z();
+	E2[0][lane] = e2.x(); E2[1][lane] = e2.y(); E2[2][lane] = e2.z();
+
+	PrimIds[lane] = primId;
+}
+
+unsigned TriangleBlock::intersect(const Ray& ray, TriangleBlockHits* hits) const
+{
+	return cKernel.Kernel(*this, ray, hits);
+}
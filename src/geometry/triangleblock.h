@@ -0,0 +1,40 @@
+#ifndef GEOMETRY_TRIANGLEBLOCK_H
+#define GEOMETRY_TRIANGLEBLOCK_H
+
+#include "geometry/ray.h"
+
+#define TRIANGLE_BLOCK_SIZE 8
+
+//! Moller-Trumbore intersection of the ray with triangle, given by its first vertex and precomputed edges
+bool IntersectTriangle(const Vec3D& v0, const Vec3D& e1, const Vec3D& e2, const Ray& ray, float* distance, float* u, float* v);
+
+// Intersections of the ray with triangles of the block, only lanes from the returned mask are valid
+struct TriangleBlockHits
+{
+	float Distance[TRIANGLE_BLOCK_SIZE];
+	float U[TRIANGLE_BLOCK_SIZE];
+	float V[TRIANGLE_BLOCK_SIZE];
+};
+
+// Triangles, stored as structure of arrays, so one ray is tested against the whole block with SIMD instructions.
+// Edges are precomputed, unused lanes are degenerate triangles, which are never hit
+struct TriangleBlock
+{
+	//! Get name of the kernel, chosen for this CPU
+	static const char* GetKernelName();
+
+	explicit TriangleBlock();
+
+	//! Put triangle into given lane, primId is reported back on intersection
+	void set(unsigned lane, const Vec3D& v0, const Vec3D& v1, const Vec3D& v2, unsigned primId);
+
+	//! Intersect all the triangles of the block, returns mask of hit lanes
+	unsigned intersect(const Ray& ray, TriangleBlockHits* hits) const;
+
+	float		 V0[3][TRIANGLE_BLOCK_SIZE];
+	float		 E1[3][TRIANGLE_BLOCK_SIZE];
+	float		 E2[3][TRIANGLE_BLOCK_SIZE];
+	unsigned PrimIds[TRIANGLE_BLOCK_SIZE];
+};
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef GEOMETRY_VECTOR3DSCALAR_H
+#define GEOMETRY_VECTOR3DSCALAR_H
+#include <math.h>
+
+#include "precision.h"
+
+// Vector of three scalar floats, it's the default backend of Vec3D
+class Vec3DScalar
+{
+	friend Vec3DScalar operator+(const Vec3DScalar& lh, const Vec3DScalar& rh);
+
+	friend Vec3DScalar operator-(const Vec3DScalar& lh, const Vec3DScalar& rh);
+
+	friend Vec3DScalar operator*(const Vec3DScalar& lh, float value);
+
+	friend Vec3DScalar operator*(float value, const Vec3DScalar& rh);
+
+	friend Vec3DScalar operator/(const Vec3DScalar& lh, float value);
+
+	friend Vec3DScalar operator-(const Vec3DScalar& v);
+
+	friend float dot(const Vec3DScalar& lh, const Vec3DScalar& rh);
+
+	friend Vec3DScalar cross(const Vec3DScalar& lh, const Vec3DScalar& rh);
+
+	friend float length(const Vec3DScalar& v);
+
+	friend float length2(const Vec3DScalar& v);
+
+	friend Vec3DScalar scale3D(const Vec3DScalar& lh, const Vec3DScalar& rh);
+
+public:
+
+	Vec3DScalar()
+		: mX(0.f),
+			mY(0.f),
+			mZ(0.f)
+	{
+
+	}
+
+	Vec3DScalar(float x, float y, float z)
+		: mX(x), mY(y), mZ(z)
+	{
+
+	}
+
+	float x() const
+	{
+		return mX;
+	}
+
+	float y() const
+	{
+		return mY;
+	}
+
+	float z() const
+	{
+		return mZ;
+	}
+
+	void setX(float x) 
+	{
+		mX = x;
+	}
+
+	void setY(float y)
+	{
+		mY = y;
+	}
+
+	void setZ(float z)
+	{
+		mZ = z;
+	}
+
+	void setXYZ(float x, float y, float z)
+	{
+		mX = x; mY = y; mZ = z;
+	}
+
+	Vec3DScalar& operator+=(const Vec3DScalar& rh)
+	{
+		mX += rh.mX;
+		mY += rh.mY;
+		mZ += rh.mZ;
+		return *this;
+	}
+
+	Vec3DScalar& operator-=(const Vec3DScalar& rh)
+	{
+		mX -= rh.mX;
+		mY -= rh.mY;
+		mZ -= rh.mZ;
+		return *this;
+	}
+
+	Vec3DScalar& operator*=(float value)
+	{
+		mX *= value;
+		mY *= value;
+		mZ *= value;
+		return *this;
+	}
+
+	Vec3DScalar& operator/=(float value)
+	{
+		mX /= value;
+		mY /= value;
+		mZ /= value;
+		return *this;
+	}
+
+	void normalize()
+	{
+		float len = length(*this);
+		if (len != 0.f)
+			*this /= len;
+	}
+
+  Vec3DScalar& toUnit()
+	{
+		normalize();
+		return *this;
+	}
+
+	Vec3DScalar inverse() const
+	{
+		return Vec3DScalar(1.f / mX, 1.f / mY, 1.f / mZ);
+	}
+
+	Vec3DScalar absolute() const
+	{
+		return Vec3DScalar(fabs(mX), fabs(mY), fabs(mZ));
+	}
+
+private:
+	float mX, mY, mZ;
+};
+
+inline Vec3DScalar operator+(const Vec3DScalar& lh, const Vec3DScalar& rh)
+{
+	return Vec3DScalar(lh.mX + rh.mX, lh.mY + rh.mY, lh.mZ + rh.mZ);
+}
+
+inline Vec3DScalar operator-(const Vec3DScalar& lh, const Vec3DScalar& rh)
+{
+	return Vec3DScalar(lh.mX - rh.mX, lh.mY - rh.mY, lh.mZ - rh.mZ);
+}
+
+inline Vec3DScalar operator*(const Vec3DScalar& lh, float value)
+{
+	return Vec3DScalar(lh.mX * value, lh.mY * value, lh.mZ * value);
+}
+
+inline Vec3DScalar operator*(float value, const Vec3DScalar& rh)
+{
+	return Vec3DScalar(rh.mX * value, rh.mY * value, rh.mZ * value);
+}
+
+inline Vec3DScalar operator/(const Vec3DScalar& lh, float value)
+{
+	return Vec3DScalar(lh.mX / value, lh.mY / value, lh.mZ / value);
+}
+
+inline Vec3DScalar operator-(const Vec3DScalar& lh)
+{
+	return Vec3DScalar(-lh.mX, -lh.mY, -lh.mZ);
+}
+
+inline float dot(const Vec3DScalar& lh, const Vec3DScalar& rh)
+{
+	return lh.mX * rh.mX + lh.mY * rh.mY + lh.mZ * rh.mZ;
+}
+
+inline Vec3DScalar cross(const Vec3DScalar& lh, const Vec3DScalar& rh)
+{
+	return Vec3DScalar(lh.mY * rh.mZ - lh.mZ * rh.mY,
+									lh.mZ * rh.mX - lh.mX * rh.mZ,
+									lh.mX * rh.mY - lh.mY * rh.mX);
+}
+
+inline float length(const Vec3DScalar& v)
+{
+	const float len = length2(v);
+
+	if (len < FLOAT_ZERO)
+		return 0.f;
+
+	return sqrtf(len);
+}
+
+inline float length2(const Vec3DScalar& v)
+{
+	return dot(v, v);
+}
+
+inline Vec3DScalar scale3D(const Vec3DScalar& lh, const Vec3DScalar& rh)
+{
+	return Vec3DScalar(lh.mX * rh.mX, lh.mY * rh.mY, lh.mZ * rh.mZ);
+}
+
+//! Reflect direction over the normal
+inline Vec3DScalar reflect(const Vec3DScalar& dir, const Vec3DScalar& normal)
+{
+	return dir - 2.f * dot(dir, normal) * normal;
+}
+
+//! Refract unit direction by the normal, which faces it, eta is the ratio of source and target refraction indices.
+//! Returns false on total internal reflection, refracted direction isn't normalized
+inline bool refract(const Vec3DScalar& dir, const Vec3DScalar& normal, float eta, Vec3DScalar* refracted)
+{
+	const float cosThetaS	 = -dot(normal, dir);
+	const float cosThetaT2 = 1.f - eta * eta * (1.f - cosThetaS * cosThetaS); // Squared
+
+	if (cosThetaT2 < 0.f)
+	{
+		return false;
+	}
+
+	*refracted = (eta * dir) + (eta * cosThetaS - sqrtf(cosThetaT2)) * normal;
+	return true;
+}
+
+#endif
\ No newline at end of file
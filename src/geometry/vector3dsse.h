@@ -0,0 +1,254 @@
+#ifndef GEOMETRY_VECTOR3DSSE_H
+#define GEOMETRY_VECTOR3DSSE_H
+
+#include "precision.h"
+
+// SSE2 is a part of the instruction set baseline, so vectors can be used in any code
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define VECTOR3D_HAS_SSE
+#endif
+
+#ifdef VECTOR3D_HAS_SSE
+
+#include <emmintrin.h>
+
+// Vector stored in one 16-byte aligned SSE register, fourth component is unused and kept out of dot products,
+// so every operation is one or a few instructions. Interface is the same as of Vec3DScalar
+class Vec3DSSE
+{
+	friend Vec3DSSE operator+(const Vec3DSSE& lh, const Vec3DSSE& rh);
+
+	friend Vec3DSSE operator-(const Vec3DSSE& lh, const Vec3DSSE& rh);
+
+	friend Vec3DSSE operator*(const Vec3DSSE& lh, float value);
+
+	friend Vec3DSSE operator*(float value, const Vec3DSSE& rh);
+
+	friend Vec3DSSE operator/(const Vec3DSSE& lh, float value);
+
+	friend Vec3DSSE operator-(const Vec3DSSE& v);
+
+	friend float dot(const Vec3DSSE& lh, const Vec3DSSE& rh);
+
+	friend Vec3DSSE cross(const Vec3DSSE& lh, const Vec3DSSE& rh);
+
+	friend float length(const Vec3DSSE& v);
+
+	friend float length2(const Vec3DSSE& v);
+
+	friend Vec3DSSE scale3D(const Vec3DSSE& lh, const Vec3DSSE& rh);
+
+	friend Vec3DSSE reflect(const Vec3DSSE& dir, const Vec3DSSE& normal);
+
+	friend bool refract(const Vec3DSSE& dir, const Vec3DSSE& normal, float eta, Vec3DSSE* refracted);
+
+public:
+
+	Vec3DSSE()
+		: mData(_mm_setzero_ps())
+	{
+	}
+
+	Vec3DSSE(float x, float y, float z)
+		: mData(_mm_set_ps(0.f, z, y, x))
+	{
+	}
+
+	float x() const
+	{
+		return _mm_cvtss_f32(mData);
+	}
+
+	float y() const
+	{
+		return _mm_cvtss_f32(_mm_shuffle_ps(mData, mData, _MM_SHUFFLE(1, 1, 1, 1)));
+	}
+
+	float z() const
+	{
+		return _mm_cvtss_f32(_mm_shuffle_ps(mData, mData, _MM_SHUFFLE(2, 2, 2, 2)));
+	}
+
+	void setX(float x)
+	{
+		mData = _mm_move_ss(mData, _mm_set_ss(x));
+	}
+
+	void setY(float y)
+	{
+		mData = _mm_set_ps(0.f, z(), y, x());
+	}
+
+	void setZ(float z)
+	{
+		mData = _mm_set_ps(0.f, z, y(), x());
+	}
+
+	void setXYZ(float x, float y, float z)
+	{
+		mData = _mm_set_ps(0.f, z, y, x);
+	}
+
+	Vec3DSSE& operator+=(const Vec3DSSE& rh)
+	{
+		mData = _mm_add_ps(mData, rh.mData);
+		return *this;
+	}
+
+	Vec3DSSE& operator-=(const Vec3DSSE& rh)
+	{
+		mData = _mm_sub_ps(mData, rh.mData);
+		return *this;
+	}
+
+	Vec3DSSE& operator*=(float value)
+	{
+		mData = _mm_mul_ps(mData, _mm_set1_ps(value));
+		return *this;
+	}
+
+	Vec3DSSE& operator/=(float value)
+	{
+		mData = _mm_div_ps(mData, _mm_set1_ps(value));
+		return *this;
+	}
+
+	//! Normalize with the fast reciprocal square root, refined by one Newton-Raphson step.
+	//! Too short vectors are kept as is, same as by scalar backend
+	void normalize()
+	{
+		const __m128 len2			= Dot(mData, mData);
+		const __m128 estimate = _mm_rsqrt_ps(len2);
+		const __m128 invLen		= _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), estimate),
+																			 _mm_sub_ps(_mm_set1_ps(3.f), _mm_mul_ps(_mm_mul_ps(len2, estimate), estimate)));
+
+		const __m128 valid = _mm_cmpge_ps(len2, _mm_set1_ps(FLOAT_ZERO));
+		mData = _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(mData, invLen)), _mm_andnot_ps(valid, mData));
+	}
+
+	Vec3DSSE& toUnit()
+	{
+		normalize();
+		return *this;
+	}
+
+	Vec3DSSE inverse() const
+	{
+		return Vec3DSSE(_mm_div_ps(_mm_set1_ps(1.f), mData));
+	}
+
+	Vec3DSSE absolute() const
+	{
+		return Vec3DSSE(_mm_andnot_ps(_mm_set1_ps(-0.f), mData));
+	}
+
+private:
+	explicit Vec3DSSE(__m128 data)
+		: mData(data)
+	{
+	}
+
+	//! Get dot product of xyz components in all the components of the result.
+	//! Sum is taken in the same order as by scalar backend, so results are equal
+	static __m128 Dot(__m128 lh, __m128 rh)
+	{
+		const __m128 product = _mm_mul_ps(lh, rh);
+		const __m128 sum		 = _mm_add_ss(_mm_add_ss(product, _mm_shuffle_ps(product, product, _MM_SHUFFLE(1, 1, 1, 1))),
+																	_mm_shuffle_ps(product, product, _MM_SHUFFLE(2, 2, 2, 2)));
+		return _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(0, 0, 0, 0));
+	}
+
+private:
+	__m128 mData;
+};
+
+inline Vec3DSSE operator+(const Vec3DSSE& lh, const Vec3DSSE& rh)
+{
+	return Vec3DSSE(_mm_add_ps(lh.mData, rh.mData));
+}
+
+inline Vec3DSSE operator-(const Vec3DSSE& lh, const Vec3DSSE& rh)
+{
+	return Vec3DSSE(_mm_sub_ps(lh.mData, rh.mData));
+}
+
+inline Vec3DSSE operator*(const Vec3DSSE& lh, float value)
+{
+	return Vec3DSSE(_mm_mul_ps(lh.mData, _mm_set1_ps(value)));
+}
+
+inline Vec3DSSE operator*(float value, const Vec3DSSE& rh)
+{
+	return Vec3DSSE(_mm_mul_ps(rh.mData, _mm_set1_ps(value)));
+}
+
+inline Vec3DSSE operator/(const Vec3DSSE& lh, float value)
+{
+	return Vec3DSSE(_mm_div_ps(lh.mData, _mm_set1_ps(value)));
+}
+
+inline Vec3DSSE operator-(const Vec3DSSE& lh)
+{
+	return Vec3DSSE(_mm_xor_ps(lh.mData, _mm_set1_ps(-0.f)));
+}
+
+inline float dot(const Vec3DSSE& lh, const Vec3DSSE& rh)
+{
+	return _mm_cvtss_f32(Vec3DSSE::Dot(lh.mData, rh.mData));
+}
+
+inline Vec3DSSE cross(const Vec3DSSE& lh, const Vec3DSSE& rh)
+{
+	const __m128 lhYZX = _mm_shuffle_ps(lh.mData, lh.mData, _MM_SHUFFLE(3, 0, 2, 1));
+	const __m128 lhZXY = _mm_shuffle_ps(lh.mData, lh.mData, _MM_SHUFFLE(3, 1, 0, 2));
+	const __m128 rhYZX = _mm_shuffle_ps(rh.mData, rh.mData, _MM_SHUFFLE(3, 0, 2, 1));
+	const __m128 rhZXY = _mm_shuffle_ps(rh.mData, rh.mData, _MM_SHUFFLE(3, 1, 0, 2));
+
+	return Vec3DSSE(_mm_sub_ps(_mm_mul_ps(lhYZX, rhZXY), _mm_mul_ps(lhZXY, rhYZX)));
+}
+
+inline float length(const Vec3DSSE& v)
+{
+	const __m128 len2	= Vec3DSSE::Dot(v.mData, v.mData);
+	const __m128 valid = _mm_cmpge_ss(len2, _mm_set_ss(FLOAT_ZERO));
+
+	return _mm_cvtss_f32(_mm_and_ps(valid, _mm_sqrt_ss(len2)));
+}
+
+inline float length2(const Vec3DSSE& v)
+{
+	return dot(v, v);
+}
+
+inline Vec3DSSE scale3D(const Vec3DSSE& lh, const Vec3DSSE& rh)
+{
+	return Vec3DSSE(_mm_mul_ps(lh.mData, rh.mData));
+}
+
+//! Reflect direction over the normal, dot product stays in the register
+inline Vec3DSSE reflect(const Vec3DSSE& dir, const Vec3DSSE& normal)
+{
+	const __m128 twiceDot = _mm_mul_ps(_mm_set1_ps(2.f), Vec3DSSE::Dot(dir.mData, normal.mData));
+	return Vec3DSSE(_mm_sub_ps(dir.mData, _mm_mul_ps(twiceDot, normal.mData)));
+}
+
+//! Refract unit direction by the normal, which faces it, eta is the ratio of source and target refraction indices.
+//! Returns false on total internal reflection, refracted direction isn't normalized
+inline bool refract(const Vec3DSSE& dir, const Vec3DSSE& normal, float eta, Vec3DSSE* refracted)
+{
+	const float cosThetaS	 = -dot(normal, dir);
+	const float cosThetaT2 = 1.f - eta * eta * (1.f - cosThetaS * cosThetaS); // Squared
+
+	if (cosThetaT2 < 0.f)
+	{
+		return false;
+	}
+
+	const __m128 normalScale = _mm_set1_ps(eta * cosThetaS - _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(cosThetaT2))));
+	*refracted = Vec3DSSE(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(eta), dir.mData), _mm_mul_ps(normalScale, normal.mData)));
+	return true;
+}
+
+#endif // VECTOR3D_HAS_SSE
+
+#endif
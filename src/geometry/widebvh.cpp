@@ -0,0 +1,95 @@
+//-------------------------------------------------------------------
+// File: widebvh.cpp
+//
+// Eight-wide bounding volume hierarchy, collapsed from the binary one
+//			 Each wide node opens its inner descendants with the largest surface area,
+//			 until it has eight children or only leaves are left
+//
+//
+//-------------------------------------------------------------------
+
+#include "widebvh.h"
+
+WideBVH::WideBVH()
+{
+}
+
+void WideBVH::build(const BVH& hierarchy)
+{
+	clear();
+
+	const std::vector< BVHNode >& nodes = hierarchy.getNodes();
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	mNodes.reserve(nodes.size() / (WIDE_BVH_WIDTH - 1) + 1);
+	collapse(nodes, 0);
+}
+
+void WideBVH::clear()
+{
+	std::vector< WideBVHNode >().swap(mNodes);
+}
+
+unsigned WideBVH::collapse(const std::vector< BVHNode >& nodes, unsigned root)
+{
+	unsigned children[WIDE_BVH_WIDTH];
+	unsigned count = 0;
+
+	// Root leaf is the only child of the wide root
+	if (nodes[root].Count > 0)
+	{
+		children[count++] = root;
+	}
+	else
+	{
+		children[count++] = root + 1;
+		children[count++] = nodes[root].Offset;
+	}
+
+	while (count < WIDE_BVH_WIDTH)
+	{
+		// Large children are the most likely to be hit, so their children are better tested at once
+		int		best		 = -1;
+		float bestArea = 0.f;
+		for (unsigned idx = 0; idx < count; ++idx)
+		{
+			const BVHNode& child = nodes[children[idx]];
+			if (child.Count == 0 && (best < 0 || child.Bounds.getSurfaceArea() > bestArea))
+			{
+				best		 = idx;
+				bestArea = child.Bounds.getSurfaceArea();
+			}
+		}
+
+		if (best < 0)
+		{
+			break;
+		}
+
+		const unsigned opened = children[best];
+		children[best]				= opened + 1;
+		children[count++]			= nodes[opened].Offset;
+	}
+
+	// Children are appended after the node, so it's filled by index
+	const unsigned index = mNodes.size();
+	mNodes.push_back(WideBVHNode());
+	mNodes[index].Bounds.setGrid(nodes[root].Bounds);
+	mNodes[index].Count = count;
+
+	for (unsigned lane = 0; lane < count; ++lane)
+	{
+		const BVHNode& child = nodes[children[lane]];
+
+		const unsigned reference = child.Count > 0 ? (children[lane] | WIDE_BVH_LEAF) : collapse(nodes, children[lane]);
+
+		WideBVHNode& node			= mNodes[index];
+		node.Children[lane] = reference;
+		node.Bounds.set(lane, child.Bounds);
+	}
+
+	return index;
+}
@@ -0,0 +1,135 @@
+#ifndef GEOMETRY_WIDEBVH_H
+#define GEOMETRY_WIDEBVH_H
+
+#include <vector>
+
+#include "geometry/bboxblock.h"
+#include "geometry/bvh.h"
+#include "geometry/ray.h"
+
+#define WIDE_BVH_WIDTH 8
+
+// Child reference flag, marks leaf node of the binary hierarchy
+#define WIDE_BVH_LEAF 0x80000000u
+
+// Every wide node pops one child and pushes at most all of its children
+#define WIDE_BVH_STACK_SIZE (BVH_STACK_SIZE * (WIDE_BVH_WIDTH - 1) + 1)
+
+// Node with up to eight children, their bounds are quantized in the grid of the node bounds
+struct WideBVHNode
+{
+	QuantizedBBox8 Bounds;
+	unsigned			 Children[WIDE_BVH_WIDTH]; // Wide node index or binary leaf node index with WIDE_BVH_LEAF flag
+	unsigned			 Count;										 // Children count, they occupy the first lanes
+};
+
+// Eight-wide bounding volume hierarchy, collapsed from the binary one. All the children of a node are tested
+// by one SIMD slab test and quantized bounds take about half of the binary nodes memory, so large meshes
+// are traversed with fewer cache misses. Leaves are the ones of the binary hierarchy, so their owner keeps using them
+class WideBVH
+{
+public:
+	explicit WideBVH();
+
+	//! Collapse binary hierarchy, it must outlive this one as its leaves are referenced
+	void build(const BVH& hierarchy);
+
+	void clear();
+
+	bool isEmpty() const
+	{
+		return mNodes.empty();
+	}
+
+	const std::vector< WideBVHNode >& getNodes() const
+	{
+		return mNodes;
+	}
+
+	//! Get memory taken by nodes in bytes
+	size_t getMemorySize() const
+	{
+		return mNodes.size() * sizeof(WideBVHNode);
+	}
+
+	//! Same as BVH::traverseLeaves, visitor is called with binary leaf node index.
+	//! Hit children are visited in order of their entry distances
+	template <class Visitor>
+	void traverseLeaves(const Ray& ray, Visitor& visitor) const;
+
+private:
+	//! Append wide node, which replaces binary inner node and its descendants, returns its index
+	unsigned collapse(const std::vector< BVHNode >& nodes, unsigned root);
+
+private:
+	std::vector< WideBVHNode > mNodes;
+};
+
+template <class Visitor>
+inline void WideBVH::traverseLeaves(const Ray& ray, Visitor& visitor) const
+{
+	if (mNodes.empty())
+	{
+		return;
+	}
+
+	float maxDistance = ray.getTMax();
+
+	// Postponed children are kept with their entry distances, so they're skipped if a closer hit is found meanwhile
+	unsigned stack[WIDE_BVH_STACK_SIZE];
+	float		 stackDistances[WIDE_BVH_STACK_SIZE];
+	int			 stackSize = 0;
+	unsigned current	 = 0;
+
+	for (;;)
+	{
+		if ((current & WIDE_BVH_LEAF) != 0)
+		{
+			if (visitor(current & ~WIDE_BVH_LEAF, &maxDistance))
+			{
+				return;
+			}
+		}
+		else
+		{
+			const WideBVHNode& node = mNodes[current];
+
+			float					 tNear[WIDE_BVH_WIDTH];
+			const unsigned mask = node.Bounds.intersect(ray, maxDistance, tNear);
+
+			// Hit children are pushed from far to near, so the nearest one is on top
+			const int first = stackSize;
+			for (unsigned lane = 0; lane < node.Count; ++lane)
+			{
+				if ((mask & (1 << lane)) == 0)
+				{
+					continue;
+				}
+
+				int position = stackSize++;
+				while (position > first && stackDistances[position - 1] < tNear[lane])
+				{
+					stack[position]					 = stack[position - 1];
+					stackDistances[position] = stackDistances[position - 1];
+					--position;
+				}
+				stack[position]					 = node.Children[lane];
+				stackDistances[position] = tNear[lane];
+			}
+		}
+
+		do
+		{
+			if (stackSize == 0)
+			{
+				return;
+			}
+			--stackSize;
+		}
+		while (stackDistances[stackSize] > maxDistance);
+
+		current = stack[stackSize];
+	}
+}
+
+#endif // GEOMETRY_WIDEBVH_H
@@ -14,11 +14,13 @@
 
 #include "lightsource.h"
 
-Color PointLightSource::computeColor(const Scene& scene, IShape* object, const Ray& viewRay, float distance, const Vec3D& normal) const
+Color PointLightSource::computeColor(const Scene& scene, const Ray& viewRay, const CIsect& isect) const
 {
+	IShape			*object = isect.Object;
+	const Vec3D &normal = isect.Normal;
 	const Mtrl *objectMtrl  = object->getMtrl();
-	const Vec3D  objSurfacePoint = viewRay.apply(distance);
-	Color ambientTerm = scale3D(object->getAmbColor(objSurfacePoint), AmbIntensity);
+	const Vec3D  objSurfacePoint = viewRay.apply(isect.Distance);
+	Color ambientTerm = scale3D(object->getAmbColor(objSurfacePoint, isect), AmbIntensity);
 	Color diffuseTerm;
 	Color specularTerm;
 	Color result			= ambientTerm;
@@ -34,19 +36,18 @@ Color PointLightSource::computeColor(const Scene& scene, IShape* object, const R
 	// Light is on the other side, we're illuminating front one
 	if (cosShadowNormal <= 0.f)
 	{
-		return object->getAmbColor(objSurfacePoint);
+		return object->getAmbColor(objSurfacePoint, isect);
 	}
 
-	const Ray shadowRay(objSurfacePoint + shadowRayDir * EPSILON, shadowRayDir);	
+	// Shadow ray starts EPSILON away from the surface and ends at the light, objects behind the light don't shadow it
+	const Ray shadowRay(objSurfacePoint + shadowRayDir * EPSILON, shadowRayDir, 0.f, distanceToLight - EPSILON);	
 
-	const CIsect lightCIsect = scene.intersect(shadowRay, true);
-	// Object not in the shadow
-	if (!lightCIsect.Exists || lightCIsect.Object->isLight() || lightCIsect.Distance > distanceToLight)
+	if (!scene.occluded(shadowRay))
 	{
-		const Color diffuseColor = object->getDifColor(objSurfacePoint);
+		const Color diffuseColor = object->getDifColor(objSurfacePoint, isect);
 		diffuseTerm  = scale3D(diffuseColor, cosShadowNormal * DifIntensity * attenuation);
 
-		const Vec3D lightReflect = (shadowRayDir - 2 * dot(shadowRayDir, normal) * normal).toUnit();
+		const Vec3D lightReflect = reflect(shadowRayDir, normal).toUnit();
 
 		const Vec3D cameraDir = (viewRay.getOrg() - objSurfacePoint).toUnit();
 		//float	cosLightReflect = dot(shadowRayDir, lightReflect);
@@ -54,7 +55,7 @@ Color PointLightSource::computeColor(const Scene& scene, IShape* object, const R
 
 		if (cosLightReflect > 0.0f)
 		{
-			const Color specularColor = object->getSpcColor(objSurfacePoint); 
+			const Color specularColor = object->getSpcColor(objSurfacePoint, isect); 
 
 			specularTerm	= scale3D(specularColor, SpcIntensity * powf(cosLightReflect, objectMtrl->SpcPower) * attenuation);
 		}				
@@ -64,11 +65,13 @@ Color PointLightSource::computeColor(const Scene& scene, IShape* object, const R
 	return result;
 }
 
-Color DiralLightSource::computeColor(const Scene& scene, IShape* object, const Ray& viewRay, float distance, const Vec3D& normal) const
+Color DiralLightSource::computeColor(const Scene& scene, const Ray& viewRay, const CIsect& isect) const
 {
+	IShape			*object = isect.Object;
+	const Vec3D &normal = isect.Normal;
 	const Mtrl *objectMtrl  = object->getMtrl();
-	const Vec3D  objSurfacePoint = viewRay.apply(distance);
-	Color ambientTerm = scale3D(object->getAmbColor(objSurfacePoint), AmbIntensity);
+	const Vec3D  objSurfacePoint = viewRay.apply(isect.Distance);
+	Color ambientTerm = scale3D(object->getAmbColor(objSurfacePoint, isect), AmbIntensity);
 	Color diffuseTerm;
 	Color specularTerm;
 	Color result			= ambientTerm;
@@ -81,7 +84,7 @@ Color DiralLightSource::computeColor(const Scene& scene, IShape* object, const R
 	// Return only object's color, if it's too far away from the light source
   if (lightDistance > LightRange)
 	{
-		return object->getAmbColor(objSurfacePoint);
+		return object->getAmbColor(objSurfacePoint, isect);
 	}
 	
   const float	cosLightNormal	= dot(lightVector, normal);
@@ -91,16 +94,15 @@ Color DiralLightSource::computeColor(const Scene& scene, IShape* object, const R
 		return result;
 	}
 
-	const Ray shadowRay(objSurfacePoint + lightVector * EPSILON, lightVector);	
+	// Shadow ray starts EPSILON away from the surface and ends at the light, objects behind the light don't shadow it
+	const Ray shadowRay(objSurfacePoint + lightVector * EPSILON, lightVector, 0.f, lightDistance - EPSILON);	
 
-	const CIsect lightCIsect = scene.intersect(shadowRay, true);
-	// Object not in the shadow
-	if (!lightCIsect.Exists || lightCIsect.Object->isLight() || lightCIsect.Distance > lightDistance)
+	if (!scene.occluded(shadowRay))
 	{
-		const Color diffuseColor = object->getDifColor(objSurfacePoint);
+		const Color diffuseColor = object->getDifColor(objSurfacePoint, isect);
 		diffuseTerm  = scale3D(diffuseColor, cosLightNormal * DifIntensity);
 
-		const Vec3D lightReflect = (Dir - 2 * dot(Dir, normal) * normal).toUnit();
+		const Vec3D lightReflect = reflect(Dir, normal).toUnit();
 
 		const Vec3D cameraDir = (viewRay.getOrg() - objSurfacePoint).toUnit();
 		//float	cosLightReflect = dot(shadowRayDir, lightReflect);
@@ -108,7 +110,7 @@ Color DiralLightSource::computeColor(const Scene& scene, IShape* object, const R
 
 		if (cosLightReflect > 0.0f)
 		{
-			const Color specularColor = object->getSpcColor(objSurfacePoint); 
+			const Color specularColor = object->getSpcColor(objSurfacePoint, isect); 
 
 			specularTerm	= scale3D(specularColor, SpcIntensity * powf(cosLightReflect, objectMtrl->SpcPower));
 		}				
@@ -118,11 +120,13 @@ Color DiralLightSource::computeColor(const Scene& scene, IShape* object, const R
 	return result;
 }
 
-Color SpotLightSource::computeColor(const Scene& scene, IShape* object, const Ray& viewRay, float distance, const Vec3D& normal) const
+Color SpotLightSource::computeColor(const Scene& scene, const Ray& viewRay, const CIsect& isect) const
 {
+	IShape			*object = isect.Object;
+	const Vec3D &normal = isect.Normal;
 	const Mtrl *objectMtrl  = object->getMtrl();
-	const Vec3D  objSurfacePoint = viewRay.apply(distance);
-	Color ambientTerm = scale3D(object->getAmbColor(objSurfacePoint), AmbIntensity);
+	const Vec3D  objSurfacePoint = viewRay.apply(isect.Distance);
+	Color ambientTerm = scale3D(object->getAmbColor(objSurfacePoint, isect), AmbIntensity);
 	Color diffuseTerm;
 	Color specularTerm;
 	Color result			= ambientTerm;
@@ -135,7 +139,7 @@ Color SpotLightSource::computeColor(const Scene& scene, IShape* object, const Ra
 	// Light is on the other side, we're illuminating front one
 	if (cosLightNormal <= 0.f)
 	{
-		return object->getAmbColor(objSurfacePoint);
+		return object->getAmbColor(objSurfacePoint, isect);
 	}
 	
 	const float distanceToLight			= length(Position - objSurfacePoint);
@@ -167,17 +171,16 @@ Color SpotLightSource::computeColor(const Scene& scene, IShape* object, const Ra
 
   result *= spotAttenuation;
 
-	const Ray shadowRay(objSurfacePoint + lightVector * EPSILON, lightVector);	
+	// Shadow ray starts EPSILON away from the surface and ends at the light, objects behind the light don't shadow it
+	const Ray shadowRay(objSurfacePoint + lightVector * EPSILON, lightVector, 0.f, distanceToLight - EPSILON);	
 
-	const CIsect lightCIsect = scene.intersect(shadowRay, true);
-	// Object not in the shadow
-	if (!lightCIsect.Exists || lightCIsect.Object->isLight() || lightCIsect.Distance > distanceToLight)
+	if (!scene.occluded(shadowRay))
 	{
 		//result *= spotAttenuation;
-		const Color diffuseColor = object->getDifColor(objSurfacePoint);
+		const Color diffuseColor = object->getDifColor(objSurfacePoint, isect);
 		diffuseTerm  = scale3D(diffuseColor, cosLightNormal * DifIntensity * spotAttenuation * distanceAttenuation);
 
-		const Vec3D lightReflect = (Dir - 2 * dot(Dir, normal) * normal).toUnit();
+		const Vec3D lightReflect = reflect(Dir, normal).toUnit();
 
 		const Vec3D cameraDir = (viewRay.getOrg() - objSurfacePoint).toUnit();
 		//float	cosLightReflect = dot(shadowRayDir, lightReflect);
@@ -185,7 +188,7 @@ Color SpotLightSource::computeColor(const Scene& scene, IShape* object, const Ra
 
 		if (cosLightReflect > 0.0f)
 		{
-			const Color specularColor = object->getSpcColor(objSurfacePoint); 
+			const Color specularColor = object->getSpcColor(objSurfacePoint, isect); 
 
 			specularTerm	= scale3D(specularColor, SpcIntensity * powf(cosLightReflect, objectMtrl->SpcPower) * spotAttenuation * distanceAttenuation);
 		}				
@@ -3,6 +3,7 @@
 
 #include "types.h"
 
+struct CIsect;
 struct IShape;
 class  Ray;
 class  Scene;
@@ -33,22 +34,22 @@ struct LightSource
 	float						CosHalfUmbraAngle;		// Inplace calculate values, that will be used in computations, this is cosf(UmbraAngle / 2.f)
 	float						CosHalfPenumbraAngle; // Inplace calculate values, that will be used in computations, this is cosf(PenumbraAngle / 2.f)
 
-	virtual Color computeColor(const Scene& scene, IShape* object, const Ray& viewRay, float distance, const Vec3D& normal) const = 0;
+	virtual Color computeColor(const Scene& scene, const Ray& viewRay, const CIsect& isect) const = 0;
 };
 
 struct PointLightSource : LightSource
 {
-	virtual Color computeColor(const Scene& scene, IShape* object, const Ray& viewRay, float distance, const Vec3D& normal) const;
+	virtual Color computeColor(const Scene& scene, const Ray& viewRay, const CIsect& isect) const;
 };
 
 struct DiralLightSource : LightSource
 {
-	virtual Color computeColor(const Scene& scene, IShape* object, const Ray& viewRay, float distance, const Vec3D& normal) const;
+	virtual Color computeColor(const Scene& scene, const Ray& viewRay, const CIsect& isect) const;
 };
 
 struct SpotLightSource : LightSource
 {
-	virtual Color computeColor(const Scene& scene, IShape* object, const Ray& viewRay, float distance, const Vec3D& normal) const;
+	virtual Color computeColor(const Scene& scene, const Ray& viewRay, const CIsect& isect) const;
 };
 
 #endif
\ No newline at end of file
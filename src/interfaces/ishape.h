@@ -1,7 +1,10 @@
 #ifndef INTERFACES_ISHAPE_H
 	#define INTERFACES_ISHAPE_H
 
+	#include "geometry/bbox.h"
+	#include "geometry/hitbuffer.h"
 	#include "geometry/ray.h"
+	#include "geometry/raypacket.h"
 	#include "geometry/intersection.h"
 	#include "illumination/types.h"
 
@@ -14,8 +17,43 @@
 		{
 		}
 
-		//! Find intersection with the ray and return data
-		virtual CIsect intersect(const Ray& ray) = 0;
+		//! Find closest intersection inside of the ray interval and return data.
+		//! If hits buffer is given, distances of all the hits are added to it, CSG operations need them
+		virtual CIsect intersect(const Ray& ray, HitBuffer* hits = NULL) = 0;
+
+		//! Find intersections with the packet rays from the mask, hits further than the max distance of the ray are ignored.
+		//! Found intersections are stored and max distances are shrunk, returns mask of rays with found intersections.
+		//! Rays are intersected one by one, unless shape knows better
+		virtual unsigned intersectPacket(const RayPacket& packet, unsigned mask, float* maxDistances, CIsect* isects)
+		{
+			unsigned found = 0;
+			for (unsigned idx = 0; idx < RAY_PACKET_SIZE; ++idx)
+			{
+				if ((mask & (1 << idx)) == 0)
+				{
+					continue;
+				}
+
+				Ray ray = packet.Rays[idx];
+				ray.setTMax(maxDistances[idx]);
+
+				const CIsect isect = intersect(ray);
+				if (isect.Exists)
+				{
+					isects[idx]				 = isect;
+					maxDistances[idx]	 = isect.Distance;
+					found							|= 1 << idx;
+				}
+			}
+			return found;
+		}
+
+		//! Check if the ray hits the shape inside of its interval, any hit is enough, so shapes may stop early.
+		//! Closest intersection is used, unless shape knows better
+		virtual bool occluded(const Ray& ray)
+		{
+			return intersect(ray).Exists;
+		}
 
 		//! Get material of the shape
 		virtual const Mtrl* getMtrl() const = 0;
@@ -41,7 +79,8 @@
 		//! Get texture coordinates at given pnt, 2 first components of vector will be used, and one will be ommited
 		virtual Vec3D getTexCoords(const Vec3D& pnt, const CIsect& isect = CIsect()) const = 0;
 
-		// TODO: Add BBox etc.
+		//! Get axis-aligned bounding box of the shape, unbounded shapes return infinite box
+		virtual BBox getBBox() const = 0;
 	};
 
 
@@ -1,31 +1,41 @@
+#include <algorithm>
 #include <iostream>
 #include <QCoreApplication>
 #include <QFileInfo>
 #include <QUrl>
+#include "Frontend/benchmark.h"
 #include "Frontend/tracerwrapper.h"
 
-int raytracing(QString sceneFile, QString outputFile, int resX, int resY, int traceDepth);
-int cmdRead(int argc, char *argv[], QString *sceneFile, QString *outputFile, int *resX, int *resY, int *traceDepth);
+int raytracing(QString sceneFile, QString outputFile, int resX, int resY, int traceDepth, int threads);
+int benchmark(QString sceneFile, int resX, int resY, int threads);
+int cmdRead(int argc, char *argv[], QString *sceneFile, QString *outputFile, int *resX, int *resY, int *traceDepth, int *threads, bool *runBenchmark);
 
 int main(int argc, char *argv[])
 {
 	QCoreApplication app(argc, argv);
 	
   QString sceneFile, outputFile;
-	int	resX = 0, resY = 0, traceDepth = -1;
+	int	resX = 0, resY = 0, traceDepth = -1, threads = 0;
+	bool runBenchmark = false;
 
-	if (cmdRead(argc, argv, &sceneFile, &outputFile, &resX, &resY, &traceDepth))
-    if (!raytracing(sceneFile, outputFile, resX, resY, traceDepth))
+	if (cmdRead(argc, argv, &sceneFile, &outputFile, &resX, &resY, &traceDepth, &threads, &runBenchmark))
+	{
+		if (runBenchmark)
+		{
+			return benchmark(sceneFile, resX, resY, threads) ? 0 : -1;
+		}
+    if (!raytracing(sceneFile, outputFile, resX, resY, traceDepth, threads))
       return -1;
+	}
 
 	return 0;
 }
 
-int cmdRead(int argc, char *argv[], QString *sceneFile, QString *outputFile, int *resX, int *resY, int *traceDepth)
+int cmdRead(int argc, char *argv[], QString *sceneFile, QString *outputFile, int *resX, int *resY, int *traceDepth, int *threads, bool *runBenchmark)
 {
   if (argc < 5)
 	{
-		std::cout << "example: rt.exe --scene=myScene.xml --resolution_x=1024 --resolution_y=768 --output=myImage.png"  << std::endl;
+		std::cout << "example: rt.exe --scene=myScene.xml --resolution_x=1024 --resolution_y=768 --output=myImage.png [--threads=8] [--benchmark]"  << std::endl;
     return 0;  
   }
   else
@@ -56,16 +66,27 @@ int cmdRead(int argc, char *argv[], QString *sceneFile, QString *outputFile, int
 		  {
 			  *traceDepth = arg.remove("--trace_depth=").toInt();
 		  }
+		  else if (arg.contains("--threads"))
+		  {
+			  // Zero means the number of hardware threads
+			  *threads = std::max(0, arg.remove("--threads=").toInt());
+		  }
+		  else if (arg == "--benchmark")
+		  {
+			  // Measure performance instead of saving the image
+			  *runBenchmark = true;
+		  }
 	  }
     return 1;
   }
   return 1;
 }
 
-int raytracing(QString sceneFile, QString outputFile, int resX, int resY, int traceDepth)
+int raytracing(QString sceneFile, QString outputFile, int resX, int resY, int traceDepth, int threads)
 {
   TracerWrapper wrapper;
 	wrapper.setRecursionDepth(traceDepth);
+	wrapper.setThreadsCount(threads);
 
   // loading scene fron xml
 	std::cout << "Scene loading..." << std::endl;
@@ -84,4 +105,12 @@ int raytracing(QString sceneFile, QString outputFile, int resX, int resY, int tr
   
   std::cout << "Ray tracing complite=)" << std::endl;
   return 1;
-}
\ No newline at end of file
+}
+
+int benchmark(QString sceneFile, int resX, int resY, int threads)
+{
+	Benchmark bench;
+	if (!bench.run(sceneFile, resX, resY, threads))
+		return 0;
+	return 1;
+}
@@ -39,5 +39,27 @@ Ray Camera::lookThrough(int x, int y) const
 	Vec3D origin    = mProperties.Eye;
 	Vec3D direction = (mXAxis * projectedX + mYAxis * projectedY + mZAxis * mFocus).toUnit();
 
-	return Ray(origin, direction);
+	return Ray(origin, direction, Ray::UNIT_DIRECTION);
+}
+
+unsigned Camera::lookThrough(int x, int y, RayPacket* packet) const
+{
+	unsigned mask = 0;
+	for (int row = 0; row < RAY_PACKET_WIDTH; ++row)
+	{
+		for (int column = 0; column < RAY_PACKET_WIDTH; ++column)
+		{
+			const int pixelX = x + column;
+			const int pixelY = y + row;
+			if (pixelX >= mProperties.ImagePlaneW || pixelY >= mProperties.ImagePlaneH)
+			{
+				continue;
+			}
+
+			const unsigned idx = row * RAY_PACKET_WIDTH + column;
+			packet->set(idx, lookThrough(pixelX, pixelY));
+			mask |= 1 << idx;
+		}
+	}
+	return mask;
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 	#include "geometry/vector3d.h"
 	#include "geometry/ray.h"
+	#include "geometry/raypacket.h"
 
 	// Properties, defining camera orientation and projection
 	struct CameraProperties
@@ -30,6 +31,10 @@
 		//! Get ray at given image plane coordinates
 		Ray lookThrough(int x, int y) const;
 
+		//! Get packet of rays for the square of RAY_PACKET_WIDTH pixels with given top left corner,
+		//! returns mask of rays, which are inside of the image plane
+		unsigned lookThrough(int x, int y, RayPacket* packet) const;
+
 		//! Get exposure usage state
 		bool hasExposure() const
 		{
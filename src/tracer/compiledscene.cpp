@@ -0,0 +1,572 @@
+//-------------------------------------------------------------------
+// File: compiledscene.cpp
+// 
+// Scene objects, grouped by type into arrays of their geometry
+//			 Kernels are chosen by primitive type in one switch, so built-in shapes are intersected without virtual calls.
+//			 Moved objects are refitted: their geometry is copied again and hierarchy bounds are updated in parallel
+//
+//  
+//-------------------------------------------------------------------
+
+#include <atomic>
+#include <vector>
+
+#include "geometry/parallel.h"
+#include "interfaces/ishape.h"
+
+#include "compiledscene.h"
+
+namespace
+{
+	// Intersection kernels, specialized by primitive geometry
+	template <class Geometry>
+	struct PrimitiveKernel
+	{
+		static bool intersect(const Geometry& geometry, const Ray& ray, CIsect* isect)
+		{
+			return geometry.intersect(ray, isect);
+		}
+
+		static bool occluded(const Geometry& geometry, const Ray& ray)
+		{
+			CIsect isect;
+			return geometry.intersect(ray, &isect);
+		}
+
+		// Rays are intersected one by one, their intervals are shrunk to the closest found hits
+		static unsigned intersectPacket(const Geometry& geometry, const RayPacket& packet, unsigned mask, float* maxDistances, CIsect* isects)
+		{
+			unsigned found = 0;
+			for (unsigned idx = 0; idx < RAY_PACKET_SIZE; ++idx)
+			{
+				if ((mask & (1 << idx)) == 0)
+				{
+					continue;
+				}
+
+				Ray ray = packet.Rays[idx];
+				ray.setTMax(maxDistances[idx]);
+
+				CIsect isect;
+				if (geometry.intersect(ray, &isect))
+				{
+					isects[idx]				 = isect;
+					maxDistances[idx]	 = isect.Distance;
+					found							|= 1 << idx;
+				}
+			}
+			return found;
+		}
+	};
+
+	// Models, CSG trees and other shapes are called through their interface
+	template <>
+	struct PrimitiveKernel< IShape* >
+	{
+		static bool intersect(IShape* shape, const Ray& ray, CIsect* isect)
+		{
+			const CIsect found = shape->intersect(ray);
+			if (!found.Exists)
+			{
+				return false;
+			}
+
+			*isect = found;
+			return true;
+		}
+
+		static bool occluded(IShape* shape, const Ray& ray)
+		{
+			return shape->occluded(ray);
+		}
+
+		static unsigned intersectPacket(IShape* shape, const RayPacket& packet, unsigned mask, float* maxDistances, CIsect* isects)
+		{
+			return shape->intersectPacket(packet, mask, maxDistances, isects);
+		}
+	};
+
+	struct IntersectOperation
+	{
+		IntersectOperation(const Ray& ray, CIsect* isect)
+			: ViewRay(ray),
+				Isect(isect)
+		{
+		}
+
+		template <class Geometry>
+		bool operator()(const PrimitiveArray< Geometry >& primitives, unsigned index)
+		{
+			return PrimitiveKernel< Geometry >::intersect(primitives.Geometries[index], ViewRay, Isect);
+		}
+
+		const Ray& ViewRay;
+		CIsect*		 Isect;
+	};
+
+	struct OccludedOperation
+	{
+		explicit OccludedOperation(const Ray& ray)
+			: ViewRay(ray)
+		{
+		}
+
+		template <class Geometry>
+		bool operator()(const PrimitiveArray< Geometry >& primitives, unsigned index)
+		{
+			return PrimitiveKernel< Geometry >::occluded(primitives.Geometries[index], ViewRay);
+		}
+
+		const Ray& ViewRay;
+	};
+
+	struct PacketOperation
+	{
+		PacketOperation(const RayPacket& packet, unsigned mask, float* maxDistances, CIsect* isects)
+			: Packet(packet),
+				Mask(mask),
+				MaxDistances(maxDistances),
+				Isects(isects),
+				Found(0)
+		{
+		}
+
+		template <class Geometry>
+		bool operator()(const PrimitiveArray< Geometry >& primitives, unsigned index)
+		{
+			Found = PrimitiveKernel< Geometry >::intersectPacket(primitives.Geometries[index], Packet, Mask, MaxDistances, Isects);
+			return Found != 0;
+		}
+
+		const RayPacket& Packet;
+		unsigned				 Mask;
+		float*					 MaxDistances;
+		CIsect*					 Isects;
+		unsigned				 Found;
+	};
+
+	struct ObjectOperation
+	{
+		ObjectOperation()
+			: Object(NULL),
+				Light(false)
+		{
+		}
+
+		template <class Geometry>
+		bool operator()(const PrimitiveArray< Geometry >& primitives, unsigned index)
+		{
+			Object = primitives.Objects[index];
+			Light	 = primitives.Lights[index];
+			return true;
+		}
+
+		IShape* Object;
+		bool		Light;
+	};
+
+	struct CountOperation
+	{
+		CountOperation()
+			: Count(0)
+		{
+		}
+
+		template <class Geometry>
+		bool operator()(const PrimitiveArray< Geometry >& primitives, unsigned)
+		{
+			Count = primitives.Objects.size();
+			return true;
+		}
+
+		unsigned Count;
+	};
+
+	// Less objects are refitted on the calling thread only
+	const unsigned cMinParallelRefit = 4096;
+
+	//! Copy geometry of moved objects, each array keeps objects of one shape type
+	template <class Shape, class Geometry>
+	void GUpdateGeometries(PrimitiveArray< Geometry >* primitives)
+	{
+		for (unsigned idx = 0, count = primitives->Objects.size(); idx < count; ++idx)
+		{
+			primitives->Geometries[idx] = static_cast< const Shape* >(primitives->Objects[idx])->getGeometry();
+		}
+	}
+
+	// Keeps closest intersection with primitives, found in hierarchy leaves
+	struct ClosestVisitor
+	{
+		ClosestVisitor(const CompiledScene& scene, const std::vector< PrimitiveHandle >& primitives, const Ray& ray)
+			: Scene(scene),
+				Primitives(primitives),
+				ViewRay(ray),
+				Closest(false)
+		{
+		}
+
+		// Ray interval is shrunk to the closest hit, so primitives reject further ones themselves
+		bool operator()(unsigned primitive, float* maxDistance)
+		{
+			ViewRay.setTMax(*maxDistance);
+
+			CIsect isect;
+			if (!Scene.intersect(Primitives[primitive], ViewRay, &isect))
+			{
+				return false;
+			}
+
+			Closest			 = isect;
+			*maxDistance = isect.Distance;
+
+			return false;
+		}
+
+		const CompiledScene&									Scene;
+		const std::vector< PrimitiveHandle >& Primitives;
+		Ray																		ViewRay;
+		CIsect																Closest;
+	};
+
+	// Stops on the first primitive, which blocks the ray, light sources don't cast shadows
+	struct AnyOccluderVisitor
+	{
+		AnyOccluderVisitor(const CompiledScene& scene, const std::vector< PrimitiveHandle >& primitives, const Ray& ray)
+			: Scene(scene),
+				Primitives(primitives),
+				ViewRay(ray),
+				Found(false)
+		{
+		}
+
+		bool operator()(unsigned primitive, float*)
+		{
+			const PrimitiveHandle handle = Primitives[primitive];
+			Found = !Scene.isLight(handle) && Scene.occluded(handle, ViewRay);
+			return Found;
+		}
+
+		const CompiledScene&									Scene;
+		const std::vector< PrimitiveHandle >& Primitives;
+		const Ray&														ViewRay;
+		bool																	Found;
+	};
+
+	// Calls primitives of reached leaves with the packet
+	struct ClosestPacketVisitor
+	{
+		ClosestPacketVisitor(const CompiledScene& scene, const std::vector< PrimitiveHandle >& primitives, const BVH& hierarchy, const RayPacket& packet, CIsect* isects)
+			: Scene(scene),
+				Primitives(primitives),
+				Nodes(hierarchy.getNodes()),
+				Indices(hierarchy.getIndices()),
+				Packet(packet),
+				Isects(isects)
+		{
+		}
+
+		bool operator()(unsigned leaf, unsigned mask, float* maxDistances)
+		{
+			const BVHNode& node = Nodes[leaf];
+			for (unsigned idx = node.Offset, last = node.Offset + node.Count; idx < last; ++idx)
+			{
+				Scene.intersectPacket(Primitives[Indices[idx]], Packet, mask, maxDistances, Isects);
+			}
+			return false;
+		}
+
+		const CompiledScene&									Scene;
+		const std::vector< PrimitiveHandle >& Primitives;
+		const std::vector< BVHNode >&					Nodes;
+		const std::vector< unsigned >&				Indices;
+		const RayPacket&											Packet;
+		CIsect*																Isects;
+	};
+}
+
+CompiledScene::CompiledScene()
+{
+}
+
+template <class Geometry>
+PrimitiveHandle CompiledScene::add(PrimitiveArray< Geometry >* primitives, PrimitiveType type, const Geometry& geometry, IShape* object)
+{
+	PrimitiveHandle handle;
+	handle.Type	 = type;
+	handle.Index = primitives->Geometries.size();
+
+	primitives->Geometries.push_back(geometry);
+	primitives->Objects.push_back(object);
+	primitives->Lights.push_back(object->isLight());
+	return handle;
+}
+
+template <class Operation>
+bool CompiledScene::dispatch(PrimitiveHandle handle, Operation& operation) const
+{
+	switch (handle.Type)
+	{
+	case PRIMITIVE_SPHERE:
+		return operation(mSpheres, handle.Index);
+	case PRIMITIVE_PLANE:
+		return operation(mPlanes, handle.Index);
+	case PRIMITIVE_BOX:
+		return operation(mBoxes, handle.Index);
+	case PRIMITIVE_CYLINDER:
+		return operation(mCylinders, handle.Index);
+	case PRIMITIVE_CONE:
+		return operation(mCones, handle.Index);
+	case PRIMITIVE_TORUS:
+		return operation(mTori, handle.Index);
+	case PRIMITIVE_TRIANGLE:
+		return operation(mTriangles, handle.Index);
+	default:
+		return operation(mShapes, handle.Index);
+	}
+}
+
+void CompiledScene::compile(const std::vector< IShape* >& objects, BVHBuildMode hierarchyMode)
+{
+	clear();
+
+	std::vector< BBox > bounds;
+	for (unsigned idx = 0, count = objects.size(); idx < count; ++idx)
+	{
+		IShape*		 object = objects[idx];
+		const BBox box		= object->getBBox();
+
+		// Empty objects, e.g. CSG intersection of disjoint operands, can't be hit
+		if (box.isFinite() && box.isEmpty())
+		{
+			continue;
+		}
+
+		// Type is checked only once, while the scene is compiled
+		PrimitiveHandle handle;
+		if (const Sphere* sphere = dynamic_cast< const Sphere* >(object))
+		{
+			handle = add(&mSpheres, PRIMITIVE_SPHERE, sphere->getGeometry(), object);
+		}
+		else if (const Plane* plane = dynamic_cast< const Plane* >(object))
+		{
+			handle = add(&mPlanes, PRIMITIVE_PLANE, plane->getGeometry(), object);
+		}
+		else if (const Box* boxShape = dynamic_cast< const Box* >(object))
+		{
+			handle = add(&mBoxes, PRIMITIVE_BOX, boxShape->getGeometry(), object);
+		}
+		else if (const Cylinder* cylinder = dynamic_cast< const Cylinder* >(object))
+		{
+			handle = add(&mCylinders, PRIMITIVE_CYLINDER, cylinder->getGeometry(), object);
+		}
+		else if (const Cone* cone = dynamic_cast< const Cone* >(object))
+		{
+			handle = add(&mCones, PRIMITIVE_CONE, cone->getGeometry(), object);
+		}
+		else if (const Torus* torus = dynamic_cast< const Torus* >(object))
+		{
+			handle = add(&mTori, PRIMITIVE_TORUS, torus->getGeometry(), object);
+		}
+		else if (const Triangle* triangle = dynamic_cast< const Triangle* >(object))
+		{
+			handle = add(&mTriangles, PRIMITIVE_TRIANGLE, triangle->getGeometry(), object);
+		}
+		else
+		{
+			handle = add(&mShapes, PRIMITIVE_SHAPE, object, object);
+		}
+
+		if (box.isFinite())
+		{
+			mBounded.push_back(handle);
+			bounds.push_back(box);
+		}
+		else
+		{
+			mUnbounded.push_back(handle);
+		}
+	}
+
+	mHierarchy.build(bounds, 4, 1, hierarchyMode);
+}
+
+bool CompiledScene::refit(float maxCostGrowth)
+{
+	GUpdateGeometries< Sphere >(&mSpheres);
+	GUpdateGeometries< Plane >(&mPlanes);
+	GUpdateGeometries< Box >(&mBoxes);
+	GUpdateGeometries< Cylinder >(&mCylinders);
+	GUpdateGeometries< Cone >(&mCones);
+	GUpdateGeometries< Torus >(&mTori);
+	GUpdateGeometries< Triangle >(&mTriangles);
+
+	// Objects are called through their interface, so their bounds are collected in parallel too
+	const unsigned			count = mBounded.size();
+	std::vector< BBox > bounds(count);
+	std::atomic< bool > bounded(true);
+	ParallelFor(count, count < cMinParallelRefit ? 1 : ParallelThreadsCount(0), [&](unsigned /*thread*/, unsigned first, unsigned last)
+	{
+		for (unsigned idx = first; idx < last; ++idx)
+		{
+			bounds[idx] = getObject(mBounded[idx])->getBBox();
+			if (!bounds[idx].isFinite() || bounds[idx].isEmpty())
+			{
+				bounded = false;
+			}
+		}
+	});
+
+	if (!bounded)
+	{
+		return false;
+	}
+
+	mHierarchy.refit(bounds);
+
+	const float builtCost = mHierarchy.getBuildStats().SAHCost;
+	return builtCost <= 0.f || mHierarchy.getSAHCost() <= builtCost * maxCostGrowth;
+}
+
+void CompiledScene::clear()
+{
+	mSpheres		= PrimitiveArray< SphereGeometry >();
+	mPlanes			= PrimitiveArray< PlaneGeometry >();
+	mBoxes			= PrimitiveArray< BoxGeometry >();
+	mCylinders	= PrimitiveArray< CylinderGeometry >();
+	mCones			= PrimitiveArray< ConeGeometry >();
+	mTori				= PrimitiveArray< TorusGeometry >();
+	mTriangles	= PrimitiveArray< TriangleGeometry >();
+	mShapes			= PrimitiveArray< IShape* >();
+	mHierarchy.clear();
+	mBounded.clear();
+	mUnbounded.clear();
+}
+
+CIsect CompiledScene::intersect(const Ray& ray) const
+{
+	// Unbounded primitives are checked first, so their intersections can cull the hierarchy
+	ClosestVisitor unbounded(*this, mUnbounded, ray);
+	float					 closestDistance = ray.getTMax();
+	for (unsigned idx = 0, count = mUnbounded.size(); idx < count; ++idx)
+	{
+		unbounded(idx, &closestDistance);
+	}
+
+	Ray bounded = ray;
+	bounded.setTMax(closestDistance);
+
+	ClosestVisitor boundedVisitor(*this, mBounded, bounded);
+	mHierarchy.traverse(bounded, boundedVisitor);
+
+	CIsect closest = boundedVisitor.Closest.Exists ? boundedVisitor.Closest : unbounded.Closest;
+	if (closest.Exists)
+	{
+		resolveObject(&closest);
+	}
+	return closest;
+}
+
+void CompiledScene::intersect(const RayPacket& packet, unsigned mask, float* maxDistances, CIsect* isects) const
+{
+	// Unbounded primitives are checked first, so their intersections can cull the hierarchy
+	for (unsigned idx = 0, count = mUnbounded.size(); idx < count; ++idx)
+	{
+		intersectPacket(mUnbounded[idx], packet, mask, maxDistances, isects);
+	}
+
+	ClosestPacketVisitor bounded(*this, mBounded, mHierarchy, packet, isects);
+	mHierarchy.traversePacket(packet, mask, maxDistances, bounded);
+
+	for (unsigned idx = 0; idx < RAY_PACKET_SIZE; ++idx)
+	{
+		if ((mask & (1 << idx)) != 0 && isects[idx].Exists)
+		{
+			resolveObject(&isects[idx]);
+		}
+	}
+}
+
+bool CompiledScene::occluded(const Ray& ray) const
+{
+	AnyOccluderVisitor unbounded(*this, mUnbounded, ray);
+	for (unsigned idx = 0, count = mUnbounded.size(); idx < count; ++idx)
+	{
+		if (unbounded(idx, NULL))
+		{
+			return true;
+		}
+	}
+
+	AnyOccluderVisitor bounded(*this, mBounded, ray);
+	mHierarchy.traverse(ray, bounded);
+
+	return bounded.Found;
+}
+
+bool CompiledScene::intersect(PrimitiveHandle handle, const Ray& ray, CIsect* isect) const
+{
+	IntersectOperation operation(ray, isect);
+	if (!dispatch(handle, operation))
+	{
+		return false;
+	}
+
+	isect->Handle = handle;
+	return true;
+}
+
+bool CompiledScene::occluded(PrimitiveHandle handle, const Ray& ray) const
+{
+	OccludedOperation operation(ray);
+	return dispatch(handle, operation);
+}
+
+unsigned CompiledScene::intersectPacket(PrimitiveHandle handle, const RayPacket& packet, unsigned mask, float* maxDistances, CIsect* isects) const
+{
+	PacketOperation operation(packet, mask, maxDistances, isects);
+	dispatch(handle, operation);
+
+	for (unsigned idx = 0; idx < RAY_PACKET_SIZE; ++idx)
+	{
+		if ((operation.Found & (1 << idx)) != 0)
+		{
+			isects[idx].Handle = handle;
+		}
+	}
+	return operation.Found;
+}
+
+IShape* CompiledScene::getObject(PrimitiveHandle handle) const
+{
+	ObjectOperation operation;
+	dispatch(handle, operation);
+	return operation.Object;
+}
+
+bool CompiledScene::isLight(PrimitiveHandle handle) const
+{
+	ObjectOperation operation;
+	dispatch(handle, operation);
+	return operation.Light;
+}
+
+unsigned CompiledScene::getCount(PrimitiveType type) const
+{
+	PrimitiveHandle handle;
+	handle.Type	 = type;
+	handle.Index = 0;
+
+	CountOperation operation;
+	dispatch(handle, operation);
+	return operation.Count;
+}
+
+void CompiledScene::resolveObject(CIsect* isect) const
+{
+	// Other shapes set the object themselves, e.g. CSG tree reports its hit operand
+	if (isect->Handle.Type != PRIMITIVE_SHAPE)
+	{
+		isect->Object = getObject(isect->Handle);
+	}
+}
@@ -0,0 +1,107 @@
+#ifndef TRACER_COMPILEDSCENE_H
+	#define TRACER_COMPILEDSCENE_H
+
+	#include <vector>
+
+	#include "geometry/box.h"
+	#include "geometry/bvh.h"
+	#include "geometry/cone.h"
+	#include "geometry/cylinder.h"
+	#include "geometry/intersection.h"
+	#include "geometry/plane.h"
+	#include "geometry/sphere.h"
+	#include "geometry/torus.h"
+	#include "geometry/triangle.h"
+
+	struct IShape;
+
+	// Primitives of one type: their geometry is stored contiguously, while objects are kept for shading.
+	// For PRIMITIVE_SHAPE geometry is the object itself
+	template <class Geometry>
+	struct PrimitiveArray
+	{
+		std::vector< Geometry > Geometries;
+		std::vector< IShape* >	Objects;
+		std::vector< bool >			Lights;
+	};
+
+	// Scene objects, compiled for rendering. Built-in shapes are grouped by type and intersected by kernels,
+	// specialized for their geometry, so the hot path doesn't make virtual calls. Objects stay owned by the scene,
+	// which authors them through IShape, compiled scene only refers to them
+	class CompiledScene
+	{
+	public:
+		explicit CompiledScene();
+
+		//! Group objects by type and build hierarchy over bounded ones, objects must outlive compiled scene
+		void compile(const std::vector< IShape* >& objects, BVHBuildMode hierarchyMode = BVH_BUILD_SAH);
+
+		//! Update geometry of primitives from their objects, which have moved since the compile, and refit hierarchy.
+		//! Returns false if an object has lost its bounds or hierarchy SAH cost has grown more than maxCostGrowth times
+		//! since it was built, then scene must be compiled again
+		bool refit(float maxCostGrowth);
+
+		void clear();
+
+		//! Find closest intersection inside of the ray interval, hit object is resolved, but its normal isn't evaluated
+		CIsect intersect(const Ray& ray) const;
+
+		//! Find closest intersections for the packet rays from the mask, max distances are shrunk to found hits
+		void intersect(const RayPacket& packet, unsigned mask, float* maxDistances, CIsect* isects) const;
+
+		//! Check if any object, except of light sources, is hit inside of the ray interval
+		bool occluded(const Ray& ray) const;
+
+		//! Intersect one primitive, found hit has the primitive handle, but object isn't set for built-in shapes
+		bool intersect(PrimitiveHandle handle, const Ray& ray, CIsect* isect) const;
+
+		//! Check if one primitive is hit inside of the ray interval
+		bool occluded(PrimitiveHandle handle, const Ray& ray) const;
+
+		//! Intersect one primitive with the packet rays from the mask, returns mask of rays with found intersections
+		unsigned intersectPacket(PrimitiveHandle handle, const RayPacket& packet, unsigned mask, float* maxDistances, CIsect* isects) const;
+
+		//! Get scene object, which the primitive was compiled from
+		IShape* getObject(PrimitiveHandle handle) const;
+
+		bool isLight(PrimitiveHandle handle) const;
+
+		//! Get count of compiled primitives of given type
+		unsigned getCount(PrimitiveType type) const;
+
+		const BVH& getHierarchy() const
+		{
+			return mHierarchy;
+		}
+
+	private:
+		// Disable copy and assignment
+		CompiledScene(const CompiledScene&);
+		CompiledScene& operator=(const CompiledScene&);
+
+		template <class Geometry>
+		PrimitiveHandle add(PrimitiveArray< Geometry >* primitives, PrimitiveType type, const Geometry& geometry, IShape* object);
+
+		//! Call operation with the array of the primitive type and primitive index
+		template <class Operation>
+		bool dispatch(PrimitiveHandle handle, Operation& operation) const;
+
+		//! Set object of the found hit from its handle
+		void resolveObject(CIsect* isect) const;
+
+	private:
+		PrimitiveArray< SphereGeometry >	 mSpheres;
+		PrimitiveArray< PlaneGeometry >		 mPlanes;
+		PrimitiveArray< BoxGeometry >			 mBoxes;
+		PrimitiveArray< CylinderGeometry > mCylinders;
+		PrimitiveArray< ConeGeometry >		 mCones;
+		PrimitiveArray< TorusGeometry >		 mTori;
+		PrimitiveArray< TriangleGeometry > mTriangles;
+		PrimitiveArray< IShape* >					 mShapes;
+		// Hierarchy is built over bounded primitives, unbounded ones are checked separately
+		BVH																 mHierarchy;
+		std::vector< PrimitiveHandle >		 mBounded;
+		std::vector< PrimitiveHandle >		 mUnbounded;
+	};
+
+#endif // TRACER_COMPILEDSCENE_H
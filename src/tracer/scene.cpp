@@ -6,6 +6,9 @@
 //  
 //-------------------------------------------------------------------
 
+#include <algorithm>
+
+#include "geometry/mesh.h"
 #include "illumination/lightsource.h"
 #include "illumination/material.h"
 #include "interfaces/ishape.h"
@@ -15,14 +18,37 @@
 #include "scene.h"
 
 #define TOO_FAR_AWAY		 1000000.f
+// Refitted hierarchy is rebuilt, when its SAH cost grows by half
+#define HIERARCHY_REBUILD_GROWTH 1.5f
+
+namespace
+{
+	// Shading normal is evaluated only once, for the closest hit
+	void GResolveNormal(const Ray& ray, CIsect* isect)
+	{
+		isect->Normal = isect->Object->getNormal(ray, isect->Distance, *isect);
+		if (isect->FlipNormal)
+		{
+			isect->Normal = -isect->Normal;
+		}
+	}
+
+	Mtrl GCreateAirProperties()
+	{
+		Mtrl air;
+		
+		air.Refraction = 1.f;			// No refraction
+		air.Reflection = 0.f;			// No reflection
+		air.Density    =	1.f;			// = No refraction
+
+		return air;
+	}
+}
 
 const Mtrl* Scene::GetDefaultAirProperties()
 {
-	static Mtrl cAir;
-	
-	cAir.Refraction = 1.f;			// No refraction
-	cAir.Reflection = 0.f;			// No reflection
-	cAir.Density    =	1.f;			// = No refraction
+	// Initialized only once, so rendering threads can share it
+	static const Mtrl cAir = GCreateAirProperties();
 	
 	return &cAir;
 }
@@ -31,7 +57,9 @@ Scene::Scene()
 	: mBackground(NULL),
 		mCamera(NULL),
 		mTracerProperties(NULL),
-		mTracerDepth(0.f)
+		mTracerDepth(0.f),
+		mHierarchyMode(BVH_BUILD_SAH),
+		mHierarchyRebuildGrowth(HIERARCHY_REBUILD_GROWTH)
 {
 }
 
@@ -40,44 +68,53 @@ Scene::~Scene()
 	clear();
 }
 
-CIsect Scene::intersect(const Ray& ray, bool stopIfFound) const
+CIsect Scene::intersect(const Ray& ray) const
 {
-	// Find closest ray object intersection
-	float				 closestDistance = TOO_FAR_AWAY;
-	bool				 anyFound				 = false;
-	CIsect closestCIsect(false);
-
-	for (int obj = 0, count = mObjects.size(); obj < count; ++obj)
+	CIsect closest = mCompiled.intersect(clip(ray));
+	if (closest.Exists)
 	{
-		CIsect isect = mObjects[obj]->intersect(ray);
-		if (!isect.Exists)
-		{
-			continue;
-		}
+		GResolveNormal(ray, &closest);
+	}
 
-		// Filter depth, if it's set, I mean if it's greater than zero
-		if (mTracerDepth > 0.f && isect.Distance > mTracerDepth)
-		{
-			continue;
-		}
+	return closest;
+}
 
-		if (isect.Distance < closestDistance || !anyFound)
-		{
-			closestDistance			= isect.Distance;
-			closestCIsect = isect;
-			anyFound						= true;
-		}
+void Scene::intersect(const RayPacket& packet, unsigned mask, CIsect* isects) const
+{
+	float maxDistances[RAY_PACKET_SIZE];
+	for (unsigned idx = 0; idx < RAY_PACKET_SIZE; ++idx)
+	{
+		maxDistances[idx] = clip(packet.Rays[idx]).getTMax();
+		isects[idx]				= CIsect(false);
+	}
+
+	mCompiled.intersect(packet, mask, maxDistances, isects);
 
-		if (stopIfFound)
+	for (unsigned idx = 0; idx < RAY_PACKET_SIZE; ++idx)
+	{
+		if ((mask & (1 << idx)) != 0 && isects[idx].Exists)
 		{
-			return closestCIsect;
+			GResolveNormal(packet.Rays[idx], &isects[idx]);
 		}
 	}
+}
+
+bool Scene::occluded(const Ray& ray) const
+{
+	return mCompiled.occluded(ray);
+}
+
+Ray Scene::clip(const Ray& ray) const
+{
+	// Filter depth, if it's set, I mean if it's greater than zero
+	const float maxDistance = mTracerDepth > 0.f ? mTracerDepth : TOO_FAR_AWAY;
 
-	return closestCIsect;
+	Ray clipped = ray;
+	clipped.setTMax(std::min(ray.getTMax(), maxDistance));
+	return clipped;
 }
 
-Color Scene::illuminate(const Ray& viewRay, IShape* object, float distance, const Vec3D& normal) const
+Color Scene::illuminate(const Ray& viewRay, const CIsect& isect) const
 {
 	Color resultColor;
 	for (int light = 0, count = mLights.size(); light < count; ++light)
@@ -85,7 +122,7 @@ Color Scene::illuminate(const Ray& viewRay, IShape* object, float distance, cons
 		const LightSource* source = mLights[light];
 
 		// The more rays are computed, the less intensivity will be
-		resultColor += (source->computeColor(*this, object, viewRay, distance, normal));
+		resultColor += (source->computeColor(*this, viewRay, isect));
 	}
 	return resultColor;
 }
@@ -95,6 +132,47 @@ void Scene::addObject(IShape *object)
 	mObjects.push_back(object);
 }
 
+void Scene::buildHierarchy()
+{
+	mCompiled.compile(mObjects, mHierarchyMode);
+}
+
+bool Scene::updateHierarchy()
+{
+	if (mCompiled.refit(mHierarchyRebuildGrowth))
+	{
+		return false;
+	}
+
+	mCompiled.compile(mObjects, mHierarchyMode);
+	return true;
+}
+
+void Scene::setHierarchyRebuildGrowth(float growth)
+{
+	mHierarchyRebuildGrowth = growth;
+}
+
+void Scene::setHierarchyBuildMode(BVHBuildMode mode)
+{
+	mHierarchyMode = mode;
+}
+
+void Scene::addMesh(const std::string& name, Mesh* mesh)
+{
+	mMeshes[name] = mesh;
+}
+
+Mesh* Scene::getMesh(const std::string& name) const
+{
+	std::map< std::string, Mesh* >::const_iterator found = mMeshes.find(name);
+	if (found == mMeshes.end())
+	{
+		return NULL;
+	}
+	return found->second;
+}
+
 void Scene::addLightSource(LightSource *light)
 {
 	mLights.push_back(light);
@@ -148,6 +226,13 @@ void Scene::clear()
 		mObjects[idx] = NULL;
 	}
 	mObjects.clear();
+	mCompiled.clear();
+	// Models are deleted, so meshes aren't used anymore
+	for (std::map< std::string, Mesh* >::iterator mesh = mMeshes.begin(); mesh != mMeshes.end(); ++mesh)
+	{
+		delete mesh->second;
+	}
+	mMeshes.clear();
 	for (int idx = 0, count = mLights.size(); idx < count; ++idx)
 	{
 		delete mLights[idx];
@@ -1,18 +1,24 @@
 #ifndef TRACER_SCENE_H
 	#define TRACER_SCENE_H
 	
+	#include <map>
+	#include <string>
 	#include <vector>
 
 	#include "geometry/intersection.h"
 
 	#include "illumination/types.h"
 
+	#include "tracer/compiledscene.h"
+
 	class	 Camera;
 	struct CameraProperties;
 	struct IShape;
 	struct LightSource;
+	class  Mesh;
 	struct Mtrl;
 	class  Ray;
+	struct RayPacket;
 	struct TracerProperties;
 	
 
@@ -27,14 +33,50 @@
 
 		~Scene();
 
-		//! Find closest intersection with one of the scene objects
-		CIsect intersect(const Ray& ray, bool stopIfFound) const;
+		//! Find closest intersection with one of the scene objects inside of the ray interval and evaluate its normal
+		CIsect intersect(const Ray& ray) const;
+
+		//! Find closest intersections for the packet rays from the mask, every ray gets the same result as if it was intersected alone
+		void intersect(const RayPacket& packet, unsigned mask, CIsect* isects) const;
+
+		//! Check if any object, except of light sources, is hit inside of the ray interval, e.g. for shadow rays.
+		//! Search stops on the first found object, intersection data isn't evaluated
+		bool occluded(const Ray& ray) const;
 
-		//! Illuminate scene in given pnt (calculated along ray direction at given distance)
-		Color illuminate(const Ray& viewRay, IShape* object, float distance, const Vec3D& normal) const;
+		//! Illuminate scene in the closest intersection of the view ray
+		Color illuminate(const Ray& viewRay, const CIsect& isect) const;
 
 		void addObject(IShape* object);
 
+		//! Compile objects and build their hierarchy, must be called after all the objects are added
+		void buildHierarchy();
+
+		//! Update hierarchy after objects have moved, e.g. between animation frames. Hierarchy is refitted,
+		//! until its SAH cost grows past the rebuild threshold, then it's built again. Returns true if it was rebuilt
+		bool updateHierarchy();
+
+		//! Set how many times hierarchy SAH cost may grow by refits, before it's rebuilt
+		void setHierarchyRebuildGrowth(float growth);
+
+		//! Set builder of the object hierarchy, it's also default for meshes, which don't choose their own
+		void setHierarchyBuildMode(BVHBuildMode mode);
+
+		BVHBuildMode getHierarchyBuildMode() const
+		{
+			return mHierarchyMode;
+		}
+
+		//! Add mesh, shared by models, scene takes ownership of it. Mesh names must be unique
+		void addMesh(const std::string& name, Mesh* mesh);
+
+		//! Get previously added mesh or NULL if there is no mesh with given name
+		Mesh* getMesh(const std::string& name) const;
+
+		const std::map< std::string, Mesh* >& getMeshes() const
+		{
+			return mMeshes;
+		}
+
 		void addLightSource(LightSource* light);
 
 		void setBackground(Mtrl* bgMtrl);
@@ -54,6 +96,12 @@
 			return mObjects;
 		}
 
+		//! Get hierarchy of bounded objects, it's built by buildHierarchy
+		const BVH& getHierarchy() const
+		{
+			return mCompiled.getHierarchy();
+		}
+
 		const std::vector< LightSource* > &getLights() const
 		{
 			return mLights;
@@ -89,13 +137,22 @@
 		Scene(const Scene&);
 		Scene& operator=(const Scene&);
 
+		//! Limit ray interval with the tracer depth
+		Ray clip(const Ray& ray) const;
+
 	private:
 		std::vector< IShape* >			mObjects;
+		// Objects, grouped by type for intersection, with hierarchy over bounded ones
+		CompiledScene								mCompiled;
+		// Meshes, instantiated by models, are owned by the scene
+		std::map< std::string, Mesh* > mMeshes;
 		std::vector< LightSource* > mLights;
 		Mtrl									 *mBackground;
 		Camera										 *mCamera;
 		TracerProperties					 *mTracerProperties;
 		float												mTracerDepth;
+		BVHBuildMode								mHierarchyMode;
+		float												mHierarchyRebuildGrowth;
 		// Explicitly store dimensions of the scene
 		int													mImagePlaneW;
 		int													mImagePlaneH;
@@ -7,12 +7,14 @@
 //-------------------------------------------------------------------
 
 #include <assert.h>
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
 #include <iostream>
-#include <ctime>
 #include <string>
 
 #include "geometry/ray.h"
+#include "geometry/raypacket.h"
 #include "illumination/lightsource.h"
 #include "illumination/material.h"
 #include "interfaces/ishape.h"
@@ -20,11 +22,13 @@
 #include "camera.h"
 #include "scene.h"
 #include "tracerproperties.h"
+#include "workstealingpool.h"
 
 #include "tracer.h"
 
 #define EXPOSURE_FACTOR  -1.0f
 #define COMPONENTS_COUNT 4
+#define TILE_SIZE				 16
 #define RGBA(r, g, b, a) ((a & 0xff) << 24) | ((r & 0xff) << 16) | ((g & 0xff) << 8) | (b & 0xff);
 
 #define PRINT_DEBUG
@@ -38,17 +42,16 @@ namespace
 											 const Vec3D& outNormal,
 											 bool* isTotalInternalReflection)
 	{
-		const float nue				 = sourceEnvDensity / targetEnvDensity;
-		const float cosThetaS  = -dot(outNormal, sourceDir);
-		const float cosThetaT2 = 1.f - nue * nue * (1.f - cosThetaS * cosThetaS); // Squared
+		const float nue = sourceEnvDensity / targetEnvDensity;
 
-		if (cosThetaT2 < 0.f)
+		Vec3D refracted;
+		if (!refract(sourceDir, outNormal, nue, &refracted))
 		{
 			*isTotalInternalReflection = true;
 			return Vec3D();
 		}
 
-		return ((nue * sourceDir) + (nue * cosThetaS - sqrtf(cosThetaT2)) * outNormal).toUnit();
+		return refracted.toUnit();
 	}
 
 	float GGetFresnelFactor(const Vec3D& sourceDir, 
@@ -104,7 +107,8 @@ namespace
 
 
 Tracer::Tracer()
-	: mCurrentExposureFactor(-1.f)
+	: mCurrentExposureFactor(-1.f),
+		mThreadsCount(0)
 {
 }
 
@@ -114,94 +118,141 @@ Tracer::~Tracer()
 
 void Tracer::render(const Scene& scene, unsigned char* image)
 {
-	const int		cImgPlaneW  = scene.getImagePlaneW();
-	const int		cImgPlaneH = scene.getImagePlaneH();
-	const float cAirRefraction		= Scene::GetDefaultAirProperties()->Refraction;
+	const int cImgPlaneW = scene.getImagePlaneW();
+	const int cImgPlaneH = scene.getImagePlaneH();
 
 	//calculateExposure(scene);
 
-	Camera* const camera = scene.getCamera();
-
 	unsigned* data = reinterpret_cast< unsigned* >(image);
 
+	const int tilesX			= (cImgPlaneW + TILE_SIZE - 1) / TILE_SIZE;
+	const int tilesY			= (cImgPlaneH + TILE_SIZE - 1) / TILE_SIZE;
+	const int tilesCount = tilesX * tilesY;
+
 	#ifdef PRINT_DEBUG
-	const unsigned pixelsCount   = cImgPlaneW * cImgPlaneH;
-	float		progress					   = 0;
-	double  lastTime					   = 0.0;
-	static const char cursor[]   = "-\\|/";
-	static int				cursor_idx = 0;
+	std::atomic< int >										 tilesDone(0);
+	std::chrono::steady_clock::time_point lastTime	 = std::chrono::steady_clock::now();
+	static const char											 cursor[]	 = "-\\|/";
+	int																		 cursor_idx = 0;
 	#endif // PRINT_DEBUG
 
-	for (int y = 0; y < cImgPlaneH; ++y)
+	WorkStealingPool pool(mThreadsCount);
+	pool.run(tilesCount, [&](unsigned tile, unsigned thread)
 	{
-		
-		for (int x = 0; x < cImgPlaneW; ++x)
-		{
-			Ray					 ray   = camera->lookThrough(x, y);
-			CIsect isect;
-			Color				 pixel = compute(scene, 
-																	 ray, 
-																	 0,								// Initial recursion depth
-																	 1.f,						  // Initial reflection intensity
-																	 cAirRefraction,  // Ray's starting from air
-																	 &isect);
-
-			// Compute exposure for color component, instead of saturation
-			float fRed = COLOR_R(pixel);
-			float	fGreen = COLOR_G(pixel); 
-			float fBlue = COLOR_B(pixel);
-			if (camera->hasExposure())
-			{
-				postprocessColor(pixel, &fRed, &fGreen, &fBlue);
-			}
-			else
-			{
-				saturateColor(pixel, &fRed, &fGreen, &fBlue);
-			}
-
-			if (camera->hasGammaCorrection())
-			{
-				fRed	 = gammaCorrection(fRed);
-				fGreen = gammaCorrection(fGreen);
-				fBlue  = gammaCorrection(fBlue);
-			}
-			
-			// Saturate values
-			unsigned char red   = static_cast<unsigned char>(std::min<unsigned>(fRed * 255, 255));
-			unsigned char green = static_cast<unsigned char>(std::min<unsigned>(fGreen * 255, 255)); 
-			unsigned char blue  = static_cast<unsigned char>(std::min<unsigned>(fBlue * 255, 255));
-			
-			int index = y * cImgPlaneW + x;
-			*(data + index) = RGBA(red, green, blue, 255);
+		renderTile(scene, tile, data);
 
-			// Kills perfomance, but gives comfort
-			#ifdef PRINT_DEBUG
-			double time = static_cast<double>(std::clock());
-			if (time - lastTime > CLOCKS_PER_SEC)
+		// Kills perfomance, but gives comfort
+		#ifdef PRINT_DEBUG
+		const int done = ++tilesDone;
+		if (thread == 0)
+		{
+			std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now();
+			if (time - lastTime > std::chrono::seconds(1))
 			{
-				progress = (index * 1.f / pixelsCount * 100.f);
-				//GClearConsole();
+				const float progress = (done * 1.f / tilesCount * 100.f);
 				
 				std::cout << cursor[cursor_idx] << " ";	
 				cursor_idx = (cursor_idx + 1) % (sizeof(cursor) - 1);
 
 				std::cout << "Progress: " << progress << "%; ";
-				std::cout << "Passed pixel " << x << ", " << y << "\r";
+				std::cout << "Passed tiles " << done << " of " << tilesCount << "\r";
 				lastTime = time;
 			}
-			#endif // PRINT_DEBUG
 		}
-	}
+		#endif // PRINT_DEBUG
+	});
 
 	std::cout << "Progress: 100%; Rendering finished!" << std::endl;
 }
 
+void Tracer::setThreadsCount(unsigned count)
+{
+	mThreadsCount = count;
+}
+
+void Tracer::renderTile(const Scene& scene, int tile, unsigned* data) const
+{
+	const int		cImgPlaneW		 = scene.getImagePlaneW();
+	const int		cImgPlaneH		 = scene.getImagePlaneH();
+	const float cAirRefraction = Scene::GetDefaultAirProperties()->Refraction;
+
+	const Camera* const camera = scene.getCamera();
+
+	const int tilesX = (cImgPlaneW + TILE_SIZE - 1) / TILE_SIZE;
+	const int startX = (tile % tilesX) * TILE_SIZE;
+	const int startY = (tile / tilesX) * TILE_SIZE;
+	const int endX	 = std::min(startX + TILE_SIZE, cImgPlaneW);
+	const int endY	 = std::min(startY + TILE_SIZE, cImgPlaneH);
+
+	// Primary rays of neighbouring pixels are coherent, so they're intersected by packets,
+	// secondary rays are traced one by one
+	RayPacket packet;
+	CIsect		isects[RAY_PACKET_SIZE];
+	for (int y = startY; y < endY; y += RAY_PACKET_WIDTH)
+	{
+		for (int x = startX; x < endX; x += RAY_PACKET_WIDTH)
+		{
+			const unsigned mask = camera->lookThrough(x, y, &packet);
+			scene.intersect(packet, mask, isects);
+
+			for (unsigned idx = 0; idx < RAY_PACKET_SIZE; ++idx)
+			{
+				if ((mask & (1 << idx)) == 0)
+				{
+					continue;
+				}
+
+				const Color pixel = shade(scene, 
+																	packet.Rays[idx], 
+																	isects[idx], 
+																	0,								// Initial recursion depth
+																	1.f,						  // Initial reflection intensity
+																	cAirRefraction);  // Ray's starting from air
+
+				const int pixelX = x + idx % RAY_PACKET_WIDTH;
+				const int pixelY = y + idx / RAY_PACKET_WIDTH;
+				storePixel(*camera, pixel, data + pixelY * cImgPlaneW + pixelX);
+			}
+		}
+	}
+}
+
+void Tracer::storePixel(const Camera& camera, const Color& color, unsigned* pixel) const
+{
+	// Compute exposure for color component, instead of saturation
+	float fRed = COLOR_R(color);
+	float	fGreen = COLOR_G(color); 
+	float fBlue = COLOR_B(color);
+	if (camera.hasExposure())
+	{
+		postprocessColor(color, &fRed, &fGreen, &fBlue);
+	}
+	else
+	{
+		saturateColor(color, &fRed, &fGreen, &fBlue);
+	}
+
+	if (camera.hasGammaCorrection())
+	{
+		fRed	 = gammaCorrection(fRed);
+		fGreen = gammaCorrection(fGreen);
+		fBlue  = gammaCorrection(fBlue);
+	}
+	
+	// Saturate values
+	unsigned char red   = static_cast<unsigned char>(std::min<unsigned>(fRed * 255, 255));
+	unsigned char green = static_cast<unsigned char>(std::min<unsigned>(fGreen * 255, 255)); 
+	unsigned char blue  = static_cast<unsigned char>(std::min<unsigned>(fBlue * 255, 255));
+	
+	*pixel = RGBA(red, green, blue, 255);
+}
+
 Color Tracer::compute(const Scene& scene, 
 											const Ray& ray, 
 											int recursionDepth, 
 											float reflectionIntensity,
 											float sourceEnvDensity,
-											CIsect *out)
+											CIsect *out) const
 {
 	const int													cMaxRecursionDepth = scene.getTracerProperties()->MaxRayRecursionDepth;
 
@@ -210,11 +261,20 @@ Color Tracer::compute(const Scene& scene,
 		return Color();
 	}
 	
+	*out = scene.intersect(ray);
+	return shade(scene, ray, *out, recursionDepth, reflectionIntensity, sourceEnvDensity);
+}
+
+Color Tracer::shade(const Scene& scene, 
+										const Ray& ray, 
+										const CIsect& intersection, 
+										int recursionDepth, 
+										float reflectionIntensity,
+										float sourceEnvDensity) const
+{
 	bool	reflected = recursionDepth != 0;
 	Color resultColor;	
 	
-	CIsect intersection = scene.intersect(ray, false);
-	*out = intersection;
 	if (!intersection.Exists) // No intersections found
 	{
 		if (reflected)
@@ -243,7 +303,7 @@ Color Tracer::compute(const Scene& scene,
 	const Vec3D normal = intersection.Normal;
 		
 	// The more rays are computed, the less intensivity will be
-	resultColor += (scene.illuminate(ray, object, intersection.Distance, normal));
+	resultColor += (scene.illuminate(ray, intersection));
 
 	const Vec3D& rayDir = ray.getDir();
 	const float viewProjection   = dot(rayDir, normal);
@@ -262,7 +322,7 @@ Color Tracer::compute(const Scene& scene,
 	{
 		// Reflect ray	
 		const Vec3D& rayDir = ray.getDir();
-		Vec3D direction = rayDir - 2.f * dot(rayDir, outNormal) * outNormal;
+		const Vec3D direction = reflect(rayDir, outNormal);
 		CIsect reflected;
 		Color reflectedColor = (compute(scene, 
 																	  Ray(isectPoint + direction * EPSILON, direction), 
@@ -286,7 +346,7 @@ Color Tracer::compute(const Scene& scene,
 		{
 			CIsect	 refractedIsect;
 			Color refracted  = compute(scene, 
-																 Ray(isectPoint + direction * EPSILON, direction), 
+																 Ray(isectPoint + direction * EPSILON, direction, Ray::UNIT_DIRECTION), 
 																 recursionDepth + 1, 
 																 reflectionIntensity, 
 																 density, 
@@ -304,21 +364,21 @@ Color Tracer::compute(const Scene& scene,
 	return resultColor;
 }
 
-void Tracer::postprocessColor(const Color& color, float *r, float *g, float *b)
+void Tracer::postprocessColor(const Color& color, float *r, float *g, float *b) const
 {
 	*r = 1.f - expf(COLOR_R(color) * mCurrentExposureFactor);
 	*g = 1.f - expf(COLOR_G(color) * mCurrentExposureFactor);
 	*b = 1.f - expf(COLOR_B(color) * mCurrentExposureFactor);
 }
 
-void Tracer::saturateColor(const Color& color, float *r, float *g, float *b)
+void Tracer::saturateColor(const Color& color, float *r, float *g, float *b) const
 {
 	*r = std::min(COLOR_R(color), 1.f);
 	*g = std::min(COLOR_G(color), 1.f);
 	*b = std::min(COLOR_B(color), 1.f);
 }
 
-float Tracer::gammaCorrection(float color)
+float Tracer::gammaCorrection(float color) const
 {
 	// Use sRGB encoding
 	if (color < 0.0031308f)
@@ -331,15 +391,15 @@ float Tracer::gammaCorrection(float color)
 	}
 }
 
-Color Tracer::getBackgroundColor(const Scene& scene)
+Color Tracer::getBackgroundColor(const Scene& scene) const
 {
 	// Return ambient part of background color for now or forever
 	return scene.getBackground()->AmbColor;
 }
 
-Ray Tracer::reflectRay(const Vec3D& reflectedOrg, const Vec3D& source, const Vec3D& over)
+Ray Tracer::reflectRay(const Vec3D& reflectedOrg, const Vec3D& source, const Vec3D& over) const
 {
-	return Ray(reflectedOrg, (source - 2 * dot(source, over) * over).toUnit());
+	return Ray(reflectedOrg, reflect(source, over).toUnit(), Ray::UNIT_DIRECTION);
 }
 
 void Tracer::calculateExposure(const Scene& scene)
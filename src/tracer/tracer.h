@@ -6,6 +6,7 @@
 	#include "geometry/intersection.h"
 	#include "illumination/types.h"
 
+	class Camera;
 	struct IShape;
 	class Scene;
 	class Ray;
@@ -20,37 +21,55 @@
 		//! Render given scene to the image data array of size width * height * 4 with format ARGB32
 		void render(const Scene& scene, unsigned char* image);
 
+		//! Set number of rendering threads, zero means the number of hardware threads
+		void setThreadsCount(unsigned count);
+
 
 	private:
+		//! Render image tile, tiles are rendered concurrently, so tracer state mustn't be changed here
+		void renderTile(const Scene& scene, int tile, unsigned* data) const;
+
 		//! Find ray intersection with given scene at given coordinates and return computed color
 		Color compute(const Scene& scene, 
 									const Ray& ray, 
 									int recursionDepth, 
 									float reflectionIntensity, 
 									float sourceEnvDensity, 
-									CIsect* out);
+									CIsect* out) const;
+
+		//! Compute color for the found ray intersection
+		Color shade(const Scene& scene, 
+								const Ray& ray, 
+								const CIsect& intersection, 
+								int recursionDepth, 
+								float reflectionIntensity, 
+								float sourceEnvDensity) const;
+
+		//! Apply exposure and gamma correction to computed color and store it to the image pixel
+		void storePixel(const Camera& camera, const Color& color, unsigned* pixel) const;
 
 		//! Apply postprocessing to computed color
-		void postprocessColor(const Color& color, float *r, float *g, float *b);
+		void postprocessColor(const Color& color, float *r, float *g, float *b) const;
 
 		//! Saturate given color
-		void saturateColor(const Color& color, float *r, float *g, float *b);
+		void saturateColor(const Color& color, float *r, float *g, float *b) const;
 
 		//! Apply gamma correction for color component
-		float gammaCorrection(float color);
+		float gammaCorrection(float color) const;
 
 		//! Get scene background color
-		Color getBackgroundColor(const Scene& scene);
+		Color getBackgroundColor(const Scene& scene) const;
 
 		//! Reflect source ray over given vector
-		Ray reflectRay(const Vec3D& reflectedOrg, const Vec3D& source, const Vec3D& over);
+		Ray reflectRay(const Vec3D& reflectedOrg, const Vec3D& source, const Vec3D& over) const;
 
 		//! Calculate exposure factor for the given scene
 		void calculateExposure(const Scene& scene);
 
 	private:
-		//! Current scene exposure factor
-		float mCurrentExposureFactor;
+		//! Current scene exposure factor, it's computed before rendering and only read by the tiles
+		float		 mCurrentExposureFactor;
+		unsigned mThreadsCount;
 	};
 
 #endif // TRACER_TRACER_H
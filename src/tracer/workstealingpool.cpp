@@ -0,0 +1,103 @@
+//-------------------------------------------------------------------
+// File: workstealingpool.cpp
+// 
+// Thread pool with per-thread work queues and work stealing
+//
+//  
+//-------------------------------------------------------------------
+
+#include <algorithm>
+#include <thread>
+
+#include "workstealingpool.h"
+
+WorkStealingPool::WorkStealingPool(unsigned threadsCount)
+	: mThreadsCount(threadsCount)
+{
+	if (mThreadsCount == 0)
+	{
+		mThreadsCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+}
+
+void WorkStealingPool::run(unsigned itemsCount, const Task& task)
+{
+	const unsigned threadsCount = std::min(mThreadsCount, std::max(1u, itemsCount));
+
+	// Every thread gets contiguous range of items, so neighbour items are processed together,
+	// while stealing from the front takes items, which are the furthest from the owner's ones
+	mQueues.resize(threadsCount);
+	for (unsigned thread = 0; thread < threadsCount; ++thread)
+	{
+		mQueues[thread] = new WorkQueue;
+
+		const unsigned first = static_cast< unsigned >(static_cast< unsigned long long >(itemsCount) * thread / threadsCount);
+		const unsigned last	 = static_cast< unsigned >(static_cast< unsigned long long >(itemsCount) * (thread + 1) / threadsCount);
+		for (unsigned item = last; item > first; --item)
+		{
+			mQueues[thread]->Items.push_back(item - 1);
+		}
+	}
+
+	std::vector< std::thread > workers;
+	workers.reserve(threadsCount - 1);
+	for (unsigned thread = 1; thread < threadsCount; ++thread)
+	{
+		workers.push_back(std::thread(&WorkStealingPool::work, this, thread, std::cref(task)));
+	}
+
+	work(0, task);
+
+	for (unsigned idx = 0; idx < workers.size(); ++idx)
+	{
+		workers[idx].join();
+	}
+
+	for (unsigned thread = 0; thread < threadsCount; ++thread)
+	{
+		delete mQueues[thread];
+	}
+	mQueues.clear();
+}
+
+void WorkStealingPool::work(unsigned thread, const Task& task)
+{
+	// No items are added during the run, so once all the queues are empty, work is done
+	unsigned item;
+	while (popOwn(thread, &item) || steal(thread, &item))
+	{
+		task(item, thread);
+	}
+}
+
+bool WorkStealingPool::popOwn(unsigned thread, unsigned* item)
+{
+	WorkQueue& queue = *mQueues[thread];
+
+	std::lock_guard< std::mutex > lock(queue.Lock);
+	if (queue.Items.empty())
+	{
+		return false;
+	}
+	*item = queue.Items.back();
+	queue.Items.pop_back();
+	return true;
+}
+
+bool WorkStealingPool::steal(unsigned thread, unsigned* item)
+{
+	const unsigned threadsCount = mQueues.size();
+	for (unsigned offset = 1; offset < threadsCount; ++offset)
+	{
+		WorkQueue& victim = *mQueues[(thread + offset) % threadsCount];
+
+		std::lock_guard< std::mutex > lock(victim.Lock);
+		if (!victim.Items.empty())
+		{
+			*item = victim.Items.front();
+			victim.Items.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,55 @@
+#ifndef TRACER_WORKSTEALINGPOOL_H
+	#define TRACER_WORKSTEALINGPOOL_H
+
+	#include <deque>
+	#include <functional>
+	#include <mutex>
+	#include <vector>
+
+	// Runs independent work items on several threads. Every thread owns a queue of items,
+	// takes them from its back and steals from the front of other queues when it runs out of work,
+	// so threads with cheap items help the ones with expensive items.
+	class WorkStealingPool
+	{
+	public:
+		//! Work item handler, called with item index and index of the calling thread
+		typedef std::function< void (unsigned item, unsigned thread) > Task;
+
+	public:
+		//! Zero threads count means the number of hardware threads
+		explicit WorkStealingPool(unsigned threadsCount = 0);
+
+		unsigned getThreadsCount() const
+		{
+			return mThreadsCount;
+		}
+
+		//! Process items [0, itemsCount), blocks until all of them are done.
+		//! Calling thread takes part in processing as thread with zero index
+		void run(unsigned itemsCount, const Task& task);
+
+	private:
+		struct WorkQueue
+		{
+			std::mutex						Lock;
+			std::deque< unsigned > Items;
+		};
+
+		//! Process own items and then steal the others, until all the queues are empty
+		void work(unsigned thread, const Task& task);
+
+		bool popOwn(unsigned thread, unsigned* item);
+
+		bool steal(unsigned thread, unsigned* item);
+
+	private:
+		// Disable copy and assignment
+		WorkStealingPool(const WorkStealingPool&);
+		WorkStealingPool& operator=(const WorkStealingPool&);
+
+	private:
+		unsigned									mThreadsCount;
+		std::vector< WorkQueue* > mQueues;
+	};
+
+#endif // TRACER_WORKSTEALINGPOOL_H